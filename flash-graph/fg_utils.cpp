@@ -1461,4 +1461,112 @@ void print_graph_el(FG_graph::ptr fg, const std::string &delim,
 	}
 }
 
+namespace
+{
+
+struct neigh_less
+{
+	bool operator()(const std::pair<vertex_id_t, size_t> &e1,
+			const std::pair<vertex_id_t, size_t> &e2) const {
+		return e1.first < e2.first;
+	}
+};
+
+/*
+ * Write the edge lists at `offs' in the original image in the new order
+ * to the buffer. It returns the location right after the edge lists.
+ */
+char *write_reordered_edge_lists(const char *data,
+		const std::vector<off_t> &offs, size_t edge_data_size,
+		const std::vector<vertex_id_t> &order,
+		const std::vector<vertex_id_t> &new_ids, char *buf,
+		std::vector<vsize_t> &num_edges)
+{
+	std::vector<std::pair<vertex_id_t, size_t> > neighs;
+	num_edges.resize(order.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		const ext_mem_undirected_vertex &v
+			= *(const ext_mem_undirected_vertex *) (data + offs[order[i]]);
+		neighs.clear();
+		for (size_t j = 0; j < v.get_num_edges(); j++)
+			neighs.push_back(std::pair<vertex_id_t, size_t>(
+						new_ids[v.get_neighbor(j)], j));
+		std::stable_sort(neighs.begin(), neighs.end(), neigh_less());
+
+		ext_mem_undirected_vertex *new_v = new (buf) ext_mem_undirected_vertex(
+				i, neighs.size(), edge_data_size);
+		for (size_t j = 0; j < neighs.size(); j++) {
+			new_v->set_neighbor(j, neighs[j].first);
+			if (edge_data_size > 0)
+				memcpy(new_v->get_raw_edge_data(j),
+						v.get_raw_edge_data(neighs[j].second), edge_data_size);
+		}
+		num_edges[i] = neighs.size();
+		buf += new_v->get_size();
+	}
+	return buf;
+}
+
+}
+
+FG_graph::ptr reorder_graph(FG_graph::ptr g,
+		const std::vector<vertex_id_t> &order,
+		const std::string &new_graph_name)
+{
+	assert(g->is_in_mem());
+	vertex_index::ptr vindex = g->get_index_data();
+	const graph_header &header = g->get_graph_header();
+	size_t num_vertices = header.get_num_vertices();
+	assert(order.size() == num_vertices);
+	std::vector<vertex_id_t> new_ids(num_vertices, INVALID_VERTEX_ID);
+	for (size_t i = 0; i < order.size(); i++) {
+		assert(new_ids[order[i]] == INVALID_VERTEX_ID);
+		new_ids[order[i]] = i;
+	}
+
+	size_t size = g->get_graph_data()->get_data().get_length();
+	std::unique_ptr<char[]> data(new char[size]);
+	g->get_graph_data()->get_data().copy_to(data.get(), size, 0);
+	std::vector<off_t> out_offs(num_vertices + 1);
+	init_out_offs(vindex, out_offs);
+	std::vector<off_t> in_offs;
+	if (header.is_directed_graph()) {
+		in_offs.resize(num_vertices + 1);
+		init_in_offs(vindex, in_offs);
+	}
+
+	// Relabeling doesn't change the size of a vertex, so the new image
+	// ends where the out-edge lists of the original image end. The buffer
+	// of the original image may be padded to pages.
+	size_t new_size = out_offs[num_vertices];
+	assert(new_size <= size);
+	std::shared_ptr<char> buf(new char[new_size], std::default_delete<char[]>());
+	memcpy(buf.get(), &header, graph_header::get_header_size());
+	char *end_loc = buf.get() + graph_header::get_header_size();
+	size_t edge_data_size = header.get_edge_data_size();
+	vertex_index::ptr new_vindex;
+	std::vector<vsize_t> num_out_edges;
+	if (header.is_directed_graph()) {
+		std::vector<vsize_t> num_in_edges;
+		end_loc = write_reordered_edge_lists(data.get(), in_offs,
+				edge_data_size, order, new_ids, end_loc, num_in_edges);
+		end_loc = write_reordered_edge_lists(data.get(), out_offs,
+				edge_data_size, order, new_ids, end_loc, num_out_edges);
+		new_vindex = cdirected_vertex_index::construct(num_vertices,
+				num_in_edges.data(), num_out_edges.data(), header);
+	}
+	else {
+		end_loc = write_reordered_edge_lists(data.get(), out_offs,
+				edge_data_size, order, new_ids, end_loc, num_out_edges);
+		new_vindex = cundirected_vertex_index::construct(num_vertices,
+				num_out_edges.data(), header);
+	}
+	assert((size_t) (end_loc - buf.get()) == new_size);
+
+	in_mem_graph::ptr new_graph = in_mem_graph::create(new_graph_name, buf,
+			new_size);
+	return FG_graph::create(new_graph, new_vindex, new_graph_name,
+			g->get_configs());
+}
+
 }
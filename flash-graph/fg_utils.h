@@ -204,6 +204,16 @@ void export_2d_matrix(fm::vector_vector::ptr adjs, size_t num_cols,
 
 void set_deduplicate(bool v);
 void set_remove_self_edge(bool v);
+
+/*
+ * This relabels the vertices of a directed or undirected graph in memory.
+ * `order' contains the original IDs of the vertices in the new order.
+ * The neighbor lists are sorted with the new IDs and the edge data
+ * moves with the edges.
+ */
+fg::FG_graph::ptr reorder_graph(fg::FG_graph::ptr g,
+		const std::vector<fg::vertex_id_t> &order,
+		const std::string &new_graph_name);
 }
 
 #endif
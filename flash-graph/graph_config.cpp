@@ -31,6 +31,12 @@
 namespace fg
 {
 
+static str2int io_classes[] = {
+	{"interactive", safs::IO_CLASS_INTERACTIVE},
+	{"normal", safs::IO_CLASS_NORMAL},
+	{"bulk", safs::IO_CLASS_BULK},
+};
+
 void graph_config::print_help()
 {
 	printf("Configuration parameters in graph algorithm.\n");
@@ -47,6 +53,7 @@ void graph_config::print_help()
 	printf("\tmin_vpart_degree: the min degree of a vertex to perform vertical partitioning\n");
 	printf("\tserial_run: run the user code on a vertex in serial\n");
 	printf("\tvertex_merge_gap: the gap size allowed when merging two vertex requests\n");
+	printf("\tio_class: the priority class of the graph I/O (interactive, normal, bulk)\n");
 }
 
 void graph_config::print()
@@ -65,6 +72,7 @@ void graph_config::print()
 	BOOST_LOG_TRIVIAL(info) << "\tmin_vpart_degree: " << min_vpart_degree;
 	BOOST_LOG_TRIVIAL(info) << "\tserial_run: " << serial_run;
 	BOOST_LOG_TRIVIAL(info) << "\tvertex_merge_gap: " << vertex_merge_gap;
+	BOOST_LOG_TRIVIAL(info) << "\tio_class: " << io_classes[io_class].name;
 }
 
 void graph_config::init(config_map::ptr map)
@@ -94,6 +102,15 @@ void graph_config::init(config_map::ptr map)
 	map->read_option_int("min_vpart_degree", min_vpart_degree);
 	map->read_option_bool("serial_run", serial_run);
 	map->read_option_int("vertex_merge_gap", vertex_merge_gap);
+	std::string io_class_str;
+	if (map->read_option("io_class", io_class_str)) {
+		str2int_map io_class_map(io_classes,
+				sizeof(io_classes) / sizeof(io_classes[0]));
+		int idx = io_class_map.map(io_class_str);
+		if (idx < 0)
+			throw conf_exception("unknown I/O class " + io_class_str);
+		io_class = io_classes[idx].value;
+	}
 }
 
 }
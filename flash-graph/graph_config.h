@@ -24,6 +24,7 @@
 
 #include "log.h"
 #include "config_map.h"
+#include "io_interface.h"
 #include "graph_exception.h"
 
 namespace fg
@@ -48,6 +49,8 @@ class graph_config
 	bool serial_run;
 	// in pages.
 	int vertex_merge_gap;
+	// The priority class of the I/O requests to the graph.
+	int io_class;
 public:
 	/**
 	 * \brief The default constructor that set all configurations to
@@ -67,6 +70,7 @@ public:
 		// When the gap is 0, it means two vertices either in the same page
 		// or two adjacent pages.
 		vertex_merge_gap = 0;
+		io_class = safs::IO_CLASS_NORMAL;
 	}
 
 	/**
@@ -196,6 +200,16 @@ public:
 	int get_vertex_merge_gap() const {
 		return vertex_merge_gap;
 	}
+
+	/**
+	 * \brief Get the priority class of the I/O requests to the graph.
+	 * A short query on the graph can run in the interactive class so that
+	 * it isn't queued behind the I/O of a long-running algorithm.
+	 * \return the I/O class.
+	 */
+	int get_io_class() const {
+		return io_class;
+	}
 };
 
 extern graph_config graph_conf;
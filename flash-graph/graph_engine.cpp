@@ -185,6 +185,15 @@ public:
 	}
 };
 
+class coalesce_comp_io_sched_creator: public comp_io_sched_creator
+{
+public:
+	comp_io_scheduler::ptr create(int node_id) const {
+		return comp_io_scheduler::ptr(new coalesce_comp_io_scheduler(node_id,
+					params.get_io_coalesce_window()));
+	}
+};
+
 size_t throughput_comp_io_scheduler::get_requests(fifo_queue<io_request> &reqs,
 		size_t max)
 {
@@ -551,14 +560,21 @@ void graph_engine::init(graph_index::ptr index)
 
 	max_processing_vertices = graph_conf.get_max_processing_vertices();
 	is_complete = false;
+	num_failed_reads = 0;
 	this->vertices = index;
 
 	pthread_mutex_init(&lock, NULL);
 	pthread_barrier_init(&barrier1, NULL, num_threads);
 	pthread_barrier_init(&barrier2, NULL, num_threads);
 
-	graph_factory->set_sched_creator(comp_io_sched_creator::ptr(
-				new throughput_comp_io_sched_creator()));
+	// Coalescing the requests of all vertices in a window gives the page
+	// cache more chances to merge requests than the per-vertex order.
+	if (params.get_io_coalesce_window() > 0)
+		graph_factory->set_sched_creator(comp_io_sched_creator::ptr(
+					new coalesce_comp_io_sched_creator()));
+	else
+		graph_factory->set_sched_creator(comp_io_sched_creator::ptr(
+					new throughput_comp_io_sched_creator()));
 #if 0
 	set_file_weight(index->get_index_file(), graph_conf.get_index_file_weight());
 #endif
@@ -808,6 +824,12 @@ void graph_engine::wait4complete()
 	BOOST_LOG_TRIVIAL(info)
 		<< boost::format("The graph engine takes %1% seconds to complete")
 		% time_diff(start_time, curr);
+	// The worker threads can't throw when a read fails, so we report it
+	// to the caller here.
+	size_t num_failed = num_failed_reads.exchange(0);
+	if (num_failed > 0)
+		throw safs::io_exception((boost::format(
+						"%1% reads of adjacency lists failed") % num_failed).str());
 }
 
 void graph_engine::set_vertex_scheduler(vertex_scheduler::ptr scheduler)
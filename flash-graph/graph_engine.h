@@ -347,6 +347,9 @@ class graph_engine
 	atomic_number<size_t> num_remaining_vertices_in_level;
 	atomic_integer level;
 	volatile bool is_complete;
+	// The number of I/O requests for adjacency lists that SAFS couldn't
+	// read. The vertices of these requests don't run in the iteration.
+	std::atomic<size_t> num_failed_reads;
 
 	// These are used for switching queues.
 	pthread_mutex_t lock;
@@ -506,12 +509,20 @@ public:
 	void start_all(vertex_initializer::ptr init = vertex_initializer::ptr(),
 			vertex_program_creater::ptr creater = vertex_program_creater::ptr());
     
-    /**
+	/**
      * \brief Synchronization barrier that waits for the graph algorithm to
 	 *        complete.
+	 * It throws safs::io_exception if some adjacency lists couldn't be read.
      */
 	void wait4complete();
 
+	/** \internal
+	 * A worker thread calls it when SAFS can't read adjacency lists.
+	 */
+	void add_failed_read() {
+		num_failed_reads++;
+	}
+
 #if 0
 	/**
 	 * \brief This method preloads the entire graph to the page cache.
@@ -126,6 +126,11 @@ public:
 	virtual vertex_id_t get_vertex_id(int part_id, compute_vertex_pointer v) const = 0;
 	virtual vertex_id_t get_vertex_id(const compute_vertex &v) const = 0;
 	virtual bool belong2part(const compute_vertex &v, int part_id) const = 0;
+	/*
+	 * This returns the partition that stores the vertex state, or -1 if
+	 * the vertex isn't stored in the index.
+	 */
+	virtual int get_part_id(const compute_vertex &v) const = 0;
 };
 
 template<class vertex_type, class part_vertex_type>
@@ -322,6 +327,38 @@ class NUMA_graph_index: public graph_index
 	// A graph index per thread
 	std::vector<std::unique_ptr<graph_local_partition<vertex_type, part_vertex_type> > > index_arr;
 
+	/*
+	 * The address range of a vertex array in a partition.
+	 * All ranges are sorted on the start address, so we can find
+	 * the partition of a vertex with a binary search.
+	 */
+	struct vertex_range
+	{
+		const char *start;
+		const char *end;
+		int part_id;
+
+		bool operator<(const vertex_range &range) const {
+			return start < range.start;
+		}
+	};
+	std::vector<vertex_range> vertex_ranges;
+	// The vertical partitions are initialized in parallel.
+	pthread_mutex_t range_lock;
+
+	void add_vertex_range(const void *start, const void *end, int part_id) {
+		if (start == end)
+			return;
+		vertex_range range;
+		range.start = (const char *) start;
+		range.end = (const char *) end;
+		range.part_id = part_id;
+		pthread_mutex_lock(&range_lock);
+		vertex_ranges.insert(std::upper_bound(vertex_ranges.begin(),
+					vertex_ranges.end(), range), range);
+		pthread_mutex_unlock(&range_lock);
+	}
+
 	class init_thread: public thread
 	{
 		graph_local_partition<vertex_type, part_vertex_type> *index;
@@ -336,7 +373,15 @@ class NUMA_graph_index: public graph_index
 			this->stop();
 		}
 	};
+
+	NUMA_graph_index() {
+		pthread_mutex_init(&range_lock, NULL);
+	}
 public:
+	~NUMA_graph_index() {
+		pthread_mutex_destroy(&range_lock);
+	}
+
 	static graph_index::ptr create(const graph_header &header) {
 		NUMA_graph_index<vertex_type, part_vertex_type> *index
 			= new NUMA_graph_index<vertex_type, part_vertex_type>();
@@ -367,6 +412,10 @@ public:
 			threads[i]->join();
 			delete threads[i];
 		}
+		for (int i = 0; i < num_threads; i++) {
+			vertex_type *arr = index_arr[i]->vertex_arr;
+			add_vertex_range(arr, arr + index_arr[i]->num_vertices, i);
+		}
 
 		min_vertex_id = 0;
 		max_vertex_id = header.get_num_vertices() - 1;
@@ -378,6 +427,12 @@ public:
 	virtual void init_vparts(int hpart_id, int num_vparts,
 			std::vector<vertex_id_t> &ids) {
 		index_arr[hpart_id]->init_vparts(num_vparts, ids);
+		for (size_t i = 0; i < index_arr[hpart_id]->part_vertex_arrs.size(); i++) {
+			part_vertex_type *arr
+				= index_arr[hpart_id]->part_vertex_arrs[i].second;
+			size_t num = index_arr[hpart_id]->part_vertex_arrs[i].first;
+			add_vertex_range(arr, arr + num, hpart_id);
+		}
 	}
 
 	virtual size_t get_vertices(const vertex_id_t ids[], int num,
@@ -491,6 +546,20 @@ public:
 		// TODO there might be a more light-weight implementation.
 		return get_vertex_id(part_id, v) != INVALID_VERTEX_ID;
 	}
+
+	virtual int get_part_id(const compute_vertex &v) const {
+		vertex_range key;
+		key.start = (const char *) &v;
+		typename std::vector<vertex_range>::const_iterator it
+			= std::upper_bound(vertex_ranges.begin(), vertex_ranges.end(), key);
+		if (it == vertex_ranges.begin())
+			return -1;
+		it--;
+		if (key.start < it->end)
+			return it->part_id;
+		else
+			return -1;
+	}
 };
 
 #if 0
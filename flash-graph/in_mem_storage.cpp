@@ -61,17 +61,29 @@ in_mem_graph::ptr in_mem_graph::create(const std::string &graph_name,
 in_mem_graph::ptr in_mem_graph::load_graph(const std::string &file_name)
 {
 	NUMA_mapper mapper(params.get_num_nodes(), GRAPH_CHUNK_SIZE_LOG);
-	safs::NUMA_buffer::ptr numa_buf = safs::NUMA_buffer::load(file_name, mapper);
+	safs::NUMA_buffer::ptr numa_buf;
+	if (params.is_in_mem_mmap())
+		numa_buf = safs::NUMA_buffer::map(file_name, mapper,
+				params.is_in_mem_populate());
+	else
+		numa_buf = safs::NUMA_buffer::load(file_name, mapper);
 	assert(numa_buf);
 	in_mem_graph::ptr graph = in_mem_graph::ptr(new in_mem_graph());
 	graph->graph_size = numa_buf->get_length();
 	graph->graph_data = numa_buf;
 	graph->graph_file_name = file_name;
+	// The page cache may need to give memory to the graph.
+	graph->reserved_size = graph->graph_size;
+	safs::reserve_memory(graph->reserved_size);
 	BOOST_LOG_TRIVIAL(info) << boost::format("load a graph of %1% bytes")
 		% graph->graph_size;
 
-	safs::NUMA_buffer::cdata_info data = numa_buf->get_data(0, PAGE_SIZE);
-	assert(data.first);
+	// A mapped buffer has the exact size of the file, which may be smaller
+	// than a page.
+	safs::NUMA_buffer::cdata_info data = numa_buf->get_data(0,
+			graph_header::get_header_size());
+	if (data.first == NULL)
+		throw wrong_format("the graph file is too small");
 	graph_header *header = (graph_header *) data.first;
 	if (!header->is_graph_file() || !header->is_right_version())
 		throw wrong_format("wrong graph file or format version");
@@ -87,6 +99,9 @@ in_mem_graph::ptr in_mem_graph::load_safs_graph(const std::string &file_name)
 	graph->graph_size = numa_buf->get_length();
 	graph->graph_data = numa_buf;
 	graph->graph_file_name = file_name;
+	// The page cache may need to give memory to the graph.
+	graph->reserved_size = graph->graph_size;
+	safs::reserve_memory(graph->reserved_size);
 
 	BOOST_LOG_TRIVIAL(info) << boost::format("load a graph of %1% bytes")
 		% graph->graph_size;
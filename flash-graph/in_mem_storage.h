@@ -36,17 +36,24 @@ namespace fg
 class in_mem_graph
 {
 	size_t graph_size;
+	// The memory reserved in SAFS for the graph loaded by us.
+	size_t reserved_size;
 	safs::NUMA_buffer::ptr graph_data;
 	int graph_file_id;
 	std::string graph_file_name;
 
 	in_mem_graph() {
 		graph_size = 0;
+		reserved_size = 0;
 		graph_file_id = -1;
 	}
 public:
 	typedef std::shared_ptr<in_mem_graph> ptr;
 
+	~in_mem_graph() {
+		safs::release_memory(reserved_size);
+	}
+
 	static ptr create(const std::string &graph_name, std::shared_ptr<char> buf,
 			size_t size);
 	/*
@@ -24,6 +24,8 @@
 
 #include <vector>
 
+#include <boost/format.hpp>
+
 #include "graph_engine.h"
 #include "graph_config.h"
 #include "FGlib.h"
@@ -143,6 +145,228 @@ void bfs_uvertex::run(vertex_program &prog, const page_vertex &vertex)
 #endif
 }
 
+/*
+ * These are for the direction-optimizing BFS. It runs a level in each
+ * run of the graph engine and chooses the direction of the traversal for
+ * each level. In the top-down direction, the vertices in the frontier read
+ * their edges and activate their neighbors. In the bottom-up direction,
+ * every unvisited vertex reads the edges in the reverse direction and
+ * searches for a neighbor in the frontier.
+ */
+enum bfs_direction
+{
+	TOP_DOWN,
+	BOTTOM_UP,
+};
+
+bool directed_graph;
+bfs_direction curr_direction;
+// The level of the frontier.
+int curr_bfs_level;
+
+edge_type get_reverse_edge(edge_type type)
+{
+	switch (type) {
+		case edge_type::IN_EDGE:
+			return edge_type::OUT_EDGE;
+		case edge_type::OUT_EDGE:
+			return edge_type::IN_EDGE;
+		default:
+			return type;
+	}
+}
+
+class do_bfs_vertex: public compute_directed_vertex
+{
+	// The BFS level of the vertex. -1 means it hasn't been visited.
+	int level;
+
+	void request_edges(vertex_program &prog, edge_type type);
+	bool has_parent(vertex_program &prog, edge_seq_iterator &it) const;
+	void visit(vertex_program &prog);
+public:
+	do_bfs_vertex(vertex_id_t id): compute_directed_vertex(id) {
+		level = -1;
+	}
+
+	bool has_visited() const {
+		return level >= 0;
+	}
+
+	int get_level() const {
+		return level;
+	}
+
+	void set_level(int level) {
+		this->level = level;
+	}
+
+	void run(vertex_program &prog);
+
+	void run(vertex_program &prog, const page_vertex &vertex);
+
+	void run_on_message(vertex_program &prog, const vertex_message &msg) {
+	}
+};
+
+/*
+ * The vertex program keeps the vertices visited in a level by the worker
+ * thread, so we can decide the direction of the next level.
+ */
+class do_bfs_vertex_program: public vertex_program_impl<do_bfs_vertex>
+{
+	std::vector<vertex_id_t> visited;
+	// The number of edges in the traversal direction of the visited vertices.
+	size_t num_frontier_edges;
+	// The number of edges in the reverse direction of the visited vertices.
+	size_t num_visited_edges;
+public:
+	typedef std::shared_ptr<do_bfs_vertex_program> ptr;
+
+	static ptr cast2(vertex_program::ptr prog) {
+		return std::static_pointer_cast<do_bfs_vertex_program,
+			   vertex_program>(prog);
+	}
+
+	do_bfs_vertex_program() {
+		num_frontier_edges = 0;
+		num_visited_edges = 0;
+	}
+
+	void add_visited(vertex_id_t id) {
+		visited.push_back(id);
+		num_frontier_edges += get_graph().get_num_edges(id, traverse_edge);
+		num_visited_edges += get_graph().get_num_edges(id,
+				get_reverse_edge(traverse_edge));
+	}
+
+	const std::vector<vertex_id_t> &get_visited() const {
+		return visited;
+	}
+
+	size_t get_num_frontier_edges() const {
+		return num_frontier_edges;
+	}
+
+	size_t get_num_visited_edges() const {
+		return num_visited_edges;
+	}
+};
+
+class do_bfs_vertex_program_creater: public vertex_program_creater
+{
+public:
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new do_bfs_vertex_program());
+	}
+};
+
+void do_bfs_vertex::request_edges(vertex_program &prog, edge_type type)
+{
+	vertex_id_t id = prog.get_vertex_id(*this);
+	if (directed_graph) {
+		directed_vertex_request req(id, type);
+		request_partial_vertices(&req, 1);
+	}
+	else
+		request_vertices(&id, 1);
+}
+
+void do_bfs_vertex::visit(vertex_program &prog)
+{
+	level = curr_bfs_level + 1;
+	((do_bfs_vertex_program &) prog).add_visited(prog.get_vertex_id(*this));
+}
+
+void do_bfs_vertex::run(vertex_program &prog)
+{
+	if (curr_direction == BOTTOM_UP) {
+		assert(!has_visited());
+		request_edges(prog, get_reverse_edge(traverse_edge));
+	}
+	// In the top-down direction, the frontier reads edges in the first
+	// iteration and the activated vertices are visited in the second one.
+	else if (prog.get_graph().get_curr_level() == 0) {
+		assert(level == curr_bfs_level);
+		request_edges(prog, traverse_edge);
+	}
+	else if (!has_visited())
+		visit(prog);
+}
+
+bool do_bfs_vertex::has_parent(vertex_program &prog,
+		edge_seq_iterator &it) const
+{
+	// Other vertices may be visited at the same time, but their level is
+	// never the level of the frontier.
+	while (it.has_next()) {
+		do_bfs_vertex &neigh = (do_bfs_vertex &) prog.get_graph().get_vertex(
+				it.next());
+		if (neigh.get_level() == curr_bfs_level)
+			return true;
+	}
+	return false;
+}
+
+void do_bfs_vertex::run(vertex_program &prog, const page_vertex &vertex)
+{
+	if (curr_direction == TOP_DOWN) {
+		if (traverse_edge == BOTH_EDGES && directed_graph) {
+			edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE);
+			prog.activate_vertices(it);
+			it = vertex.get_neigh_seq_it(OUT_EDGE);
+			prog.activate_vertices(it);
+		}
+		else {
+			edge_type type = directed_graph ? traverse_edge : BOTH_EDGES;
+			edge_seq_iterator it = vertex.get_neigh_seq_it(type);
+			prog.activate_vertices(it);
+		}
+		return;
+	}
+
+	// We stop at the first neighbor in the frontier.
+	bool found;
+	if (traverse_edge == BOTH_EDGES && directed_graph) {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE);
+		found = has_parent(prog, it);
+		if (!found) {
+			it = vertex.get_neigh_seq_it(OUT_EDGE);
+			found = has_parent(prog, it);
+		}
+	}
+	else {
+		edge_type type = directed_graph ? get_reverse_edge(
+				traverse_edge) : BOTH_EDGES;
+		edge_seq_iterator it = vertex.get_neigh_seq_it(type);
+		found = has_parent(prog, it);
+	}
+	if (found)
+		visit(prog);
+}
+
+class frontier_filter: public vertex_filter
+{
+public:
+	bool keep(vertex_program &prog, compute_vertex &v) {
+		return ((do_bfs_vertex &) v).get_level() == curr_bfs_level;
+	}
+};
+
+/*
+ * In the bottom-up direction, only the unvisited vertices that can be
+ * reached by an edge read their edges.
+ */
+class unvisited_filter: public vertex_filter
+{
+public:
+	bool keep(vertex_program &prog, compute_vertex &v) {
+		do_bfs_vertex &bfs_v = (do_bfs_vertex &) v;
+		return !bfs_v.has_visited() && prog.get_graph().get_num_edges(
+				prog.get_vertex_id(v), get_reverse_edge(traverse_edge)) > 0;
+	}
+};
+
 template<class vertex_type>
 class count_vertex_query: public vertex_query
 {
@@ -213,3 +437,102 @@ size_t bfs(FG_graph::ptr fg, vertex_id_t start_vertex, edge_type traverse_e)
 #endif
 	return num_visited;
 }
+
+/*
+ * The direction-optimizing BFS switches to the bottom-up direction when
+ * the edges of the frontier exceed 1/alpha of the edges of the unvisited
+ * vertices, and switches back when the frontier has fewer than 1/beta of
+ * the vertices in the graph. The engine reads the entire edge list of
+ * a vertex, so a bottom-up level reads all edges of the unvisited vertices
+ * even though it stops at the first parent.
+ */
+size_t bfs_dir_opt(FG_graph::ptr fg, vertex_id_t start_vertex,
+		edge_type traverse_e, double alpha, double beta)
+{
+	const graph_header &header = fg->get_graph_header();
+	directed_graph = header.is_directed_graph();
+	graph_index::ptr index = NUMA_graph_index<do_bfs_vertex>::create(header);
+	graph_engine::ptr graph = fg->create_engine(index);
+
+	traverse_edge = directed_graph ? traverse_e : edge_type::BOTH_EDGES;
+	size_t num_vertices = graph->get_num_vertices();
+	// The number of edges in the reverse direction of the unvisited vertices.
+	size_t num_unvisited_edges = header.get_num_edges();
+	if (!directed_graph || traverse_edge == edge_type::BOTH_EDGES)
+		num_unvisited_edges *= 2;
+	printf("direction-optimizing BFS starts\n");
+#ifdef PROFILER
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStart(graph_conf.get_prof_file().c_str());
+#endif
+
+	do_bfs_vertex &start = (do_bfs_vertex &) index->get_vertex(start_vertex);
+	start.set_level(0);
+	std::vector<vertex_id_t> frontier(1, start_vertex);
+	size_t num_frontier_edges = graph->get_num_edges(start_vertex,
+			traverse_edge);
+	num_unvisited_edges -= graph->get_num_edges(start_vertex,
+			get_reverse_edge(traverse_edge));
+	size_t num_frontier = 1;
+	size_t num_visited = 1;
+	curr_direction = TOP_DOWN;
+	for (curr_bfs_level = 0; num_frontier > 0; curr_bfs_level++) {
+		if (curr_direction == TOP_DOWN
+				&& num_frontier_edges > num_unvisited_edges / alpha)
+			curr_direction = BOTTOM_UP;
+		else if (curr_direction == BOTTOM_UP
+				&& num_frontier < num_vertices / beta)
+			curr_direction = TOP_DOWN;
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"level %1%: %2% vertices and %3% edges in the frontier, run %4%")
+			% curr_bfs_level % num_frontier % num_frontier_edges
+			% (curr_direction == TOP_DOWN ? "top-down" : "bottom-up");
+
+		if (curr_direction == TOP_DOWN) {
+			// We need the frontier in the top-down direction. It's usually
+			// small, so we don't need to scan all vertices to start the engine.
+			if (frontier.empty())
+				graph->start(std::shared_ptr<vertex_filter>(
+							new frontier_filter()), vertex_program_creater::ptr(
+							new do_bfs_vertex_program_creater()));
+			else
+				graph->start(frontier.data(), frontier.size(),
+						vertex_initializer::ptr(), vertex_program_creater::ptr(
+							new do_bfs_vertex_program_creater()));
+		}
+		else
+			graph->start(std::shared_ptr<vertex_filter>(
+						new unvisited_filter()), vertex_program_creater::ptr(
+						new do_bfs_vertex_program_creater()));
+		graph->wait4complete();
+
+		std::vector<vertex_program::ptr> programs;
+		graph->get_vertex_programs(programs);
+		frontier.clear();
+		num_frontier = 0;
+		num_frontier_edges = 0;
+		for (size_t i = 0; i < programs.size(); i++) {
+			do_bfs_vertex_program::ptr bfs_prog
+				= do_bfs_vertex_program::cast2(programs[i]);
+			num_frontier += bfs_prog->get_visited().size();
+			num_frontier_edges += bfs_prog->get_num_frontier_edges();
+			num_unvisited_edges -= bfs_prog->get_num_visited_edges();
+		}
+		// We only keep the frontier when the next level may run top-down.
+		if (num_frontier < num_vertices / beta) {
+			for (size_t i = 0; i < programs.size(); i++) {
+				do_bfs_vertex_program::ptr bfs_prog
+					= do_bfs_vertex_program::cast2(programs[i]);
+				frontier.insert(frontier.end(), bfs_prog->get_visited().begin(),
+						bfs_prog->get_visited().end());
+			}
+		}
+		num_visited += num_frontier;
+	}
+
+#ifdef PROFILER
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStop();
+#endif
+	return num_visited;
+}
@@ -24,6 +24,87 @@
 namespace fg
 {
 
+vertex_chunk_deque::vertex_chunk_deque()
+{
+	top = 0;
+	bottom = 0;
+	slots = new chunk[NUM_SLOTS];
+}
+
+vertex_chunk_deque::~vertex_chunk_deque()
+{
+	delete [] slots;
+}
+
+int vertex_chunk_deque::copy_chunk(const chunk &c,
+		compute_vertex_pointer vertices[])
+{
+	// A thief may read a chunk that is being overwritten. The number is
+	// garbage in that case, but the thief will fail to claim the chunk.
+	int num = std::min(c.num, CHUNK_SIZE);
+	memcpy(vertices, c.vertices, num * sizeof(vertices[0]));
+	return num;
+}
+
+bool vertex_chunk_deque::push(const compute_vertex_pointer vertices[], int num)
+{
+	assert(num > 0 && num <= CHUNK_SIZE);
+	long b = bottom.load(std::memory_order_relaxed);
+	long t = top.load(std::memory_order_acquire);
+	if (b - t >= NUM_SLOTS)
+		return false;
+
+	chunk &c = slots[b % NUM_SLOTS];
+	c.num = num;
+	memcpy(c.vertices, vertices, num * sizeof(vertices[0]));
+	// The chunk has to be visible before the new bottom.
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+int vertex_chunk_deque::pop(compute_vertex_pointer vertices[])
+{
+	long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long t = top.load(std::memory_order_relaxed);
+	// The deque is empty.
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	int num = copy_chunk(slots[b % NUM_SLOTS], vertices);
+	// If this is the last chunk, we race with the thieves for it.
+	if (t == b) {
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+					std::memory_order_relaxed))
+			num = 0;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return num;
+}
+
+int vertex_chunk_deque::steal(compute_vertex_pointer vertices[])
+{
+	while (true) {
+		long t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return 0;
+
+		// The owner can't overwrite the chunk until it's claimed,
+		// so we copy it before claiming it.
+		int num = copy_chunk(slots[t % NUM_SLOTS], vertices);
+		if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+					std::memory_order_relaxed))
+			return num;
+		// Another thread has taken the chunk. Try the next one.
+	}
+}
+
 load_balancer::load_balancer(graph_engine &_graph,
 		worker_thread &_owner): owner(_owner), graph(_graph)
 {
@@ -36,6 +117,7 @@ load_balancer::load_balancer(graph_engine &_graph,
 				_owner.get_node_id(), 4096, true);
 	}
 	num_completed_stolen_vertices = 0;
+	chunk_fetch_idx = 0;
 }
 
 load_balancer::~load_balancer()
@@ -45,36 +127,92 @@ load_balancer::~load_balancer()
 	free(completed_stolen_vertices);
 }
 
+int load_balancer::fetch_chunk_buf(compute_vertex_pointer vertices[], int num)
+{
+	int num_fetched = std::min((size_t) num,
+			chunk_buf.size() - chunk_fetch_idx);
+	memcpy(vertices, chunk_buf.data() + chunk_fetch_idx,
+			num_fetched * sizeof(vertices[0]));
+	chunk_fetch_idx += num_fetched;
+	return num_fetched;
+}
+
+/*
+ * The owner thread moves activated vertices from its vertex queue to
+ * the deque, so other threads can steal them. The chunks are pushed in
+ * the reverse order, so the owner pops them in the order of the vertex
+ * queue and the thieves steal the vertices at the other end.
+ */
+void load_balancer::refill_deque()
+{
+	assert(deque.is_empty());
+	std::vector<compute_vertex_pointer> vertices(
+			NUM_REFILL_CHUNKS * vertex_chunk_deque::CHUNK_SIZE);
+	int num = owner.curr_activated_vertices->fetch(vertices.data(),
+			vertices.size());
+	int num_chunks = ROUNDUP(num, vertex_chunk_deque::CHUNK_SIZE)
+		/ vertex_chunk_deque::CHUNK_SIZE;
+	for (int i = num_chunks - 1; i >= 0; i--) {
+		int start = i * vertex_chunk_deque::CHUNK_SIZE;
+		int num_in_chunk = std::min(num - start,
+				vertex_chunk_deque::CHUNK_SIZE);
+		BOOST_VERIFY(deque.push(vertices.data() + start, num_in_chunk));
+	}
+}
+
+bool load_balancer::pop_chunk()
+{
+	chunk_buf.resize(vertex_chunk_deque::CHUNK_SIZE);
+	int num = deque.pop(chunk_buf.data());
+	if (num == 0) {
+		refill_deque();
+		num = deque.pop(chunk_buf.data());
+	}
+	chunk_buf.resize(num);
+	chunk_fetch_idx = 0;
+	return num > 0;
+}
+
 /**
- * This steals vertices from other threads. It tries to steal more vertices
- * than it can process, and the remaining vertices will be placed in its
- * own activated vertex queue.
+ * This steals a chunk of vertices from other threads. The thread keeps
+ * stealing from the same thread until the thread runs out of vertices.
  */
-int load_balancer::steal_activated_vertices(compute_vertex_pointer vertex_buf[],
-		int buf_size)
+bool load_balancer::steal_chunk()
 {
 	if (steal_thread_id == owner.get_worker_id())
 		steal_thread_id = (steal_thread_id + 1) % graph.get_num_threads();
+	chunk_buf.resize(vertex_chunk_deque::CHUNK_SIZE);
 	int num_tries = 0;
 	int num;
 	do {
 		worker_thread *t = graph.get_thread(steal_thread_id);
 		num_tries++;
 
-		num = t->steal_activated_vertices(vertex_buf, buf_size);
+		num = t->steal_activated_vertices(chunk_buf.data(), chunk_buf.size());
 		// If we can't steal vertices from the thread, we should move
 		// to the next thread.
 		if (num == 0)
 			steal_thread_id = (steal_thread_id + 1) % graph.get_num_threads();
 		// If we have tried to steal vertices from all threads.
 	} while (num == 0 && num_tries < graph.get_num_threads());
+	chunk_buf.resize(num);
+	chunk_fetch_idx = 0;
+	return num > 0;
+}
 
-	// Record the owner thread of the stolen vertices.
-	for (int i = 0; i < num; i++)
-		stolen_vertex_map.insert(vertex_map_t::value_type(
-					vertex_buf[i].get(), steal_thread_id));
-
-	return num;
+int load_balancer::fetch_activated_vertices(compute_vertex_pointer vertices[],
+		int num)
+{
+	int num_fetched = fetch_chunk_buf(vertices, num);
+	while (num_fetched < num && pop_chunk())
+		num_fetched += fetch_chunk_buf(vertices + num_fetched,
+				num - num_fetched);
+	if (num_fetched == 0) {
+		assert(owner.curr_activated_vertices->is_empty());
+		if (steal_chunk())
+			num_fetched = fetch_chunk_buf(vertices, num);
+	}
+	return num_fetched;
 }
 
 void load_balancer::process_completed_stolen_vertices()
@@ -103,13 +241,12 @@ void load_balancer::return_vertices(const compute_vertex_pointer vs[], int num)
 {
 	for (int i = 0; i < num; i++) {
 		compute_vertex_pointer v = vs[i];
-		vertex_map_t::iterator it = stolen_vertex_map.find(v.get());
-		assert(it != stolen_vertex_map.end());
-		int part_id = it->second;
 		// We don't need to return verticalled partitioned vertices to their
 		// owner because messages are processed in the main vertices and the
 		// main vertices cannot be stolen by other threads.
 		if (!v.is_part()) {
+			int part_id = get_stolen_vertex_part(*v.get());
+			assert(part_id >= 0);
 			if (completed_stolen_vertices[part_id].is_full()) {
 				completed_stolen_vertices[part_id].expand_queue(
 						completed_stolen_vertices[part_id].get_size() * 2);
@@ -121,7 +258,6 @@ void load_balancer::return_vertices(const compute_vertex_pointer vs[], int num)
 			completed_stolen_vertices[part_id].push_back(id);
 			num_completed_stolen_vertices++;
 		}
-		stolen_vertex_map.erase(it);
 	}
 }
 
@@ -130,15 +266,21 @@ void load_balancer::reset()
 	for (int i = 0; i < graph.get_num_threads(); i++)
 		assert(completed_stolen_vertices[i].is_empty());
 	assert(num_completed_stolen_vertices == 0);
+	assert(deque.is_empty());
+	assert(chunk_fetch_idx == chunk_buf.size());
 }
 
+/*
+ * The vertices of a partition are stored in contiguous arrays in the graph
+ * index, so we can find the owner thread of a stolen vertex from its address.
+ */
 int load_balancer::get_stolen_vertex_part(const compute_vertex &v) const
 {
-	vertex_map_t::const_iterator it = stolen_vertex_map.find(&v);
-	if (it != stolen_vertex_map.end())
-		return it->second;
-	else
+	int part_id = graph.get_graph_index().get_part_id(v);
+	if (part_id == owner.get_worker_id())
 		return -1;
+	else
+		return part_id;
 }
 
 }
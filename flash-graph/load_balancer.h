@@ -20,10 +20,12 @@
  * limitations under the License.
  */
 
-#include <unordered_map>
+#include <atomic>
+#include <vector>
 
 #include "container.h"
 #include "vertex.h"
+#include "vertex_pointer.h"
 
 namespace fg
 {
@@ -31,23 +33,84 @@ namespace fg
 class worker_thread;
 class graph_engine;
 class compute_vertex;
-class compute_vertex_pointer;
+
+/*
+ * This is a Chase-Lev work-stealing deque of chunks of active vertices.
+ * The owner thread pushes and pops chunks at the bottom, and other threads
+ * steal chunks from the top without locking.
+ * The deque has a fixed number of slots and the vertices of a chunk are
+ * stored in the slot, so the owner can't overwrite a chunk before
+ * a thief has claimed it.
+ */
+class vertex_chunk_deque
+{
+public:
+	static const int CHUNK_SIZE = 256;
+	static const int NUM_SLOTS = 64;
+private:
+	struct chunk
+	{
+		int num;
+		compute_vertex_pointer vertices[CHUNK_SIZE];
+	};
+
+	// The owner and the thieves update different ends of the deque.
+	// We put them in different cache lines.
+	std::atomic<long> top;
+	char pad[64 - sizeof(std::atomic<long>)];
+	std::atomic<long> bottom;
+	chunk *slots;
+
+	static int copy_chunk(const chunk &c, compute_vertex_pointer vertices[]);
+public:
+	vertex_chunk_deque();
+	~vertex_chunk_deque();
+
+	/*
+	 * The three methods below are used by the owner thread.
+	 */
+
+	/*
+	 * Push a chunk at the bottom of the deque. It fails if the deque is
+	 * full.
+	 */
+	bool push(const compute_vertex_pointer vertices[], int num);
+	/*
+	 * Pop the chunk at the bottom of the deque. The buffer has to be able
+	 * to hold CHUNK_SIZE vertices. It returns the number of vertices in
+	 * the chunk or 0 if the deque is empty.
+	 */
+	int pop(compute_vertex_pointer vertices[]);
+	bool is_empty() const {
+		return bottom.load(std::memory_order_relaxed)
+			<= top.load(std::memory_order_relaxed);
+	}
+
+	/*
+	 * Steal the chunk at the top of the deque. It's used by other threads.
+	 */
+	int steal(compute_vertex_pointer vertices[]);
+};
 
 /*
  * This class is to help balance the load.
- * If the owner thread has finished the work originally assigned to it,
- * it can steal work from other threads through this class.
+ * The active vertices of a thread are split into chunks in a work-stealing
+ * deque. If the owner thread has finished the work originally assigned to
+ * it, it steals chunks from the deques of other threads.
  */
 class load_balancer
 {
-	typedef std::unordered_map<const compute_vertex *, int> vertex_map_t;
+	// The owner fills the deque with this many chunks at a time.
+	static const int NUM_REFILL_CHUNKS = vertex_chunk_deque::NUM_SLOTS / 2;
 
 	worker_thread &owner;
 	graph_engine &graph;
 
-	// This map records the owner threads of vertices stolen from another
-	// partition.
-	vertex_map_t stolen_vertex_map;
+	vertex_chunk_deque deque;
+	// The vertices of the chunk taken by the owner thread, either from
+	// its own deque or from another thread. They haven't been processed.
+	std::vector<compute_vertex_pointer> chunk_buf;
+	size_t chunk_fetch_idx;
 
 	// This is a local buffer that contains the completed stolen vertices.
 	// All vertices here need to be returned to their owner threads.
@@ -55,6 +118,11 @@ class load_balancer
 	int num_completed_stolen_vertices;
 	// The thread where we should steal activated vertices from.
 	int steal_thread_id;
+
+	int fetch_chunk_buf(compute_vertex_pointer vertices[], int num);
+	bool pop_chunk();
+	bool steal_chunk();
+	void refill_deque();
 public:
 	load_balancer(graph_engine &_graph, worker_thread &_owner);
 
@@ -62,7 +130,22 @@ public:
 
 	int get_stolen_vertex_part(const compute_vertex &v) const;
 
-	int steal_activated_vertices(compute_vertex_pointer vertices[], int num);
+	/*
+	 * This fetches activated vertices for the owner thread to process.
+	 * It gets vertices from the deque of the owner thread first. If it
+	 * runs out of vertices, it steals a chunk of vertices from another
+	 * thread.
+	 */
+	int fetch_activated_vertices(compute_vertex_pointer vertices[], int num);
+
+	/*
+	 * This is used by other threads to steal a chunk of vertices from
+	 * the deque of the owner thread.
+	 */
+	int steal_chunk(compute_vertex_pointer vertices[]) {
+		return deque.steal(vertices);
+	}
+
 	/**
 	 * After the thread finishes processing the stolen vertices, it needs to
 	 * return all the vertices to their owner threads.
@@ -92,4 +92,44 @@ int multicast_msg_sender::add_dests(local_vid_t ids[], int num)
 	return orig_num;
 }
 
+void combine_msg_sender::send(const vertex_message &msg)
+{
+	if (slot_size == 0) {
+		// The messages are aligned in the buffer.
+		slot_size = ROUNDUP(msg.get_serialized_size(), sizeof(vertex_id_t));
+		buf.resize(NUM_SLOTS * slot_size);
+		dests.resize(NUM_SLOTS, INVALID_VERTEX_ID);
+	}
+	assert((size_t) msg.get_serialized_size() <= slot_size);
+
+	vertex_id_t id = msg.get_dest().id;
+	size_t slot = id % NUM_SLOTS;
+	vertex_message &buffered = *(vertex_message *) (buf.data()
+			+ slot * slot_size);
+	if (dests[slot] == id) {
+		combiner->combine(buffered, msg);
+		if (msg.is_activate())
+			buffered.set_activate(true);
+		num_combined++;
+		return;
+	}
+
+	if (dests[slot] == INVALID_VERTEX_ID)
+		used_slots.push_back(slot);
+	else
+		sender.send_cached(buffered);
+	msg.serialize((char *) &buffered, msg.get_serialized_size());
+	dests[slot] = id;
+}
+
+void combine_msg_sender::flush()
+{
+	for (size_t i = 0; i < used_slots.size(); i++) {
+		uint32_t slot = used_slots[i];
+		sender.send_cached(*(vertex_message *) (buf.data() + slot * slot_size));
+		dests[slot] = INVALID_VERTEX_ID;
+	}
+	used_slots.clear();
+}
+
 }
@@ -20,6 +20,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include "slab_allocator.h"
 
 #include "vertex.h"
@@ -345,6 +347,10 @@ public:
 		this->flush = flush;
 	}
 
+	void set_activate(bool activate) {
+		this->activate = activate;
+	}
+
 	local_vid_t get_dest() const {
 		return local_vid_t(u.dest);
 	}
@@ -561,6 +567,122 @@ public:
 	}
 };
 
+/**
+ * \brief A combiner merges the messages sent to the same vertex by a worker
+ *        thread, so that fewer messages are sent to the owner thread of
+ *        the vertex. It can only be used when a vertex gets the same result
+ *        from the merged message as from the original messages, e.g.,
+ *        the vertex adds up the values in the messages or keeps
+ *        the minimal value.
+ */
+class message_combiner
+{
+public:
+	typedef std::shared_ptr<message_combiner> ptr;
+
+	virtual ~message_combiner() {
+	}
+
+	/**
+	 * \brief Merge a message to the message buffered for the same vertex.
+	 * \param buffered The message buffered in the worker thread.
+	 * \param msg The new message.
+	 */
+	virtual void combine(vertex_message &buffered,
+			const vertex_message &msg) const = 0;
+};
+
+/*
+ * The combiners below require the message type to provide `get_value()'
+ * and `set_value()'.
+ */
+
+template<class message_type>
+class sum_combiner: public message_combiner
+{
+public:
+	virtual void combine(vertex_message &buffered,
+			const vertex_message &msg) const {
+		message_type &buf_msg = (message_type &) buffered;
+		buf_msg.set_value(buf_msg.get_value()
+				+ ((const message_type &) msg).get_value());
+	}
+};
+
+template<class message_type>
+class min_combiner: public message_combiner
+{
+public:
+	virtual void combine(vertex_message &buffered,
+			const vertex_message &msg) const {
+		message_type &buf_msg = (message_type &) buffered;
+		buf_msg.set_value(std::min(buf_msg.get_value(),
+					((const message_type &) msg).get_value()));
+	}
+};
+
+template<class message_type>
+class max_combiner: public message_combiner
+{
+public:
+	virtual void combine(vertex_message &buffered,
+			const vertex_message &msg) const {
+		message_type &buf_msg = (message_type &) buffered;
+		buf_msg.set_value(std::max(buf_msg.get_value(),
+					((const message_type &) msg).get_value()));
+	}
+};
+
+/*
+ * This sender buffers the messages to the vertices of a worker thread and
+ * merges the messages to the same vertex with a combiner. The buffer is
+ * direct-mapped: a message is kept in the slot indexed by the local ID of
+ * its destination, so merging a message costs an array access. A message
+ * in a slot is sent by a simple message sender when a message to another
+ * vertex takes the slot or when the sender is flushed.
+ *
+ * A vertex program only uses it after set_message_combiner() is called.
+ * Merging a message costs about as much as sending it, so it only pays off
+ * if a vertex processes a message more expensively than the sender merges
+ * it. Multicast messages are never combined because they already cost
+ * only a vertex ID per destination.
+ */
+class combine_msg_sender
+{
+	// The local IDs of a partition are dense, so the vertices that share
+	// a slot are NUM_SLOTS apart.
+	const static size_t NUM_SLOTS = 4096;
+
+	simple_msg_sender &sender;
+	message_combiner::ptr combiner;
+	// A combiner merges messages of one type, so all messages have
+	// the same size. It's known when the first message arrives.
+	size_t slot_size;
+	std::vector<char> buf;
+	// The destination of the message in each slot.
+	std::vector<vertex_id_t> dests;
+	// The slots that have messages, so a flush doesn't scan all slots.
+	std::vector<uint32_t> used_slots;
+	size_t num_combined;
+public:
+	combine_msg_sender(simple_msg_sender &_sender,
+			message_combiner::ptr combiner): sender(_sender) {
+		this->combiner = combiner;
+		slot_size = 0;
+		num_combined = 0;
+	}
+
+	/*
+	 * The destination of the message has been set.
+	 */
+	void send(const vertex_message &msg);
+	void flush();
+
+	size_t get_num_combined() const {
+		return num_combined;
+	}
+};
+
 }
 
 #endif
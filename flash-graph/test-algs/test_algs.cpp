@@ -675,9 +675,10 @@ void run_bfs(FG_graph::ptr graph, int argc, char* argv[])
 	int num_opts = 0;
 	edge_type edge = edge_type::OUT_EDGE;
 	vertex_id_t start_vertex = 0;
+	bool dir_opt = false;
 
 	std::string edge_type_str;
-	while ((opt = getopt(argc, argv, "e:s:")) != -1) {
+	while ((opt = getopt(argc, argv, "e:s:d")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'e':
@@ -688,6 +689,9 @@ void run_bfs(FG_graph::ptr graph, int argc, char* argv[])
 				start_vertex = atol(optarg);
 				num_opts++;
 				break;
+			case 'd':
+				dir_opt = true;
+				break;
 			default:
 				print_usage();
 				abort();
@@ -707,7 +711,13 @@ void run_bfs(FG_graph::ptr graph, int argc, char* argv[])
 	}
 
 	size_t bfs(FG_graph::ptr fg, vertex_id_t start_vertex, edge_type);
-	size_t num_vertices = bfs(graph, start_vertex, edge);
+	size_t bfs_dir_opt(FG_graph::ptr fg, vertex_id_t start_vertex,
+			edge_type traverse_e, double alpha, double beta);
+	size_t num_vertices;
+	if (dir_opt)
+		num_vertices = bfs_dir_opt(graph, start_vertex, edge, 1, 24);
+	else
+		num_vertices = bfs(graph, start_vertex, edge);
 	printf("BFS from v%u traverses %ld vertices on edge type %d\n",
 			start_vertex, num_vertices, edge);
 }
@@ -892,6 +902,7 @@ void print_usage()
 	fprintf(stderr, "bfs\n");
 	fprintf(stderr, "-e edge type: the type of edge to traverse (IN, OUT, BOTH)\n");
 	fprintf(stderr, "-s vertex id: the vertex where the BFS starts\n");
+	fprintf(stderr, "-d: run the direction-optimizing BFS\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "louvain\n");
 	fprintf(stderr, "-l: how many levels in the hierarchy to compute\n");
@@ -0,0 +1,101 @@
+#include <assert.h>
+#include <stdio.h>
+#include <limits.h>
+
+#include <boost/assert.hpp>
+
+#include "messaging.h"
+
+using namespace fg;
+
+class test_message: public vertex_message
+{
+	int value;
+public:
+	test_message(int value, bool activate): vertex_message(
+			sizeof(test_message), activate) {
+		this->value = value;
+	}
+
+	int get_value() const {
+		return value;
+	}
+
+	void set_value(int value) {
+		this->value = value;
+	}
+};
+
+void send_msgs(combine_msg_sender &sender, int num_vertices, int num_msgs)
+{
+	for (int i = 0; i < num_msgs; i++) {
+		test_message msg(i, i % 3 == 0);
+		msg.set_dest(local_vid_t(i % num_vertices));
+		sender.send(msg);
+	}
+}
+
+/*
+ * Fetch all messages in the queue and check that each vertex gets one
+ * message with the values of all messages to it combined.
+ */
+void check_msgs(msg_queue &queue, int num_vertices, int num_msgs,
+		int max_per_vertex)
+{
+	std::vector<int> sums(num_vertices);
+	std::vector<int> counts(num_vertices);
+	while (!queue.is_empty()) {
+		message msg;
+		BOOST_VERIFY(queue.fetch(&msg, 1) == 1);
+		while (msg.has_next()) {
+			vertex_message *msgs[16];
+			int num = msg.get_next(msgs, 16);
+			for (int i = 0; i < num; i++) {
+				test_message *tmsg = (test_message *) msgs[i];
+				int id = tmsg->get_dest().id;
+				sums[id] += tmsg->get_value();
+				counts[id]++;
+				// Every vertex gets an activating message, so a fully merged
+				// message activates its vertex.
+				if (max_per_vertex == 1)
+					assert(tmsg->is_activate());
+			}
+		}
+	}
+	for (int i = 0; i < num_vertices; i++) {
+		int expected = 0;
+		for (int j = i; j < num_msgs; j += num_vertices)
+			expected += j;
+		assert(sums[i] == expected);
+		assert(counts[i] >= 1 && counts[i] <= max_per_vertex);
+	}
+}
+
+void test_combine(int num_vertices, int num_msgs, int max_per_vertex)
+{
+	printf("test combining %d messages to %d vertices\n", num_msgs,
+			num_vertices);
+	std::shared_ptr<slab_allocator> alloc(new slab_allocator(
+				"test-msg-allocator", 4096, 1024 * 1024, INT_MAX, 0, false,
+				false, 5));
+	msg_queue queue(0, "test-msg_queue", 16, INT_MAX);
+	simple_msg_sender *sender = simple_msg_sender::create(0, alloc, &queue);
+	combine_msg_sender combine_sender(*sender,
+			message_combiner::ptr(new sum_combiner<test_message>()));
+	send_msgs(combine_sender, num_vertices, num_msgs);
+	combine_sender.flush();
+	sender->flush();
+	check_msgs(queue, num_vertices, num_msgs, max_per_vertex);
+	assert(combine_sender.get_num_combined() >= (size_t) (num_msgs
+				- num_vertices * max_per_vertex));
+	simple_msg_sender::destroy(sender);
+}
+
+int main()
+{
+	// All messages to a vertex are merged.
+	test_combine(100, 10000, 1);
+	// The vertices share the slots of the direct-mapped buffer, so
+	// the messages in a slot are sent before all messages are merged.
+	test_combine(10000, 30000, 3);
+}
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "in_mem_storage.h"
+
+#include "fg_utils.h"
+#include "sparse_matrix.h"
+#include "data_frame.h"
+
+using namespace fm;
+
+/*
+ * Create a random graph whose edges have an attribute, so we can check
+ * that the edge data moves with the edges.
+ */
+fg::FG_graph::ptr create_rand_graph(bool directed)
+{
+	size_t num_vertices = 1000;
+	size_t num_edges = 10000;
+	detail::smp_vec_store::ptr sources = detail::smp_vec_store::create(
+			num_edges, get_scalar_type<fg::vertex_id_t>());
+	detail::smp_vec_store::ptr dests = detail::smp_vec_store::create(
+			num_edges, get_scalar_type<fg::vertex_id_t>());
+	detail::smp_vec_store::ptr vals = detail::smp_vec_store::create(
+			num_edges, get_scalar_type<int>());
+	for (size_t i = 0; i < num_edges; i++) {
+		sources->set<fg::vertex_id_t>(i, random() % num_vertices);
+		dests->set<fg::vertex_id_t>(i, random() % num_vertices);
+		vals->set<int>(i, i);
+	}
+	data_frame::ptr df = data_frame::create();
+	df->add_vec("source", sources);
+	df->add_vec("dest", dests);
+	df->add_vec("attr", vals);
+	return fg::create_fg_graph("test", fg::edge_list::create(df, directed));
+}
+
+/*
+ * The image of a graph without the padding at the end.
+ */
+std::vector<char> get_image(fg::FG_graph::ptr g)
+{
+	fg::vertex_index::ptr vindex = g->get_index_data();
+	std::vector<off_t> out_offs(vindex->get_num_vertices() + 1);
+	fg::init_out_offs(vindex, out_offs);
+	size_t size = out_offs.back();
+	assert(size <= g->get_graph_data()->get_data().get_length());
+	std::vector<char> image(size);
+	g->get_graph_data()->get_data().copy_to(image.data(), size, 0);
+	return image;
+}
+
+/*
+ * Get the neighbors of each vertex with their edge data in a graph.
+ */
+std::vector<std::vector<std::pair<fg::vertex_id_t, int> > > get_edges(
+		fg::FG_graph::ptr g)
+{
+	std::vector<char> image = get_image(g);
+	fg::vertex_index::ptr vindex = g->get_index_data();
+	std::vector<off_t> out_offs(vindex->get_num_vertices() + 1);
+	fg::init_out_offs(vindex, out_offs);
+	std::vector<std::vector<std::pair<fg::vertex_id_t, int> > > edges(
+			vindex->get_num_vertices());
+	for (size_t i = 0; i < edges.size(); i++) {
+		const fg::ext_mem_undirected_vertex *v
+			= (const fg::ext_mem_undirected_vertex *) (image.data()
+					+ out_offs[i]);
+		assert(v->get_id() == i);
+		for (size_t j = 0; j < v->get_num_edges(); j++)
+			edges[i].push_back(std::pair<fg::vertex_id_t, int>(
+						v->get_neighbor(j),
+						*(const int *) v->get_raw_edge_data(j)));
+	}
+	return edges;
+}
+
+/*
+ * Relabel the vertices of a graph in a random order and relabel them back.
+ * The round trip gets the original graph.
+ */
+void test_round_trip(bool directed)
+{
+	printf("reorder a %s graph\n", directed ? "directed" : "undirected");
+	fg::FG_graph::ptr g = create_rand_graph(directed);
+	size_t num_vertices = g->get_graph_header().get_num_vertices();
+	std::vector<fg::vertex_id_t> order(num_vertices);
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::random_shuffle(order.begin(), order.end());
+	std::vector<fg::vertex_id_t> new_ids(num_vertices);
+	for (size_t i = 0; i < order.size(); i++)
+		new_ids[order[i]] = i;
+
+	fg::FG_graph::ptr new_g = fg::reorder_graph(g, order, "test-reorder");
+	assert(new_g->get_graph_header().get_num_edges()
+			== g->get_graph_header().get_num_edges());
+	// Relabeling doesn't change the size of the graph image.
+	assert(get_image(new_g).size() == get_image(g).size());
+
+	// Vertex i in the new graph is vertex order[i] in the original graph.
+	std::vector<std::vector<std::pair<fg::vertex_id_t, int> > > edges
+		= get_edges(g);
+	std::vector<std::vector<std::pair<fg::vertex_id_t, int> > > new_edges
+		= get_edges(new_g);
+	for (size_t i = 0; i < num_vertices; i++) {
+		std::vector<std::pair<fg::vertex_id_t, int> > &v = new_edges[i];
+		for (size_t j = 1; j < v.size(); j++)
+			assert(v[j - 1].first <= v[j].first);
+		for (size_t j = 0; j < v.size(); j++)
+			v[j].first = order[v[j].first];
+		std::sort(v.begin(), v.end());
+		std::vector<std::pair<fg::vertex_id_t, int> > &orig = edges[order[i]];
+		std::sort(orig.begin(), orig.end());
+		assert(v == orig);
+	}
+
+	// The inverse permutation gets the original graph back.
+	fg::FG_graph::ptr orig_g = fg::reorder_graph(new_g, new_ids,
+			"test-reorder-back");
+	std::vector<std::vector<std::pair<fg::vertex_id_t, int> > > orig_edges
+		= get_edges(orig_g);
+	for (size_t i = 0; i < num_vertices; i++) {
+		std::sort(orig_edges[i].begin(), orig_edges[i].end());
+		assert(orig_edges[i] == edges[i]);
+	}
+
+	// The identity order doesn't change a graph with sorted neighbor lists.
+	std::vector<fg::vertex_id_t> identity(num_vertices);
+	for (size_t i = 0; i < identity.size(); i++)
+		identity[i] = i;
+	fg::FG_graph::ptr same_g = fg::reorder_graph(orig_g, identity,
+			"test-reorder-same");
+	assert(get_image(same_g) == get_image(orig_g));
+}
+
+int main()
+{
+	init_flash_matrix(NULL);
+	test_round_trip(true);
+	test_round_trip(false);
+	destroy_flash_matrix();
+}
@@ -0,0 +1,101 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include "load_balancer.h"
+
+using namespace fg;
+
+const long NUM_VERTICES = 1000000;
+const int NUM_THIEVES = 3;
+// A fake address of the first vertex.
+const long VERTEX_BASE = 1000000;
+
+vertex_chunk_deque deque;
+std::atomic<bool> done;
+std::atomic<long> sum;
+std::atomic<long> count;
+
+void add_vertices(const compute_vertex_pointer vertices[], int num)
+{
+	for (int i = 0; i < num; i++) {
+		sum += (long) vertices[i].get() - VERTEX_BASE;
+		count++;
+	}
+}
+
+void steal_vertices()
+{
+	compute_vertex_pointer buf[vertex_chunk_deque::CHUNK_SIZE];
+	while (!done.load())
+		add_vertices(buf, deque.steal(buf));
+}
+
+/*
+ * The owner thread pushes and pops chunks while other threads steal them.
+ * Every vertex has to be taken exactly once.
+ */
+void test_steal()
+{
+	printf("test stealing chunks\n");
+	done = false;
+	sum = 0;
+	count = 0;
+	std::vector<std::thread> thieves;
+	for (int i = 0; i < NUM_THIEVES; i++)
+		thieves.push_back(std::thread(steal_vertices));
+
+	compute_vertex_pointer buf[vertex_chunk_deque::CHUNK_SIZE];
+	long next = 0;
+	while (next < NUM_VERTICES) {
+		while (next < NUM_VERTICES) {
+			int num = std::min(100L, NUM_VERTICES - next);
+			for (int i = 0; i < num; i++)
+				buf[i] = compute_vertex_pointer(
+						(compute_vertex *) (VERTEX_BASE + next + i));
+			if (!deque.push(buf, num))
+				break;
+			next += num;
+		}
+		int num;
+		while ((num = deque.pop(buf)) > 0)
+			add_vertices(buf, num);
+	}
+	done = true;
+	for (size_t i = 0; i < thieves.size(); i++)
+		thieves[i].join();
+	assert(deque.is_empty());
+	assert(count == NUM_VERTICES);
+	assert(sum == NUM_VERTICES * (NUM_VERTICES - 1) / 2);
+}
+
+void test_order()
+{
+	printf("test the order of chunks\n");
+	compute_vertex_pointer buf[vertex_chunk_deque::CHUNK_SIZE];
+	for (int i = 0; i < vertex_chunk_deque::NUM_SLOTS; i++) {
+		buf[0] = compute_vertex_pointer((compute_vertex *) (VERTEX_BASE + i));
+		BOOST_VERIFY(deque.push(buf, 1));
+	}
+	// The deque is full.
+	BOOST_VERIFY(!deque.push(buf, 1));
+	// The owner gets the last chunk and the thieves get the first one.
+	BOOST_VERIFY(deque.pop(buf) == 1);
+	assert((long) buf[0].get()
+			== VERTEX_BASE + vertex_chunk_deque::NUM_SLOTS - 1);
+	BOOST_VERIFY(deque.steal(buf) == 1);
+	assert((long) buf[0].get() == VERTEX_BASE);
+	while (deque.pop(buf) > 0);
+	assert(deque.is_empty());
+}
+
+int main()
+{
+	test_order();
+	test_steal();
+}
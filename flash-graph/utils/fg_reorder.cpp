@@ -0,0 +1,297 @@
+/*
+ * Copyright 2016 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This tool relabels the vertices of a graph to improve the locality of
+ * the graph image. Vertices that are accessed together get close IDs, so
+ * their adjacency lists are close to each other in the graph file and
+ * the I/O requests to them can be merged.
+ */
+
+#include <unistd.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "common.h"
+
+#include "FGlib.h"
+#include "in_mem_storage.h"
+#include "fg_utils.h"
+
+using namespace fg;
+
+namespace
+{
+
+/*
+ * The graph image in memory.
+ */
+class graph_image
+{
+	graph_header header;
+	std::unique_ptr<char[]> data;
+	std::vector<off_t> out_offs;
+	std::vector<off_t> in_offs;
+public:
+	graph_image(FG_graph::ptr g);
+
+	const graph_header &get_header() const {
+		return header;
+	}
+
+	size_t get_num_vertices() const {
+		return header.get_num_vertices();
+	}
+
+	const ext_mem_undirected_vertex &get_vertex(vertex_id_t id,
+			edge_type type) const {
+		const std::vector<off_t> &offs = type == IN_EDGE ? in_offs : out_offs;
+		return *(const ext_mem_undirected_vertex *) (data.get() + offs[id]);
+	}
+
+	size_t get_degree(vertex_id_t id) const {
+		size_t degree = get_vertex(id, OUT_EDGE).get_num_edges();
+		if (header.is_directed_graph())
+			degree += get_vertex(id, IN_EDGE).get_num_edges();
+		return degree;
+	}
+
+	/*
+	 * Get the neighbors of a vertex regardless of the direction of edges.
+	 */
+	void get_neighbors(vertex_id_t id, std::vector<vertex_id_t> &neighs) const;
+};
+
+graph_image::graph_image(FG_graph::ptr g)
+{
+	vertex_index::ptr vindex = g->get_index_data();
+	header = vindex->get_graph_header();
+	size_t size = g->get_graph_data()->get_data().get_length();
+	data = std::unique_ptr<char[]>(new char[size]);
+	g->get_graph_data()->get_data().copy_to(data.get(), size, 0);
+
+	out_offs.resize(header.get_num_vertices() + 1);
+	init_out_offs(vindex, out_offs);
+	if (header.is_directed_graph()) {
+		in_offs.resize(header.get_num_vertices() + 1);
+		init_in_offs(vindex, in_offs);
+	}
+}
+
+void graph_image::get_neighbors(vertex_id_t id,
+		std::vector<vertex_id_t> &neighs) const
+{
+	neighs.clear();
+	const ext_mem_undirected_vertex &out_v = get_vertex(id, OUT_EDGE);
+	for (size_t i = 0; i < out_v.get_num_edges(); i++)
+		neighs.push_back(out_v.get_neighbor(i));
+	if (header.is_directed_graph()) {
+		const ext_mem_undirected_vertex &in_v = get_vertex(id, IN_EDGE);
+		for (size_t i = 0; i < in_v.get_num_edges(); i++)
+			neighs.push_back(in_v.get_neighbor(i));
+	}
+}
+
+struct degree_greater
+{
+	const graph_image &g;
+
+	degree_greater(const graph_image &_g): g(_g) {
+	}
+
+	bool operator()(vertex_id_t id1, vertex_id_t id2) const {
+		return g.get_degree(id1) > g.get_degree(id2);
+	}
+};
+
+struct degree_less
+{
+	const graph_image &g;
+
+	degree_less(const graph_image &_g): g(_g) {
+	}
+
+	bool operator()(vertex_id_t id1, vertex_id_t id2) const {
+		return g.get_degree(id1) < g.get_degree(id2);
+	}
+};
+
+/*
+ * All orders return the original IDs of the vertices in the new order.
+ */
+
+/*
+ * High-degree vertices are accessed most often, so putting them together
+ * keeps the hot part of the graph in a small number of pages.
+ */
+std::vector<vertex_id_t> get_degree_order(const graph_image &g)
+{
+	std::vector<vertex_id_t> order(g.get_num_vertices());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), degree_greater(g));
+	return order;
+}
+
+/*
+ * The vertices are numbered in the order of BFS, so the neighbors of
+ * a vertex tend to have close IDs. We start BFS from high-degree vertices.
+ * In the reverse Cuthill-McKee order, BFS starts from low-degree vertices,
+ * visits neighbors in the order of their degree and the final order
+ * is reversed. It reduces the bandwidth of the adjacency matrix.
+ */
+std::vector<vertex_id_t> get_bfs_order(const graph_image &g, bool rcm)
+{
+	std::vector<vertex_id_t> starts = get_degree_order(g);
+	if (rcm)
+		std::reverse(starts.begin(), starts.end());
+
+	std::vector<bool> visited(g.get_num_vertices());
+	std::vector<vertex_id_t> order;
+	order.reserve(g.get_num_vertices());
+	std::vector<vertex_id_t> neighs;
+	for (size_t i = 0; i < starts.size(); i++) {
+		if (visited[starts[i]])
+			continue;
+		visited[starts[i]] = true;
+		size_t head = order.size();
+		order.push_back(starts[i]);
+		while (head < order.size()) {
+			g.get_neighbors(order[head++], neighs);
+			if (rcm)
+				std::stable_sort(neighs.begin(), neighs.end(), degree_less(g));
+			for (size_t j = 0; j < neighs.size(); j++) {
+				if (!visited[neighs[j]]) {
+					visited[neighs[j]] = true;
+					order.push_back(neighs[j]);
+				}
+			}
+		}
+	}
+	assert(order.size() == g.get_num_vertices());
+	if (rcm)
+		std::reverse(order.begin(), order.end());
+	return order;
+}
+
+void print_usage()
+{
+	fprintf(stderr,
+			"fg_reorder [options] conf_file graph_file index_file new_graph\n");
+	fprintf(stderr, "-o order: the vertex order (degree, bfs, rcm)\n");
+	fprintf(stderr, "The new graph is stored in new_graph.adj and new_graph.index.\n");
+	fprintf(stderr, "new_graph.map stores the original ID of each vertex in the new graph as an array of 8-byte integers.\n");
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	int num_opts = 0;
+	std::string order_name = "bfs";
+	while ((opt = getopt(argc, argv, "o:")) != -1) {
+		num_opts++;
+		switch (opt) {
+			case 'o':
+				order_name = optarg;
+				num_opts++;
+				break;
+			default:
+				print_usage();
+				exit(1);
+		}
+	}
+	argv += 1 + num_opts;
+	argc -= 1 + num_opts;
+	if (argc < 4) {
+		print_usage();
+		exit(1);
+	}
+	if (order_name != "degree" && order_name != "bfs" && order_name != "rcm") {
+		fprintf(stderr, "unknown order %s\n", order_name.c_str());
+		exit(1);
+	}
+
+	std::string conf_file = argv[0];
+	std::string graph_file = argv[1];
+	std::string index_file = argv[2];
+	std::string new_graph_name = argv[3];
+
+	config_map::ptr configs = config_map::create(conf_file);
+	graph_engine::init_flash_graph(configs);
+
+	FG_graph::ptr g = FG_graph::create(graph_file, index_file, configs);
+	const graph_header &header = g->get_graph_header();
+	if (!g->is_in_mem()) {
+		fprintf(stderr, "the graph needs to be loaded to memory\n");
+		exit(1);
+	}
+	if (header.get_graph_type() != graph_type::DIRECTED
+			&& header.get_graph_type() != graph_type::UNDIRECTED) {
+		fprintf(stderr, "only directed and undirected graphs can be reordered\n");
+		exit(1);
+	}
+	printf("The graph has %ld vertices and %ld edges\n",
+			header.get_num_vertices(), header.get_num_edges());
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	std::vector<vertex_id_t> order;
+	{
+		// The copy of the graph image is freed before the graph is reordered.
+		graph_image image(g);
+		if (order_name == "degree")
+			order = get_degree_order(image);
+		else
+			order = get_bfs_order(image, order_name == "rcm");
+	}
+	gettimeofday(&end, NULL);
+	printf("It takes %.3f seconds to compute the %s order\n",
+			time_diff(start, end), order_name.c_str());
+
+	gettimeofday(&start, NULL);
+	FG_graph::ptr new_graph = reorder_graph(g, order, new_graph_name);
+	gettimeofday(&end, NULL);
+	printf("It takes %.3f seconds to construct the new graph\n",
+			time_diff(start, end));
+
+	new_graph->get_graph_data()->dump(new_graph_name + ".adj");
+	new_graph->get_index_data()->dump(new_graph_name + ".index");
+
+	std::string map_file = new_graph_name + ".map";
+	FILE *f = fopen(map_file.c_str(), "w");
+	if (f == NULL) {
+		perror("fopen");
+		exit(1);
+	}
+	if (fwrite(order.data(), sizeof(order[0]), order.size(), f)
+			!= order.size()) {
+		perror("fwrite");
+		exit(1);
+	}
+	fclose(f);
+
+	graph_engine::destroy_flash_graph();
+}
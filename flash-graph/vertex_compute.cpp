@@ -104,6 +104,18 @@ void vertex_compute::run(page_byte_array &array)
 	finish_run();
 }
 
+/*
+ * SAFS can't read the adjacency list. The vertex program doesn't run on it,
+ * but the vertex still completes when all of its requests are done.
+ */
+void vertex_compute::fail(const request_range &range)
+{
+	num_complete_fetched++;
+	graph->add_failed_read();
+	start_run();
+	finish_run();
+}
+
 void directed_vertex_compute::run_on_page_vertex(page_directed_vertex &pg_v)
 {
 	start_run();
@@ -137,6 +149,13 @@ void directed_vertex_compute::run(page_byte_array &array)
 		page_byte_array *arr_copy = array.clone();
 		assert(arr_copy);
 		it->second = arr_copy;
+		// The other edge list of the vertex failed, so this is the last
+		// request and the vertex has to complete here.
+		if (get_num_pending() == 0) {
+			start_run();
+			finish_run();
+			drop_partial_vertices();
+		}
 	}
 	else {
 		page_byte_array *in_arr;
@@ -158,6 +177,27 @@ void directed_vertex_compute::run(page_byte_array &array)
 	}
 }
 
+void directed_vertex_compute::fail(const request_range &range)
+{
+	vertex_compute::fail(range);
+	drop_partial_vertices();
+}
+
+/*
+ * When all requests are done, the vertices left in the combine map have
+ * an edge list that can't be read, so they never run.
+ */
+void directed_vertex_compute::drop_partial_vertices()
+{
+	if (get_num_pending() > 0)
+		return;
+	for (combine_map_t::iterator it = combine_map.begin();
+			it != combine_map.end(); it++)
+		if (it->second)
+			page_byte_array::destroy(it->second);
+	combine_map.clear();
+}
+
 void directed_vertex_compute::request_vertices(vertex_id_t ids[], size_t num)
 {
 	stack_array<directed_vertex_request> reqs(num);
@@ -239,6 +279,26 @@ void merged_vertex_compute::finish_run(compute_vertex_pointer v)
 		issue_thread->complete_vertex(v);
 }
 
+/*
+ * The vertices complete without running the vertex program when
+ * their adjacency lists can't be read.
+ */
+void merged_vertex_compute::skip_vertices()
+{
+	for (int i = 0; i < num_vertices; i++) {
+		compute_vertex_pointer v(&get_graph().get_vertex(start_id + i));
+		start_run(v);
+		finish_run(v);
+	}
+}
+
+void merged_undirected_vertex_compute::fail(const request_range &range)
+{
+	get_graph().add_failed_read();
+	skip_vertices();
+	complete = true;
+}
+
 void merged_undirected_vertex_compute::run(page_byte_array &array)
 {
 	off_t off = 0;
@@ -310,6 +370,11 @@ void merged_directed_vertex_compute::run(page_byte_array &arr)
 {
 	this->num_fetched_arrs++;
 	assert(num_fetched_arrs <= num_required_arrs);
+	// The other edge list failed, so the vertices can't run.
+	if (failed) {
+		skip_vertices();
+		return;
+	}
 	if (type == BOTH_EDGES && buffered_arr) {
 		page_byte_array *in_arr;
 		page_byte_array *out_arr;
@@ -343,6 +408,20 @@ void merged_directed_vertex_compute::run(page_byte_array &arr)
 		throw std::invalid_argument("wrong edge type");
 }
 
+void merged_directed_vertex_compute::fail(const request_range &range)
+{
+	this->num_fetched_arrs++;
+	assert(num_fetched_arrs <= num_required_arrs);
+	get_graph().add_failed_read();
+	failed = true;
+	if (buffered_arr) {
+		page_byte_array::destroy(buffered_arr);
+		buffered_arr = NULL;
+	}
+	if (has_completed())
+		skip_vertices();
+}
+
 void sparse_vertex_compute::start_run(compute_vertex_pointer v)
 {
 	issue_thread->start_run_vertex(v);
@@ -362,6 +441,29 @@ void sparse_vertex_compute::finish_run(compute_vertex_pointer v)
 		issue_thread->complete_vertex(v);
 }
 
+/*
+ * The vertices complete without running the vertex program when
+ * their adjacency lists can't be read.
+ */
+void sparse_vertex_compute::skip_vertices()
+{
+	for (int i = 0; i < num_ranges; i++) {
+		for (vertex_id_t id = ranges[i].id_range.first;
+				id < ranges[i].id_range.second; id++) {
+			compute_vertex_pointer v(&get_graph().get_vertex(id));
+			start_run(v);
+			finish_run(v);
+		}
+	}
+	complete = true;
+}
+
+void sparse_undirected_vertex_compute::fail(const request_range &range)
+{
+	get_graph().add_failed_read();
+	skip_vertices();
+}
+
 void sparse_undirected_vertex_compute::run(page_byte_array &arr)
 {
 	assert(arr.get_offset() + arr.get_size() > (size_t) ranges[num_ranges - 1].start_off);
@@ -446,8 +548,28 @@ void sparse_directed_vertex_compute::run_on_arrays(page_byte_array &in_arr,
 	complete = true;
 }
 
+void sparse_directed_vertex_compute::fail(const request_range &range)
+{
+	get_graph().add_failed_read();
+	// We wait for the other edge list before the vertices complete.
+	if (type == BOTH_EDGES && buffered_arr == NULL && !failed) {
+		failed = true;
+		return;
+	}
+	if (buffered_arr) {
+		page_byte_array::destroy(buffered_arr);
+		buffered_arr = NULL;
+	}
+	skip_vertices();
+}
+
 void sparse_directed_vertex_compute::run(page_byte_array &arr)
 {
+	// The other edge list failed, so the vertices can't run.
+	if (failed) {
+		skip_vertices();
+		return;
+	}
 	if (type == BOTH_EDGES && buffered_arr) {
 		page_byte_array *in_arr;
 		page_byte_array *out_arr;
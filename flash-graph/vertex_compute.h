@@ -143,6 +143,7 @@ public:
 	virtual safs::request_range get_next_request();
 
 	virtual void run(safs::page_byte_array &);
+	virtual void fail(const safs::request_range &range);
 
 	virtual bool has_completed() {
 		// If the user compute has got all requested data and it has
@@ -214,6 +215,7 @@ class directed_vertex_compute: public vertex_compute
 	combine_map_t combine_map;
 
 	void run_on_page_vertex(page_directed_vertex &);
+	void drop_partial_vertices();
 public:
 	directed_vertex_compute(graph_engine *graph,
 			safs::compute_allocator *alloc): vertex_compute(graph, alloc) {
@@ -224,6 +226,7 @@ public:
 	}
 
 	virtual void run(safs::page_byte_array &);
+	virtual void fail(const safs::request_range &range);
 
 	/*
 	 * These two methods accept the requests from graph applications and issue
@@ -267,6 +270,7 @@ protected:
 
 	void start_run(compute_vertex_pointer v);
 	void finish_run(compute_vertex_pointer v);
+	void skip_vertices();
 public:
 	merged_vertex_compute(graph_engine *graph,
 			safs::compute_allocator *alloc): safs::user_compute(alloc) {
@@ -326,6 +330,7 @@ public:
 	}
 
 	virtual void run(safs::page_byte_array &arr);
+	virtual void fail(const safs::request_range &range);
 
 	virtual bool has_completed() {
 		return complete;
@@ -342,6 +347,8 @@ class merged_directed_vertex_compute: public merged_vertex_compute
 	int num_fetched_arrs;
 	int num_required_arrs;
 	safs::page_byte_array *buffered_arr;
+	// It's set when an edge list of the vertices can't be read.
+	bool failed;
 
 	void run_on_array(safs::page_byte_array &arr);
 	void run_on_arrays(safs::page_byte_array &in_arr, safs::page_byte_array &out_arr);
@@ -352,12 +359,14 @@ public:
 		num_fetched_arrs = 0;
 		num_required_arrs = 0;
 		buffered_arr = NULL;
+		failed = false;
 	}
 
 	void init(vertex_id_t start_id, int num_vertices, edge_type type) {
 		merged_vertex_compute::init(start_id, num_vertices, type);
 		this->type = type;
 		this->num_fetched_arrs = 0;
+		this->failed = false;
 		switch(type) {
 			case IN_EDGE:
 			case OUT_EDGE:
@@ -372,6 +381,7 @@ public:
 	}
 
 	virtual void run(safs::page_byte_array &arr);
+	virtual void fail(const safs::request_range &range);
 
 	virtual bool has_completed() {
 		return num_fetched_arrs == num_required_arrs;
@@ -398,6 +408,7 @@ protected:
 
 	void start_run(compute_vertex_pointer v);
 	void finish_run(compute_vertex_pointer v);
+	void skip_vertices();
 public:
 	sparse_vertex_compute(graph_engine *graph,
 			safs::compute_allocator *alloc): safs::user_compute(alloc) {
@@ -481,6 +492,7 @@ public:
 	}
 
 	virtual void run(safs::page_byte_array &arr);
+	virtual void fail(const safs::request_range &range);
 };
 
 class sparse_directed_vertex_compute: public sparse_vertex_compute
@@ -488,6 +500,8 @@ class sparse_directed_vertex_compute: public sparse_vertex_compute
 	edge_type type;
 	std::vector<off_t> out_start_offs;
 	safs::page_byte_array *buffered_arr;
+	// It's set when an edge list of the vertices can't be read.
+	bool failed;
 
 	void run_on_array(safs::page_byte_array &arr);
 	void run_on_arrays(safs::page_byte_array &in_arr, safs::page_byte_array &out_arr);
@@ -496,12 +510,14 @@ public:
 			safs::compute_allocator *alloc): sparse_vertex_compute(graph, alloc) {
 		type = edge_type::NONE;
 		buffered_arr = NULL;
+		failed = false;
 	}
 
 	virtual void init(const std::pair<vertex_id_t, vertex_id_t> &range,
 			const std::pair<off_t, off_t> off_ranges[],
 			edge_type type) {
 		this->type = type;
+		this->failed = false;
 		sparse_vertex_compute::init(range, off_ranges, type);
 		if (type == BOTH_EDGES) {
 			out_start_offs.clear();
@@ -518,6 +534,7 @@ public:
 	}
 
 	virtual void run(safs::page_byte_array &arr);
+	virtual void fail(const safs::request_range &range);
 };
 
 template<class compute_type>
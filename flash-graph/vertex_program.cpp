@@ -39,6 +39,8 @@ vertex_program::~vertex_program()
 		multicast_msg_sender::destroy(multicast_senders[i]);
 	for (unsigned i = 0; i < activate_senders.size(); i++)
 		multicast_msg_sender::destroy(activate_senders[i]);
+	for (unsigned i = 0; i < combine_senders.size(); i++)
+		delete combine_senders[i];
 }
 
 void vertex_program::init(graph_engine *graph, worker_thread *t)
@@ -72,6 +74,39 @@ void vertex_program::init_messaging(const std::vector<worker_thread *> &threads,
 		activate_sender->init(msg);
 		activate_senders.push_back(activate_sender);
 	}
+	if (combiner)
+		init_combine_senders();
+}
+
+void vertex_program::init_combine_senders()
+{
+	for (unsigned i = 0; i < combine_senders.size(); i++) {
+		combine_senders[i]->flush();
+		delete combine_senders[i];
+	}
+	combine_senders.clear();
+	if (combiner == NULL)
+		return;
+	for (unsigned i = 0; i < msg_senders.size(); i++)
+		combine_senders.push_back(new combine_msg_sender(*msg_senders[i],
+					combiner));
+}
+
+void vertex_program::set_message_combiner(message_combiner::ptr combiner)
+{
+	this->combiner = combiner;
+	// If the messaging has been initialized, we create the senders here.
+	// Otherwise, they are created when the messaging is initialized.
+	if (!msg_senders.empty())
+		init_combine_senders();
+}
+
+size_t vertex_program::get_num_combined_msgs() const
+{
+	size_t num = 0;
+	for (size_t i = 0; i < combine_senders.size(); i++)
+		num += combine_senders[i]->get_num_combined();
+	return num;
 }
 
 void vertex_program::multicast_msg(vertex_id_t ids[], int num,
@@ -150,12 +185,16 @@ void vertex_program::send_msg(vertex_id_t dest, vertex_message &msg)
 		// the flush message.
 		get_activate_sender(part_id).flush();
 		get_multicast_sender(part_id).flush();
+		if (!combine_senders.empty())
+			combine_senders[part_id]->flush();
 		get_msg_sender(part_id).flush();
 
 		simple_msg_sender &sender = get_flush_msg_sender(part_id);
 		sender.send_cached(msg);
 		sender.flush();
 	}
+	else if (!combine_senders.empty())
+		combine_senders[part_id]->send(msg);
 	else {
 		simple_msg_sender &sender = get_msg_sender(part_id);
 		sender.send_cached(msg);
@@ -245,6 +284,9 @@ void vertex_program::activate_vertices(edge_seq_iterator &it)
 
 void vertex_program::flush_msgs()
 {
+	// The merged messages are sent with the simple message senders.
+	for (size_t i = 0; i < combine_senders.size(); i++)
+		combine_senders[i]->flush();
 	for (size_t i = 0; i < msg_senders.size(); i++)
 		msg_senders[i]->flush();
 	for (size_t i = 0; i < multicast_senders.size(); i++)
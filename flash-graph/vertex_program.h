@@ -59,6 +59,12 @@ class vertex_program
 	std::vector<simple_msg_sender *> flush_msg_senders;
 	std::vector<multicast_msg_sender *> multicast_senders;
 	std::vector<multicast_msg_sender *> activate_senders;
+	// The senders that merge the point-to-point messages to the same
+	// vertex. They only exist when there is a message combiner.
+	message_combiner::ptr combiner;
+	std::vector<combine_msg_sender *> combine_senders;
+
+	void init_combine_senders();
     
 	multicast_msg_sender &get_activate_sender(int thread_id) const {
 		return *activate_senders[thread_id];
@@ -215,6 +221,24 @@ public:
 		activate_vertices(&vertex, 1);
 	}
 
+	/**
+	 * \brief Merge the point-to-point messages sent to the same vertex by
+	 *        the worker thread with a combiner before they are sent to
+	 *        the owner thread of the vertex. Multicast messages aren't
+	 *        merged. The merged messages are delivered at the end of
+	 *        the iteration at the latest. It's off by default, because
+	 *        merging a message costs about as much as sending it.
+	 *        A user usually sets the combiner in the constructor of
+	 *        a customized vertex program.
+	 *  \param combiner The combiner for the messages sent by the vertex program.
+	 */
+	void set_message_combiner(message_combiner::ptr combiner);
+
+	/**
+	 * \brief Get the number of messages merged by the combiner.
+	 */
+	size_t get_num_combined_msgs() const;
+
     /* Internal */
 	void flush_msgs();
 
@@ -423,6 +423,7 @@ void worker_thread::init()
 				new default_vertex_queue(*graph, worker_id, get_node_id()));
 
 	io = create_io(graph_factory, this);
+	io->set_io_priority(graph_conf.get_io_class());
 	if (graph->get_in_mem_index())
 		index_reader = simple_index_reader::create(
 				graph->get_in_mem_index(),
@@ -430,8 +431,9 @@ void worker_thread::init()
 				this);
 	else {
 		assert(index_factory);
-		index_reader = simple_index_reader::create(
-				create_io(index_factory, this),
+		io_interface::ptr index_io = create_io(index_factory, this);
+		index_io->set_io_priority(graph_conf.get_io_class());
+		index_reader = simple_index_reader::create(index_io,
 				graph->get_graph_header().get_graph_type() == graph_type::DIRECTED,
 				this);
 	}
@@ -506,12 +508,8 @@ int worker_thread::process_activated_vertices(int max)
 		return 0;
 
 	process_vertex_buf.resize(max);
-	int num = curr_activated_vertices->fetch(process_vertex_buf.data(), max);
-	if (num == 0) {
-		assert(curr_activated_vertices->is_empty());
-		num = balancer->steal_activated_vertices(process_vertex_buf.data(),
-				max);
-	}
+	int num = balancer->fetch_activated_vertices(process_vertex_buf.data(),
+			max);
 	if (num > 0) {
 		num_activated_vertices_in_level.inc(num);
 		graph->process_vertices(num);
@@ -628,17 +626,22 @@ void worker_thread::run()
 
 int worker_thread::steal_activated_vertices(compute_vertex_pointer vertices[], int num)
 {
-	// This method is called in the context of other worker threads,
+	assert(num >= vertex_chunk_deque::CHUNK_SIZE);
+	// This method is called in the context of other worker threads.
+	// We steal a chunk from the deque of the thread first.
+	num = balancer->steal_chunk(vertices);
+	// If the deque is empty, the thread hasn't moved its remaining
+	// vertices to the deque yet. We steal from its vertex queue directly.
 	// curr_activated_vertices may not have been initialized. If so,
 	// skip it.
-	if (curr_activated_vertices == NULL)
-		return 0;
-	// We want to steal as much as possible, but we don't want
-	// to overloaded by the stolen vertices.
-	size_t num_steal = std::max(1UL,
-			curr_activated_vertices->get_num_vertices() / graph->get_num_threads());
-	num = curr_activated_vertices->fetch(vertices,
-			std::min((size_t) num, num_steal));
+	if (num == 0 && curr_activated_vertices != NULL) {
+		// We want to steal as much as possible, but we don't want
+		// to overloaded by the stolen vertices.
+		size_t num_steal = std::max(1UL,
+				curr_activated_vertices->get_num_vertices() / graph->get_num_threads());
+		num = curr_activated_vertices->fetch(vertices,
+				std::min((size_t) vertex_chunk_deque::CHUNK_SIZE, num_steal));
+	}
 	if (num > 0)
 		// If the thread steals vertices from another thread successfully,
 		// it needs to notify the thread of the stolen vertices.
@@ -56,9 +56,10 @@ public:
 		return *caches[node_id];
 	}
 
-	virtual page *search(const page_id_t &pg_id, page_id_t &old_id) {
+	virtual page *search(const page_id_t &pg_id, page_id_t &old_id,
+			int hint) {
 		int idx = cache_conf->page2cache(pg_id);
-		return caches[idx]->search(pg_id, old_id);
+		return caches[idx]->search(pg_id, old_id, hint);
 	}
 
 	virtual page *search(const page_id_t &pg_id) {
@@ -67,7 +68,17 @@ public:
 	}
 
 	virtual long size() {
-		return cache_conf->get_size();
+		long tot = 0;
+		for (size_t i = 0; i < caches.size(); i++)
+			tot += caches[i]->size();
+		return tot;
+	}
+
+	virtual long resize(long new_size) {
+		long tot = 0;
+		for (size_t i = 0; i < caches.size(); i++)
+			tot += caches[i]->resize(new_size / caches.size());
+		return tot;
 	}
 
 	// TODO shouldn't I use a different underlying IO for cache
@@ -111,6 +122,11 @@ public:
 		return tot;
 	}
 
+	virtual void get_cached_pages(std::vector<page_id_t> &pg_ids) const {
+		for (size_t i = 0; i < caches.size(); i++)
+			caches[i]->get_cached_pages(pg_ids);
+	}
+
 	virtual void sanity_check() const {
 		for (size_t i = 0; i < caches.size(); i++) {
 			caches[i]->sanity_check();
@@ -27,13 +27,6 @@
 namespace safs
 {
 
-static safs_header get_safs_header(const RAID_config &conf,
-		const std::string &file_name)
-{
-	safs_file f(conf, file_name);
-	return f.get_header();
-}
-
 file_mapper::ptr RAID_config::create_file_mapper(const std::string &file_name) const
 {
 	/*
@@ -70,7 +63,8 @@ file_mapper::ptr RAID_config::create_file_mapper(const std::string &file_name) c
 		}
 		int part_id = atoi(part_ids[0].c_str());
 		part_file_info info(dir_name + std::string("/") + part_ids[0],
-				root_paths[i].get_disk_id(), root_paths[i].get_node_id());
+				root_paths[i].get_disk_id(), root_paths[i].get_node_id(),
+				root_paths[i].get_weight());
 		file_map.insert(std::pair<int, part_file_info>(part_id, info));
 	}
 	if (file_map.size() < root_paths.size()) {
@@ -85,28 +79,21 @@ file_mapper::ptr RAID_config::create_file_mapper(const std::string &file_name) c
 		files.push_back(it->second);
 	}
 
-	safs_header header = get_safs_header(*this, file_name);
-	int block_size = RAID_block_size;
-	int mapping_option = RAID_mapping_option;
+	safs_file f(*this, file_name);
+	safs_header header = f.get_header();
 	// The per-file config can overwrite the default config.
-	if (header.is_valid()) {
-		block_size = header.get_block_size();
-		mapping_option = header.get_mapping_option();
-	}
-	switch (mapping_option) {
-		case RAID0:
-			return file_mapper::ptr(new RAID0_mapper(file_name, files,
-						block_size));
-		case RAID5:
-			return file_mapper::ptr(new RAID5_mapper(file_name, files,
-						block_size));
-		case HASH:
-			return file_mapper::ptr(new hash_mapper(file_name, files,
-						block_size));
-		default:
-			fprintf(stderr, "wrong RAID mapping option\n");
-			return file_mapper::ptr();
-	}
+	if (!header.is_valid())
+		header = safs_header(RAID_block_size, RAID_mapping_option, false, 0);
+	file_mapper::ptr mapper = file_mapper::create(header, files, file_name,
+			f.get_disk_weights());
+	if (mapper == NULL)
+		return file_mapper::ptr();
+	mapper->set_compress_table(f.get_compress_table());
+	// The checksums are only loaded to memory if they are verified.
+	mapper->set_has_checksums(f.has_checksum_table());
+	if (params.get_verify_checksum() > 0 && mapper->has_checksums())
+		mapper->set_checksum_table(f.get_checksum_table());
+	return mapper;
 }
 
 file_mapper::ptr RAID_config::create_file_mapper() const
@@ -121,6 +108,9 @@ file_mapper::ptr RAID_config::create_file_mapper() const
 		case HASH:
 			return file_mapper::ptr(new hash_mapper("root", root_paths,
 						RAID_block_size));
+		case WEIGHTED:
+			return file_mapper::ptr(new weighted_mapper("root", root_paths,
+						RAID_block_size));
 		default:
 			fprintf(stderr, "wrong RAID mapping option\n");
 			return file_mapper::ptr();
@@ -169,6 +159,20 @@ static int retrieve_data_files(std::string file_file,
 			colon++;
 			name = colon;
 		}
+		// The weight of the disk for the weighted mapping is optional and
+		// follows the path, e.g., "0:/mnt/ssd0:2".
+		int weight = 0;
+		char *weight_colon = strstr(name, ":");
+		if (weight_colon) {
+			*weight_colon = 0;
+			weight = atoi(weight_colon + 1);
+			if (weight <= 0) {
+				BOOST_LOG_TRIVIAL(error) << boost::format(
+						"The weight of `%1%' must be a positive integer") % name;
+				data_files.clear();
+				break;
+			}
+		}
 		std::string path_name = name;
 		path_name.erase(std::remove_if(path_name.begin(), path_name.end(),
 					isspace), path_name.end());
@@ -193,7 +197,7 @@ static int retrieve_data_files(std::string file_file,
 			break;
 		}
 
-		data_files.emplace_back(path_name, disk_id, node_id);
+		data_files.emplace_back(path_name, disk_id, node_id, weight);
 		free(line);
 		line = NULL;
 		size = 0;
@@ -35,6 +35,7 @@ enum {
 	RAID0,
 	RAID5,
 	HASH,
+	WEIGHTED,
 };
 
 class RAID_config
@@ -18,14 +18,20 @@
  */
 
 #include <limits.h>
+#include <string.h>
 
 #include <boost/assert.hpp>
+#include <boost/format.hpp>
 
+#include "log.h"
 #include "aio_private.h"
 #include "messaging.h"
 #include "read_private.h"
 #include "file_partition.h"
 #include "slab_allocator.h"
+#include "compression.h"
+#include "checksum.h"
+#include "safs_exception.h"
 
 template class blocking_FIFO_queue<safs::thread_callback_s *>;
 
@@ -51,6 +57,19 @@ struct thread_callback_s
 	callback_allocator *cb_allocator;
 	io_request req;
 	embedded_array<struct iovec, MAX_EMBED_BUFS> vec;
+	// These are used when the request reads a compressed block.
+	const block_compress_table *compress_table;
+	// The location of the compressed block in the SAFS file.
+	off_t block_off;
+	char *compressed_buf;
+	size_t compressed_buf_size;
+	size_t compressed_size;
+	// It's set if the checksums of the data read by the request
+	// are verified.
+	const block_checksum_table *checksum_table;
+	// These are used for the latency histograms.
+	uint64_t issue_time;
+	int disk_id;
 };
 
 /**
@@ -64,6 +83,7 @@ class callback_allocator: public obj_allocator<thread_callback_s>
 	public:
 		void init(thread_callback_s *cb) {
 			new (&cb->req) io_request();
+			cb->compressed_buf = NULL;
 		}
 	};
 public:
@@ -86,6 +106,18 @@ void aio_callback(io_context_t ctx, struct iocb* iocb[],
 			aio = tcbs[i]->aio;
 		// This is true when disks are only accessed by disk access threads.
 		assert(aio == tcbs[i]->aio);
+		// A read on a compressed block has to get the entire compressed
+		// data, or it can't be decompressed.
+		io_request &req = tcbs[i]->req;
+		if (req.get_access_method() == READ && (res[i] < 0
+					|| (tcbs[i]->compressed_buf
+						&& (size_t) res[i] < tcbs[i]->compressed_size))) {
+			BOOST_LOG_TRIVIAL(error) << boost::format(
+					"fail to read %1% bytes at %2% in file %3% on disk %4%: %5%")
+				% req.get_size() % req.get_offset() % req.get_file_id()
+				% tcbs[i]->disk_id % (res[i] < 0 ? strerror(-res[i]) : "short read");
+			req.set_failed(true);
+		}
 	}
 
 	aio->return_cb(tcbs, num);
@@ -115,16 +147,29 @@ async_io::async_io(const logical_file_partition &partition,
 	cb_allocator = new callback_allocator(node_id,
 			AIO_DEPTH * sizeof(thread_callback_s));;
 	buf_idx = 0;
-	ctx = new aio_ctx_impl(node_id, AIO_DEPTH);
+	ctx = create_aio_ctx(node_id, AIO_DEPTH);
 
 	num_iowait = 0;
 	num_completed_reqs = 0;
 	open_flags = flags;
+	compress_buf_size = 0;
+	curr_issue_time = 0;
+	num_unchecked_reads = 0;
+	if (params.is_latency_stat()) {
+		queue_lat = latency_histogram::ptr(new latency_histogram());
+		register_latency_hist(get_thread_stat_name() + " queue", queue_lat);
+		if (params.get_verify_checksum() > 0) {
+			checksum_lat = latency_histogram::ptr(new latency_histogram());
+			register_latency_hist(get_thread_stat_name() + " checksum",
+					checksum_lat);
+		}
+	}
 	if (partition.is_active()) {
 		int file_id = partition.get_file_id();
 		io_ref io(new buffered_io(partition, t, header, O_DIRECT | flags));
 		default_io = io;
 		open_files.insert(std::pair<int, io_ref>(file_id, io));
+		ctx->register_files(io.get_io().get_fds());
 	}
 }
 
@@ -149,6 +194,21 @@ async_io::~async_io()
 	delete ctx;
 	open_files.clear();
 	delete cb_allocator;
+	for (size_t i = 0; i < compress_bufs.size(); i++)
+		free(compress_bufs[i]);
+	if (queue_lat)
+		unregister_latency_hist(get_thread_stat_name() + " queue", queue_lat);
+	if (checksum_lat)
+		unregister_latency_hist(get_thread_stat_name() + " checksum",
+				checksum_lat);
+	for (size_t i = 0; i < device_lats.size(); i++) {
+		if (device_lats[i] == NULL)
+			continue;
+		unregister_latency_hist(std::string("disk-") + itoa(i) + " device",
+				device_lats[i]);
+		unregister_latency_hist(get_thread_stat_name() + " device",
+				device_lats[i]);
+	}
 }
 
 int async_io::get_file_id() const
@@ -170,6 +230,7 @@ struct iocb *async_io::construct_req(io_request &io_req, callback_t cb_func)
 	tcb->req = io_req;
 	tcb->aio = this;
 	tcb->cb_allocator = cb_allocator;
+	tcb->issue_time = curr_issue_time;
 
 	assert(tcb->req.get_size() >= MIN_BLOCK_SIZE);
 	assert(tcb->req.get_size() % MIN_BLOCK_SIZE == 0);
@@ -181,7 +242,25 @@ struct iocb *async_io::construct_req(io_request &io_req, callback_t cb_func)
 	assert(it != open_files.end());
 	assert(it->second.is_valid());
 	buffered_io &io = it->second.get_io();
+	tcb->checksum_table = NULL;
+	if (io_type == A_READ && params.get_verify_checksum() > 0) {
+		const block_checksum_table *sums
+			= io.get_partition().get_mapper()->get_checksum_table().get();
+		// In the sampled mode, we only verify one in every N reads.
+		if (sums && ++num_unchecked_reads >= params.get_verify_checksum()) {
+			tcb->checksum_table = sums;
+			num_unchecked_reads = 0;
+		}
+	}
+	if (io_type == A_READ) {
+		const block_compress_table *table
+			= io.get_partition().get_mapper()->get_compress_table().get();
+		if (table && table->get_compressed_size(tcb->req.get_offset()
+					/ PAGE_SIZE / table->get_block_size()) > 0)
+			return construct_compressed_req(tcb, io, *table);
+	}
 	io.get_partition().map(tcb->req.get_offset() / PAGE_SIZE, bid);
+	tcb->disk_id = io.get_partition().get_mapper()->get_disk_id(bid.idx);
 	// Here we translate the global request offset to the offset in the local
 	// disk.
 	off_t local_off = bid.off * PAGE_SIZE + (tcb->req.get_offset() % PAGE_SIZE);
@@ -210,9 +289,141 @@ struct iocb *async_io::construct_req(io_request &io_req, callback_t cb_func)
 	}
 }
 
+/*
+ * A read on a compressed block fetches the compressed block from
+ * the beginning of the space of the block. The requested data is
+ * decompressed when the read completes.
+ */
+struct iocb *async_io::construct_compressed_req(thread_callback_s *tcb,
+		buffered_io &io, const block_compress_table &table)
+{
+	const size_t block_bytes = table.get_block_size() * PAGE_SIZE;
+	tcb->compress_table = &table;
+	tcb->block_off = ROUND(tcb->req.get_offset(), block_bytes);
+	tcb->compressed_size = table.get_compressed_size(
+			tcb->block_off / block_bytes);
+	tcb->compressed_buf = alloc_compress_buf(block_bytes);
+	tcb->compressed_buf_size = compress_buf_size;
+
+	block_identifier bid;
+	io.get_partition().map(tcb->block_off / PAGE_SIZE, bid);
+	tcb->disk_id = io.get_partition().get_mapper()->get_disk_id(bid.idx);
+	return ctx->make_io_request(io.get_fd(tcb->block_off),
+			ROUNDUP(tcb->compressed_size, MIN_BLOCK_SIZE), bid.off * PAGE_SIZE,
+			tcb->compressed_buf, A_READ, (io_callback_s *) tcb);
+}
+
+char *async_io::alloc_compress_buf(size_t size)
+{
+	// The buffers in the pool are too small.
+	if (size > compress_buf_size) {
+		for (size_t i = 0; i < compress_bufs.size(); i++)
+			free(compress_bufs[i]);
+		compress_bufs.clear();
+		compress_buf_size = size;
+	}
+	if (!compress_bufs.empty()) {
+		char *buf = compress_bufs.back();
+		compress_bufs.pop_back();
+		return buf;
+	}
+	void *addr = NULL;
+	BOOST_VERIFY(posix_memalign(&addr, PAGE_SIZE, compress_buf_size) == 0);
+	return (char *) addr;
+}
+
+void async_io::free_compress_buf(char *buf, size_t size)
+{
+	if (size == compress_buf_size)
+		compress_bufs.push_back(buf);
+	else
+		free(buf);
+}
+
+/*
+ * This runs in the I/O thread when a read on a compressed block completes.
+ * The page cache gets the decompressed data.
+ */
+void async_io::decompress(thread_callback_s *tcb)
+{
+	io_request &req = tcb->req;
+	// The compressed data wasn't read from the disk.
+	if (req.is_failed()) {
+		free_compress_buf(tcb->compressed_buf, tcb->compressed_buf_size);
+		tcb->compressed_buf = NULL;
+		return;
+	}
+	const block_compress_table &table = *tcb->compress_table;
+	const size_t block_bytes = table.get_block_size() * PAGE_SIZE;
+	off_t off_in_block = req.get_offset() - tcb->block_off;
+	// If the request reads the entire block, we can decompress it to
+	// the request buffer directly.
+	bool in_place = req.get_num_bufs() == 1 && off_in_block == 0
+		&& (size_t) req.get_size() == block_bytes;
+	char *block;
+	if (in_place)
+		block = req.get_buf();
+	else {
+		decompress_buf.resize(block_bytes);
+		block = decompress_buf.data();
+	}
+	ssize_t size = decompress_block(table.get_codec(), tcb->compressed_buf,
+			tcb->compressed_size, block, block_bytes);
+	free_compress_buf(tcb->compressed_buf, tcb->compressed_buf_size);
+	tcb->compressed_buf = NULL;
+	// This runs in the I/O thread, so we can't throw an exception here.
+	// The request is completed as a failed request instead.
+	if (size < 0) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"the compressed block at %1% in file %2% is corrupted")
+			% tcb->block_off % req.get_file_id();
+		req.set_failed(true);
+		return;
+	}
+	// The last block of a file may be smaller than the others.
+	memset(block + size, 0, block_bytes - size);
+	if (!in_place) {
+		for (int i = 0; i < req.get_num_bufs(); i++) {
+			memcpy(req.get_buf(i), block + off_in_block, req.get_buf_size(i));
+			off_in_block += req.get_buf_size(i);
+		}
+	}
+}
+
+/*
+ * This runs in the I/O thread when a read completes. A compressed block
+ * is verified after it's decompressed.
+ */
+void async_io::verify_checksum(thread_callback_s *tcb)
+{
+	uint64_t start = checksum_lat ? get_curr_time_ns() : 0;
+	io_request &req = tcb->req;
+	int num_bufs = req.get_num_bufs();
+	struct iovec vecs[num_bufs];
+	if (num_bufs == 1) {
+		vecs[0].iov_base = req.get_buf();
+		vecs[0].iov_len = req.get_size();
+	}
+	else
+		BOOST_VERIFY(req.get_vec(vecs, num_bufs) == num_bufs);
+	off_t bad_off = tcb->checksum_table->verify(req.get_offset(), vecs,
+			num_bufs);
+	if (checksum_lat)
+		checksum_lat->add(get_curr_time_ns() - start);
+	// Like a block that can't be decompressed, the request is completed
+	// as a failed request because we can't throw in the I/O thread.
+	if (bad_off >= 0) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"checksum mismatch at %1% in file %2% on disk %3%")
+			% bad_off % req.get_file_id() % tcb->disk_id;
+		req.set_failed(true);
+	}
+}
+
 void async_io::access(io_request *requests, int num, io_status *status)
 {
 	ASSERT_EQ(get_thread(), thread::get_curr_thread());
+	uint64_t start = queue_lat ? get_curr_time_ns() : 0;
 	while (num > 0) {
 		int slot = ctx->max_io_slot();
 		if (slot == 0) {
@@ -227,6 +438,17 @@ void async_io::access(io_request *requests, int num, io_status *status)
 		struct iocb *reqs[slot];
 		int min = slot > num ? num : slot;
 		int num_iocb = 0;
+		if (queue_lat) {
+			curr_issue_time = get_curr_time_ns();
+			// The requests sent by remote_io carry the time when they were
+			// sent, so the time in the message queues and the scheduler
+			// is counted.
+			for (int i = 0; i < min; i++) {
+				uint64_t create_time = requests[i].get_create_time();
+				queue_lat->add(curr_issue_time
+						- (create_time > 0 ? create_time : start));
+			}
+		}
 		for (int i = 0; i < min; i++) {
 			assert(requests->get_io());
 			struct iocb *req = construct_req(*requests, aio_callback);
@@ -339,8 +561,17 @@ void async_io::return_cb(thread_callback_s *tcbs[], int num)
 	int num_remote = 0;
 
 	num_completed_reqs += num;
+	uint64_t now = queue_lat ? get_curr_time_ns() : 0;
 	for (int i = 0; i < num; i++) {
 		thread_callback_s *tcb = tcbs[i];
+		if (queue_lat)
+			record_device_lat(tcb, now);
+		if (tcb->compressed_buf)
+			decompress(tcb);
+		// There is nothing to verify if the block can't be read or
+		// decompressed.
+		if (tcb->checksum_table && !tcb->req.is_failed())
+			verify_checksum(tcb);
 		if (tcb->req.get_io() == this)
 			local_tcbs[num_local++] = tcb;
 		else
@@ -367,6 +598,40 @@ void async_io::return_cb(thread_callback_s *tcbs[], int num)
 	}
 }
 
+void async_io::record_device_lat(thread_callback_s *tcb, uint64_t now)
+{
+	if ((size_t) tcb->disk_id >= device_lats.size())
+		device_lats.resize(tcb->disk_id + 1);
+	latency_histogram::ptr &hist = device_lats[tcb->disk_id];
+	// The histogram of a disk is registered twice, so we can see
+	// the device time of each disk and each I/O thread.
+	if (hist == NULL) {
+		hist = latency_histogram::ptr(new latency_histogram());
+		register_latency_hist(std::string("disk-") + itoa(tcb->disk_id)
+				+ " device", hist);
+		register_latency_hist(get_thread_stat_name() + " device", hist);
+	}
+	hist->add(now - tcb->issue_time);
+}
+
+int async_io::wait4complete(int num)
+{
+	int num_completed = 0;
+	uint64_t budget = get_poll_budget() * 1000UL;
+	if (budget > 0) {
+		// We poll the completion queue without blocking first, so we don't
+		// pay for a context switch if the requests are completed soon.
+		struct timespec zero = {0, 0};
+		uint64_t start = get_curr_time_ns();
+		do {
+			num_completed += ctx->io_wait(&zero, 0);
+		} while (num_completed < num && get_curr_time_ns() - start < budget);
+	}
+	if (num_completed < num)
+		num_completed += ctx->io_wait(NULL, num - num_completed);
+	return num_completed;
+}
+
 void async_io::notify_completion(io_request *reqs[], int num)
 {
 	if (this->cb) {
@@ -382,6 +647,7 @@ int async_io::open_file(const logical_file_partition &partition)
 		buffered_io *io = new buffered_io(partition, get_thread(),
 				get_header(), O_DIRECT | open_flags);
 		open_files.insert(std::pair<int, io_ref>(file_id, io_ref(io)));
+		ctx->register_files(io->get_fds());
 #if 0
 		if (data)
 			data->add_new_file(io);
@@ -395,6 +661,7 @@ int async_io::open_file(const logical_file_partition &partition)
 	else {
 		it->second = io_ref(new buffered_io(partition, get_thread(),
 					get_header(), O_DIRECT | open_flags));
+		ctx->register_files(it->second.get_io().get_fds());
 	}
 	return 0;
 }
@@ -404,6 +671,9 @@ int async_io::close_file(int file_id)
 	auto it = open_files.find(file_id);
 	// Users shouldn't close a file that hasn't been opened before.
 	assert(it != open_files.end());
+	// The physical files are closed when the last reference is gone.
+	if (it->second.get_count() == 1)
+		ctx->unregister_files(it->second.get_io().get_fds());
 	it->second.dec_ref();
 //	open_files.erase(it);
 	return 0;
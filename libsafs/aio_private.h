@@ -25,6 +25,7 @@
 
 #include "wpaio.h"
 #include "io_interface.h"
+#include "latency_histogram.h"
 #include "thread.h"
 #include "container.h"
 #include "io_request.h"
@@ -37,6 +38,8 @@ struct thread_callback_s;
 class buffered_io;
 class logical_file_partition;
 class callback_allocator;
+class block_compress_table;
+class block_checksum_table;
 
 class async_io: public io_interface
 {
@@ -87,7 +90,39 @@ class async_io: public io_interface
 	std::unordered_map<int, io_ref> open_files;
 	io_ref default_io;
 
+	// The buffers for reading compressed RAID blocks from disks.
+	// They all have `compress_buf_size' bytes.
+	std::vector<char *> compress_bufs;
+	size_t compress_buf_size;
+	// The buffer where a compressed RAID block is decompressed.
+	std::vector<char> decompress_buf;
+
+	// The latency histograms are only created when latency_stat is enabled.
+	// The time from when requests are sent to the I/O thread by remote_io
+	// until they are submitted to the kernel. It includes the time in
+	// the message queues and the request scheduler.
+	latency_histogram::ptr queue_lat;
+	// The device time of each disk, indexed by the disk id.
+	std::vector<latency_histogram::ptr> device_lats;
+	// The time when the requests being constructed are issued.
+	uint64_t curr_issue_time;
+	// The time of verifying the checksums of the data read from disks.
+	latency_histogram::ptr checksum_lat;
+	// The number of reads since the checksums were verified last time.
+	int num_unchecked_reads;
+
+	std::string get_thread_stat_name() const {
+		return std::string("io-thread-") + itoa(get_thread()->get_id());
+	}
+	void record_device_lat(thread_callback_s *tcb, uint64_t now);
+
 	struct iocb *construct_req(io_request &io_req, callback_t cb_func);
+	struct iocb *construct_compressed_req(thread_callback_s *tcb,
+			buffered_io &io, const block_compress_table &table);
+	char *alloc_compress_buf(size_t size);
+	void free_compress_buf(char *buf, size_t size);
+	void decompress(thread_callback_s *tcb);
+	void verify_checksum(thread_callback_s *tcb);
 public:
 	/**
 	 * @aio_depth_per_file
@@ -136,9 +171,7 @@ public:
 	}
 
 	virtual void notify_completion(io_request *reqs[], int num);
-	int wait4complete(int num) {
-		return ctx->io_wait(NULL, num);
-	}
+	int wait4complete(int num);
 	virtual int get_max_num_pending_ios() const {
 		return AIO_DEPTH;
 	}
@@ -169,6 +202,10 @@ public:
 		printf("aio %d has %ld open files, %d pending reqs\n",
 				get_io_id(), open_files.size(), num_pending_ios());
 	}
+
+	void print_stat() {
+		ctx->print_stat();
+	}
 };
 
 void init_aio(std::vector<int> node_ids);
@@ -21,6 +21,7 @@
 #include <limits.h>
 
 #include <algorithm>
+#include <vector>
 
 #include "io_interface.h"
 #include "associative_cache.h"
@@ -112,7 +113,9 @@ void page_cell<T>::steal_pages(T pages[], int &npages)
 template<class T>
 void page_cell<T>::sanity_check() const
 {
-	assert(params.get_SA_min_cell_size() <= num_pages);
+	// A cell may be shrunk to CELL_MIN_NUM_PAGES pages at runtime.
+	assert(std::min(params.get_SA_min_cell_size(), CELL_MIN_NUM_PAGES)
+			<= num_pages);
 	int num_used_pages = 0;
 	for (int i = 0; i < CELL_SIZE; i++)
 		if (buf[i].get_data())
@@ -149,6 +152,7 @@ void hash_cell::init(associative_cache *cache, long hash, bool get_pages) {
 			throw oom_exception();
 		buf.set_pages(pages, params.get_SA_min_cell_size(), table->get_node_id());
 	}
+	adaptive = params.get_cache_policy() == CACHE_POLICY_ADAPTIVE;
 	num_accesses = 0;
 	num_evictions = 0;
 }
@@ -296,6 +300,43 @@ void hash_cell::steal_pages(char *pages[], int &npages)
 	npages = num_stolen;
 }
 
+int hash_cell::release_pages(char *pages[], int npages, int min_npages)
+{
+	int num_released = 0;
+	_lock.lock();
+	while (num_released < npages && (int) buf.get_num_pages() > min_npages) {
+		// We take the empty pages first, and then the pages with
+		// the fewest hits.
+		thread_safe_page *victim = NULL;
+		for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
+			thread_safe_page *pg = buf.get_page(i);
+			if (pg->get_ref() || pg->is_dirty() || pg->is_old_dirty()
+					|| pg->is_io_pending() || pg->is_prepare_writeback())
+				continue;
+			if (!pg->initialized()) {
+				victim = pg;
+				break;
+			}
+			if (victim == NULL || pg->get_hits() < victim->get_hits())
+				victim = pg;
+		}
+		if (victim == NULL)
+			break;
+		pages[num_released++] = (char *) victim->get_data();
+		*victim = thread_safe_page();
+		buf.steal_page(victim);
+	}
+	_lock.unlock();
+	return num_released;
+}
+
+void hash_cell::refill_pages(char *pages[], int npages)
+{
+	_lock.lock();
+	buf.add_pages(pages, npages, table->get_node_id());
+	_lock.unlock();
+}
+
 void hash_cell::rebalance(hash_cell *cell)
 {
 	// TODO
@@ -322,9 +363,12 @@ page *hash_cell::search(const page_id_t &pg_id)
  * search for a page with the offset.
  * If the page doesn't exist, return an empty page.
  */
-page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
+page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id, int hint)
 {
 	thread_safe_page *ret = NULL;
+	bool reused = hint != ACCESS_HINT_SEQUENTIAL
+		&& hint != ACCESS_HINT_REUSE_ONCE;
+	bool hit = true;
 	_lock.lock();
 	num_accesses++;
 
@@ -336,7 +380,13 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 		}
 	}
 	if (ret == NULL) {
+		hit = false;
 		num_evictions++;
+		bool active = false;
+		// A page that isn't reused shouldn't change the target size
+		// of the lists.
+		if (adaptive && reused)
+			active = adaptive_policy.miss_page(pg_id);
 		ret = get_empty_page();
 		if (ret == NULL) {
 			_lock.unlock();
@@ -368,8 +418,10 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 		 * it might not have data ready.
 		 */
 		ret->set_id(pg_id);
+		if (adaptive)
+			adaptive_policy.add_page(ret, active, reused);
 #ifdef USE_SHADOW_PAGE
-		shadow_page shadow_pg = shadow.search(off);
+		shadow_page shadow_pg = shadow.search(pg_id);
 		/*
 		 * if the page has been seen before,
 		 * we should set the hits info.
@@ -378,6 +430,12 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 			ret->set_hits(shadow_pg.get_hits());
 #endif
 	}
+	else if (adaptive) {
+		// A page brought in by a scan is kept once it's accessed by
+		// others.
+		if (reused && !ret->referenced())
+			ret->set_referenced(true);
+	}
 	else
 		policy.access_page(ret, buf);
 	/* it's possible that the data in the page isn't ready */
@@ -388,7 +446,14 @@ page *hash_cell::search(const page_id_t &pg_id, page_id_t &old_id)
 		shadow.scale_down_hits();
 #endif
 	}
-	ret->hit();
+	/*
+	 * A page that isn't reused doesn't gain hits, so it's evicted first.
+	 * The adaptive policy doesn't count the access that brings a page
+	 * to the cell, so that a page accessed only once is never moved to
+	 * the active list.
+	 */
+	if (reused && (hit || !adaptive))
+		ret->hit();
 	_lock.unlock();
 #ifdef DEBUG
 	if (enable_debug && ret->is_old_dirty())
@@ -414,7 +479,11 @@ void hash_cell::print_cell()
 /* this function has to be called with lock held */
 thread_safe_page *hash_cell::get_empty_page()
 {
-	thread_safe_page *ret = policy.evict_page(buf);
+	thread_safe_page *ret;
+	if (adaptive)
+		ret = adaptive_policy.evict_page(buf);
+	else
+		ret = policy.evict_page(buf);
 	if (ret == NULL) {
 #ifdef DEBUG
 		printf("all pages in the cell were all referenced\n");
@@ -697,6 +766,152 @@ thread_safe_page *clock_eviction_policy::evict_page(
 	return ret;
 }
 
+bool adaptive_eviction_policy::miss_page(const page_id_t &pg_id)
+{
+	int num_active, num_inactive;
+	shadow.count_pages(num_active, num_inactive);
+	shadow_page pg = shadow.remove(pg_id);
+	if (!pg.is_valid())
+		return false;
+
+	/*
+	 * If the page was evicted from the inactive list, the inactive list
+	 * is too small, and vice versa. The target size changes faster if
+	 * the shadow cell has fewer pages of the list.
+	 */
+	if (pg.active())
+		target_inactive = std::max(0,
+				target_inactive - std::max(1, num_inactive / num_active));
+	else
+		target_inactive = std::min(CELL_SIZE,
+				target_inactive + std::max(1, num_active / num_inactive));
+	return true;
+}
+
+void adaptive_eviction_policy::add_page(thread_safe_page *pg, bool active,
+		bool reused)
+{
+	pg->set_active(active);
+	pg->set_referenced(reused);
+}
+
+thread_safe_page *adaptive_eviction_policy::evict_page(
+		page_cell<thread_safe_page> &buf)
+{
+	const int num_pages = buf.get_num_pages();
+	int num_inactive = 0;
+	for (int i = 0; i < num_pages; i++)
+		if (!buf.get_page(i)->active())
+			num_inactive++;
+	// We evict a page from the inactive list if the list is larger
+	// than its target.
+	bool evict_inactive = num_inactive > 0
+		&& num_inactive >= std::max(1, target_inactive);
+
+	thread_safe_page *ret = NULL;
+	int num_visited = 0;
+	int num_referenced = 0;
+	bool avoid_dirty = true;
+	bool any_list = false;
+	do {
+		/*
+		 * If the clock has gone through all pages and can't find one
+		 * to evict, we first allow to evict dirty pages, and then
+		 * allow to evict pages from both lists.
+		 */
+		if (num_visited >= num_pages) {
+			if (num_referenced >= num_pages)
+				return NULL;
+			if (avoid_dirty)
+				avoid_dirty = false;
+			else
+				any_list = true;
+			num_visited = 0;
+			num_referenced = 0;
+		}
+		thread_safe_page *pg = buf.get_page(clock_head % num_pages);
+		clock_head++;
+		num_visited++;
+		if (pg->get_ref()) {
+			num_referenced++;
+			continue;
+		}
+		if (!pg->initialized()) {
+			ret = pg;
+			break;
+		}
+		if (avoid_dirty && pg->is_dirty())
+			continue;
+		// A page that isn't reused is evicted right away.
+		if (!pg->active() && !pg->referenced() && pg->get_hits() == 0) {
+			ret = pg;
+			break;
+		}
+		if (!any_list && pg->active() == evict_inactive)
+			continue;
+		if (pg->get_hits() == 0) {
+			ret = pg;
+			break;
+		}
+		pg->set_hits(pg->get_hits() - 1);
+		// An inactive page accessed again is moved to the active list.
+		if (!pg->active())
+			pg->set_active(true);
+	} while (ret == NULL);
+
+	if (ret->initialized() && ret->referenced()) {
+		shadow_page shadow_pg(*ret);
+		shadow_pg.set_active(ret->active());
+		shadow.add(shadow_pg);
+	}
+	ret->set_active(false);
+	ret->set_referenced(false);
+	ret->set_data_ready(false);
+	ret->reset_hits();
+	return ret;
+}
+
+/**
+ * The pages that aren't reused are evicted first, then the pages in
+ * the inactive list and then the ones in the active list. The pages
+ * with fewer hits are evicted earlier in each list.
+ */
+int adaptive_eviction_policy::predict_evicted_pages(
+		page_cell<thread_safe_page> &buf, int num_pages, int set_flags,
+		int clear_flags, std::map<off_t, thread_safe_page *> &pages)
+{
+	page_score scores[CELL_SIZE];
+	int num_avail_pages = 0;
+	for (int i = 0; i < (int) buf.get_num_pages(); i++) {
+		thread_safe_page *pg = buf.get_page(i);
+		if (!pg->is_valid())
+			continue;
+		int score = pg->get_hits();
+		if (pg->referenced())
+			score += 0x100;
+		if (pg->active())
+			score += 0x200;
+		scores[num_avail_pages].pg = pg;
+		scores[num_avail_pages].score = score;
+		num_avail_pages++;
+	}
+	std::sort(scores, scores + num_avail_pages, flush_score_comparator);
+	for (int i = 0; i < num_avail_pages; i++)
+		scores[i].pg->set_flush_score(i);
+
+	int num_most_likely = std::min(num_avail_pages, MAX_NUM_WRITEBACK);
+	for (int i = 0; i < num_most_likely; i++) {
+		thread_safe_page *p = scores[i].pg;
+		if (p->test_flags(set_flags) && !p->test_flags(clear_flags)) {
+			pages.insert(std::pair<off_t, thread_safe_page *>(
+						p->get_offset(), p));
+			if ((int) pages.size() == num_pages)
+				break;
+		}
+	}
+	return pages.size();
+}
+
 associative_cache::~associative_cache()
 {
 	for (unsigned int i = 0; i < cells_table.size(); i++)
@@ -920,7 +1135,77 @@ next_cell:
 	return npages - pg_idx;
 }
 
-page *associative_cache::search(const page_id_t &pg_id, page_id_t &old_id) {
+long associative_cache::resize(long new_size)
+{
+	// Resizing can't run together with expanding or shrinking the table.
+	if (flags.set_flag(TABLE_EXPANDING))
+		return size();
+
+	const int ncells = get_num_cells();
+	const int BATCH_SIZE = 1024;
+	char *pages[BATCH_SIZE];
+	long npages = new_size / PAGE_SIZE - cache_npages.get();
+	// We go through the cells in rounds and move a page to or from a cell
+	// at a time, so the cells keep the similar number of pages.
+	// We stop when we can't move a page in a whole round.
+	int num_idle = 0;
+	if (npages < 0) {
+		long num_required = -npages;
+		int num_pages = 0;
+		while (num_required > 0 && num_idle < ncells) {
+			hash_cell *cell = get_cell(resize_cell_idx);
+			resize_cell_idx = (resize_cell_idx + 1) % ncells;
+			int ret = cell->release_pages(&pages[num_pages], 1,
+					CELL_MIN_NUM_PAGES);
+			if (ret == 0) {
+				num_idle++;
+				continue;
+			}
+			num_idle = 0;
+			num_pages += ret;
+			num_required -= ret;
+			cache_npages.dec(ret);
+			if (num_pages == BATCH_SIZE) {
+				manager->release_pages(num_pages, pages);
+				num_pages = 0;
+			}
+		}
+		manager->release_pages(num_pages, pages);
+	}
+	else {
+		long num_required = npages;
+		while (num_required > 0 && num_idle < ncells) {
+			int num_pages = std::min(num_required, (long) BATCH_SIZE);
+			// The memory manager allocates all pages or none of them,
+			// so we ask for fewer pages if it can't get enough.
+			while (num_pages > 0
+					&& !manager->get_free_pages(num_pages, pages, this))
+				num_pages /= 2;
+			if (num_pages == 0)
+				break;
+			int pg_idx = 0;
+			while (pg_idx < num_pages && num_idle < ncells) {
+				hash_cell *cell = get_cell(resize_cell_idx);
+				resize_cell_idx = (resize_cell_idx + 1) % ncells;
+				if (cell->get_num_pages() >= std::min(height, CELL_SIZE)) {
+					num_idle++;
+					continue;
+				}
+				num_idle = 0;
+				cell->refill_pages(&pages[pg_idx++], 1);
+			}
+			cache_npages.inc(pg_idx);
+			num_required -= pg_idx;
+			if (pg_idx < num_pages)
+				manager->release_pages(num_pages - pg_idx, &pages[pg_idx]);
+		}
+	}
+	flags.clear_flag(TABLE_EXPANDING);
+	return size();
+}
+
+page *associative_cache::search(const page_id_t &pg_id, page_id_t &old_id,
+		int hint) {
 	/*
 	 * search might change the structure of the cell,
 	 * and cause the cell table to expand.
@@ -929,7 +1214,7 @@ page *associative_cache::search(const page_id_t &pg_id, page_id_t &old_id) {
 	 * for the cell.
 	 */
 	do {
-		page *p = get_cell_offset(pg_id)->search(pg_id, old_id);
+		page *p = get_cell_offset(pg_id)->search(pg_id, old_id, hint);
 #ifdef DEBUG
 		if (p->is_old_dirty())
 			num_dirty_pages.dec(1);
@@ -987,6 +1272,7 @@ associative_cache::associative_cache(long cache_size, long max_cache_size,
 	split = 0;
 	height = params.get_SA_min_cell_size();
 	expand_cell_idx = 0;
+	resize_cell_idx = 0;
 	this->expandable = expandable;
 	this->manager = memory_manager::create(max_cache_size, node_id);
 	manager->register_cache(this);
@@ -1012,6 +1298,7 @@ associative_cache::associative_cache(long cache_size, long max_cache_size,
 				max_npages, npages);
 		throw e;
 	}
+	cache_npages.inc(init_ncells * min_cell_size);
 
 	cells_table.push_back(cells);
 
@@ -1099,6 +1386,9 @@ public:
 		this->cache = cache;
 		this->flusher = flusher;
 		pthread_key_create(&underlying_key, NULL);
+		// Writing back dirty pages shouldn't delay the reads of the
+		// application, so the writes go to the bulk class.
+		set_io_priority(IO_CLASS_BULK);
 	}
 
 	virtual int get_file_id() const {
@@ -1130,6 +1420,11 @@ class associative_flusher: public dirty_page_flusher
 
 	std::unique_ptr<flush_io> io;
 	std::unique_ptr<select_dirty_pages_policy> policy;
+	// The maximal number of pending flushes. It's adjusted with the latency
+	// of writing back dirty pages if flush_lat_target is set.
+	atomic_integer flush_limit;
+	// The maximal number of pages written back in a request.
+	int max_flush_pages;
 public:
 	thread_safe_FIFO_queue<hash_cell *> dirty_cells;
 	associative_flusher(page_cache *cache, associative_cache *local_cache,
@@ -1144,12 +1439,20 @@ public:
 
 		this->io = std::unique_ptr<flush_io>(new flush_io(io, local_cache, this));
 		policy = std::unique_ptr<select_dirty_pages_policy>(new eviction_select_dirty_pages_policy());
+		flush_limit = atomic_integer(local_cache->max_num_pending_flush);
+		max_flush_pages = std::min(io->get_block_size(), 1024);
 	}
 
 	int get_node_id() const {
 		return node_id;
 	}
 
+	int get_flush_limit() const {
+		return flush_limit.get();
+	}
+
+	void update_flush_limit(long avg_lat_us);
+
 	void run();
 	void flush_dirty_pages(thread_safe_page *pages[], int num,
 			io_interface &io);
@@ -1162,6 +1465,14 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 	hash_cell *dirty_cells[num];
 	int num_dirty_cells = 0;
 	int num_flushes = 0;
+	// We only measure the latency of writes when the flush limit
+	// is adjusted with it.
+	bool measure_lat = params.get_flush_lat_target() > 0;
+	struct timeval curr;
+	if (measure_lat)
+		gettimeofday(&curr, NULL);
+	long tot_lat = 0;
+	int num_writes = 0;
 	for (int i = 0; i < num; i++) {
 		// If the request is discarded by the I/O thread, we need to
 		// check the page set where it is located.
@@ -1179,7 +1490,7 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 
 			// Try to add more flushes only when there aren't many pending
 			// flush requests.
-			if (cache->num_pending_flush.get() < cache->max_num_pending_flush) {
+			if (cache->num_pending_flush.get() < flusher->get_flush_limit()) {
 				io_request req_array[NUM_WRITEBACK_DIRTY_PAGES];
 				int ret = flusher->flush_cell(cell, req_array,
 						NUM_WRITEBACK_DIRTY_PAGES);
@@ -1227,8 +1538,14 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 			}
 		}
 
+		if (measure_lat) {
+			tot_lat += time_diff_us(reqs[i]->get_timestamp(), curr);
+			num_writes++;
+		}
 		delete reqs[i]->get_extension();
 	}
+	if (num_writes > 0)
+		flusher->update_flush_limit(tot_lat / num_writes);
 	if (num_dirty_cells > 0)
 		flusher->dirty_cells.add(dirty_cells, num_dirty_cells);
 	if (num_flushes > 0)
@@ -1239,7 +1556,7 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 	cache->num_dirty_pages.dec(num);
 	int orig = cache->num_pending_flush.get();
 #endif
-	if (cache->num_pending_flush.get() < cache->max_num_pending_flush) {
+	if (cache->num_pending_flush.get() < flusher->get_flush_limit()) {
 		flusher->run();
 	}
 #ifdef DEBUG
@@ -1251,69 +1568,91 @@ void flush_io::notify_completion(io_request *reqs[], int num)
 #endif
 }
 
-void merge_pages2req(io_request &req, page_cache *cache);
+void merge_dirty_pages2req(io_request &req, page_cache &cache,
+		size_t block_size);
+
+int adjust_flush_limit(int limit, long avg_lat_us, long lat_target,
+		int max_limit)
+{
+	// The minimal limit can't be larger than the maximal one.
+	const int MIN_FLUSH_LIMIT = std::min(8, max_limit);
+	if (avg_lat_us > lat_target)
+		return std::max(limit - limit / 4, MIN_FLUSH_LIMIT);
+	else
+		return std::min(limit + 1, max_limit);
+}
+
+/*
+ * The flush limit is adjusted with the latency of writing back dirty pages,
+ * so that it doesn't saturate the devices and starve reads.
+ */
+void associative_flusher::update_flush_limit(long avg_lat_us)
+{
+	int target = params.get_flush_lat_target();
+	if (target <= 0)
+		return;
+
+	int limit = flush_limit.get();
+	int new_limit = adjust_flush_limit(limit, avg_lat_us, target,
+			local_cache->max_num_pending_flush);
+	// If another thread has changed the limit, we use its value.
+	if (new_limit != limit)
+		flush_limit.CAS(limit, new_limit);
+}
+
+struct page_off_less
+{
+	bool operator()(const thread_safe_page *p1,
+			const thread_safe_page *p2) const {
+		if (p1->get_file_id() != p2->get_file_id())
+			return p1->get_file_id() < p2->get_file_id();
+		return p1->get_offset() < p2->get_offset();
+	}
+};
 
 int associative_flusher::flush_cell(hash_cell *cell,
 		io_request *req_array, int req_array_size)
 {
-	std::map<off_t, thread_safe_page *> dirty_pages;
-	policy->select(cell, NUM_WRITEBACK_DIRTY_PAGES, dirty_pages);
-	int num_init_reqs = 0;
+	std::map<off_t, thread_safe_page *> selected;
+	policy->select(cell, NUM_WRITEBACK_DIRTY_PAGES, selected);
+	// We write back the dirty pages of a file in the order of their offsets,
+	// so the first page of a run of dirty pages absorbs the rest of the run.
+	std::vector<thread_safe_page *> dirty_pages;
 	for (std::map<off_t, thread_safe_page *>::const_iterator it
-			= dirty_pages.begin(); it != dirty_pages.end(); it++) {
-		thread_safe_page *p = it->second;
+			= selected.begin(); it != selected.end(); it++)
+		dirty_pages.push_back(it->second);
+	std::sort(dirty_pages.begin(), dirty_pages.end(), page_off_less());
+
+	int num_init_reqs = 0;
+	for (size_t i = 0; i < dirty_pages.size(); i++) {
+		thread_safe_page *p = dirty_pages[i];
 		p->lock();
 		assert(!p->is_old_dirty());
 		assert(p->data_ready());
 
 		assert(num_init_reqs < req_array_size);
-		// Here we flush dirty pages with normal requests.
-#if 0
-		if (!p->is_io_pending() && !p->is_prepare_writeback()
-				// The page may have been cleaned.
-				&& p->is_dirty()) {
-			// TODO global_cached_io may delete the extension.
-			// I'll fix it later.
-			if (!req_array[num_init_reqs].is_extended_req()) {
-				io_request tmp(true);
-				req_array[num_init_reqs] = tmp;
-			}
-			req_array[num_init_reqs].init(p->get_offset(), WRITE, io,
-					get_node_id(), NULL, cache, NULL);
-			req_array[num_init_reqs].add_page(p);
-			req_array[num_init_reqs].set_high_prio(true);
-			p->set_io_pending(true);
-			p->unlock();
-			merge_pages2req(req_array[num_init_reqs], cache);
-			num_init_reqs++;
-		}
-		else {
+		// The page may be written back in a request of another page
+		// or have been cleaned.
+		if (p->is_io_pending() || !p->is_dirty()) {
 			p->unlock();
 			p->dec_ref();
+			continue;
 		}
-#endif
 
-		// The code blow flush dirty pages with low-priority requests.
-		if (!p->is_io_pending() && !p->is_prepare_writeback()
-				// The page may have been cleaned.
-				&& p->is_dirty()) {
-			data_loc_t loc(p->get_file_id(), p->get_offset());
-			new (req_array + num_init_reqs) io_request(
-					new io_req_extension(), loc, WRITE, io.get(), get_node_id());
-			req_array[num_init_reqs].set_priv(cache);
-			req_array[num_init_reqs].add_page(p);
-			req_array[num_init_reqs].set_high_prio(false);
-#ifdef STATISTICS
-			req_array[num_init_reqs].set_timestamp();
-#endif
-			num_init_reqs++;
-			p->set_prepare_writeback(true);
-		}
-		// When a page is put in the queue for writing back,
-		// the queue of the IO thread doesn't own the page, which
-		// means that the page can be evicted.
+		// The request owns the reference of the page until the page
+		// is written back.
+		p->set_io_pending(true);
 		p->unlock();
-		p->dec_ref();
+		data_loc_t loc(p->get_file_id(), p->get_offset());
+		new (req_array + num_init_reqs) io_request(
+				new io_req_extension(), loc, WRITE, io.get(), get_node_id());
+		req_array[num_init_reqs].add_page(p);
+		// Write the adjacent dirty pages in the same request.
+		merge_dirty_pages2req(req_array[num_init_reqs], *cache,
+				max_flush_pages);
+		if (params.get_flush_lat_target() > 0)
+			req_array[num_init_reqs].set_timestamp();
+		num_init_reqs++;
 	}
 	return num_init_reqs;
 }
@@ -1358,8 +1697,7 @@ void associative_flusher::run()
 		tot_flushes += num_flushes;
 
 		// If we have flushed enough pages, we can stop now.
-		if (local_cache->num_pending_flush.get()
-				> local_cache->max_num_pending_flush) {
+		if (local_cache->num_pending_flush.get() > get_flush_limit()) {
 			break;
 		}
 	}
@@ -1452,12 +1790,27 @@ int hash_cell::num_pages(char set_flags, char clear_flags)
 	return num;
 }
 
+void hash_cell::get_cached_pages(std::vector<page_id_t> &pg_ids)
+{
+	_lock.lock();
+	for (unsigned int i = 0; i < buf.get_num_pages(); i++) {
+		thread_safe_page *p = buf.get_page(i);
+		if (p->data_ready())
+			pg_ids.push_back(page_id_t(p->get_file_id(), p->get_offset()));
+	}
+	_lock.unlock();
+}
+
 void hash_cell::predict_evicted_pages(int num_pages, char set_flags,
 		char clear_flags, std::map<off_t, thread_safe_page *> &pages)
 {
 	_lock.lock();
-	policy.predict_evicted_pages(buf, num_pages, set_flags,
-			clear_flags, pages);
+	if (adaptive)
+		adaptive_policy.predict_evicted_pages(buf, num_pages, set_flags,
+				clear_flags, pages);
+	else
+		policy.predict_evicted_pages(buf, num_pages, set_flags,
+				clear_flags, pages);
 	bool print = false;
 	for (std::map<off_t, thread_safe_page *>::iterator it = pages.begin();
 			it != pages.end(); it++) {
@@ -1517,8 +1870,7 @@ void associative_flusher::flush_dirty_pages(thread_safe_page *pages[],
 		 */
 		int n = cell->num_pages(dirty_flag, skip_flags);
 		if (n > DIRTY_PAGES_THRESHOLD) {
-			if (local_cache->num_pending_flush.get()
-					> local_cache->max_num_pending_flush) {
+			if (local_cache->num_pending_flush.get() > get_flush_limit()) {
 				if (!cell->set_in_queue(true))
 					cells[num_queued_cells++] = cell;
 			}
@@ -1610,6 +1962,12 @@ int associative_cache::get_num_dirty_pages() const
 	return num;
 }
 
+void associative_cache::get_cached_pages(std::vector<page_id_t> &pg_ids) const
+{
+	for (int i = 0; i < get_num_cells(); i++)
+		get_cell(i)->get_cached_pages(pg_ids);
+}
+
 int associative_cache::flush_dirty_pages(page_filter *filter, int max_num)
 {
 	if (_flusher)
@@ -219,6 +219,49 @@ public:
 	thread_safe_page *evict_page(page_cell<thread_safe_page> &buf);
 };
 
+/**
+ * This policy adapts between recency and frequency in the way of CAR
+ * (CLOCK with Adaptive Replacement). A page enters a cell in the inactive
+ * list and is moved to the active list when the clock finds it has been
+ * accessed again. The evicted pages are remembered in a shadow cell.
+ * When a remembered page is accessed again, the target size of
+ * the inactive list grows or shrinks, depending on which list the page
+ * was evicted from.
+ * A page brought in by an access that won't reuse it, such as a sequential
+ * scan, isn't remembered after eviction and is evicted before other
+ * pages, so a scan can't flush the pages that are accessed repeatedly.
+ * The two lists share the pages of a cell, and the ACTIVE bit of a page
+ * tells which list the page belongs to.
+ */
+class adaptive_eviction_policy: public eviction_policy
+{
+	unsigned int clock_head;
+	// The target number of pages in the inactive list.
+	int target_inactive;
+	LRU_shadow_cell shadow;
+public:
+	adaptive_eviction_policy() {
+		clock_head = 0;
+		target_inactive = 0;
+	}
+
+	/**
+	 * This is invoked when a page misses the cell. It adapts the target
+	 * size of the inactive list if the page was evicted recently.
+	 * It returns true if the page should be placed in the active list.
+	 */
+	bool miss_page(const page_id_t &pg_id);
+	/**
+	 * This adds a page to one of the lists after its new ID is set.
+	 * `reused' indicates whether the page is expected to be accessed again.
+	 */
+	void add_page(thread_safe_page *pg, bool active, bool reused);
+	thread_safe_page *evict_page(page_cell<thread_safe_page> &buf);
+	int predict_evicted_pages(page_cell<thread_safe_page> &buf,
+			int num_pages, int set_flags, int clear_flags,
+			std::map<off_t, thread_safe_page *> &pages);
+};
+
 class associative_cache;
 
 class hash_cell
@@ -248,6 +291,10 @@ class hash_cell
 #ifdef USE_SHADOW_PAGE
 	clock_shadow_cell shadow;
 #endif
+	// It's used instead of `policy' if the adaptive policy is chosen
+	// at runtime.
+	adaptive_eviction_policy adaptive_policy;
+	bool adaptive;
 
 	long num_accesses;
 	long num_evictions;
@@ -257,6 +304,7 @@ class hash_cell
 	void init() {
 		table = NULL;
 		hash = -1;
+		adaptive = false;
 		num_accesses = 0;
 		num_evictions = 0;
 	}
@@ -299,7 +347,18 @@ public:
 
 	void rebalance(hash_cell *cell);
 
-	page *search(const page_id_t &pg_id, page_id_t &old_id);
+	/**
+	 * Take free pages from the cell without reducing the cell to fewer
+	 * than `min_npages' pages. Only the clean pages that aren't used
+	 * can be taken. It returns the number of pages taken.
+	 */
+	int release_pages(char *pages[], int npages, int min_npages);
+	/**
+	 * Add free pages to the cell while other threads may access the cell.
+	 */
+	void refill_pages(char *pages[], int npages);
+
+	page *search(const page_id_t &pg_id, page_id_t &old_id, int hint);
 	page *search(const page_id_t &pg_id);
 
 	bool contain(thread_safe_page *pg) const {
@@ -361,6 +420,10 @@ public:
 	}
 
 	int num_pages(char set_flags, char clear_flags);
+	/**
+	 * Get the IDs of the pages with valid data in the cell.
+	 */
+	void get_cached_pages(std::vector<page_id_t> &pg_ids);
 	int get_num_pages() const {
 		return buf.get_num_pages();
 	}
@@ -402,6 +465,10 @@ class associative_cache: public page_cache
 	 * The index points to the cell that will expand next time.
 	 */
 	unsigned int expand_cell_idx;
+	/*
+	 * The index points to the cell that will be resized next time.
+	 */
+	int resize_cell_idx;
 	// The number of pages in the cache.
 	// Cells may have different numbers of pages.
 	atomic_integer cache_npages;
@@ -492,7 +559,7 @@ public:
 	 * it tries to evict a page. Therefore, it also triggers some code of
 	 * maintaining eviction policy.
 	 */
-	page *search(const page_id_t &pg_id, page_id_t &old_id);
+	page *search(const page_id_t &pg_id, page_id_t &old_id, int hint);
 	/**
 	 * This method just searches for the specified page, nothing more.
 	 * So if the request isn't issued from the workload, and we don't need
@@ -507,6 +574,12 @@ public:
 	 */
 	int expand(int npages);
 	bool shrink(int npages, char *pages[]);
+	/**
+	 * Release pages to the OS or take pages back from the memory manager.
+	 * A cell keeps at least CELL_MIN_NUM_PAGES pages and grows back to
+	 * at most the pages it had before the cache was shrunk.
+	 */
+	long resize(long new_size);
 
 	void print_cell(off_t off) {
 		get_cell(off)->print_cell();
@@ -566,6 +639,7 @@ public:
 	virtual void sanity_check() const;
 
 	int get_num_dirty_pages() const;
+	virtual void get_cached_pages(std::vector<page_id_t> &pg_ids) const;
 
 	virtual void init(std::shared_ptr<io_interface> underlying);
 
@@ -587,6 +661,15 @@ public:
 #endif
 };
 
+/*
+ * Compute the new limit of pending flushes from the average latency (us)
+ * of writing back dirty pages. The limit is increased additively when
+ * the writes meet the latency target and decreased multiplicatively when
+ * they are slower. It stays between a small minimum and max_limit.
+ */
+int adjust_flush_limit(int limit, long avg_lat_us, long lat_target,
+		int max_limit);
+
 }
 
 #endif
@@ -29,6 +29,7 @@
 
 #include <memory>
 #include <map>
+#include <vector>
 
 #include "common.h"
 #include "concurrency.h"
@@ -239,6 +240,9 @@ class thread_safe_page: public page
 
 	original_io_request *reqs;
 	int node_id;
+	// The page is being read ahead, and the read-ahead holds a reference
+	// to the page until the data is ready. It's protected by the lock.
+	bool prefetch;
 	spin_lock _lock;
 
 public:
@@ -250,6 +254,7 @@ public:
 #endif
 		reqs = NULL;
 		node_id = -1;
+		prefetch = false;
 	}
 
 	thread_safe_page(const page_id_t &pg_id, char *data,
@@ -261,6 +266,7 @@ public:
 #endif
 		reqs = NULL;
 		this->node_id = node_id;
+		prefetch = false;
 	}
 
 	~thread_safe_page() {
@@ -334,6 +340,15 @@ public:
 	bool is_io_pending() const {
 		return get_flags_bit(IO_PENDING_BIT);
 	}
+
+	bool is_prefetch() const {
+		return prefetch;
+	}
+	bool set_prefetch(bool prefetch) {
+		bool orig = this->prefetch;
+		this->prefetch = prefetch;
+		return orig;
+	}
 	bool set_io_pending(bool pending) {
 		return set_flags_bit(IO_PENDING_BIT, pending);
 	}
@@ -344,6 +359,25 @@ public:
 		return old & (0x1 << IO_PENDING_BIT);
 	}
 
+	/*
+	 * The two bits are changed while other bits may be changed by
+	 * other threads without the lock of the page set, so they have to
+	 * be changed atomically as well.
+	 */
+	bool set_referenced(bool referenced) {
+		return set_flags_bit(REFERENCED_BIT, referenced);
+	}
+	bool referenced() const {
+		return get_flags_bit(REFERENCED_BIT);
+	}
+
+	bool set_active(bool active) {
+		return set_flags_bit(ACTIVE_BIT, active);
+	}
+	bool active() const {
+		return get_flags_bit(ACTIVE_BIT);
+	}
+
 	bool is_prepare_writeback() const {
 		return get_flags_bit(PREPARE_WRITEBACK);
 	}
@@ -405,8 +439,10 @@ public:
 	 * It may evict a page if the specificed page doesn't exist.
 	 * If the returned page is evicted, its original page offset is
 	 * saved in `old_off'.
+	 * `hint' is the access hint of the I/O instance that accesses the page.
 	 */
-	virtual page *search(const page_id_t &pg_id, page_id_t &old_id) = 0;
+	virtual page *search(const page_id_t &pg_id, page_id_t &old_id,
+			int hint) = 0;
 	/**
 	 * This method searches for a page with the specified offset.
 	 * If the page doesn't exist, it returns NULL.
@@ -424,6 +460,14 @@ public:
 	virtual bool shrink(int npages, char *pages[]) {
 		return false;
 	}
+	/**
+	 * This method changes the size of the cache at runtime and returns
+	 * the new size of the cache in bytes. A cache may not reach
+	 * the requested size.
+	 */
+	virtual long resize(long new_size) {
+		return size();
+	}
 	virtual void create_flusher(std::shared_ptr<io_interface> io,
 			page_cache *global_cache) {
 	}
@@ -438,6 +482,11 @@ public:
 	virtual int get_node_id() const {
 		return -1;
 	}
+	/**
+	 * This method gets the IDs of the pages whose data is in the cache.
+	 */
+	virtual void get_cached_pages(std::vector<page_id_t> &pg_ids) const {
+	}
 
 	// For test
 	virtual void print_stat() const {
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "io_request.h"
+#include "cache_warm.h"
+
+namespace safs
+{
+
+cached_page_map merge_cached_pages(
+		std::vector<std::pair<std::string, off_t> > &pages)
+{
+	cached_page_map ret;
+	std::sort(pages.begin(), pages.end());
+	pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+	for (size_t i = 0; i < pages.size(); i++) {
+		page_range_list &ranges = ret[pages[i].first];
+		off_t off = pages[i].second;
+		if (!ranges.empty() && ranges.back().first
+				+ (off_t) ranges.back().second == off)
+			ranges.back().second += PAGE_SIZE;
+		else
+			ranges.push_back(std::pair<off_t, size_t>(off, PAGE_SIZE));
+	}
+	return ret;
+}
+
+bool save_cached_pages(const std::string &file, const cached_page_map &pages)
+{
+	// We write to a temporary file first, so a crash won't leave
+	// a partial file behind.
+	std::string tmp_file = file + ".tmp";
+	FILE *f = fopen(tmp_file.c_str(), "w");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+			% tmp_file % strerror(errno);
+		return false;
+	}
+	for (auto it = pages.begin(); it != pages.end(); it++) {
+		const page_range_list &ranges = it->second;
+		for (size_t i = 0; i < ranges.size(); i++)
+			fprintf(f, "%s %ld %ld\n", it->first.c_str(),
+					(long) ranges[i].first, (long) ranges[i].second);
+	}
+	bool ret = fflush(f) == 0;
+	fclose(f);
+	if (ret)
+		ret = rename(tmp_file.c_str(), file.c_str()) == 0;
+	if (!ret)
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't write %1%: %2%")
+			% file % strerror(errno);
+	return ret;
+}
+
+bool load_cached_pages(const std::string &file, cached_page_map &pages)
+{
+	FILE *f = fopen(file.c_str(), "r");
+	if (f == NULL)
+		return false;
+
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t len;
+	int line_no = 0;
+	bool ret = true;
+	while ((len = getline(&line, &line_size, f)) > 0) {
+		line_no++;
+		// A line without the newline is cut in the middle.
+		bool complete = line[len - 1] == '\n';
+		std::string str(line, complete ? len - 1 : len);
+		// The file name may contain spaces, so we parse the line from
+		// the end.
+		size_t size_pos = str.find_last_of(' ');
+		size_t off_pos = size_pos == std::string::npos || size_pos == 0
+			? std::string::npos : str.find_last_of(' ', size_pos - 1);
+		long off = -1, size = 0;
+		// Both numbers have to take the entire fields.
+		if (complete && off_pos != std::string::npos && off_pos > 0
+				&& size_pos > off_pos + 1 && size_pos + 1 < str.length()) {
+			char *end;
+			off = strtol(str.c_str() + off_pos + 1, &end, 10);
+			if (end != str.c_str() + size_pos)
+				off = -1;
+			size = strtol(str.c_str() + size_pos + 1, &end, 10);
+			if (end != str.c_str() + str.length())
+				size = 0;
+		}
+		// We drop the whole line if any field in it is invalid.
+		if (off < 0 || size <= 0 || off % PAGE_SIZE || size % PAGE_SIZE) {
+			BOOST_LOG_TRIVIAL(error) << boost::format(
+					"line %1% in %2% is corrupted") % line_no % file;
+			ret = false;
+			continue;
+		}
+		pages[str.substr(0, off_pos)].push_back(
+				std::pair<off_t, size_t>(off, size));
+	}
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+}
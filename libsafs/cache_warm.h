@@ -0,0 +1,59 @@
+#ifndef __SAFS_CACHE_WARM_H__
+#define __SAFS_CACHE_WARM_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace safs
+{
+
+/*
+ * The pages of a file that were in the page cache. Each range is
+ * the offset and the size in bytes. The ranges are sorted by offsets
+ * and don't overlap with each other.
+ */
+typedef std::vector<std::pair<off_t, size_t> > page_range_list;
+typedef std::map<std::string, page_range_list> cached_page_map;
+
+/*
+ * Merge the pages of each file into contiguous ranges.
+ * Each page is identified by the file name and the page offset.
+ */
+cached_page_map merge_cached_pages(
+		std::vector<std::pair<std::string, off_t> > &pages);
+
+/*
+ * The pages are stored in a text file. Each line is a range of pages:
+ * <file name> <offset> <size>
+ * A corrupted line is skipped as a whole and the loader returns false,
+ * but the ranges in the other lines are still loaded.
+ */
+bool save_cached_pages(const std::string &file, const cached_page_map &pages);
+bool load_cached_pages(const std::string &file, cached_page_map &pages);
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include <algorithm>
+
+#include "checksum.h"
+
+namespace safs
+{
+
+namespace
+{
+
+// The reversed polynomial of CRC32C.
+const uint32_t CRC32C_POLY = 0x82F63B78;
+
+struct crc32c_sw_table
+{
+	uint32_t table[256];
+
+	crc32c_sw_table() {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t crc = i;
+			for (int j = 0; j < 8; j++)
+				crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+			table[i] = crc;
+		}
+	}
+};
+
+const crc32c_sw_table sw_table;
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t crc, const char *buf, size_t size)
+{
+	uint64_t crc64 = ~crc;
+	while (size >= sizeof(uint64_t)) {
+		uint64_t v;
+		memcpy(&v, buf, sizeof(v));
+		crc64 = _mm_crc32_u64(crc64, v);
+		buf += sizeof(v);
+		size -= sizeof(v);
+	}
+	uint32_t crc32 = crc64;
+	for (; size > 0; size--, buf++)
+		crc32 = _mm_crc32_u8(crc32, *buf);
+	return ~crc32;
+}
+
+const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+#else
+const bool has_sse42 = false;
+#endif
+
+/*
+ * The layout of a checksum table file.
+ */
+struct checksum_table_header
+{
+	static const uint32_t MAGIC_NUMBER = 0x5AF5C3C2;
+
+	uint32_t magic_number;
+	uint32_t reserved;
+	uint64_t block_size;
+	uint64_t num_blocks;
+};
+
+}
+
+uint32_t crc32c_sw(uint32_t crc, const char *buf, size_t size)
+{
+	crc = ~crc;
+	const unsigned char *p = (const unsigned char *) buf;
+	for (size_t i = 0; i < size; i++)
+		crc = sw_table.table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+bool crc32c_hw_supported()
+{
+	return has_sse42;
+}
+
+uint32_t crc32c(uint32_t crc, const char *buf, size_t size)
+{
+#if defined(__x86_64__)
+	if (has_sse42)
+		return crc32c_hw(crc, buf, size);
+#endif
+	return crc32c_sw(crc, buf, size);
+}
+
+block_checksum_table::ptr block_checksum_table::load(const std::string &file)
+{
+	FILE *f = fopen(file.c_str(), "r");
+	if (f == NULL) {
+		fprintf(stderr, "fopen %s: %s\n", file.c_str(), strerror(errno));
+		return ptr();
+	}
+	checksum_table_header header;
+	if (fread(&header, sizeof(header), 1, f) != 1
+			|| header.magic_number != checksum_table_header::MAGIC_NUMBER
+			|| header.block_size == 0) {
+		fprintf(stderr, "%s isn't a checksum table\n", file.c_str());
+		fclose(f);
+		return ptr();
+	}
+	ptr table(new block_checksum_table(header.block_size));
+	table->sums.resize(header.num_blocks);
+	if (header.num_blocks > 0 && fread(table->sums.data(),
+				sizeof(table->sums[0]) * header.num_blocks, 1, f) != 1) {
+		perror("fread");
+		fclose(f);
+		return ptr();
+	}
+	fclose(f);
+	return table;
+}
+
+bool block_checksum_table::dump(const std::string &file) const
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "fopen %s: %s\n", file.c_str(), strerror(errno));
+		return false;
+	}
+	checksum_table_header header;
+	header.magic_number = checksum_table_header::MAGIC_NUMBER;
+	header.reserved = 0;
+	header.block_size = block_size;
+	header.num_blocks = sums.size();
+	if (fwrite(&header, sizeof(header), 1, f) != 1
+			|| (!sums.empty() && fwrite(sums.data(),
+					sizeof(sums[0]) * sums.size(), 1, f) != 1)) {
+		perror("fwrite");
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+	return true;
+}
+
+void block_checksum_table::append(const char *buf, size_t size)
+{
+	while (size > 0) {
+		size_t part = std::min(size, block_size - tail_size);
+		tail_crc = crc32c(tail_crc, buf, part);
+		tail_size += part;
+		buf += part;
+		size -= part;
+		if (tail_size == block_size) {
+			sums.push_back(tail_crc);
+			tail_crc = 0;
+			tail_size = 0;
+		}
+	}
+}
+
+off_t block_checksum_table::verify(off_t off, const struct iovec *vecs,
+		int num_vecs) const
+{
+	off_t pos = off;
+	// We only check the blocks whose beginning is in the buffers.
+	bool covered = pos % block_size == 0;
+	uint32_t crc = 0;
+	for (int i = 0; i < num_vecs; i++) {
+		const char *p = (const char *) vecs[i].iov_base;
+		size_t remain = vecs[i].iov_len;
+		while (remain > 0) {
+			off_t block_end = pos - pos % block_size + block_size;
+			size_t size = std::min<size_t>(remain, block_end - pos);
+			if (covered)
+				crc = crc32c(crc, p, size);
+			pos += size;
+			p += size;
+			remain -= size;
+			if (pos == block_end) {
+				size_t idx = pos / block_size - 1;
+				if (covered && idx < sums.size() && sums[idx] != crc)
+					return block_end - block_size;
+				covered = true;
+				crc = 0;
+			}
+		}
+	}
+	return -1;
+}
+
+}
@@ -0,0 +1,114 @@
+#ifndef __SAFS_CHECKSUM_H__
+#define __SAFS_CHECKSUM_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace safs
+{
+
+/*
+ * Compute CRC32C (Castagnoli) of the data. `crc' is the CRC of the data
+ * before the buffer, so a CRC can be computed over multiple buffers.
+ * The CRC of empty data is 0.
+ * It uses the SSE4.2 instruction if the CPU supports it.
+ */
+uint32_t crc32c(uint32_t crc, const char *buf, size_t size);
+/*
+ * The software implementation of CRC32C.
+ */
+uint32_t crc32c_sw(uint32_t crc, const char *buf, size_t size);
+bool crc32c_hw_supported();
+
+/*
+ * This keeps the CRC32C of each block of an SAFS file, so data read from
+ * disks can be verified. The checksums are computed on the data of
+ * the file, so they don't depend on the RAID mapping or compression.
+ * Only whole blocks have checksums; the last partial block of a file
+ * isn't checked.
+ * The checksums are only computed when data is loaded to SAFS
+ * (safs_file::load_data). Writes through io_interface don't update them,
+ * so a file with checksums can't be written, and the data of a file
+ * created and written through io_interface has no checksums at all.
+ */
+class block_checksum_table
+{
+	// In bytes.
+	size_t block_size;
+	std::vector<uint32_t> sums;
+	// The CRC and the size of the data appended to the last partial block.
+	uint32_t tail_crc;
+	size_t tail_size;
+public:
+	typedef std::shared_ptr<block_checksum_table> ptr;
+	typedef std::shared_ptr<const block_checksum_table> const_ptr;
+
+	static ptr load(const std::string &file);
+
+	block_checksum_table(size_t block_size) {
+		this->block_size = block_size;
+		tail_crc = 0;
+		tail_size = 0;
+	}
+
+	bool dump(const std::string &file) const;
+
+	size_t get_block_size() const {
+		return block_size;
+	}
+
+	size_t get_num_blocks() const {
+		return sums.size();
+	}
+
+	void set_checksum(off_t block_idx, uint32_t sum) {
+		if ((size_t) block_idx >= sums.size())
+			sums.resize(block_idx + 1);
+		sums[block_idx] = sum;
+	}
+
+	uint32_t get_checksum(off_t block_idx) const {
+		return sums[block_idx];
+	}
+
+	/*
+	 * Compute the checksums of the data appended to the end of the file.
+	 * A block may span multiple calls.
+	 */
+	void append(const char *buf, size_t size);
+
+	/*
+	 * Verify the blocks fully covered by the data in the buffers, which
+	 * starts at `off' in the file. It returns the offset of the first
+	 * corrupted block, or -1 if the data isn't corrupted.
+	 */
+	off_t verify(off_t off, const struct iovec *vecs, int num_vecs) const;
+};
+
+}
+
+#endif
@@ -18,6 +18,11 @@
  */
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+
+#include "log.h"
+#include "parameters.h"
 #include "comp_io_scheduler.h"
 
 namespace safs
@@ -129,4 +134,87 @@ void default_comp_io_scheduler::gc_computes()
 	}
 }
 
+coalesce_comp_io_scheduler::coalesce_comp_io_scheduler(int node_id,
+		size_t window_size): comp_io_scheduler(node_id),
+	window_size(window_size), fetch_buf(node_id, window_size, true),
+	curr_it(get_end())
+{
+	window_idx = 0;
+	has_completed = false;
+	// Sorting requests only helps if the page cache merges them.
+	static std::atomic<bool> warned(false);
+	if (!params.is_merge_reqs() && !warned.exchange(true))
+		BOOST_LOG_TRIVIAL(warning)
+			<< "io_coalesce_window has little effect without merge_reqs";
+}
+
+namespace
+{
+
+class req_loc_less
+{
+public:
+	bool operator()(const io_request &req1, const io_request &req2) const {
+		if (req1.get_file_id() != req2.get_file_id())
+			return req1.get_file_id() < req2.get_file_id();
+		return req1.get_offset() < req2.get_offset();
+	}
+};
+
+}
+
+void coalesce_comp_io_scheduler::fill_window()
+{
+	window.clear();
+	window_idx = 0;
+	// We continue from the user task where we stopped last time, so all
+	// user tasks get a chance to issue requests.
+	bool from_begin;
+	do {
+		compute_iterator end = this->get_end();
+		if (curr_it == end)
+			curr_it = this->get_begin();
+		from_begin = (curr_it == this->get_begin());
+		for (; curr_it != end
+				&& (size_t) fetch_buf.get_num_entries() < window_size; ++curr_it) {
+			user_compute *compute = *curr_it;
+			compute->fetch_requests(get_io(), fetch_buf,
+					window_size - fetch_buf.get_num_entries());
+			has_completed |= compute->has_completed();
+		}
+	} while (!from_begin && (size_t) fetch_buf.get_num_entries() < window_size);
+
+	window.resize(fetch_buf.get_num_entries());
+	BOOST_VERIFY(fetch_buf.fetch(window.data(), window.size())
+			== (int) window.size());
+	std::stable_sort(window.begin(), window.end(), req_loc_less());
+}
+
+size_t coalesce_comp_io_scheduler::get_requests(
+		fifo_queue<io_request> &requests, size_t max)
+{
+	if (requests.is_full() || max == 0)
+		return 0;
+
+	if (window_idx == window.size())
+		fill_window();
+	size_t num = 0;
+	while (window_idx < window.size() && num < max && !requests.is_full()) {
+		requests.push_back(window[window_idx++]);
+		num++;
+	}
+	return num;
+}
+
+void coalesce_comp_io_scheduler::gc_computes()
+{
+	if (has_completed) {
+		comp_io_scheduler::gc_computes();
+		has_completed = false;
+		// The garbage collection reorders the elements in the user compute
+		// queue. The original iterator should be reset.
+		curr_it = this->get_end();
+	}
+}
+
 }
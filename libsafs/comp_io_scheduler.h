@@ -21,6 +21,7 @@
  */
 
 #include <memory>
+#include <vector>
 
 #include "concurrency.h"
 #include "container.h"
@@ -226,6 +227,34 @@ public:
 	virtual void gc_computes();
 };
 
+/*
+ * This scheduler favors throughput. It gathers the requests of all
+ * incomplete user tasks in a window and returns them in the order of
+ * their locations in the files. Requests to adjacent or overlapping pages
+ * then reach the page cache together, so the page cache merges them into
+ * large I/O requests to disks and delivers the data of a page to all
+ * requests that access it. Without merge_reqs, the page cache doesn't
+ * merge requests, so it warns when it's created in that case.
+ */
+class coalesce_comp_io_scheduler: public comp_io_scheduler
+{
+	// The maximal number of requests gathered in a window.
+	const size_t window_size;
+	// The requests in the current window, sorted by their locations.
+	std::vector<io_request> window;
+	size_t window_idx;
+	fifo_queue<io_request> fetch_buf;
+	bool has_completed;
+	compute_iterator curr_it;
+
+	void fill_window();
+public:
+	coalesce_comp_io_scheduler(int node_id, size_t window_size);
+
+	virtual size_t get_requests(fifo_queue<io_request> &reqs, size_t max);
+	virtual void gc_computes();
+};
+
 }
 
 #endif
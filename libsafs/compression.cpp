@@ -0,0 +1,425 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+
+#include "compression.h"
+
+namespace safs
+{
+
+namespace
+{
+
+/*
+ * The compressed data is a sequence of (literals, match) pairs, and each of
+ * them starts with a token: the upper 4 bits are the number of literals and
+ * the lower 4 bits are the match length minus MIN_MATCH. A value of 15 means
+ * more bytes follow to encode the length. The literals are followed by
+ * the 2-byte offset of the match. The last sequence only has literals.
+ */
+const int HASH_LOG = 12;
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+
+inline uint32_t read32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint32_t hash32(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+unsigned char *write_len(unsigned char *op, const unsigned char *oend,
+		size_t len)
+{
+	while (len >= 255) {
+		if (op >= oend)
+			return NULL;
+		*op++ = 255;
+		len -= 255;
+	}
+	if (op >= oend)
+		return NULL;
+	*op++ = (unsigned char) len;
+	return op;
+}
+
+bool read_len(const unsigned char *&ip, const unsigned char *iend,
+		size_t &len)
+{
+	unsigned char b;
+	do {
+		if (ip >= iend)
+			return false;
+		b = *ip++;
+		len += b;
+	} while (b == 255);
+	return true;
+}
+
+/*
+ * Write a sequence. `match_len' is 0 for the last sequence.
+ */
+unsigned char *write_seq(unsigned char *op, const unsigned char *oend,
+		const unsigned char *lits, size_t num_lits, size_t offset,
+		size_t match_len)
+{
+	size_t ml = match_len > 0 ? match_len - MIN_MATCH : 0;
+	if (op >= oend)
+		return NULL;
+	unsigned char *token = op++;
+	*token = (std::min<size_t>(num_lits, 15) << 4) | std::min<size_t>(ml, 15);
+	if (num_lits >= 15 && (op = write_len(op, oend, num_lits - 15)) == NULL)
+		return NULL;
+	if ((size_t) (oend - op) < num_lits)
+		return NULL;
+	memcpy(op, lits, num_lits);
+	op += num_lits;
+	if (match_len == 0)
+		return op;
+
+	if (oend - op < 2)
+		return NULL;
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+	if (ml >= 15 && (op = write_len(op, oend, ml - 15)) == NULL)
+		return NULL;
+	return op;
+}
+
+size_t lz_compress(const char *src, size_t size, char *dst, size_t capacity)
+{
+	const unsigned char *base = (const unsigned char *) src;
+	const unsigned char *ip = base;
+	const unsigned char *anchor = base;
+	const unsigned char *iend = base + size;
+	unsigned char *op = (unsigned char *) dst;
+	const unsigned char *oend = op + capacity;
+	// The table stores the last location of a 4-byte sequence.
+	uint32_t table[1 << HASH_LOG];
+	memset(table, 0, sizeof(table));
+
+	while (size > MIN_MATCH && ip < iend - MIN_MATCH) {
+		uint32_t h = hash32(read32(ip));
+		const unsigned char *ref = base + table[h];
+		table[h] = ip - base;
+		if (ref >= ip || (size_t) (ip - ref) > MAX_OFFSET
+				|| read32(ref) != read32(ip)) {
+			ip++;
+			continue;
+		}
+
+		const unsigned char *mp = ip + MIN_MATCH;
+		const unsigned char *rp = ref + MIN_MATCH;
+		while (mp < iend && *mp == *rp) {
+			mp++;
+			rp++;
+		}
+		op = write_seq(op, oend, anchor, ip - anchor, ip - ref, mp - ip);
+		if (op == NULL)
+			return 0;
+		ip = anchor = mp;
+	}
+	op = write_seq(op, oend, anchor, iend - anchor, 0, 0);
+	if (op == NULL)
+		return 0;
+	return op - (unsigned char *) dst;
+}
+
+ssize_t lz_decompress(const char *src, size_t size, char *dst,
+		size_t capacity)
+{
+	const unsigned char *ip = (const unsigned char *) src;
+	const unsigned char *iend = ip + size;
+	unsigned char *ostart = (unsigned char *) dst;
+	unsigned char *op = ostart;
+	const unsigned char *oend = op + capacity;
+	while (ip < iend) {
+		unsigned token = *ip++;
+		size_t num_lits = token >> 4;
+		if (num_lits == 15 && !read_len(ip, iend, num_lits))
+			return -1;
+		if ((size_t) (iend - ip) < num_lits || (size_t) (oend - op) < num_lits)
+			return -1;
+		memcpy(op, ip, num_lits);
+		op += num_lits;
+		ip += num_lits;
+		// The last sequence doesn't have a match.
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		size_t match_len = token & 15;
+		if (match_len == 15 && !read_len(ip, iend, match_len))
+			return -1;
+		match_len += MIN_MATCH;
+		if (offset == 0 || offset > (size_t) (op - ostart)
+				|| (size_t) (oend - op) < match_len)
+			return -1;
+		const unsigned char *mp = op - offset;
+		// A match may overlap with the data it generates.
+		if (offset >= match_len) {
+			memcpy(op, mp, match_len);
+			op += match_len;
+		}
+		else {
+			for (size_t i = 0; i < match_len; i++)
+				*op++ = *mp++;
+		}
+	}
+	return op - ostart;
+}
+
+/*
+ * The compressed data starts with a byte that stores the number of trailing
+ * bytes that don't form a whole word. It's followed by the varints of
+ * the words and the trailing bytes are stored at the end uncompressed.
+ */
+const size_t MAX_VARINT_SIZE = 10;
+
+inline uint64_t zigzag_encode(uint64_t delta)
+{
+	return (delta << 1) ^ (uint64_t) (((int64_t) delta) >> 63);
+}
+
+inline uint64_t zigzag_decode(uint64_t v)
+{
+	return (v >> 1) ^ (~(v & 1) + 1);
+}
+
+size_t delta_compress(const char *src, size_t size, char *dst,
+		size_t capacity)
+{
+	size_t num_words = size / sizeof(uint64_t);
+	size_t num_tail = size % sizeof(uint64_t);
+	unsigned char *op = (unsigned char *) dst;
+	const unsigned char *oend = op + capacity;
+	if (op >= oend)
+		return 0;
+	*op++ = num_tail;
+	uint64_t prev = 0;
+	for (size_t i = 0; i < num_words; i++) {
+		uint64_t word;
+		memcpy(&word, src + i * sizeof(word), sizeof(word));
+		uint64_t v = zigzag_encode(word - prev);
+		prev = word;
+		// Check the space only when we are close to the end of the buffer.
+		if ((size_t) (oend - op) < MAX_VARINT_SIZE) {
+			size_t len = 1;
+			for (uint64_t tmp = v >> 7; tmp > 0; tmp >>= 7)
+				len++;
+			if ((size_t) (oend - op) < len)
+				return 0;
+		}
+		while (v >= 0x80) {
+			*op++ = (v & 0x7f) | 0x80;
+			v >>= 7;
+		}
+		*op++ = v;
+	}
+	if ((size_t) (oend - op) < num_tail)
+		return 0;
+	memcpy(op, src + num_words * sizeof(uint64_t), num_tail);
+	op += num_tail;
+	return op - (unsigned char *) dst;
+}
+
+ssize_t delta_decompress(const char *src, size_t size, char *dst,
+		size_t capacity)
+{
+	const unsigned char *ip = (const unsigned char *) src;
+	if (size == 0 || *ip >= sizeof(uint64_t) || *ip > size - 1)
+		return -1;
+	size_t num_tail = *ip++;
+	const unsigned char *iend = (const unsigned char *) src + size - num_tail;
+	char *op = dst;
+	const char *oend = dst + capacity;
+	uint64_t prev = 0;
+	while (ip < iend) {
+		uint64_t v = 0;
+		int shift = 0;
+		unsigned char b;
+		do {
+			if (ip >= iend || shift >= 64)
+				return -1;
+			b = *ip++;
+			v |= ((uint64_t) (b & 0x7f)) << shift;
+			shift += 7;
+		} while (b & 0x80);
+		if ((size_t) (oend - op) < sizeof(prev))
+			return -1;
+		prev += zigzag_decode(v);
+		memcpy(op, &prev, sizeof(prev));
+		op += sizeof(prev);
+	}
+	if ((size_t) (oend - op) < num_tail)
+		return -1;
+	memcpy(op, iend, num_tail);
+	op += num_tail;
+	return op - dst;
+}
+
+/*
+ * The layout of a compression table file.
+ */
+struct compress_table_header
+{
+	static const uint32_t MAGIC_NUMBER = 0x5AF5C0DE;
+
+	uint32_t magic_number;
+	uint32_t codec;
+	uint32_t block_size;
+	uint32_t reserved;
+	uint64_t num_blocks;
+};
+
+}
+
+size_t compress_block(int codec, const char *src, size_t size, char *dst,
+		size_t capacity)
+{
+	switch (codec) {
+		case COMPRESS_LZ:
+			return lz_compress(src, size, dst, capacity);
+		case COMPRESS_DELTA_VARINT:
+			return delta_compress(src, size, dst, capacity);
+		default:
+			fprintf(stderr, "unknown compression codec %d\n", codec);
+			return 0;
+	}
+}
+
+ssize_t decompress_block(int codec, const char *src, size_t size, char *dst,
+		size_t capacity)
+{
+	switch (codec) {
+		case COMPRESS_LZ:
+			return lz_decompress(src, size, dst, capacity);
+		case COMPRESS_DELTA_VARINT:
+			return delta_decompress(src, size, dst, capacity);
+		default:
+			fprintf(stderr, "unknown compression codec %d\n", codec);
+			return -1;
+	}
+}
+
+int get_compress_unit(int codec, int block_size)
+{
+	switch (codec) {
+		case COMPRESS_DELTA_VARINT:
+			return 1;
+		default:
+			// The unit has to divide the RAID block.
+			for (int unit = std::min(block_size, MAX_LZ_UNIT); unit > 1; unit--)
+				if (block_size % unit == 0)
+					return unit;
+			return 1;
+	}
+}
+
+int get_codec(const std::string &name)
+{
+	if (name == "lz")
+		return COMPRESS_LZ;
+	else if (name == "delta")
+		return COMPRESS_DELTA_VARINT;
+	else
+		return -1;
+}
+
+block_compress_table::ptr block_compress_table::load(const std::string &file)
+{
+	FILE *f = fopen(file.c_str(), "r");
+	if (f == NULL) {
+		fprintf(stderr, "fopen %s: %s\n", file.c_str(), strerror(errno));
+		return ptr();
+	}
+	compress_table_header header;
+	if (fread(&header, sizeof(header), 1, f) != 1
+			|| header.magic_number != compress_table_header::MAGIC_NUMBER) {
+		fprintf(stderr, "%s isn't a compression table\n", file.c_str());
+		fclose(f);
+		return ptr();
+	}
+	ptr table(new block_compress_table(header.codec, header.block_size));
+	table->sizes.resize(header.num_blocks);
+	if (header.num_blocks > 0 && fread(table->sizes.data(),
+				sizeof(table->sizes[0]) * header.num_blocks, 1, f) != 1) {
+		perror("fread");
+		fclose(f);
+		return ptr();
+	}
+	fclose(f);
+	return table;
+}
+
+bool block_compress_table::dump(const std::string &file) const
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "fopen %s: %s\n", file.c_str(), strerror(errno));
+		return false;
+	}
+	compress_table_header header;
+	header.magic_number = compress_table_header::MAGIC_NUMBER;
+	header.codec = codec;
+	header.block_size = block_size;
+	header.reserved = 0;
+	header.num_blocks = sizes.size();
+	if (fwrite(&header, sizeof(header), 1, f) != 1
+			|| (!sizes.empty() && fwrite(sizes.data(),
+					sizeof(sizes[0]) * sizes.size(), 1, f) != 1)) {
+		perror("fwrite");
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+	return true;
+}
+
+size_t block_compress_table::get_num_compressed_blocks() const
+{
+	size_t num = 0;
+	for (size_t i = 0; i < sizes.size(); i++)
+		if (sizes[i] > 0)
+			num++;
+	return num;
+}
+
+size_t block_compress_table::get_tot_compressed_bytes() const
+{
+	size_t tot = 0;
+	for (size_t i = 0; i < sizes.size(); i++)
+		tot += sizes[i];
+	return tot;
+}
+
+}
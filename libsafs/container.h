@@ -28,6 +28,7 @@
 #include <limits.h>
 
 #include <string>
+#include <atomic>
 #include <boost/assert.hpp>
 
 #include "common.h"
@@ -387,6 +388,97 @@ public:
 	}
 };
 
+/*
+ * This is a lock-free FIFO queue with a single producer and a single
+ * consumer. Only one thread can add entries and only one thread can fetch
+ * entries. The producer only updates `end' and the consumer only updates
+ * `start', and they are in different cache lines, so the two threads don't
+ * bounce cache lines unless they need to see each other's progress.
+ * The queue has a fixed capacity of 2^n.
+ */
+template<class T>
+class spsc_queue
+{
+	static const int PAD_SIZE = 128;
+
+	T *buf;
+	long size_mask;
+	char pad0[PAD_SIZE];
+	// Owned by the consumer.
+	std::atomic<long> start;
+	// The consumer's copy of `end'.
+	long cached_end;
+	char pad1[PAD_SIZE];
+	// Owned by the producer.
+	std::atomic<long> end;
+	// The producer's copy of `start'.
+	long cached_start;
+	char pad2[PAD_SIZE];
+
+	long loc_in_queue(long idx) const {
+		return idx & size_mask;
+	}
+public:
+	spsc_queue(int size) {
+		int log_size = (int) ceil(log2(size));
+		size = 1 << log_size;
+		size_mask = size - 1;
+		buf = new T[size];
+		start = 0;
+		end = 0;
+		cached_start = 0;
+		cached_end = 0;
+	}
+
+	~spsc_queue() {
+		delete [] buf;
+	}
+
+	int get_size() const {
+		return size_mask + 1;
+	}
+
+	/*
+	 * This is only invoked by the producer.
+	 */
+	int add(T *entries, int num) {
+		long curr_end = end.load(std::memory_order_relaxed);
+		if (curr_end + num - cached_start > get_size())
+			cached_start = start.load(std::memory_order_acquire);
+		int num_adds = min(num, get_size() - (int) (curr_end - cached_start));
+		for (int i = 0; i < num_adds; i++)
+			buf[loc_in_queue(curr_end + i)] = entries[i];
+		end.store(curr_end + num_adds, std::memory_order_release);
+		return num_adds;
+	}
+
+	/*
+	 * This is only invoked by the consumer.
+	 */
+	int fetch(T *entries, int num) {
+		long curr_start = start.load(std::memory_order_relaxed);
+		if (curr_start + num > cached_end)
+			cached_end = end.load(std::memory_order_acquire);
+		int num_fetches = min(num, (int) (cached_end - curr_start));
+		for (int i = 0; i < num_fetches; i++)
+			entries[i] = buf[loc_in_queue(curr_start + i)];
+		start.store(curr_start + num_fetches, std::memory_order_release);
+		return num_fetches;
+	}
+
+	/*
+	 * Both threads can invoke this, but the result may be out of date.
+	 */
+	int get_num_entries() const {
+		return (int) (end.load(std::memory_order_acquire)
+				- start.load(std::memory_order_acquire));
+	}
+
+	bool is_empty() const {
+		return get_num_entries() == 0;
+	}
+};
+
 /*
  * This FIFO queue can block the thread if
  * a thread wants to add more entries when the queue is full;
@@ -169,11 +169,29 @@ class orig_comp_request
 	off_t off;
 	size_t size;
 	user_compute *compute;
+	// The user data of a request with buffers.
+	void *user_data;
 public:
-	orig_comp_request(off_t off, size_t size, user_compute *compute) {
+	orig_comp_request() {
+		this->off = 0;
+		this->size = 0;
+		this->compute = NULL;
+		this->user_data = NULL;
+	}
+
+	void init(off_t off, size_t size, user_compute *compute) {
 		this->off = off;
 		this->size = size;
 		this->compute = compute;
+		this->user_data = NULL;
+	}
+
+	void set_user_data(void *user_data) {
+		this->user_data = user_data;
+	}
+
+	void *get_user_data() const {
+		return user_data;
 	}
 
 	off_t get_offset() const {
@@ -219,6 +237,10 @@ direct_comp_io::direct_comp_io(std::shared_ptr<remote_io> io): io_interface(
 	num_req_bytes = 0;
 	arr_alloc = std::unique_ptr<direct_byte_array_allocator>(
 			new direct_byte_array_allocator(io->get_thread()));
+	orig_allocator = std::unique_ptr<req_obj_allocator<orig_comp_request> >(
+			new req_obj_allocator<orig_comp_request>(
+				std::string("orig_comp_req_allocator-") + itoa(get_node_id()),
+				get_node_id(), true));
 }
 
 direct_comp_io::~direct_comp_io()
@@ -229,18 +251,37 @@ direct_comp_io::~direct_comp_io()
 void direct_comp_io::complete_req(const io_request &req)
 {
 	num_completed_areqs++;
-	// When an I/O request is complete, we need to invoke the user task.
 	orig_comp_request *orig = (orig_comp_request *) req.get_user_data();
 	assert(orig);
+	// A request with buffers is returned to the user as it was issued.
+	if (orig->get_compute() == NULL) {
+		io_request user_req = req;
+		user_req.set_user_data(orig->get_user_data());
+		user_req.set_io(this);
+		orig_allocator->free(orig);
+		if (cb) {
+			io_request *reqp = &user_req;
+			cb->invoke(&reqp, 1);
+		}
+		return;
+	}
+
+	// When an I/O request is complete, we need to invoke the user task.
 	assert(orig->get_offset() + orig->get_size()
 			<= req.get_offset() + req.get_size());
 	// We pass the ownership of the memory buffer to the byte array.
 	// The byte array will free the buffer once it's done.
 	direct_byte_array arr(orig->get_offset(), orig->get_size(), req.get_buf(),
 			*arr_alloc);
-	orig->get_compute()->run(arr);
+	// The user task can't run on the data of a failed request.
+	if (req.is_failed())
+		orig->get_compute()->fail(request_range(data_loc_t(req.get_file_id(),
+						orig->get_offset()), orig->get_size(),
+					req.get_access_method(), orig->get_compute()));
+	else
+		orig->get_compute()->run(arr);
 	comp_sched->post_comp_process(orig->get_compute());
-	delete orig;
+	orig_allocator->free(orig);
 
 	alloc_mem_size -= req.get_size();
 }
@@ -250,6 +291,12 @@ int direct_comp_io::get_file_id() const
 	return underlying->get_file_id();
 }
 
+void direct_comp_io::set_io_priority(int io_class, int weight)
+{
+	io_interface::set_io_priority(io_class, weight);
+	underlying->set_io_priority(io_class, weight);
+}
+
 void direct_comp_io::cleanup()
 {
 	// wait4complete may generate more requests because of user compute
@@ -259,7 +306,7 @@ void direct_comp_io::cleanup()
 	underlying->cleanup();
 }
 
-static void conv_comp_to_basic(io_request &req)
+void direct_comp_io::conv_comp_to_basic(io_request &req)
 {
 	// The data requested by the user compute may not be aligned to
 	// BLOCK_SIZE, we need to align the offset and size.
@@ -270,44 +317,76 @@ static void conv_comp_to_basic(io_request &req)
 	char *buf = NULL;
 	int ret = posix_memalign((void **) &buf, MIN_BLOCK_SIZE, req_size);
 	assert(ret == 0);
-	orig_comp_request *orig = new orig_comp_request(req.get_offset(),
-			req.get_size(), req.get_compute());
+	orig_comp_request *orig = orig_allocator->alloc_obj();
+	orig->init(req.get_offset(), req.get_size(), req.get_compute());
 	data_loc_t loc(req.get_file_id(), align_off);
 	req = io_request(buf, loc, req_size, req.get_access_method(),
 			req.get_io(), req.get_node_id());
 	req.set_user_data(orig);
 }
 
+/*
+ * A request with buffers is issued to the underlying I/O as it is, and
+ * the underlying I/O notifies us in this thread when it completes.
+ * Its user data is kept in an orig_comp_request without a user compute,
+ * so we can tell it from the requests of user computes.
+ */
+void direct_comp_io::conv_buf_req(io_request &req)
+{
+	num_req_bytes += req.get_size();
+	num_disk_bytes += req.get_size();
+	orig_comp_request *orig = orig_allocator->alloc_obj();
+	orig->init(req.get_offset(), req.get_size(), NULL);
+	orig->set_user_data(req.get_user_data());
+	req.set_user_data(orig);
+	req.set_io(underlying.get());
+	req.set_node_id(this->get_node_id());
+}
+
 void direct_comp_io::access(io_request *requests, int num, io_status *status)
 {
 	num_issued_areqs += num;
-	int i;
-	for (i = 0; i < num; i++) {
+	int num_issues = 0;
+	for (int i = 0; i < num; i++) {
+		// The data of a request with buffers is read to the buffers
+		// directly. If the request has multiple buffers, the underlying I/O
+		// issues scatter-gather reads, so the data doesn't need to be copied
+		// from an I/O buffer.
+		if (requests[i].get_req_type() != io_request::USER_COMPUTE) {
+			conv_buf_req(requests[i]);
+			requests[num_issues++] = requests[i];
+			continue;
+		}
+
 		assert(requests[i].get_user_data() == NULL);
-		// It has to be a user-compute request, and we need to convert it into
+		// It's a user-compute request, and we need to convert it into
 		// a basic I/O request.
-		assert(requests[i].get_req_type() == io_request::USER_COMPUTE);
 		user_compute *compute = requests[i].get_compute();
 		compute->inc_ref();
 
-		if (alloc_mem_size <= MAX_PEND_COMP_SIZE) {
-			// We count the number of bytes accessed by I/O requests.
-			num_req_bytes = requests[i].get_size();
-			// This convert the original request to the request that accesses
-			// the aligned area on the disks.
-			conv_comp_to_basic(requests[i]);
-			num_disk_bytes = requests[i].get_size();
-			alloc_mem_size += requests[i].get_size();
-		}
-		else
+		// If there are too many pending requests, we need to buffer
+		// the rest of requests, so they are still issued in order.
+		if (alloc_mem_size > MAX_PEND_COMP_SIZE) {
+			for (int j = i + 1; j < num; j++)
+				if (requests[j].get_req_type() == io_request::USER_COMPUTE)
+					requests[j].get_compute()->inc_ref();
+			req_buf.add(&requests[i], num - i);
 			break;
+		}
+		// We count the number of bytes accessed by I/O requests.
+		num_req_bytes = requests[i].get_size();
+		// This convert the original request to the request that accesses
+		// the aligned area on the disks.
+		conv_comp_to_basic(requests[i]);
+		num_disk_bytes = requests[i].get_size();
+		alloc_mem_size += requests[i].get_size();
+		requests[num_issues++] = requests[i];
 	}
-	// If there are requests that didn't get converted (because there are
-	// too many pending requests), we need to buffer the rest of requests.
-	if (i < num)
-		req_buf.add(&requests[i], num - i);
 	// We issue the requests that have been converted to the underlying I/O.
-	underlying->access(requests, i, status);
+	underlying->access(requests, num_issues, NULL);
+	if (status)
+		for (int i = 0; i < num; i++)
+			status[i] = IO_PENDING;
 }
 
 void direct_comp_io::process_buf_reqs()
@@ -317,16 +396,21 @@ void direct_comp_io::process_buf_reqs()
 	int num_reqs = 0;
 	while (!req_buf.is_empty() && alloc_mem_size <= MAX_PEND_COMP_SIZE) {
 		io_request req = req_buf.pop_front();
-		assert(req.get_user_data() == NULL);
-		assert(req.get_req_type() == io_request::USER_COMPUTE);
-
-		conv_comp_to_basic(req);
-		alloc_mem_size += req.get_size();
-		// The IO instance in the request gets notified from the I/O thread
-		// when the IO request is completed. direct_comp_io gets notification
-		// from remote_io, so we should set io in the request to
-		// the underlying IO instance.
-		req.set_io(underlying.get());
+
+		// A request with buffers was buffered behind a user-compute request.
+		// It doesn't need memory from us.
+		if (req.get_req_type() != io_request::USER_COMPUTE)
+			conv_buf_req(req);
+		else {
+			assert(req.get_user_data() == NULL);
+			conv_comp_to_basic(req);
+			alloc_mem_size += req.get_size();
+			// The IO instance in the request gets notified from the I/O
+			// thread when the IO request is completed. direct_comp_io gets
+			// notification from remote_io, so we should set io in
+			// the request to the underlying IO instance.
+			req.set_io(underlying.get());
+		}
 		local_buf[num_reqs++] = req;
 
 		if (num_reqs == BUF_SIZE) {
@@ -370,6 +454,16 @@ int direct_comp_io::wait4complete(int num_to_complete)
 	return num_completed_areqs - prev_completed_areqs;
 }
 
+size_t direct_comp_io::get_num_req_allocs() const
+{
+	return orig_allocator->get_num_allocs() + underlying->get_num_req_allocs();
+}
+
+size_t direct_comp_io::get_num_req_chunks() const
+{
+	return orig_allocator->get_num_chunks() + underlying->get_num_req_chunks();
+}
+
 int direct_comp_io::num_pending_ios() const
 {
 	assert(num_issued_areqs >= num_completed_areqs);
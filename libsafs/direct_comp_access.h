@@ -23,6 +23,7 @@
 #include "container.h"
 
 #include "io_interface.h"
+#include "req_allocator.h"
 
 namespace safs
 {
@@ -30,10 +31,18 @@ namespace safs
 class remote_io;
 class comp_io_scheduler;
 class direct_byte_array_allocator;
+class orig_comp_request;
 
 /**
  * This class supports asynchronous user-task I/O requests.
  * Unlike global_cached_io, it doesn't support page cache.
+ *
+ * It also accepts requests with buffers, which read data to the buffers
+ * directly. A request with an extension can have a list of buffers,
+ * and the data is scattered to the buffers, so it can be read to its final
+ * layout in memory. The buffers and their sizes have to be aligned to
+ * the minimal block size. The callback of the I/O instance is invoked
+ * when these requests complete.
  */
 class direct_comp_io: public io_interface
 {
@@ -48,8 +57,13 @@ class direct_comp_io: public io_interface
 	fifo_queue<io_request> req_buf;
 	std::shared_ptr<remote_io> underlying;
 	std::shared_ptr<comp_io_scheduler> comp_sched;
+	// It's invoked when the requests with buffers complete.
+	callback::ptr cb;
 	std::unique_ptr<direct_byte_array_allocator> arr_alloc;
+	std::unique_ptr<req_obj_allocator<orig_comp_request> > orig_allocator;
 
+	void conv_comp_to_basic(io_request &req);
+	void conv_buf_req(io_request &req);
 	void process_buf_reqs();
 	void process_incomplete_computes();
 public:
@@ -64,10 +78,24 @@ public:
 
 	virtual int get_file_id() const;
 	virtual void cleanup();
+	virtual void set_io_priority(int io_class, int weight);
 	virtual bool support_aio() {
 		return true;
 	}
 
+	virtual bool set_callback(callback::ptr cb) {
+		this->cb = cb;
+		return true;
+	}
+
+	virtual bool have_callback() const {
+		return cb != NULL;
+	}
+
+	virtual callback &get_callback() {
+		return *cb;
+	}
+
 	virtual void access(io_request *requests, int num,
 			io_status *status = NULL);
 	virtual void flush_requests();
@@ -89,6 +117,9 @@ public:
 	size_t get_num_completed_reqs() {
 		return num_completed_areqs;
 	}
+
+	size_t get_num_req_allocs() const;
+	size_t get_num_req_chunks() const;
 };
 
 }
@@ -17,6 +17,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include "disk_read_thread.h"
 #include "parameters.h"
 #include "aio_private.h"
@@ -27,6 +29,7 @@ namespace safs
 
 const int AIO_HIGH_PRIO_SLOTS = 7;
 const int NUM_DIRTY_PAGES_TO_FETCH = 16 * 18;
+const int RING_FETCH_SIZE = 32;
 
 /*
  * This is run inside the I/O thread, so it's OK to access its data structure.
@@ -46,6 +49,44 @@ void disk_io_thread::open_comm::run()
 	set_status(ret);
 }
 
+void disk_io_thread::acquire_ring_comm::run()
+{
+	auto it = t.rings.find(app);
+	if (it == t.rings.end()) {
+		req_ring ring;
+		// The ring is allocated in the I/O thread, so its memory is on
+		// the NUMA node of the I/O thread.
+		ring.q = new spsc_queue<io_request>(IO_RING_SIZE);
+		ring.ref = 1;
+		t.rings.insert(std::pair<thread *, req_ring>(app, ring));
+		t.ring_vec.push_back(ring.q);
+		*ret = ring.q;
+	}
+	else {
+		it->second.ref++;
+		*ret = it->second.q;
+	}
+}
+
+void disk_io_thread::release_ring_comm::run()
+{
+	auto it = t.rings.find(app);
+	assert(it != t.rings.end());
+	it->second.ref--;
+	if (it->second.ref > 0)
+		return;
+
+	spsc_queue<io_request> *q = it->second.q;
+	// Move the requests still in the ring to the local buffer.
+	io_request reqs[RING_FETCH_SIZE];
+	int num;
+	while ((num = q->fetch(reqs, RING_FETCH_SIZE)) > 0)
+		t.orphan_reqs.insert(t.orphan_reqs.end(), reqs, reqs + num);
+	t.ring_vec.erase(std::find(t.ring_vec.begin(), t.ring_vec.end(), q));
+	t.rings.erase(it);
+	delete q;
+}
+
 // The partition contains a file mapper but the file mapper doesn't point
 // to a file in the SAFS filesystem.
 disk_io_thread::disk_io_thread(const logical_file_partition &_partition, int cpu_id,
@@ -57,7 +98,8 @@ disk_io_thread::disk_io_thread(const logical_file_partition &_partition, int cpu
 		low_prio_queue(node_id, std::string("io-queue-low_prio-")
 				+ itoa(node_id), IO_QUEUE_SIZE, INT_MAX, false),
 		comm_queue(std::string("comm-queue") + itoa(node_id), node_id, 1,
-				INT_MAX), partition(_partition)
+				INT_MAX), partition(_partition),
+		sched(params.get_io_class_deadlines())
 {
 	// Find out the disks that this I/O thread is responsible for.
 	int num_disks = partition.get_num_files();
@@ -96,7 +138,8 @@ disk_io_thread::disk_io_thread(const logical_file_partition &_partition,
 		low_prio_queue(node_id, std::string("io-queue-low_prio-")
 				+ itoa(node_id), IO_QUEUE_SIZE, INT_MAX, false),
 		comm_queue(std::string("comm-queue") + itoa(node_id), node_id, 1,
-				INT_MAX), partition(_partition)
+				INT_MAX), partition(_partition),
+		sched(params.get_io_class_deadlines())
 {
 	// Find out the disks that this I/O thread is responsible for.
 	int num_disks = partition.get_num_files();
@@ -281,16 +324,8 @@ size_t disk_io_thread::get_all_reqs(msg_queue<io_request> &queue,
 			int num_reqs = msg_buffer[i].get_num_objs();
 			local_reqs.resize(num_reqs);
 			msg_buffer[i].get_next_objs(local_reqs.data(), num_reqs);
-			for (int j = 0; j < num_reqs; j++) {
-				if (local_reqs[j].get_access_method() == READ) {
-					num_reads++;
-					num_read_bytes += local_reqs[j].get_size();
-				}
-				else {
-					num_writes++;
-					num_write_bytes += local_reqs[j].get_size();
-				}
-			}
+			for (int j = 0; j < num_reqs; j++)
+				count_req(local_reqs[j]);
 			msg_buffer[i].clear();
 			reqs.insert(reqs.end(), local_reqs.begin(), local_reqs.end());
 			tot_num_reqs += local_reqs.size();
@@ -299,6 +334,62 @@ size_t disk_io_thread::get_all_reqs(msg_queue<io_request> &queue,
 	return tot_num_reqs;
 }
 
+size_t disk_io_thread::get_ring_reqs(std::vector<io_request> &reqs)
+{
+	size_t tot_num_reqs = orphan_reqs.size();
+	for (size_t i = 0; i < orphan_reqs.size(); i++)
+		count_req(orphan_reqs[i]);
+	reqs.insert(reqs.end(), orphan_reqs.begin(), orphan_reqs.end());
+	orphan_reqs.clear();
+
+	for (size_t i = 0; i < ring_vec.size(); i++) {
+		if (ring_vec[i]->is_empty())
+			continue;
+
+		io_request local_reqs[RING_FETCH_SIZE];
+		int num;
+		// An application thread can't keep the I/O thread here forever
+		// because a ring has a limited size.
+		while ((num = ring_vec[i]->fetch(local_reqs, RING_FETCH_SIZE)) > 0) {
+			for (int j = 0; j < num; j++)
+				count_req(local_reqs[j]);
+			reqs.insert(reqs.end(), local_reqs, local_reqs + num);
+			tot_num_reqs += num;
+			if (num < RING_FETCH_SIZE)
+				break;
+		}
+	}
+	return tot_num_reqs;
+}
+
+void disk_io_thread::issue_reqs(std::vector<io_request> &reqs)
+{
+	// The slots reserved for the interactive class. There must be slots
+	// left for the other classes.
+	size_t num_reserved = std::min(AIO_HIGH_PRIO_SLOTS,
+			aio->get_max_num_pending_ios() / 2);
+	// If there is no backlog, we don't need to schedule the requests.
+	if (sched.is_empty() && reqs.size()
+			+ num_reserved <= (size_t) aio->num_available_IO_slots()) {
+		aio->access(reqs.data(), reqs.size());
+		return;
+	}
+
+	// We only submit the requests that can get AIO slots right away, so
+	// the requests that arrive later can still be scheduled before
+	// the remaining ones.
+	uint64_t now = get_curr_time_ns();
+	sched.add(reqs.data(), reqs.size(), now);
+	reqs.clear();
+	sched.fetch(aio->num_available_IO_slots(), num_reserved, now, reqs);
+	if (!reqs.empty())
+		aio->access(reqs.data(), reqs.size());
+	// All slots are used. We wait for a request to complete to get
+	// a free slot.
+	else if (aio->num_pending_ios() > 0)
+		aio->wait4complete(1);
+}
+
 void disk_io_thread::run() {
 	// First, check if we need to flush requests.
 	int num_flushes = flush_counter.get();
@@ -319,6 +410,7 @@ void disk_io_thread::run() {
 			run_commands(comm_queue);
 
 		int num = get_all_reqs(queue, local_reqs);
+		num += get_ring_reqs(local_reqs);
 
 		if (is_debug_enabled())
 			printf("I/O thread %d: queue size: %d, low-prio queue size: %d\n",
@@ -328,7 +420,7 @@ void disk_io_thread::run() {
 		// TODO we might want to get all low-priority I/O requests for
 		// better scheduling, like the normal I/O requests. But low-priority
 		// requests aren't used, so we don't need to do anything for now.
-		while (num == 0) {
+		while (num == 0 && sched.is_empty()) {
 			// we can process as many low-prio requests as possible,
 			// but they shouldn't block the thread.
 			if (!low_prio_queue.is_empty()
@@ -352,14 +444,15 @@ void disk_io_thread::run() {
 				break;
 
 			num = get_all_reqs(queue, local_reqs);
+			num += get_ring_reqs(local_reqs);
 		}
 
-		aio->access(local_reqs.data(), local_reqs.size());
+		issue_reqs(local_reqs);
 		local_reqs.clear();
 
 		// We can't exit the loop if there are still pending AIO requests.
 		// This thread is responsible for processing completed AIO requests.
-	} while (aio->num_pending_ios() > 0);
+	} while (aio->num_pending_ios() > 0 || !sched.is_empty());
 }
 
 void disk_io_thread::print_state()
@@ -24,8 +24,10 @@
 
 #include <string>
 #include <unordered_set>
+#include <unordered_map>
 
 #include "aio_private.h"
+#include "disk_req_scheduler.h"
 #include "io_request.h"
 #include "container.h"
 #include "file_partition.h"
@@ -122,12 +124,76 @@ class disk_io_thread: public thread
 		}
 	};
 
+	/*
+	 * The command creates a ring for an application thread to send
+	 * requests to the I/O thread, or gets the existing one.
+	 */
+	class acquire_ring_comm: public remote_comm
+	{
+		disk_io_thread &t;
+		thread *app;
+		spsc_queue<io_request> **ret;
+	public:
+		acquire_ring_comm(disk_io_thread &_t, thread *app,
+				spsc_queue<io_request> **ret): t(_t) {
+			this->app = app;
+			this->ret = ret;
+		}
+
+		void run();
+	};
+
+	class release_ring_comm: public remote_comm
+	{
+		disk_io_thread &t;
+		thread *app;
+	public:
+		release_ring_comm(disk_io_thread &_t, thread *app): t(_t) {
+			this->app = app;
+		}
+
+		void run();
+	};
+
+	/*
+	 * The command passes requests to the I/O thread when the requests
+	 * can't be sent through a ring.
+	 */
+	class send_reqs_comm: public remote_comm
+	{
+		disk_io_thread &t;
+		std::vector<io_request> reqs;
+	public:
+		send_reqs_comm(disk_io_thread &_t,
+				const std::vector<io_request> &reqs): t(_t) {
+			this->reqs = reqs;
+		}
+
+		void run() {
+			t.orphan_reqs.insert(t.orphan_reqs.end(), reqs.begin(), reqs.end());
+		}
+	};
+
+	struct req_ring
+	{
+		spsc_queue<io_request> *q;
+		int ref;
+	};
+
 	// The id of disks accessed by this thread.
 	std::unordered_set<int> disk_ids;
+	// The rings from application threads. They are only accessed in
+	// the I/O thread.
+	std::unordered_map<thread *, req_ring> rings;
+	std::vector<spsc_queue<io_request> *> ring_vec;
+	// The requests that are passed to the I/O thread without a ring.
+	std::vector<io_request> orphan_reqs;
 	msg_queue<io_request> queue;
 	msg_queue<io_request> low_prio_queue;
 	thread_safe_FIFO_queue<remote_comm *> comm_queue;
 	logical_file_partition partition;
+	// The requests waiting for AIO slots.
+	disk_req_scheduler sched;
 
 	async_io *aio;
 	long num_reads;
@@ -156,8 +222,21 @@ class disk_io_thread: public thread
 		return low_prio_queue.get_num_objs();
 	}
 
+	void count_req(const io_request &req) {
+		if (req.get_access_method() == READ) {
+			num_reads++;
+			num_read_bytes += req.get_size();
+		}
+		else {
+			num_writes++;
+			num_write_bytes += req.get_size();
+		}
+	}
+
 	size_t get_all_reqs(msg_queue<io_request> &queue,
 			std::vector<io_request> &reqs);
+	size_t get_ring_reqs(std::vector<io_request> &reqs);
+	void issue_reqs(std::vector<io_request> &reqs);
 
 	void run_commands(thread_safe_FIFO_queue<remote_comm *> &);
 
@@ -214,6 +293,33 @@ public:
 		return execute_remote_comm(comm);
 	}
 
+	/*
+	 * Get the ring for the application thread to send requests to
+	 * the I/O thread. All I/O instances in the application thread share
+	 * the same ring, and only the application thread can add requests to
+	 * the ring.
+	 */
+	spsc_queue<io_request> *acquire_ring(thread *app) {
+		spsc_queue<io_request> *ring = NULL;
+		execute_remote_comm(new acquire_ring_comm(*this, app, &ring));
+		return ring;
+	}
+
+	/*
+	 * Release the ring of the application thread. The ring is destroyed
+	 * when it isn't used by any I/O instances.
+	 */
+	void release_ring(thread *app) {
+		execute_remote_comm(new release_ring_comm(*this, app));
+	}
+
+	/*
+	 * Pass requests to the I/O thread from a thread that doesn't own a ring.
+	 */
+	void send_reqs(const std::vector<io_request> &reqs) {
+		execute_remote_comm(new send_reqs_comm(*this, reqs));
+	}
+
 	~disk_io_thread() {
 		delete aio;
 	}
@@ -255,6 +361,10 @@ public:
 					min_flush_delay);
 		printf("\tremain %d high-prio requests, %d low-prio requests, %ld messages in total\n",
 				get_num_high_prio_reqs(), get_num_low_prio_reqs(), num_msgs);
+		for (int i = 0; i < NUM_IO_CLASSES; i++)
+			printf("\tI/O class %d: issue %ld reqs (%ld expired)\n", i,
+					sched.get_num_issued(i), sched.get_num_expired(i));
+		aio->print_stat();
 #endif
 	}
 
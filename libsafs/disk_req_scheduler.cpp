@@ -0,0 +1,168 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "disk_req_scheduler.h"
+
+namespace safs
+{
+
+disk_req_scheduler::disk_req_scheduler(const std::vector<int> &deadlines)
+{
+	assert(deadlines.size() == NUM_IO_CLASSES);
+	for (int i = 0; i < NUM_IO_CLASSES; i++) {
+		this->deadlines[i] = deadlines[i] * 1000UL;
+		classes[i].rr_idx = 0;
+		num_issued[i] = 0;
+		num_expired[i] = 0;
+	}
+	num_reqs = 0;
+	last_expired = false;
+}
+
+disk_req_scheduler::~disk_req_scheduler()
+{
+	for (int i = 0; i < NUM_IO_CLASSES; i++) {
+		for (size_t j = 0; j < classes[i].active.size(); j++)
+			delete classes[i].active[j];
+	}
+}
+
+void disk_req_scheduler::add(const io_request reqs[], size_t num,
+		uint64_t now)
+{
+	for (size_t i = 0; i < num; i++) {
+		io_interface *io = reqs[i].get_io();
+		assert(io);
+		int io_class = io->get_io_class();
+		class_queue &q = classes[io_class];
+		io_queue *ioq;
+		auto it = q.ios.find(io);
+		if (it == q.ios.end()) {
+			ioq = new io_queue();
+			ioq->io = io;
+			ioq->deficit = 0;
+			q.ios.insert(std::pair<io_interface *, io_queue *>(io, ioq));
+			q.active.push_back(ioq);
+		}
+		else
+			ioq = it->second;
+		// The weight may be changed by the application thread.
+		ioq->weight = io->get_io_weight();
+		queued_req qreq;
+		qreq.req = reqs[i];
+		qreq.deadline = now + deadlines[io_class];
+		ioq->reqs.push_back(qreq);
+	}
+	num_reqs += num;
+}
+
+int disk_req_scheduler::get_highest_class() const
+{
+	for (int i = 0; i < NUM_IO_CLASSES; i++)
+		if (!classes[i].active.empty())
+			return i;
+	return -1;
+}
+
+bool disk_req_scheduler::get_expired(int top_class, uint64_t now,
+		int &io_class, size_t &idx) const
+{
+	bool found = false;
+	uint64_t min_deadline = now;
+	for (int i = top_class + 1; i < NUM_IO_CLASSES; i++) {
+		const class_queue &q = classes[i];
+		for (size_t j = 0; j < q.active.size(); j++) {
+			// The oldest request of an I/O instance expires first.
+			uint64_t deadline = q.active[j]->reqs.front().deadline;
+			if (deadline <= min_deadline) {
+				min_deadline = deadline;
+				io_class = i;
+				idx = j;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+io_request disk_req_scheduler::pop(class_queue &q, size_t idx)
+{
+	io_queue *ioq = q.active[idx];
+	io_request req = ioq->reqs.front().req;
+	ioq->reqs.pop_front();
+	num_reqs--;
+	// We only keep the I/O instances with queued requests, so we don't
+	// keep the queues of the I/O instances that have been destroyed.
+	if (ioq->reqs.empty()) {
+		q.active.erase(q.active.begin() + idx);
+		q.ios.erase(ioq->io);
+		delete ioq;
+		if (idx < q.rr_idx)
+			q.rr_idx--;
+		if (q.rr_idx >= q.active.size())
+			q.rr_idx = 0;
+	}
+	return req;
+}
+
+io_request disk_req_scheduler::fetch_fair(class_queue &q)
+{
+	assert(!q.active.empty());
+	while (true) {
+		io_queue *ioq = q.active[q.rr_idx];
+		long size = ioq->reqs.front().req.get_size();
+		if (ioq->deficit >= size) {
+			ioq->deficit -= size;
+			return pop(q, q.rr_idx);
+		}
+		ioq->deficit += ioq->weight * QUANTUM;
+		q.rr_idx = (q.rr_idx + 1) % q.active.size();
+	}
+}
+
+size_t disk_req_scheduler::fetch(size_t max_num, size_t num_reserved,
+		uint64_t now, std::vector<io_request> &reqs)
+{
+	size_t num = 0;
+	while (num < max_num && num_reqs > 0) {
+		bool use_reserved = max_num - num <= num_reserved;
+		int top_class = get_highest_class();
+		int io_class;
+		size_t idx;
+		if (!last_expired && !use_reserved
+				&& get_expired(top_class, now, io_class, idx)) {
+			reqs.push_back(pop(classes[io_class], idx));
+			num_expired[io_class]++;
+			num_issued[io_class]++;
+			last_expired = true;
+		}
+		// Only the interactive class can use the reserved slots.
+		else if (use_reserved && top_class != IO_CLASS_INTERACTIVE)
+			break;
+		else {
+			reqs.push_back(fetch_fair(classes[top_class]));
+			num_issued[top_class]++;
+			last_expired = false;
+		}
+		num++;
+	}
+	return num;
+}
+
+}
@@ -0,0 +1,134 @@
+#ifndef __DISK_REQ_SCHEDULER_H__
+#define __DISK_REQ_SCHEDULER_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "io_interface.h"
+#include "io_request.h"
+
+namespace safs
+{
+
+/*
+ * This schedules the requests waiting in an I/O thread for AIO slots.
+ * The class and the weight of a request come from the I/O instance that
+ * issues it.
+ *
+ * A request of a higher class is always issued before the requests of
+ * lower classes, unless the oldest request of a lower class has waited
+ * longer than the deadline of its class. Such an expired request is
+ * issued before the requests of higher classes, but we alternate between
+ * the expired requests and the requests of the highest class, so a backlog
+ * of expired requests can't block a higher class.
+ * The I/O instances in the same class share the disks in proportion to
+ * their weights with deficit round-robin on the number of bytes.
+ */
+class disk_req_scheduler
+{
+	// The number of bytes an I/O instance can issue in a round for each
+	// unit of its weight.
+	static const long QUANTUM = 128 * 1024;
+
+	struct queued_req
+	{
+		io_request req;
+		// In ns.
+		uint64_t deadline;
+	};
+
+	struct io_queue
+	{
+		io_interface *io;
+		int weight;
+		long deficit;
+		std::deque<queued_req> reqs;
+	};
+
+	struct class_queue
+	{
+		// The I/O instances with queued requests, in the round-robin order.
+		std::vector<io_queue *> active;
+		size_t rr_idx;
+		std::unordered_map<io_interface *, io_queue *> ios;
+	};
+
+	class_queue classes[NUM_IO_CLASSES];
+	// The deadlines of the classes in ns.
+	uint64_t deadlines[NUM_IO_CLASSES];
+	size_t num_reqs;
+	// Whether the last request was issued because it expired.
+	bool last_expired;
+
+	size_t num_issued[NUM_IO_CLASSES];
+	size_t num_expired[NUM_IO_CLASSES];
+
+	int get_highest_class() const;
+	/*
+	 * Find the I/O queue whose oldest request expires first among
+	 * the classes lower than `top_class'. It returns false if no request
+	 * has expired.
+	 */
+	bool get_expired(int top_class, uint64_t now, int &io_class,
+			size_t &idx) const;
+	io_request pop(class_queue &q, size_t idx);
+	io_request fetch_fair(class_queue &q);
+public:
+	/*
+	 * The deadlines are in microseconds.
+	 */
+	disk_req_scheduler(const std::vector<int> &deadlines);
+	~disk_req_scheduler();
+
+	void add(const io_request reqs[], size_t num, uint64_t now);
+
+	/*
+	 * Get at most `max_num' requests in the order that they should be
+	 * issued. The requests of the classes lower than the interactive class
+	 * leave `num_reserved' of the `max_num' slots to the interactive class.
+	 */
+	size_t fetch(size_t max_num, size_t num_reserved, uint64_t now,
+			std::vector<io_request> &reqs);
+
+	bool is_empty() const {
+		return num_reqs == 0;
+	}
+
+	size_t get_num_reqs() const {
+		return num_reqs;
+	}
+
+	size_t get_num_issued(int io_class) const {
+		return num_issued[io_class];
+	}
+
+	size_t get_num_expired(int io_class) const {
+		return num_expired[io_class];
+	}
+};
+
+}
+
+#endif
@@ -17,6 +17,10 @@
  * limitations under the License.
  */
 
+#include <math.h>
+
+#include <algorithm>
+
 #include "file_mapper.h"
 #include "RAID_config.h"
 
@@ -24,7 +28,8 @@ namespace safs
 {
 
 file_mapper::ptr file_mapper::create(const safs_header &header,
-		const std::vector<part_file_info> &files, const std::string &file_name)
+		const std::vector<part_file_info> &files, const std::string &file_name,
+		const std::vector<int> &weights)
 {
 	if (!header.is_valid())
 		return file_mapper::ptr();
@@ -41,6 +46,23 @@ file_mapper::ptr file_mapper::create(const safs_header &header,
 		case HASH:
 			return file_mapper::ptr(new hash_mapper(file_name, files,
 						block_size));
+		case WEIGHTED:
+			{
+				if (weights.empty())
+					return file_mapper::ptr(new weighted_mapper(file_name,
+								files, block_size));
+				if (weights.size() != files.size()) {
+					fprintf(stderr,
+							"%s has %ld disk weights, but there are %ld disks\n",
+							file_name.c_str(), weights.size(), files.size());
+					return file_mapper::ptr();
+				}
+				std::vector<part_file_info> weighted_files = files;
+				for (size_t i = 0; i < weights.size(); i++)
+					weighted_files[i].set_weight(weights[i]);
+				return file_mapper::ptr(new weighted_mapper(file_name,
+							weighted_files, block_size));
+			}
 		default:
 			fprintf(stderr, "wrong RAID mapping option\n");
 			return file_mapper::ptr();
@@ -56,6 +78,73 @@ int gen_RAID_rand_start(int num_files)
 	return r % num_files;
 }
 
+std::vector<int> throughput2weights(const std::vector<double> &throughputs)
+{
+	std::vector<int> weights(throughputs.size());
+	if (throughputs.empty())
+		return weights;
+	double min_thr = *std::min_element(throughputs.begin(), throughputs.end());
+	assert(min_thr > 0);
+	int max_weight = 0;
+	for (size_t i = 0; i < throughputs.size(); i++) {
+		weights[i] = (int) round(throughputs[i] / min_thr * 4);
+		max_weight = std::max(max_weight, weights[i]);
+	}
+	if (max_weight > MAX_DISK_WEIGHT) {
+		for (size_t i = 0; i < weights.size(); i++)
+			weights[i] = std::max(1, (int) round(
+						(double) weights[i] * MAX_DISK_WEIGHT / max_weight));
+	}
+	// We want the cycle of the mapping as short as possible.
+	int gcd = weights[0];
+	for (size_t i = 1; i < weights.size(); i++) {
+		int a = gcd, b = weights[i];
+		while (b) {
+			int t = a % b;
+			a = b;
+			b = t;
+		}
+		gcd = a;
+	}
+	for (size_t i = 0; i < weights.size(); i++)
+		weights[i] /= gcd;
+	return weights;
+}
+
+weighted_mapper::weighted_mapper(const std::string &name,
+		const std::vector<part_file_info> &files,
+		int block_size): file_mapper(name, files, block_size)
+{
+	// The disks without weights are treated as the slowest disks.
+	weights.resize(files.size());
+	int tot_weight = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		weights[i] = std::min(std::max(files[i].get_weight(), 1),
+				MAX_DISK_WEIGHT);
+		tot_weight += weights[i];
+	}
+
+	// Smooth weighted round-robin: in each step, every disk gains credits
+	// of its weight and the disk with the most credits gets the block.
+	std::vector<int> credits(weights.size());
+	std::vector<int> num_blocks(weights.size());
+	cycle_disks.resize(tot_weight);
+	cycle_offs.resize(tot_weight);
+	for (int i = 0; i < tot_weight; i++) {
+		int selected = 0;
+		for (size_t j = 0; j < weights.size(); j++) {
+			credits[j] += weights[j];
+			if (credits[j] > credits[selected])
+				selected = j;
+		}
+		credits[selected] -= tot_weight;
+		cycle_disks[i] = selected;
+		cycle_offs[i] = num_blocks[selected]++;
+	}
+	for (size_t i = 0; i < weights.size(); i++)
+		assert(num_blocks[i] == weights[i]);
+}
+
 int RAID0_mapper::rand_start;
 int RAID5_mapper::rand_start;
 
@@ -77,6 +166,22 @@ std::vector<size_t> file_mapper::get_size_per_disk(size_t size) const
 	return ret;
 }
 
+std::vector<size_t> weighted_mapper::get_size_per_disk(size_t size) const
+{
+	std::vector<size_t> ret(get_num_files());
+	// The last cycle covers all disks.
+	for (size_t i = 0; i < cycle_disks.size(); i++) {
+		if (size < i * STRIPE_BLOCK_SIZE)
+			break;
+		off_t off = (size / STRIPE_BLOCK_SIZE - i) * STRIPE_BLOCK_SIZE
+			+ STRIPE_BLOCK_SIZE - 1;
+		struct block_identifier bid;
+		map(off, bid);
+		ret[bid.idx] = std::max((size_t) bid.off + 1, ret[bid.idx]);
+	}
+	return ret;
+}
+
 std::vector<size_t> hash_mapper::get_size_per_disk(size_t size) const
 {
 	std::vector<size_t> ret(get_num_files());
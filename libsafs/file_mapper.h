@@ -29,6 +29,8 @@
 #include "safs_exception.h"
 #include "comm_exception.h"
 #include "safs_file.h"
+#include "compression.h"
+#include "checksum.h"
 
 namespace safs
 {
@@ -61,6 +63,12 @@ class file_mapper
 	int file_id;
 	std::vector<part_file_info> files;
 	std::string file_name;
+	// It's NULL if the file isn't compressed.
+	block_compress_table::const_ptr compress_table;
+	// It's NULL if the checksums of the file aren't verified.
+	block_checksum_table::const_ptr checksum_table;
+	// The file has checksums even if they aren't verified.
+	bool checksums;
 protected:
 	const std::vector<part_file_info> &get_files() const {
 		return files;
@@ -71,9 +79,15 @@ public:
 	typedef std::shared_ptr<file_mapper> ptr;
 	typedef std::shared_ptr<const file_mapper> const_ptr;
 
+	/*
+	 * `disk_weights' are the weights of the partitions of a file with
+	 * the weighted mapping in the order of partition IDs. It's ignored
+	 * by the other mappings.
+	 */
 	static ptr create(const safs_header &header,
 			const std::vector<part_file_info> &files,
-			const std::string &file_name);
+			const std::string &file_name,
+			const std::vector<int> &disk_weights);
 
 	file_mapper(const std::string &name, const std::vector<part_file_info> &files,
 			int block_size): STRIPE_BLOCK_SIZE(block_size) {
@@ -81,6 +95,7 @@ public:
 		ASSERT_TRUE(block_size > 0);
 		this->files = files;
 		file_id = file_id_gen.inc(1);
+		checksums = false;
 	}
 
 	virtual ~file_mapper() {
@@ -122,6 +137,42 @@ public:
 		return (int) files.size();
 	}
 
+	void set_compress_table(block_compress_table::const_ptr table) {
+		this->compress_table = table;
+	}
+
+	/*
+	 * The table of compressed RAID blocks. It's NULL if the SAFS file
+	 * isn't compressed.
+	 */
+	const block_compress_table::const_ptr &get_compress_table() const {
+		return compress_table;
+	}
+
+	void set_checksum_table(block_checksum_table::const_ptr table) {
+		this->checksum_table = table;
+	}
+
+	/*
+	 * The checksums of the blocks in the SAFS file. It's NULL if the file
+	 * has no checksums or they aren't verified.
+	 */
+	const block_checksum_table::const_ptr &get_checksum_table() const {
+		return checksum_table;
+	}
+
+	void set_has_checksums(bool checksums) {
+		this->checksums = checksums;
+	}
+
+	/*
+	 * Whether the SAFS file has a checksum table. The table has to be kept
+	 * in sync with the data even if the checksums aren't verified.
+	 */
+	bool has_checksums() const {
+		return checksums;
+	}
+
 	/*
 	 * This maps a chunk of data in the SAFS file to the location of a RAID
 	 * stripe. It doesn't identify the physical location of the chunk of data.
@@ -159,7 +210,12 @@ public:
 	}
 
 	virtual file_mapper *clone() {
-		return new RAID0_mapper(get_name(), get_files(), STRIPE_BLOCK_SIZE);
+		file_mapper *ret = new RAID0_mapper(get_name(), get_files(),
+				STRIPE_BLOCK_SIZE);
+		ret->set_compress_table(get_compress_table());
+		ret->set_checksum_table(get_checksum_table());
+		ret->set_has_checksums(has_checksums());
+		return ret;
 	}
 };
 
@@ -189,7 +245,12 @@ public:
 	}
 
 	virtual file_mapper *clone() {
-		return new RAID5_mapper(get_name(), get_files(), STRIPE_BLOCK_SIZE);
+		file_mapper *ret = new RAID5_mapper(get_name(), get_files(),
+				STRIPE_BLOCK_SIZE);
+		ret->set_compress_table(get_compress_table());
+		ret->set_checksum_table(get_checksum_table());
+		ret->set_has_checksums(has_checksums());
+		return ret;
 	}
 };
 
@@ -232,7 +293,73 @@ public:
 	virtual std::vector<size_t> get_size_per_disk(size_t size) const;
 
 	virtual file_mapper *clone() {
-		return new hash_mapper(get_name(), get_files(), STRIPE_BLOCK_SIZE);
+		file_mapper *ret = new hash_mapper(get_name(), get_files(),
+				STRIPE_BLOCK_SIZE);
+		ret->set_compress_table(get_compress_table());
+		ret->set_checksum_table(get_checksum_table());
+		ret->set_has_checksums(has_checksums());
+		return ret;
+	}
+};
+
+const int MAX_DISK_WEIGHT = 16;
+
+/*
+ * This converts the throughput of disks to the weights used by
+ * `weighted_mapper'. The weights keep the ratio of the throughput with
+ * the resolution of a quarter of the slowest disk and don't exceed
+ * MAX_DISK_WEIGHT. The disks with similar throughput get the same weight.
+ */
+std::vector<int> throughput2weights(const std::vector<double> &throughputs);
+
+/*
+ * This mapper places more stripe blocks on the disks with larger weights,
+ * so a fast disk isn't slowed down by slow disks in the RAID.
+ * The weight of a partition is given by `part_file_info'.
+ * A cycle of the mapping has as many blocks as the total weight, and
+ * the blocks in a cycle are interleaved among the disks with smooth
+ * weighted round-robin, so consecutive blocks are still spread across
+ * the disks.
+ */
+class weighted_mapper: public file_mapper
+{
+	std::vector<int> weights;
+	// The disk where each block in a cycle is stored.
+	std::vector<int> cycle_disks;
+	// The location of each block in a cycle among the blocks that
+	// the cycle places on the same disk.
+	std::vector<int> cycle_offs;
+public:
+	weighted_mapper(const std::string &name,
+			const std::vector<part_file_info> &files, int block_size);
+
+	virtual void map(off_t off, struct block_identifier &bid) const {
+		int idx_in_block = off % STRIPE_BLOCK_SIZE;
+		off_t block_idx = off / STRIPE_BLOCK_SIZE;
+		off_t cycle_idx = block_idx / cycle_disks.size();
+		int idx_in_cycle = block_idx % cycle_disks.size();
+		bid.idx = cycle_disks[idx_in_cycle];
+		bid.off = (cycle_idx * weights[bid.idx] + cycle_offs[idx_in_cycle])
+			* STRIPE_BLOCK_SIZE + idx_in_block;
+	}
+
+	virtual int map2file(off_t off) const {
+		return cycle_disks[(off / STRIPE_BLOCK_SIZE) % cycle_disks.size()];
+	}
+
+	virtual std::vector<size_t> get_size_per_disk(size_t size) const;
+
+	const std::vector<int> &get_weights() const {
+		return weights;
+	}
+
+	virtual file_mapper *clone() {
+		file_mapper *ret = new weighted_mapper(get_name(), get_files(),
+				STRIPE_BLOCK_SIZE);
+		ret->set_compress_table(get_compress_table());
+		ret->set_checksum_table(get_checksum_table());
+		ret->set_has_checksums(has_checksums());
+		return ret;
 	}
 };
 
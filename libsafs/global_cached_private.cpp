@@ -49,13 +49,13 @@
 
 #include "global_cached_private.h"
 #include "slab_allocator.h"
+#include "req_allocator.h"
 
 namespace safs
 {
 
 static const int COMPLETE_QUEUE_SIZE = 10240;
 const int REQ_BUF_SIZE = 64;
-const int OBJ_ALLOC_INC_SIZE = 1024 * 1024;
 
 class original_io_request: public io_request
 {
@@ -400,6 +400,10 @@ public:
  * The initial size of the queue for pending IO requests
  */
 const int INIT_GCACHE_PENDING_SIZE = 1000;
+/**
+ * The maximal number of pages being read when we warm up the cache.
+ */
+const size_t MAX_WARM_UP_PAGES = 4096;
 
 void thread_safe_page::add_req(original_io_request *req)
 {
@@ -419,73 +423,16 @@ original_io_request *thread_safe_page::get_io_req() const
 	return reqs;
 }
 
-class req_ext_allocator: public obj_allocator<io_req_extension>
-{
-	class ext_initiator: public obj_initiator<io_req_extension>
-	{
-	public:
-		void init(io_req_extension *ext) {
-			new (ext) io_req_extension();
-		}
-	};
-
-	class ext_destructor: public obj_destructor<io_req_extension>
-	{
-	public:
-		void destroy(io_req_extension *ext) {
-			ext->~io_req_extension();
-		}
-	};
-public:
-	req_ext_allocator(int node_id, long max_size = params.get_max_obj_alloc_size(
-				)): obj_allocator<io_req_extension>(
-				std::string("req_ext_allocator-") + itoa(node_id), node_id,
-				true, OBJ_ALLOC_INC_SIZE, max_size,
-				obj_initiator<io_req_extension>::ptr(new ext_initiator()),
-				obj_destructor<io_req_extension>::ptr(new ext_destructor())) {
-	}
-	
-	virtual io_req_extension *alloc_obj() {
-		io_req_extension *ext = obj_allocator<io_req_extension>::alloc_obj();
-		assert(ext);
-		return ext;
-	}
-};
-
 /**
  * This slab allocator allocates IO requests, and all of them are
  * extended requests.
  */
-class request_allocator: public obj_allocator<original_io_request>
+class request_allocator: public req_obj_allocator<original_io_request>
 {
-	class req_initiator: public obj_initiator<original_io_request>
-	{
-	public:
-		void init(original_io_request *req) {
-			new (req) original_io_request();
-		}
-	};
-
-	class req_destructor: public obj_destructor<original_io_request>
-	{
-	public:
-		void destroy(original_io_request *req) {
-			req->~original_io_request();
-		}
-	};
 public:
-	request_allocator(int node_id, long max_size = params.get_max_obj_alloc_size(
-				)): obj_allocator<original_io_request>(
-				std::string("gcached_req_allocator-") + itoa(node_id), node_id,
-				true, OBJ_ALLOC_INC_SIZE, max_size,
-				obj_initiator<original_io_request>::ptr(new req_initiator()),
-				obj_destructor<original_io_request>::ptr(new req_destructor())) {
-	}
-
-	virtual original_io_request *alloc_obj() {
-		original_io_request *req = obj_allocator<original_io_request>::alloc_obj();
-		assert(req);
-		return req;
+	request_allocator(int node_id): req_obj_allocator<original_io_request>(
+			std::string("gcached_req_allocator-") + itoa(node_id), node_id,
+			true) {
 	}
 };
 
@@ -535,8 +482,15 @@ thread_safe_page *original_io_request::complete_req(thread_safe_page *p,
 void original_io_request::compute(byte_array_allocator &alloc)
 {
 	assert(this->get_req_type() == io_request::USER_COMPUTE);
+	// The byte array holds the references to the pages, so we create it
+	// even if the request failed.
 	original_req_byte_array byte_arr(*this, alloc);
-	get_compute()->run(byte_arr);
+	if (is_failed())
+		get_compute()->fail(request_range(data_loc_t(get_file_id(),
+						get_offset()), get_size(),
+					get_access_method(), get_compute()));
+	else
+		get_compute()->run(byte_arr);
 }
 
 /**
@@ -693,6 +647,19 @@ void queue_requests(std::vector<page_req_pair> &pending_reqs)
 	process_page_reqs_on_io(pending_reqs.data(), pending_reqs.size());
 }
 
+/*
+ * If the read of a page failed, the requests waiting for the page
+ * can't get correct data from it. They are completed as failed requests
+ * in handle_pending_requests().
+ */
+static void fail_reqs_on_page(thread_safe_page *p, original_io_request *req)
+{
+	while (req) {
+		req->set_failed(true);
+		req = req->get_next_req_on_page(p);
+	}
+}
+
 int global_cached_io::multibuf_completion(io_request *request)
 {
 	/*
@@ -710,8 +677,14 @@ int global_cached_io::multibuf_completion(io_request *request)
 		assert(p);
 		p->lock();
 		assert(p->is_io_pending());
-		if (request->get_access_method() == READ)
-			p->set_data_ready(true);
+		bool prefetch = false;
+		if (request->get_access_method() == READ) {
+			// The page of a failed read doesn't have valid data, so it's
+			// read again by the next request that accesses it.
+			if (!request->is_failed())
+				p->set_data_ready(true);
+			prefetch = p->set_prefetch(false);
+		}
 		else {
 			p->set_dirty(false);
 			p->set_old_dirty(false);
@@ -719,8 +692,13 @@ int global_cached_io::multibuf_completion(io_request *request)
 		p->set_io_pending(false);
 		original_io_request *pending_req = p->reset_reqs();
 		p->unlock();
+		if (request->is_failed())
+			fail_reqs_on_page(p, pending_req);
 		if (pending_req)
 			pending_reqs.push_back(page_req_pair(p, pending_req));
+		// Release the reference held by read-ahead.
+		if (prefetch)
+			p->dec_ref();
 		if (request->get_access_method() == WRITE) {
 			// The reference count of a dirty page is always 1 + # original
 			// requests, so we can decrease the extra reference here.
@@ -753,10 +731,13 @@ void global_cached_io::process_disk_completed_requests(io_request requests[],
 		assert(request->get_size() <= PAGE_SIZE);
 
 		p->lock();
+		bool prefetch = false;
 		// If we write data to part of a page, we need to first read
 		// the entire page to memory first.
 		if (request->get_access_method() == READ) {
-			p->set_data_ready(true);
+			if (!request->is_failed())
+				p->set_data_ready(true);
+			prefetch = p->set_prefetch(false);
 		}
 		// We just evict a page with dirty data and write the original
 		// dirty data in the page to a file.
@@ -768,6 +749,11 @@ void global_cached_io::process_disk_completed_requests(io_request requests[],
 		p->set_io_pending(false);
 		original_io_request *old = p->reset_reqs();
 		p->unlock();
+		if (request->is_failed())
+			fail_reqs_on_page(p, old);
+		// Release the reference held by read-ahead.
+		if (prefetch)
+			p->dec_ref();
 
 		if (request->get_access_method() == WRITE) {
 			// The reference count of a dirty page is always 1 + # original
@@ -848,7 +834,9 @@ global_cached_io::global_cached_io(thread *t, io_interface::ptr underlying,
 {
 	assert(t == underlying->get_thread());
 	ext_allocator = std::unique_ptr<req_ext_allocator>(
-			new req_ext_allocator(underlying->get_node_id()));
+			new req_ext_allocator(std::string("req_ext_allocator-")
+				+ itoa(underlying->get_node_id()), underlying->get_node_id(),
+				true));
 	req_allocator = std::unique_ptr<request_allocator>(
 			new request_allocator(underlying->get_node_id()));
 	orig_array_allocator
@@ -864,23 +852,46 @@ global_cached_io::global_cached_io(thread *t, io_interface::ptr underlying,
 	num_bytes = 0;
 	num_fast_process = 0;
 	num_evicted_dirty_pages = 0;
+	num_read_ahead_pages = 0;
+	file_size = -1;
 
 	this->underlying = underlying;
 	this->cache_size = cache->size();
 	global_cache = cache;
 	assert(processing_req.is_empty());
 
-	if (sched == NULL)
+	if (sched == NULL && params.get_io_coalesce_window() > 0)
+		comp_io_sched = comp_io_scheduler::ptr(
+				new coalesce_comp_io_scheduler(this->get_node_id(),
+					params.get_io_coalesce_window()));
+	else if (sched == NULL)
 		comp_io_sched = comp_io_scheduler::ptr(
 				new default_comp_io_scheduler(this->get_node_id()));
 	else
 		comp_io_sched = sched;
 	comp_io_sched->set_io(this);
+
+	if (params.is_latency_stat()) {
+		hit_lat = latency_histogram::ptr(new latency_histogram());
+		register_latency_hist(get_hit_stat_name(), hit_lat);
+	}
+}
+
+size_t global_cached_io::get_num_req_allocs() const
+{
+	return req_allocator->get_num_allocs() + ext_allocator->get_num_allocs();
+}
+
+size_t global_cached_io::get_num_req_chunks() const
+{
+	return req_allocator->get_num_chunks() + ext_allocator->get_num_chunks();
 }
 
 global_cached_io::~global_cached_io()
 {
 	cleanup();
+	if (hit_lat)
+		unregister_latency_hist(get_hit_stat_name(), hit_lat);
 }
 
 /**
@@ -1098,6 +1109,103 @@ ssize_t global_cached_io::read(io_request &req, thread_safe_page *pages[],
 	return ret;
 }
 
+void global_cached_io::read_ahead(const io_request &req)
+{
+	if (params.get_read_ahead_max() <= 0 || req.get_access_method() != READ)
+		return;
+
+	auto it = streams.find(req.get_file_id());
+	if (it == streams.end())
+		it = streams.insert(std::pair<int, stream_detector>(req.get_file_id(),
+					stream_detector(params.get_read_ahead_init(),
+						params.get_read_ahead_max()))).first;
+	std::vector<stream_detector::range_t> ranges;
+	it->second.access(req.get_offset(), req.get_size(), ranges);
+	for (size_t i = 0; i < ranges.size(); i++)
+		prefetch(req.get_file_id(), ranges[i].first, ranges[i].second,
+				ACCESS_HINT_SEQUENTIAL);
+}
+
+void global_cached_io::warm_up(off_t off, size_t size)
+{
+	prefetch(get_file_id(), off, size, ACCESS_HINT_NORMAL);
+	flush_requests();
+	// The pages being read are referenced, so we can't issue too many
+	// reads. Otherwise, we can't evict pages from the cache.
+	while (num_underlying_pages.get() > MAX_WARM_UP_PAGES) {
+		get_thread()->wait();
+		process_all_requests();
+	}
+}
+
+void global_cached_io::prefetch(int file_id, off_t off, size_t size,
+		int hint)
+{
+	off_t end = off + size;
+	if (file_size >= 0 && end > file_size)
+		end = file_size;
+	if (end <= off)
+		return;
+	end = ROUNDUP_PAGE(end);
+
+	io_req_extension *ext = ext_allocator->alloc_obj();
+	io_request multibuf_req(ext, INVALID_DATA_LOC, READ, this, get_node_id());
+	for (off_t pg_off = ROUND_PAGE(off); pg_off < end; pg_off += PAGE_SIZE) {
+		page_id_t pg_id(file_id, pg_off);
+		page_id_t old_id;
+		thread_safe_page *p = (thread_safe_page *) get_global_cache().search(
+				pg_id, old_id, hint);
+		// All pages in the page set are referenced. We shouldn't evict
+		// more pages for read-ahead.
+		if (p == NULL)
+			break;
+
+		bool added = false;
+		if (p->is_old_dirty()) {
+			// We are the only one that can write back the old dirty data.
+			if (old_id.get_offset() != -1)
+				write_dirty_page(p, old_id, NULL);
+			p->dec_ref();
+		}
+		else {
+			p->lock();
+			if (!p->data_ready() && !p->is_io_pending()) {
+				assert(p->get_io_req() == NULL);
+				assert(!p->is_dirty());
+				p->set_io_pending(true);
+				// The reference of the page is kept until the data is ready.
+				p->set_prefetch(true);
+				if (multibuf_req.is_empty()) {
+					data_loc_t loc(p->get_file_id(), p->get_offset());
+					multibuf_req.set_data_loc(loc);
+				}
+				multibuf_req.add_page(p);
+				multibuf_req.set_priv(p);
+				added = true;
+				num_read_ahead_pages++;
+			}
+			p->unlock();
+			if (!added)
+				p->dec_ref();
+		}
+
+		// We issue the request if the pages aren't contiguous any more
+		// or the request reaches the end of a RAID block.
+		if (!multibuf_req.is_empty() && (!added
+					|| (pg_off + PAGE_SIZE) % (get_block_size() * PAGE_SIZE) == 0)) {
+			send2underlying(multibuf_req);
+
+			io_req_extension *ext = ext_allocator->alloc_obj();
+			io_request tmp(ext, INVALID_DATA_LOC, READ, this, get_node_id());
+			multibuf_req = tmp;
+		}
+	}
+	if (!multibuf_req.is_empty())
+		send2underlying(multibuf_req);
+	else
+		ext_allocator->free(multibuf_req.get_extension());
+}
+
 int global_cached_io::handle_pending_requests()
 {
 	int tot = 0;
@@ -1117,7 +1225,13 @@ int global_cached_io::handle_pending_requests()
 			 */
 			assert(req->get_next_req_on_page(p) == NULL);
 			assert(req->get_io() == this);
-			if (req->get_access_method() == WRITE)
+			// The read of the page failed. We don't read the page again
+			// for the request, or it'd fail again and again.
+			if (req->is_failed()) {
+				finalize_partial_request(p, req);
+				p->dec_ref();
+			}
+			else if (req->get_access_method() == WRITE)
 				__write(req, p, dirty_pages);
 			else
 				__read(req, p);
@@ -1133,11 +1247,14 @@ int global_cached_io::handle_pending_requests()
 	return tot;
 }
 
-void merge_pages2req(io_request &req, page_cache &cache, size_t block_size)
+/**
+ * Add the dirty pages adjacent to the page in the request to the request,
+ * so they are written back together. The request doesn't cross
+ * the boundary of a RAID block.
+ */
+void merge_dirty_pages2req(io_request &req, page_cache &cache,
+		size_t block_size)
 {
-	if (!params.is_cache_large_write())
-		return;
-
 	thread_safe_page *p;
 	off_t off = req.get_offset();
 	off_t forward_off = off + PAGE_SIZE;
@@ -1198,6 +1315,12 @@ void merge_pages2req(io_request &req, page_cache &cache, size_t block_size)
 	assert(req.inside_RAID_block(block_size));
 }
 
+void merge_pages2req(io_request &req, page_cache &cache, size_t block_size)
+{
+	if (params.is_cache_large_write())
+		merge_dirty_pages2req(req, cache, block_size);
+}
+
 /**
  * Write the dirty page. If possible, we merge it with pages adjacent to
  * it and write a larger request.
@@ -1214,7 +1337,10 @@ void global_cached_io::write_dirty_page(thread_safe_page *p,
 	io_request req(ext, pg_id, WRITE, this, p->get_node_id());
 	assert(p->get_ref() > 0);
 	req.add_page(p);
-	p->add_req(orig);
+	// The write may be triggered by read-ahead, so there isn't
+	// an original request.
+	if (orig)
+		p->add_req(orig);
 	/*
 	 * I need to add another reference.
 	 * Normally, the reference count of a page should be the same as the number
@@ -1233,9 +1359,10 @@ void global_cached_io::write_dirty_page(thread_safe_page *p,
 	merge_pages2req(req, get_global_cache(), get_block_size());
 	// The writeback data should have no overlap with the original request
 	// that triggered this writeback.
-	assert(!req.has_overlap(orig->get_offset(), orig->get_size()));
+	assert(orig == NULL || !req.has_overlap(orig->get_offset(),
+				orig->get_size()));
 
-	if (orig->is_sync())
+	if (orig && orig->is_sync())
 		req.set_low_latency(true);
 
 	/*
@@ -1324,6 +1451,8 @@ void global_cached_io::process_cached_reqs()
 			safs::notify_completion(this, reqp_buf, num_reqs_in_buf);
 			num_reqs_in_buf = 0;
 		}
+		if (hit_lat && pair.first.get_create_time() > 0)
+			hit_lat->add(get_curr_time_ns() - pair.first.get_create_time());
 	}
 	// We don't need to notify completion for sync requests.
 	// Actually, we don't even need to do anything for sync requests.
@@ -1345,7 +1474,8 @@ void global_cached_io::process_user_req(
 		page_id_t pg_id = processing_req.get_curr_page_id();
 		page_id_t old_id;
 		do {
-			p = (thread_safe_page *) (get_global_cache().search(pg_id, old_id));
+			p = (thread_safe_page *) (get_global_cache().search(pg_id, old_id,
+						get_access_hint()));
 			// If the cache can't evict a page, it's probably because
 			// all pages have been referenced. It's likely that we issued
 			// too many requests. Let's stop issuing more requests for now.
@@ -1511,6 +1641,10 @@ void global_cached_io::process_user_reqs(queue_interface<io_request> &queue)
 			&& num_underlying_pages.get() < 1000) {
 		io_request req = queue.pop_front();
 		num_processed_areqs.inc(1);
+		// The requests generated by user compute don't have the time
+		// when they are created.
+		if (hit_lat && req.get_create_time() == 0)
+			req.set_create_time(get_curr_time_ns());
 		// We don't allow the user's requests to be extended requests.
 		assert(!req.is_extended_req());
 		assert(!req.is_sync());
@@ -1524,6 +1658,7 @@ void global_cached_io::process_user_reqs(queue_interface<io_request> &queue)
 		processing_req.init(req);
 		num_bytes += req.get_size();
 		process_user_req(dirty_pages, NULL);
+		read_ahead(req);
 	}
 
 	get_global_cache().mark_dirty_pages(dirty_pages.data(),
@@ -1541,6 +1676,7 @@ void global_cached_io::access(io_request *requests, int num, io_status *status)
 
 	bool syncd = false;
 	std::vector<thread_safe_page *> dirty_pages;
+	uint64_t now = hit_lat ? get_curr_time_ns() : 0;
 
 	int num_async = 0;
 	for (int i = 0; i < num; i++) {
@@ -1548,6 +1684,8 @@ void global_cached_io::access(io_request *requests, int num, io_status *status)
 			requests[i].set_io(this);
 			requests[i].set_node_id(this->get_node_id());
 		}
+		if (hit_lat)
+			requests[i].set_create_time(now);
 		if (!requests[i].is_sync())
 			num_async++;
 		// The user compute will be referenced by IO requests. I need to
@@ -1592,6 +1730,7 @@ void global_cached_io::access(io_request *requests, int num, io_status *status)
 		if (status)
 			stat_p = &status[i];
 		process_user_req(dirty_pages, stat_p);
+		read_ahead(requests[i]);
 		// We can't process all requests. Let's queue the remaining requests.
 		if (!processing_req.is_empty() && i < num - 1) {
 			user_requests.add(&requests[i + 1], num - i - 1);
@@ -1614,10 +1753,11 @@ io_status global_cached_io::access(char *buf, off_t offset,
 	io_request req(buf, loc, size, access_method, this, this->get_node_id(), true);
 	io_status status;
 	access(&req, 1, &status);
+	bool success = true;
 	if (status == IO_PENDING) {
 		original_io_request *orig = (original_io_request *) status.get_priv_data();
 		assert(orig);
-		wait4req(orig);
+		success = wait4req(orig);
 	}
 	else {
 		// Process the completed requests served in the cache directly.
@@ -1627,7 +1767,8 @@ io_status global_cached_io::access(char *buf, off_t offset,
 		// call this function to complete processing this request.
 		process_cached_reqs();
 	}
-	// TODO IO may fail, I need to return an error in case it fails.
+	if (!success)
+		return IO_FAIL;
 	status = IO_OK;
 	status.set_priv_data(size);
 	return status;
@@ -1644,7 +1785,7 @@ int global_cached_io::preload(off_t start, long size) {
 		page_id_t pg_id(get_file_id(), ROUND_PAGE(offset));
 		page_id_t old_id;
 		thread_safe_page *p = (thread_safe_page *) (get_global_cache().search(
-					pg_id, old_id));
+					pg_id, old_id, get_access_hint()));
 		// This is mainly for testing. I don't need to really read data from disks.
 		if (!p->data_ready()) {
 			p->set_io_pending(false);
@@ -1714,16 +1855,18 @@ void global_cached_io::process_all_requests()
 	flush_requests();
 }
 
-void global_cached_io::wait4req(original_io_request *req)
+bool global_cached_io::wait4req(original_io_request *req)
 {
 	while (!req->is_complete()) {
 		process_all_requests();
 		if (req->is_complete())
 			break;
-		get_thread()->wait();
+		wait4activation();
 	}
+	bool failed = req->is_failed();
 	// Now we can delete it.
 	req_allocator->free(req);
+	return !failed;
 }
 
 /**
@@ -1745,7 +1888,7 @@ int global_cached_io::wait4complete(int num_to_complete)
 			- prev_completed_areqs < (size_t) num_to_complete) {
 		// We only wait when there are pending requests in the underlying IO.
 		if (num_to_underlying.get() - num_from_underlying.get() > 0) {
-			get_thread()->wait();
+			wait4activation();
 		}
 		process_all_requests();
 	}
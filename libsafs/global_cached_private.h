@@ -21,11 +21,14 @@
  */
 
 #include <atomic>
+#include <unordered_map>
 
 #include "io_interface.h"
 #include "cache.h"
 #include "container.h"
 #include "comp_io_scheduler.h"
+#include "latency_histogram.h"
+#include "read_ahead.h"
 
 namespace safs
 {
@@ -143,6 +146,25 @@ class global_cached_io: public io_interface
 	size_t cache_hits;
 	size_t num_fast_process;
 	size_t num_evicted_dirty_pages;
+	// The time from when requests served by the page cache in the fast
+	// process path are issued to global_cached_io until they complete.
+	// It's only created when latency_stat is enabled. Each I/O instance
+	// has its own histogram, named after its thread and file.
+	latency_histogram::ptr hit_lat;
+
+	std::string get_hit_stat_name() const {
+		return get_thread()->get_thread_name() + " file-"
+			+ itoa(get_file_id()) + " cache-hit";
+	}
+
+	// The read streams detected in the files. They're only used when
+	// read-ahead is enabled.
+	std::unordered_map<int, stream_detector> streams;
+	// We don't read ahead or warm up the cache beyond the end of the file.
+	// -1 means the file size is unknown.
+	ssize_t file_size;
+	// The number of pages read ahead.
+	size_t num_read_ahead_pages;
 
 	// Count the number of async requests.
 	// The number of async requests that have been completed.
@@ -166,8 +188,23 @@ class global_cached_io: public io_interface
 	ssize_t __write(original_io_request *orig, thread_safe_page *p,
 		std::vector<thread_safe_page *> &dirty_pages);
 	int multibuf_completion(io_request *request);
+	/*
+	 * Detect whether a read request is part of a stream and read ahead
+	 * the data that the stream is going to access.
+	 */
+	void read_ahead(const io_request &req);
+	/*
+	 * Read the pages in the range to the page cache if they aren't
+	 * in the cache yet. No user request waits for these pages.
+	 * The hint tells the page cache how the pages will be reused.
+	 */
+	void prefetch(int file_id, off_t off, size_t size, int hint);
 
-	void wait4req(original_io_request *req);
+	/*
+	 * Wait for a synchronous request to complete.
+	 * It returns false if the request failed.
+	 */
+	bool wait4req(original_io_request *req);
 
 	int get_num_underlying_reqs() const {
 		return num_to_underlying.get() - num_from_underlying.get();
@@ -259,6 +296,12 @@ public:
 		return underlying->support_aio();
 	}
 
+	// The requests to disks are issued by the underlying I/O.
+	virtual void set_io_priority(int io_class, int weight) {
+		io_interface::set_io_priority(io_class, weight);
+		underlying->set_io_priority(io_class, weight);
+	}
+
 	virtual int get_file_id() const {
 		return underlying->get_file_id();
 	}
@@ -268,6 +311,13 @@ public:
 		// tasks. We have to make sure all requests are completed.
 		while (num_pending_ios() > 0 || !comp_io_sched->is_empty())
 			wait4complete(num_pending_ios());
+		// No user request waits for the pages read ahead, so we have to
+		// wait for them explicitly.
+		flush_requests();
+		while (get_num_underlying_reqs() > 0) {
+			get_thread()->wait();
+			process_all_requests();
+		}
 		underlying->cleanup();
 		assert(num_processed_areqs.get() == num_completed_areqs.get());
 		assert(num_processed_areqs.get() == num_issued_areqs.get());
@@ -332,6 +382,27 @@ public:
 	size_t get_num_fast_process() const {
 		return num_fast_process;
 	}
+	size_t get_num_read_ahead_pages() const {
+		return num_read_ahead_pages;
+	}
+	/*
+	 * The number of request objects allocated from the slab allocators
+	 * and the number of memory chunks the allocators get from the OS.
+	 */
+	size_t get_num_req_allocs() const;
+	size_t get_num_req_chunks() const;
+
+	void set_file_size(ssize_t file_size) {
+		this->file_size = file_size;
+	}
+
+	/*
+	 * Read the pages in the range of the file to the page cache.
+	 * It limits the number of pages being read from the disks.
+	 * The pages are the hot set of the previous run, so they're cached
+	 * as the pages accessed by users instead of the pages read ahead.
+	 */
+	void warm_up(off_t off, size_t size);
 
 	virtual void print_state() {
 #ifdef STATISTICS
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/mman.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef USE_NUMA
+#include <numa.h>
+#endif
+
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "common.h"
+#include "huge_page_arena.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace safs
+{
+
+namespace
+{
+
+struct prefault_task
+{
+	char *addr;
+	size_t num_pages;
+	size_t page_size;
+	int idx;
+	int num_tasks;
+};
+
+void *prefault_pages(void *arg)
+{
+	prefault_task *task = (prefault_task *) arg;
+	// Writing a byte to a huge page makes the kernel allocate and zero it.
+	for (size_t i = task->idx; i < task->num_pages; i += task->num_tasks)
+		task->addr[i * task->page_size] = 0;
+	return NULL;
+}
+
+}
+
+huge_page_arena::ptr huge_page_arena::create(size_t size,
+		size_t huge_page_size, int node_id, bool prefault)
+{
+	size = ROUNDUP(size, huge_page_size);
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+	flags |= (__builtin_ctzl(huge_page_size) << MAP_HUGE_SHIFT);
+	void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return ptr();
+	}
+#ifdef USE_NUMA
+	if (node_id >= 0)
+		numa_tonode_memory(addr, size, node_id);
+#endif
+	ptr arena(new huge_page_arena((char *) addr, size, huge_page_size));
+	if (prefault)
+		arena->prefault();
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"reserve %1% bytes in %2%-byte huge pages on node %3%")
+		% size % huge_page_size % node_id;
+	return arena;
+}
+
+void huge_page_arena::prefault()
+{
+	size_t num_pages = size / huge_page_size;
+	int num_tasks = sysconf(_SC_NPROCESSORS_ONLN);
+	if (num_tasks <= 0)
+		num_tasks = 1;
+	if ((size_t) num_tasks > num_pages)
+		num_tasks = num_pages;
+	std::vector<prefault_task> tasks(num_tasks);
+	std::vector<pthread_t> ids(num_tasks);
+	std::vector<bool> started(num_tasks);
+	for (int i = 0; i < num_tasks; i++) {
+		tasks[i].addr = addr;
+		tasks[i].num_pages = num_pages;
+		tasks[i].page_size = huge_page_size;
+		tasks[i].idx = i;
+		tasks[i].num_tasks = num_tasks;
+		started[i] = pthread_create(&ids[i], NULL, prefault_pages,
+				&tasks[i]) == 0;
+		// We touch the pages of this task here.
+		if (!started[i])
+			prefault_pages(&tasks[i]);
+	}
+	for (int i = 0; i < num_tasks; i++)
+		if (started[i])
+			pthread_join(ids[i], NULL);
+}
+
+huge_page_arena::~huge_page_arena()
+{
+	munmap(addr, size);
+}
+
+char *huge_page_arena::alloc(size_t size)
+{
+	size_t off = alloc_off.load();
+	do {
+		if (off + size > this->size)
+			return NULL;
+	} while (!alloc_off.compare_exchange_weak(off, off + size));
+	return addr + off;
+}
+
+}
@@ -0,0 +1,92 @@
+#ifndef __SAFS_HUGE_PAGE_ARENA_H__
+#define __SAFS_HUGE_PAGE_ARENA_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+
+namespace safs
+{
+
+/*
+ * This arena reserves a contiguous range of memory backed by huge pages
+ * on a NUMA node and hands out chunks of it. The page cache uses it for
+ * its pages, so page lookups cause fewer TLB misses.
+ *
+ * The memory is allocated when the arena is created. If it's pre-faulted,
+ * multiple threads touch the huge pages in parallel, so the first accesses
+ * to the page cache don't need to wait for page faults.
+ * Chunks are never returned to the arena.
+ */
+class huge_page_arena
+{
+	char *addr;
+	size_t size;
+	size_t huge_page_size;
+	std::atomic<size_t> alloc_off;
+
+	huge_page_arena(char *addr, size_t size, size_t huge_page_size) {
+		this->addr = addr;
+		this->size = size;
+		this->huge_page_size = huge_page_size;
+		alloc_off = 0;
+	}
+
+	void prefault();
+public:
+	typedef std::shared_ptr<huge_page_arena> ptr;
+
+	/*
+	 * Create an arena of `size' bytes with huge pages of `huge_page_size'
+	 * bytes (2MB or 1GB) on the NUMA node. node_id is -1 if the memory
+	 * isn't bound to a NUMA node.
+	 * It returns NULL if there aren't enough huge pages in the system.
+	 */
+	static ptr create(size_t size, size_t huge_page_size, int node_id,
+			bool prefault);
+
+	~huge_page_arena();
+
+	/*
+	 * Allocate a chunk of memory from the arena.
+	 * It returns NULL if there isn't enough memory left in the arena.
+	 * It's thread-safe.
+	 */
+	char *alloc(size_t size);
+
+	bool contains(const char *buf) const {
+		return buf >= addr && buf < addr + size;
+	}
+
+	size_t get_size() const {
+		return size;
+	}
+
+	size_t get_huge_page_size() const {
+		return huge_page_size;
+	}
+};
+
+}
+
+#endif
@@ -17,6 +17,9 @@
  * limitations under the License.
  */
 
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
 #ifdef USE_NUMA
 #include <numa.h>
 #endif
@@ -59,6 +62,46 @@ public:
 	}
 };
 
+class munmap_delete
+{
+	size_t size;
+public:
+	munmap_delete(size_t size) {
+		this->size = size;
+	}
+
+	void operator()(char *buf) const {
+		munmap(buf, size);
+	}
+};
+
+struct populate_task
+{
+	const char *addr;
+	size_t length;
+	const NUMA_mapper *mapper;
+	int node_id;
+};
+
+void *populate_ranges(void *arg)
+{
+	populate_task *task = (populate_task *) arg;
+#ifdef USE_NUMA
+	// The pages of a file mapping are allocated on the NUMA node of
+	// the thread that reads them first.
+	numa_run_on_node(task->node_id);
+#endif
+	size_t range_size = task->mapper->get_range_size();
+	for (size_t off = 0; off < task->length; off += range_size) {
+		if (task->mapper->map2physical(off).first != task->node_id)
+			continue;
+		size_t end = std::min(off + range_size, task->length);
+		for (size_t pg_off = off; pg_off < end; pg_off += PAGE_SIZE)
+			*(volatile char *) (task->addr + pg_off);
+	}
+	return NULL;
+}
+
 }
 
 NUMA_buffer::NUMA_buffer(std::shared_ptr<char> data, size_t length,
@@ -123,6 +166,46 @@ NUMA_buffer::NUMA_buffer(size_t length,
 	}
 }
 
+NUMA_buffer::NUMA_buffer(char *mapped_addr, size_t length,
+		const NUMA_mapper &_mapper): mapper(_mapper)
+{
+	this->length = length;
+	// The mapping covers whole pages.
+	mapped = std::shared_ptr<char>(mapped_addr,
+			munmap_delete(ROUNDUP(length, PAGE_SIZE)));
+#ifdef USE_NUMA
+	// Place the data ranges in the NUMA nodes in the same way as
+	// the buffers allocated on the NUMA nodes.
+	if (mapper.get_num_nodes() > 1) {
+		for (size_t off = 0; off < length; off += mapper.get_range_size()) {
+			size_t size = std::min(mapper.get_range_size(), length - off);
+			numa_tonode_memory(mapped_addr + off, size,
+					mapper.map2physical(off).first);
+		}
+	}
+#endif
+}
+
+void NUMA_buffer::populate()
+{
+	std::vector<populate_task> tasks(mapper.get_num_nodes());
+	std::vector<pthread_t> ids(tasks.size());
+	std::vector<bool> started(tasks.size());
+	for (size_t i = 0; i < tasks.size(); i++) {
+		tasks[i].addr = mapped.get();
+		tasks[i].length = length;
+		tasks[i].mapper = &mapper;
+		tasks[i].node_id = i;
+		started[i] = pthread_create(&ids[i], NULL, populate_ranges,
+				&tasks[i]) == 0;
+		if (!started[i])
+			populate_ranges(&tasks[i]);
+	}
+	for (size_t i = 0; i < tasks.size(); i++)
+		if (started[i])
+			pthread_join(ids[i], NULL);
+}
+
 NUMA_buffer::data_loc_info NUMA_buffer::get_data_loc(off_t off,
 		size_t size) const
 {
@@ -160,6 +243,15 @@ NUMA_buffer::data_loc_info NUMA_buffer::get_data_loc(off_t off,
 
 NUMA_buffer::cdata_info NUMA_buffer::get_data(off_t off, size_t size) const
 {
+	if (mapped) {
+		if (off + size > length) {
+			fprintf(stderr, "data of %ld bytes in %ld exceeds length %ld\n",
+					size, off, length);
+			return cdata_info(NULL, 0);
+		}
+		return cdata_info(mapped.get() + off, size);
+	}
+
 	data_loc_info loc = get_data_loc(off, size);
 	if (loc.node_id < 0)
 		return cdata_info(NULL, 0);
@@ -169,6 +261,15 @@ NUMA_buffer::cdata_info NUMA_buffer::get_data(off_t off, size_t size) const
 
 NUMA_buffer::data_info NUMA_buffer::get_data(off_t off, size_t size)
 {
+	if (mapped) {
+		if (off + size > length) {
+			fprintf(stderr, "data of %ld bytes in %ld exceeds length %ld\n",
+					size, off, length);
+			return data_info(NULL, 0);
+		}
+		return data_info(mapped.get() + off, size);
+	}
+
 	data_loc_info loc = get_data_loc(off, size);
 	if (loc.node_id < 0)
 		return data_info(NULL, 0);
@@ -254,6 +355,44 @@ NUMA_buffer::ptr NUMA_buffer::load(const std::string &file_name,
 	return numa_buf;
 }
 
+NUMA_buffer::ptr NUMA_buffer::map(const std::string &file_name,
+		const NUMA_mapper &mapper, bool populate)
+{
+	native_file local_f(file_name);
+	if (!local_f.exist())
+		throw io_exception(boost::str(
+					boost::format("Linux file %1% doesn't exist") % file_name));
+
+	ssize_t file_size = local_f.get_size();
+	assert(file_size > 0);
+	int fd = open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw io_exception(boost::str(boost::format("can't open %1%: %2%")
+					% file_name % strerror(errno)));
+
+	// The buffer has the size of the file, while the mapping covers
+	// whole pages.
+	size_t length = ROUNDUP(file_size, PAGE_SIZE);
+	int flags = MAP_PRIVATE;
+	// If the data is on a single NUMA node, the kernel can read all pages
+	// when it creates the mapping. Otherwise, the pages need to be read
+	// by threads on the NUMA nodes where they should be placed.
+	if (populate && mapper.get_num_nodes() == 1)
+		flags |= MAP_POPULATE;
+	void *addr = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, fd, 0);
+	int err = errno;
+	close(fd);
+	if (addr == MAP_FAILED)
+		throw io_exception(boost::str(boost::format("can't mmap %1%: %2%")
+					% file_name % strerror(err)));
+
+	NUMA_buffer::ptr numa_buf(new NUMA_buffer((char *) addr, file_size,
+				mapper));
+	if (populate && mapper.get_num_nodes() > 1)
+		numa_buf->populate();
+	return numa_buf;
+}
+
 void NUMA_buffer::dump(const std::string &file_name)
 {
 	FILE *f = fopen(file_name.c_str(), "w");
@@ -449,7 +588,7 @@ void in_mem_io::process_req(const io_request &req)
 	// If the data in the buffer isn't stored in contiguous memory,
 	// we need to copy them to a piece of contiguous memory.
 	// This should happen very rarely if the range size in the NUMA mapper
-	// is very large. TODO but we can avoid the memory copy entirely.
+	// is very large, and it never happens if the buffer maps a file.
 	if (info.second < size) {
 		first_page = (char *) malloc(size);
 		data->copy_to(first_page, size, off);
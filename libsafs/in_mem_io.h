@@ -38,6 +38,10 @@ class NUMA_buffer
 	// This is the total length of the buffer.
 	size_t length;
 	NUMA_mapper mapper;
+	// If the buffer maps a file, the data is stored contiguously in
+	// the mapping and `bufs' is empty. The data ranges in the mapping
+	// are placed in the NUMA nodes chosen by the NUMA mapper.
+	std::shared_ptr<char> mapped;
 
 	struct data_loc_info {
 		int node_id;
@@ -53,6 +57,9 @@ class NUMA_buffer
 
 	NUMA_buffer(std::shared_ptr<char>, size_t length, const NUMA_mapper &mapper);
 	NUMA_buffer(size_t length, const NUMA_mapper &mapper);
+	NUMA_buffer(char *mapped_addr, size_t length, const NUMA_mapper &mapper);
+
+	void populate();
 public:
 	typedef std::pair<const char *, size_t> cdata_info;
 	typedef std::pair<char *, size_t> data_info;
@@ -63,6 +70,14 @@ public:
 	 */
 	static ptr load(const std::string &file, const NUMA_mapper &mapper);
 	static ptr load_safs(const std::string &file, const NUMA_mapper &mapper);
+	/*
+	 * Map a file to the buffer instead of reading it. The data isn't copied
+	 * and the pages are read from the file when they are accessed.
+	 * Writes to the buffer aren't written back to the file.
+	 * If `populate' is true, all pages are read before the function returns.
+	 */
+	static ptr map(const std::string &file, const NUMA_mapper &mapper,
+			bool populate);
 
 	static ptr create(std::shared_ptr<char>, size_t length,
 			const NUMA_mapper &mapper);
@@ -70,6 +85,10 @@ public:
 		return ptr(new NUMA_buffer(length, mapper));
 	}
 
+	/*
+	 * Get the buffer in the NUMA node. A buffer that maps a file
+	 * doesn't have buffers on individual NUMA nodes.
+	 */
 	std::shared_ptr<char> get_buf(int node_id) {
 		if ((size_t) node_id >= bufs.size())
 			return std::shared_ptr<char>();
@@ -85,6 +104,10 @@ public:
 		return length;
 	}
 
+	bool is_mapped() const {
+		return mapped != NULL;
+	}
+
 	/*
 	 * Get the data in the specified location.
 	 * Since the data in the buffer isn't stored contiguously, the size of
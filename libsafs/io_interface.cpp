@@ -19,12 +19,17 @@
 
 #include <assert.h>
 #include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
 #include <time.h>
 #include <pthread.h>
 
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
+#include <atomic>
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 
@@ -45,10 +50,54 @@
 #include "safs_file.h"
 #include "safs_exception.h"
 #include "direct_comp_access.h"
+#include "latency_histogram.h"
+#include "cache_warm.h"
 
 namespace safs
 {
 
+/*
+ * Write the latency histograms to a file. The histograms are written to
+ * a temporary file first, so a reader never sees a partial snapshot.
+ */
+static void write_stat_file(const std::string &file)
+{
+	std::string tmp_file = file + ".tmp";
+	FILE *f = fopen(tmp_file.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "fopen %s: %s\n", tmp_file.c_str(), strerror(errno));
+		return;
+	}
+	std::string report = get_latency_report();
+	fwrite(report.c_str(), report.size(), 1, f);
+	fclose(f);
+	if (rename(tmp_file.c_str(), file.c_str()) < 0)
+		fprintf(stderr, "rename %s: %s\n", tmp_file.c_str(), strerror(errno));
+}
+
+/*
+ * This thread writes the latency histograms to the statistics file
+ * periodically, so they can be polled while the program runs.
+ */
+class stat_writer_thread: public thread
+{
+	std::string file;
+	int interval;	// in ms
+public:
+	stat_writer_thread(const std::string &file,
+			int interval): thread("stat_writer", -1, false) {
+		this->file = file;
+		this->interval = interval;
+	}
+
+	void run() {
+		write_stat_file(file);
+		// We sleep a short time each time, so the thread can exit quickly.
+		for (int i = 0; i < interval && is_running(); i += 10)
+			usleep(10000);
+	}
+};
+
 /*
  * This global data collection is very static.
  * Once the data is initialized, no data needs to be changed.
@@ -71,6 +120,25 @@ struct global_data_collection
 	cache_config::ptr cache_conf;
 	page_cache::ptr global_cache;
 	std::vector<int> io_cpus;
+	// The callbacks that release memory under memory pressure,
+	// in the order of registration.
+	std::vector<mem_pressure_callback::ptr> mem_callbacks;
+	// The memory reserved by applications.
+	std::atomic<long> reserved_mem;
+	// It's set when the callbacks can't release more memory. Reserving
+	// memory doesn't ask them again until memory is returned or a new
+	// callback is registered.
+	std::atomic<bool> mem_exhausted;
+	// It protects the memory callbacks and resizing the page cache.
+	// Reserving memory within the budget doesn't need it.
+	pthread_mutex_t mem_mutex;
+	std::shared_ptr<stat_writer_thread> stat_writer;
+	// The names of the files accessed through the page cache.
+	// The key is the file ID.
+	std::map<int, std::string> cached_file_names;
+	// The pages saved in the previous run that haven't been read back
+	// to the page cache.
+	cached_page_map warm_pages;
 #ifdef PART_IO
 	// For part_global_cached_io
 	part_io_process_table *table;
@@ -80,7 +148,10 @@ struct global_data_collection
 #ifdef PART_IO
 		table = NULL;
 #endif
+		reserved_mem = 0;
+		mem_exhausted = false;
 		pthread_mutex_init(&mutex, NULL);
+		pthread_mutex_init(&mem_mutex, NULL);
 	}
 };
 
@@ -105,6 +176,88 @@ const RAID_config &get_sys_RAID_conf()
 	return *global_data.raid_conf;
 }
 
+/*
+ * This releases memory from the page cache under memory pressure.
+ */
+class cache_mem_pressure_callback: public mem_pressure_callback
+{
+	page_cache::ptr cache;
+public:
+	cache_mem_pressure_callback(page_cache::ptr cache) {
+		this->cache = cache;
+	}
+
+	virtual size_t release(size_t size) {
+		long orig_size = cache->size();
+		long new_size = cache->resize(std::max(0L, orig_size - (long) size));
+		return orig_size > new_size ? orig_size - new_size : 0;
+	}
+};
+
+/*
+ * Save the offsets of the pages in the page cache, so the next run can
+ * read them back.
+ */
+static void save_cache_warm_file(const std::string &file)
+{
+	std::vector<page_id_t> pg_ids;
+	global_data.global_cache->get_cached_pages(pg_ids);
+	std::vector<std::pair<std::string, off_t> > pages;
+	pthread_mutex_lock(&global_data.mutex);
+	for (size_t i = 0; i < pg_ids.size(); i++) {
+		auto it = global_data.cached_file_names.find(pg_ids[i].get_file_id());
+		if (it != global_data.cached_file_names.end())
+			pages.push_back(std::pair<std::string, off_t>(it->second,
+						pg_ids[i].get_offset()));
+	}
+	cached_page_map saved = merge_cached_pages(pages);
+	// We keep the pages of the files that weren't opened in this run.
+	saved.insert(global_data.warm_pages.begin(), global_data.warm_pages.end());
+	global_data.warm_pages.clear();
+	global_data.cached_file_names.clear();
+	pthread_mutex_unlock(&global_data.mutex);
+	if (save_cached_pages(file, saved))
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"save %1% cached pages of %2% files to %3%")
+			% pages.size() % saved.size() % file;
+}
+
+/*
+ * Read the pages of the file saved in the previous run back to the page
+ * cache. It's only done when the file is opened for the first time.
+ */
+static void warm_up_cache(file_io_factory::shared_ptr factory)
+{
+	// The maximal size of the data read in a warm-up step.
+	const size_t MAX_WARM_UP_SIZE = 16 * 1024 * 1024;
+
+	page_range_list ranges;
+	pthread_mutex_lock(&global_data.mutex);
+	global_data.cached_file_names[factory->get_file_id()] = factory->get_name();
+	auto it = global_data.warm_pages.find(factory->get_name());
+	if (it != global_data.warm_pages.end()) {
+		ranges.swap(it->second);
+		global_data.warm_pages.erase(it);
+	}
+	pthread_mutex_unlock(&global_data.mutex);
+	if (ranges.empty())
+		return;
+
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	global_cached_io &gio = (global_cached_io &) *io;
+	size_t tot_size = 0;
+	for (size_t i = 0; i < ranges.size(); i++) {
+		off_t end = ranges[i].first + ranges[i].second;
+		for (off_t off = ranges[i].first; off < end; off += MAX_WARM_UP_SIZE)
+			gio.warm_up(off, std::min((size_t) (end - off), MAX_WARM_UP_SIZE));
+		tot_size += ranges[i].second;
+	}
+	io->cleanup();
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"read %1% bytes of %2% back to the page cache in %3% ranges")
+		% tot_size % factory->get_name() % ranges.size();
+}
+
 void init_io_system(config_map::ptr configs, bool with_cache)
 {
 #ifdef ENABLE_MEM_TRACE
@@ -134,8 +287,9 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 		return;
 	}
 
-	// If we don't have libaio, we disable the initialization of SAFS.
-#ifdef USE_LIBAIO
+	// If we don't have libaio or liburing, we disable the initialization
+	// of SAFS.
+#if defined(USE_LIBAIO) || defined(USE_LIBURING)
 	if (!configs->has_option("root_conf"))
 		throw init_error("RAID config file doesn't exist");
 	std::string root_conf_file = configs->get_option("root_conf");
@@ -249,6 +403,16 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 		global_data.global_cache = global_data.cache_conf->create_cache(
 				MAX_NUM_FLUSHES_PER_FILE *
 				global_data.raid_conf->get_num_disks());
+		// Shrink the page cache when applications need the memory.
+		register_mem_pressure_callback(mem_pressure_callback::ptr(
+					new cache_mem_pressure_callback(global_data.global_cache)));
+
+		if (!params.get_cache_warm_file().empty()
+				&& !load_cached_pages(params.get_cache_warm_file(),
+					global_data.warm_pages))
+			BOOST_LOG_TRIVIAL(info) << boost::format(
+					"can't load the cached pages from %1%")
+				% params.get_cache_warm_file();
 
 		// The remote IO will never be used. It's only used for creating
 		// more remote IOs for flushing dirty pages, so it doesn't matter
@@ -269,9 +433,15 @@ void init_io_system(config_map::ptr configs, bool with_cache)
 					(NUMA_cache *) global_data.global_cache);
 	}
 #endif
+	if (global_data.stat_writer == NULL && !params.get_stat_file().empty()) {
+		global_data.stat_writer = std::shared_ptr<stat_writer_thread>(
+				new stat_writer_thread(params.get_stat_file(),
+					params.get_stat_interval()));
+		global_data.stat_writer->start();
+	}
 	pthread_mutex_unlock(&global_data.mutex);
 #else
-	throw init_error("There isn't libaio. SAFS isn't initialized.");
+	throw init_error("There isn't libaio or liburing. SAFS isn't initialized.");
 #endif
 }
 
@@ -286,6 +456,8 @@ void destroy_io_system()
 	}
 
 	BOOST_LOG_TRIVIAL(info) << "I/O system is destroyed";
+	if (global_data.global_cache && !params.get_cache_warm_file().empty())
+		save_cache_warm_file(params.get_cache_warm_file());
 	global_data.raid_conf.reset();
 	if (global_data.global_cache)
 		global_data.global_cache->sanity_check();
@@ -314,6 +486,13 @@ void destroy_io_system()
 	BOOST_LOG_TRIVIAL(info)
 		<< boost::format("I/O threads get %1% reads (%2% bytes) and %3% writes (%4% bytes)")
 		% num_reads % num_read_bytes % num_writes % num_write_bytes;
+	// The I/O threads have been destroyed, so the statistics file gets
+	// the final histograms.
+	global_data.stat_writer.reset();
+	if (!params.get_stat_file().empty())
+		write_stat_file(params.get_stat_file());
+	if (params.is_latency_stat())
+		BOOST_LOG_TRIVIAL(info) << "I/O latency:\n" << get_latency_report();
 
 #ifdef ENABLE_MEM_TRACE
 	BOOST_LOG_TRIVIAL(info) << boost::format("memleak: %1% objects and %2% bytes")
@@ -324,6 +503,20 @@ void destroy_io_system()
 #endif
 }
 
+/*
+ * The request objects that I/O instances allocate on the I/O path come
+ * from slab allocators. Most of them should be reused objects, so
+ * the allocators should rarely get memory from the OS.
+ */
+static void print_req_alloc_stat(const std::string &name, size_t num_allocs,
+		size_t num_chunks)
+{
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("%1% allocates %2% request objects from %3% slab chunks, %4% iovec arrays from the heap in total")
+		% name % num_allocs % num_chunks
+		% io_req_extension::get_num_vec_allocs();
+}
+
 class posix_io_factory: public file_io_factory
 {
 	int access_option;
@@ -381,6 +574,8 @@ class remote_io_factory: public file_io_factory
 	std::shared_ptr<slab_allocator> unbind_msg_allocator;
 	std::vector<std::shared_ptr<slab_allocator> > msg_allocators;
 	std::atomic_ulong tot_accesses;
+	std::atomic_ulong tot_req_allocs;
+	std::atomic_ulong tot_req_chunks;
 	// The number of existing IO instances.
 	std::atomic<size_t> num_ios;
 	file_mapper::ptr mapper;
@@ -407,11 +602,14 @@ public:
 	virtual void collect_stat(io_interface &io) {
 		remote_io &rio = (remote_io &) io;
 		tot_accesses += rio.get_num_reqs();
+		tot_req_allocs += rio.get_num_req_allocs();
+		tot_req_chunks += rio.get_num_req_chunks();
 	}
 
 	virtual void print_statistics() const {
 		BOOST_LOG_TRIVIAL(info) << boost::format("%1% gets %2% I/O accesses")
 			% mapper->get_name() % tot_accesses.load();
+		print_req_alloc_stat(get_name(), tot_req_allocs, tot_req_chunks);
 	}
 };
 
@@ -422,6 +620,9 @@ class global_cached_io_factory: public file_io_factory
 	std::atomic_ulong tot_pg_accesses;
 	std::atomic_ulong tot_hits;
 	std::atomic_ulong tot_fast_process;
+	std::atomic_ulong tot_read_ahead_pages;
+	std::atomic_ulong tot_req_allocs;
+	std::atomic_ulong tot_req_chunks;
 
 	page_cache::ptr global_cache;
 	remote_io_factory::shared_ptr remote_factory;
@@ -434,6 +635,9 @@ public:
 		tot_pg_accesses = 0;
 		tot_hits = 0;
 		tot_fast_process = 0;
+		tot_read_ahead_pages = 0;
+		tot_req_allocs = 0;
+		tot_req_chunks = 0;
 		remote_factory = remote_io_factory::shared_ptr(new remote_io_factory(mapper));
 	}
 
@@ -453,6 +657,9 @@ public:
 		tot_pg_accesses += gio.get_num_pg_accesses();
 		tot_hits += gio.get_cache_hits();
 		tot_fast_process += gio.get_num_fast_process();
+		tot_read_ahead_pages += gio.get_num_read_ahead_pages();
+		tot_req_allocs += gio.get_num_req_allocs();
+		tot_req_chunks += gio.get_num_req_chunks();
 	}
 
 	virtual void print_statistics() const {
@@ -462,6 +669,11 @@ public:
 		BOOST_LOG_TRIVIAL(info)
 			<< boost::format("There are %1% pages accessed, %2% cache hits, %3% of them are in the fast process")
 			% tot_pg_accesses.load() % tot_hits.load() % tot_fast_process.load();
+		if (params.get_read_ahead_max() > 0)
+			BOOST_LOG_TRIVIAL(info)
+				<< boost::format("%1% reads ahead %2% pages")
+				% get_name() % tot_read_ahead_pages.load();
+		print_req_alloc_stat(get_name(), tot_req_allocs, tot_req_chunks);
 	}
 };
 
@@ -472,6 +684,8 @@ class direct_comp_io_factory: public file_io_factory
 	// The number of bytes requested by applications.
 	std::atomic_ulong tot_req_bytes;
 	std::atomic_ulong tot_accesses;
+	std::atomic_ulong tot_req_allocs;
+	std::atomic_ulong tot_req_chunks;
 
 	remote_io_factory::shared_ptr remote_factory;
 public:
@@ -480,6 +694,8 @@ public:
 		tot_disk_bytes = 0;
 		tot_req_bytes = 0;
 		tot_accesses = 0;
+		tot_req_allocs = 0;
+		tot_req_chunks = 0;
 		remote_factory = remote_io_factory::shared_ptr(new remote_io_factory(mapper));
 	}
 
@@ -497,6 +713,8 @@ public:
 		tot_disk_bytes += dio.get_num_disk_bytes();
 		tot_req_bytes += dio.get_num_req_bytes();
 		tot_accesses += dio.get_num_reqs();
+		tot_req_allocs += dio.get_num_req_allocs();
+		tot_req_chunks += dio.get_num_req_chunks();
 	}
 
 	virtual void print_statistics() const {
@@ -504,6 +722,7 @@ public:
 			<< boost::format("%1% gets %2% async I/O accesses, %3% req bytes, %4% disk bytes")
 			% get_name() % tot_accesses.load() % tot_req_bytes.load()
 			% tot_disk_bytes.load();
+		print_req_alloc_stat(get_name(), tot_req_allocs, tot_req_chunks);
 	}
 };
 
@@ -588,6 +807,8 @@ remote_io_factory::remote_io_factory(file_mapper::ptr mapper): file_io_factory(
 				IO_MSG_SIZE * sizeof(io_request),
 				IO_MSG_SIZE * sizeof(io_request) * 1024, INT_MAX, -1));
 	tot_accesses = 0;
+	tot_req_allocs = 0;
+	tot_req_chunks = 0;
 	num_ios = 0;
 	int num_files = mapper->get_num_files();
 	assert((int) global_data.read_threads.size() == num_files);
@@ -633,6 +854,9 @@ io_interface::ptr global_cached_io_factory::create_io(thread *t)
 		scheduler = get_sched_creator()->create(underlying->get_node_id());
 	global_cached_io *io = new global_cached_io(t, underlying,
 			global_cache, scheduler);
+	// Read-ahead and warming up the cache don't read beyond the end of
+	// the file.
+	io->set_file_size(get_file_size());
 	return io_interface::ptr(io);
 }
 
@@ -704,6 +928,13 @@ file_io_factory::shared_ptr create_io_factory(const std::string &file_name,
 	}
 
 	file_mapper::ptr mapper = global_data.raid_conf->create_file_mapper(file_name);
+	// Only I/O threads decompress the blocks of a compressed file.
+	// The synchronous I/O would return the compressed bytes.
+	if ((access_option == READ_ACCESS || access_option == DIRECT_ACCESS)
+			&& mapper->get_compress_table())
+		throw io_exception((boost::format(
+						"%1% is compressed and can't be accessed with sync I/O")
+					% file_name).str());
 	file_io_factory *factory = NULL;
 	switch (access_option) {
 		case READ_ACCESS:
@@ -738,7 +969,10 @@ file_io_factory::shared_ptr create_io_factory(const std::string &file_name,
 		default:
 			throw io_exception("a wrong access option");
 	}
-	return file_io_factory::shared_ptr(factory, destroy_io_factory());
+	file_io_factory::shared_ptr ret(factory, destroy_io_factory());
+	if (access_option == GLOBAL_CACHE_ACCESS)
+		warm_up_cache(ret);
+	return ret;
 }
 
 io_interface::ptr create_io(file_io_factory::shared_ptr factory, thread *t)
@@ -757,6 +991,11 @@ void print_io_thread_stat()
 	}
 }
 
+void print_io_latency_stat()
+{
+	printf("%s", get_latency_report().c_str());
+}
+
 void print_io_summary()
 {
 	size_t num_reads = 0;
@@ -792,12 +1031,41 @@ atomic_integer io_interface::io_counter;
 
 io_interface::~io_interface()
 {
+	if (poll_wakeup_lat)
+		unregister_latency_hist("io-wait poll", poll_wakeup_lat);
+	if (sleep_wakeup_lat)
+		unregister_latency_hist("io-wait sleep", sleep_wakeup_lat);
 	if (io_factory) {
 		io_factory->collect_stat(*this);
 		io_factory->destroy_io(*this);
 	}
 }
 
+void io_interface::wait4activation()
+{
+	bool polled;
+	uint64_t lat = get_thread()->wait(get_poll_budget() * 1000UL, polled);
+	if (!params.is_latency_stat())
+		return;
+
+	// We keep the wake-up latency of polling and sleeping separately,
+	// so we can see how much polling helps.
+	if (polled) {
+		if (poll_wakeup_lat == NULL) {
+			poll_wakeup_lat = latency_histogram::ptr(new latency_histogram());
+			register_latency_hist("io-wait poll", poll_wakeup_lat);
+		}
+		poll_wakeup_lat->add(lat);
+	}
+	else {
+		if (sleep_wakeup_lat == NULL) {
+			sleep_wakeup_lat = latency_histogram::ptr(new latency_histogram());
+			register_latency_hist("io-wait sleep", sleep_wakeup_lat);
+		}
+		sleep_wakeup_lat->add(lat);
+	}
+}
+
 file_io_factory::file_io_factory(const std::string _name): name(_name)
 {
 	// It's possible that SAFS hasn't been initialized.
@@ -878,6 +1146,87 @@ const std::vector<int> &get_io_cpus()
 	return global_data.io_cpus;
 }
 
+void register_mem_pressure_callback(mem_pressure_callback::ptr cb)
+{
+	pthread_mutex_lock(&global_data.mem_mutex);
+	global_data.mem_callbacks.push_back(cb);
+	global_data.mem_exhausted = false;
+	pthread_mutex_unlock(&global_data.mem_mutex);
+}
+
+void unregister_mem_pressure_callback(mem_pressure_callback::ptr cb)
+{
+	pthread_mutex_lock(&global_data.mem_mutex);
+	auto it = std::find(global_data.mem_callbacks.begin(),
+			global_data.mem_callbacks.end(), cb);
+	if (it != global_data.mem_callbacks.end())
+		global_data.mem_callbacks.erase(it);
+	pthread_mutex_unlock(&global_data.mem_mutex);
+}
+
+long get_page_cache_size()
+{
+	if (global_data.global_cache)
+		return global_data.global_cache->size();
+	else
+		return 0;
+}
+
+long resize_page_cache(long size)
+{
+	if (global_data.global_cache == NULL)
+		return 0;
+	size = std::min(size, params.get_cache_size());
+	pthread_mutex_lock(&global_data.mem_mutex);
+	long ret = global_data.global_cache->resize(size);
+	pthread_mutex_unlock(&global_data.mem_mutex);
+	return ret;
+}
+
+void reserve_memory(size_t size)
+{
+	long reserved = global_data.reserved_mem.fetch_add(size) + size;
+	long budget = params.get_mem_budget();
+	if (budget <= 0 || global_data.mem_exhausted.load()
+			|| get_page_cache_size() + reserved <= budget)
+		return;
+
+	// Only one thread asks the callbacks to release memory. The others
+	// don't wait for it because the memory is already reserved.
+	if (pthread_mutex_trylock(&global_data.mem_mutex) != 0)
+		return;
+	// Other threads may have released memory before we got the lock.
+	long excess = get_page_cache_size() + global_data.reserved_mem.load()
+		- budget;
+	for (size_t i = 0; i < global_data.mem_callbacks.size() && excess > 0; i++)
+		excess -= global_data.mem_callbacks[i]->release(excess);
+	if (excess > 0 && !global_data.mem_exhausted.exchange(true))
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"memory budget is exceeded by %1% bytes") % excess;
+	pthread_mutex_unlock(&global_data.mem_mutex);
+}
+
+/*
+ * The page cache only grows back when it can get this much memory back,
+ * so it isn't resized every time a small piece of memory is returned.
+ */
+static const long CACHE_REGROW_SIZE = 64L * 1024 * 1024;
+
+void release_memory(size_t size)
+{
+	long reserved = global_data.reserved_mem.fetch_sub(size) - size;
+	long budget = params.get_mem_budget();
+	if (budget <= 0)
+		return;
+	global_data.mem_exhausted = false;
+	if (global_data.global_cache == NULL)
+		return;
+
+	long cache_size = std::min(params.get_cache_size(), budget - reserved);
+	if (cache_size - get_page_cache_size() >= CACHE_REGROW_SIZE)
+		resize_page_cache(cache_size);
+}
+
 std::string get_supported_features()
 {
 	std::string ret;
@@ -892,6 +1241,12 @@ std::string get_supported_features()
 #else
 	ret += "-libaio ";
 #endif
+
+#ifdef USE_LIBURING
+	ret += "+io_uring ";
+#else
+	ret += "-io_uring ";
+#endif
 	return ret;
 }
 
@@ -33,6 +33,7 @@
 #include "io_request.h"
 #include "comm_exception.h"
 #include "safs_header.h"
+#include "latency_histogram.h"
 
 namespace safs
 {
@@ -141,6 +142,51 @@ enum {
 	DIRECT_COMP_ACCESS,
 };
 
+/**
+ * The hints of how the data accessed by an I/O instance is reused.
+ * The page cache uses them to keep pages that are read in one pass from
+ * evicting the pages that are accessed repeatedly.
+ */
+enum {
+	/**
+	 * The data is cached as usual. This is the default hint.
+	 */
+	ACCESS_HINT_NORMAL,
+	/**
+	 * The data is accessed randomly. It is cached as usual.
+	 */
+	ACCESS_HINT_RANDOM,
+	/**
+	 * The data is scanned sequentially and won't be accessed again soon.
+	 */
+	ACCESS_HINT_SEQUENTIAL,
+	/**
+	 * Each page of the data is accessed only once.
+	 */
+	ACCESS_HINT_REUSE_ONCE,
+};
+
+/**
+ * The priority classes of I/O instances. The I/O threads issue the requests
+ * of a higher class first, while the requests of a lower class are still
+ * issued when they have waited for longer than the deadline of the class.
+ */
+enum {
+	/**
+	 * Small latency-sensitive requests, e.g., of interactive queries.
+	 */
+	IO_CLASS_INTERACTIVE,
+	/**
+	 * This is the default class.
+	 */
+	IO_CLASS_NORMAL,
+	/**
+	 * Requests of background jobs, e.g., scanning a whole graph.
+	 */
+	IO_CLASS_BULK,
+	NUM_IO_CLASSES,
+};
+
 class file_io_factory;
 class io_select;
 
@@ -159,6 +205,17 @@ class io_interface
 	// This is an index for locating this IO object in a global table.
 	int io_idx;
 	int max_num_pending_ios;
+	int access_hint;
+	int io_class;
+	// The share of the I/O instance among the instances in the same class.
+	int io_weight;
+	// The time (us) the I/O instance polls for completed requests before
+	// it sleeps. A negative value means using the global parameter.
+	int poll_budget;
+	// The wake-up latency of waiting for completed requests. They are only
+	// created when latency_stat is enabled.
+	latency_histogram::ptr poll_wakeup_lat;
+	latency_histogram::ptr sleep_wakeup_lat;
 	static atomic_integer io_counter;
 	// Keep the I/O factory alive.
 	std::shared_ptr<file_io_factory> io_factory;
@@ -169,6 +226,10 @@ protected:
 		this->curr = t;
 		this->io_idx = io_counter.inc(1) - 1;
 		max_num_pending_ios = params.get_max_num_pending_ios();
+		access_hint = ACCESS_HINT_NORMAL;
+		io_class = IO_CLASS_NORMAL;
+		io_weight = 1;
+		poll_budget = -1;
 	}
 
 public:
@@ -230,6 +291,84 @@ public:
 		return get_max_num_pending_ios() - num_pending_ios();
 	}
 
+	/**
+	 * This method tells the I/O instance how the data it accesses
+	 * is going to be reused. Only the I/O instances that access data
+	 * through the page cache use the hint.
+	 * \param hint one of the access hints.
+	 */
+	void set_access_hint(int hint) {
+		this->access_hint = hint;
+	}
+
+	/**
+	 * This method gets the access hint of the I/O instance.
+	 * \return the access hint.
+	 */
+	int get_access_hint() const {
+		return access_hint;
+	}
+
+	/**
+	 * This method sets the priority class of the requests issued by
+	 * the I/O instance. The I/O threads share the disks among the I/O
+	 * instances in the same class in proportion to their weights.
+	 * \param io_class one of the I/O classes.
+	 * \param weight the share of the I/O instance in its class.
+	 */
+	virtual void set_io_priority(int io_class, int weight = 1) {
+		assert(io_class >= 0 && io_class < NUM_IO_CLASSES);
+		assert(weight > 0);
+		this->io_class = io_class;
+		this->io_weight = weight;
+	}
+
+	/**
+	 * This method gets the priority class of the I/O instance.
+	 * \return the I/O class.
+	 */
+	int get_io_class() const {
+		return io_class;
+	}
+
+	/**
+	 * This method gets the weight of the I/O instance in its class.
+	 * \return the weight.
+	 */
+	int get_io_weight() const {
+		return io_weight;
+	}
+
+	/**
+	 * This method sets the time that the I/O instance polls for completed
+	 * requests before it sleeps when it waits for I/O. Polling reduces
+	 * the latency of small requests at the cost of CPU.
+	 * \param us the time in microseconds. 0 means sleeping right away
+	 * and a negative value means using the global parameter `poll_budget'.
+	 */
+	void set_poll_budget(int us) {
+		this->poll_budget = us;
+	}
+
+	/**
+	 * This method gets the time that the I/O instance polls for completed
+	 * requests before it sleeps.
+	 * \return the time in microseconds.
+	 */
+	int get_poll_budget() const {
+		if (poll_budget >= 0)
+			return poll_budget;
+		else
+			return params.get_poll_budget();
+	}
+
+	/*
+	 * This waits until the thread of the I/O instance is activated, which
+	 * happens when requests are completed. It polls for the poll budget
+	 * before it sleeps.
+	 */
+	void wait4activation();
+
 	/**
 	 * This method returns the ID of the file being accessed by the IO
 	 * instance.
@@ -561,6 +700,25 @@ const std::vector<int> &get_io_cpus();
  */
 void print_io_thread_stat();
 
+/**
+ * This function prints the latency histograms of I/O requests in SAFS.
+ * The histograms are collected when `latency_stat' is enabled:
+ * - "io-thread-N queue": from when an application thread sends a request
+ *   to the I/O thread until the request is submitted to the kernel,
+ *   including the time in the message queues and the request scheduler.
+ * - "disk-N device" and "io-thread-N device": from the submission to
+ *   the kernel until the completion, per disk and per I/O thread.
+ * - "io-thread-N checksum": the time of verifying checksums.
+ * - "<thread> file-N cache-hit": from when a request is issued to
+ *   the page cache until it completes, for the requests served by
+ *   the cache directly. Each I/O instance of the page cache has its own.
+ * - "io-wait poll" and "io-wait sleep": the wake-up latency of threads
+ *   waiting for completed requests.
+ * get_latency_snapshot() in latency_histogram.h gets the histograms
+ * while the program runs.
+ */
+void print_io_latency_stat();
+
 /**
  * This function prints the summary info on I/O statistics in the system.
  */
@@ -582,6 +740,77 @@ void set_file_weight(const std::string &file_name, int weight);
  */
 std::string get_supported_features();
 
+/**
+ * This is invoked when SAFS needs memory back from a component to keep
+ * the page cache and the memory reserved by applications within
+ * the memory budget (`mem_budget').
+ */
+class mem_pressure_callback
+{
+public:
+	typedef std::shared_ptr<mem_pressure_callback> ptr;
+
+	virtual ~mem_pressure_callback() {
+	}
+
+	/**
+	 * The component should release the memory it can do without.
+	 * The callback is invoked while the memory budget is locked, so it
+	 * can't reserve or release memory in the budget.
+	 * \param size the number of bytes requested.
+	 * \return the number of bytes released.
+	 */
+	virtual size_t release(size_t size) = 0;
+};
+
+/**
+ * This function registers a callback to release memory under memory
+ * pressure. The callbacks are asked in the order of registration.
+ * The page cache registers its callback when SAFS is initialized.
+ * \param cb the callback.
+ */
+void register_mem_pressure_callback(mem_pressure_callback::ptr cb);
+
+/**
+ * This function unregisters a callback registered before.
+ * \param cb the callback.
+ */
+void unregister_mem_pressure_callback(mem_pressure_callback::ptr cb);
+
+/**
+ * An application reserves memory from the memory budget before it uses
+ * a large piece of memory. If the page cache and the reserved memory
+ * exceed the budget, the registered callbacks are asked to release memory.
+ * Reserving memory within the budget only updates an atomic counter.
+ * The memory is always reserved, even if the callbacks can't bring
+ * the memory back within the budget. In that case, the callbacks aren't
+ * asked again until some memory is returned.
+ * It does nothing if there isn't a memory budget.
+ * \param size the number of bytes to reserve.
+ */
+void reserve_memory(size_t size);
+
+/**
+ * An application returns the memory reserved before. The page cache grows
+ * back if the budget allows.
+ * \param size the number of bytes to return.
+ */
+void release_memory(size_t size);
+
+/**
+ * This function changes the size of the page cache at runtime.
+ * The page cache can't grow larger than `cache_size', and it may not
+ * shrink to the requested size.
+ * \param size the new size of the page cache in bytes.
+ * \return the actual size of the page cache in bytes.
+ */
+long resize_page_cache(long size);
+
+/**
+ * This function gets the current size of the page cache in bytes.
+ */
+long get_page_cache_size();
+
 }
 
 #endif
@@ -17,13 +17,24 @@
  * limitations under the License.
  */
 
+#include <boost/format.hpp>
+
+#include "log.h"
 #include "io_request.h"
 #include "cache.h"
 #include "io_interface.h"
+#include "safs_exception.h"
 
 namespace safs
 {
 
+static atomic_number<size_t> num_vec_allocs;
+
+size_t io_req_extension::get_num_vec_allocs()
+{
+	return num_vec_allocs.get();
+}
+
 void *io_buf::get_buf() const
 {
 	if (is_page)
@@ -63,6 +74,7 @@ void io_request::init(char *buf, const data_loc_t &loc, ssize_t size,
 	// by default, a request is of high priority.
 	assert(node_id <= MAX_NODE_ID);
 	this->node_id = node_id;
+	this->create_time = 0;
 }
 
 int io_request::get_overlap_size(thread_safe_page *pg) const
@@ -84,12 +96,14 @@ void io_req_extension::add_io_buf(const io_buf &buf)
 		if (vec_pointer == embedded_vecs) {
 			vec_capacity = MIN_NUM_ALLOC_IOVECS;
 			vec_pointer = new io_buf[vec_capacity];
+			num_vec_allocs.inc(1);
 			memcpy(vec_pointer, embedded_vecs,
 					sizeof(embedded_vecs[0]) * NUM_EMBEDDED_IOVECS);
 		}
 		else {
 			vec_capacity *= 2;
 			io_buf *tmp = new io_buf[vec_capacity];
+			num_vec_allocs.inc(1);
 			memcpy(tmp, vec_pointer,
 					sizeof(vec_pointer[0]) * vec_capacity / 2);
 			delete [] vec_pointer;
@@ -114,12 +128,14 @@ void io_req_extension::add_buf_front(char *buf, int size, bool is_page)
 		if (vec_pointer == embedded_vecs) {
 			vec_capacity = MIN_NUM_ALLOC_IOVECS;
 			vec_pointer = new io_buf[vec_capacity];
+			num_vec_allocs.inc(1);
 			memcpy(vec_pointer + 1, embedded_vecs,
 					sizeof(embedded_vecs[0]) * NUM_EMBEDDED_IOVECS);
 		}
 		else {
 			vec_capacity *= 2;
 			io_buf *tmp = new io_buf[vec_capacity];
+			num_vec_allocs.inc(1);
 			memcpy(tmp + 1, vec_pointer,
 					sizeof(vec_pointer[0]) * vec_capacity / 2);
 			delete [] vec_pointer;
@@ -151,6 +167,14 @@ int user_compute::fetch_requests(io_interface *io, user_comp_req_queue &reqs,
 	return num_issues;
 }
 
+void user_compute::fail(const request_range &range)
+{
+	BOOST_LOG_TRIVIAL(error) << boost::format(
+			"can't read %1% bytes at %2% in file %3% for a user task")
+		% range.get_size() % range.get_loc().get_offset()
+		% range.get_loc().get_file_id();
+}
+
 bool user_compute::fetch_request(io_interface *io, io_request &req)
 {
 	if (!has_requests())
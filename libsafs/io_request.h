@@ -24,6 +24,7 @@
 #include <sys/uio.h>
 #include <sys/time.h>
 #include <limits.h>
+#include <stdint.h>
 
 #include <algorithm>
 #include <queue>
@@ -150,6 +151,11 @@ public:
 		return issue_time;
 	}
 
+	/*
+	 * The number of iovec arrays allocated from the heap by all extensions.
+	 */
+	static size_t get_num_vec_allocs();
+
 	void add_io_buf(const io_buf &buf);
 	void add_buf(char *buf, int size, bool is_page);
 	void add_buf_front(char *buf, int size, bool is_page);
@@ -330,6 +336,7 @@ public:
 	 */
 	user_compute(compute_allocator *alloc) {
 		this->alloc = alloc;
+		num_refs = 0;
 	}
 
 	/**
@@ -365,6 +372,17 @@ public:
 	 */
 	virtual void run(page_byte_array &arr) = 0;
 
+	/**
+	 * This method is invoked instead of run() if SAFS can't read correct
+	 * data for the I/O request, e.g., the data is corrupted on disks.
+	 * It runs in the thread that owns the I/O instance, so it shouldn't
+	 * throw exceptions. By default, it only logs an error. A user task
+	 * should override it to account for the request, so that it can still
+	 * complete.
+	 * \param range the I/O request that failed.
+	 */
+	virtual void fail(const request_range &range);
+
 	/**
 	 * This method indicates whether the user task has been completed.
 	 * \return whether the user task has been completed.
@@ -514,8 +532,13 @@ class io_request
 	unsigned int high_prio: 1;
 	unsigned int low_latency: 1;
 	unsigned int discarded: 1;
+	// The I/O thread couldn't deliver correct data for the request.
+	unsigned int failed: 1;
 	unsigned int node_id: 8;
 	int file_id;
+	// The time (ns) when the request enters SAFS. It's only set when
+	// latency_stat is enabled, and 0 means it isn't set.
+	uint64_t create_time;
 
 	io_interface *io;
 	void *user_data;
@@ -544,6 +567,7 @@ class io_request
 		high_prio = 1;
 		low_latency = 0;
 		discarded = 0;
+		failed = 0;
 	}
 
 	void copy_flags(const io_request &req) {
@@ -659,6 +683,7 @@ public:
 		}
 		copy_flags(req);
 		this->user_data = req.user_data;
+		this->create_time = req.create_time;
 	}
 
 	void init() {
@@ -681,6 +706,7 @@ public:
 		access_method = 0;
 		set_int_buf_size(0);
 		user_data = NULL;
+		create_time = 0;
 	}
 
 	void init(char *buf, const data_loc_t &loc, ssize_t size,
@@ -759,6 +785,19 @@ public:
 		this->discarded = discarded;
 	}
 
+	/*
+	 * A request fails if its data is corrupted on the disks, e.g.,
+	 * a checksum mismatch or a compressed block that can't be decompressed.
+	 * The data in the buffers of a failed request shouldn't be used.
+	 */
+	bool is_failed() const {
+		return (failed & 0x1) == 1;
+	}
+
+	void set_failed(bool failed) {
+		this->failed = failed;
+	}
+
 	bool is_high_prio() const {
 		return (high_prio & 0x1) == 1;
 	}
@@ -767,6 +806,14 @@ public:
 		this->high_prio = high_prio;
 	}
 
+	uint64_t get_create_time() const {
+		return create_time;
+	}
+
+	void set_create_time(uint64_t time) {
+		this->create_time = time;
+	}
+
 	bool is_low_latency() const {
 		return (low_latency & 0x1) == 1;
 	}
@@ -948,7 +995,6 @@ public:
 		off_t req_off;
 		char *req_buf;
 		ssize_t req_size;
-		assert(get_num_bufs() == 1);
 		// We have to make sure the extracted range has overlap with
 		// the input request.
 		bool check = has_overlap(off, size);
@@ -956,6 +1002,10 @@ public:
 			fprintf(stderr, "req %lx, size: %lx, page off: %lx\n",
 					this->get_offset(), this->get_size(), off);
 		assert(check);
+		if (get_num_bufs() > 1) {
+			extract_bufs(off, size, extracted);
+			return;
+		}
 		// this is the first page in the request.
 		if (off <= this->get_offset()) {
 			req_off = this->get_offset();
@@ -976,6 +1026,31 @@ public:
 				this->get_io(), this->get_node_id());
 	}
 
+	/*
+	 * Extract a request from a request with multiple buffers. The extracted
+	 * request has to be an extended request, and it gets the parts of
+	 * the buffers in the range [off, off + size).
+	 */
+	void extract_bufs(off_t off, int size, io_request &extracted) const {
+		assert(extracted.is_extended_req());
+		off_t start = max(off, this->get_offset());
+		off_t end = min(off + size, this->get_offset() + this->get_size());
+		data_loc_t loc(this->get_file_id(), start);
+		extracted.init(NULL, loc, 0, this->get_access_method(),
+				this->get_io(), this->get_node_id());
+		off_t buf_start = this->get_offset();
+		for (int i = 0; i < get_num_bufs() && buf_start < end; i++) {
+			off_t buf_end = buf_start + get_buf_size(i);
+			if (buf_end > start) {
+				off_t part_start = max(buf_start, start);
+				off_t part_end = min(buf_end, end);
+				extracted.add_buf(get_buf(i) + (part_start - buf_start),
+						part_end - part_start);
+			}
+			buf_start = buf_end;
+		}
+	}
+
 	/*
 	 * We need to serialize an io request to a buffer so it can be sent to
 	 * another thread.
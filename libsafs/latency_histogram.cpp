@@ -0,0 +1,188 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include <algorithm>
+
+#include <boost/format.hpp>
+
+#include "latency_histogram.h"
+
+namespace safs
+{
+
+uint64_t latency_histogram::get_bucket_max(int idx)
+{
+	if (idx < NUM_SUB_BUCKETS)
+		return idx;
+	int exp = idx / NUM_SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	uint64_t sub = idx % NUM_SUB_BUCKETS;
+	uint64_t unit = 1UL << (exp - SUB_BUCKET_BITS);
+	return ((NUM_SUB_BUCKETS + sub) << (exp - SUB_BUCKET_BITS)) + unit - 1;
+}
+
+void latency_histogram::reset()
+{
+	for (int i = 0; i < NUM_BUCKETS; i++)
+		counts[i].store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+void latency_histogram::merge(const latency_histogram &hist)
+{
+	for (int i = 0; i < NUM_BUCKETS; i++) {
+		uint64_t num = hist.counts[i].load(std::memory_order_relaxed);
+		if (num > 0)
+			inc(counts[i], num);
+	}
+	inc(count, hist.count.load(std::memory_order_relaxed));
+	inc(sum, hist.sum.load(std::memory_order_relaxed));
+	if (hist.get_max() > get_max())
+		max.store(hist.get_max(), std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::get_percentile(double percent) const
+{
+	// The histogram may be updated when we read it, so we compute
+	// the total count from the buckets.
+	uint64_t tot = 0;
+	for (int i = 0; i < NUM_BUCKETS; i++)
+		tot += counts[i].load(std::memory_order_relaxed);
+	if (tot == 0)
+		return 0;
+
+	uint64_t target = tot * percent / 100;
+	if (target == 0)
+		target = 1;
+	uint64_t num = 0;
+	for (int i = 0; i < NUM_BUCKETS; i++) {
+		num += counts[i].load(std::memory_order_relaxed);
+		if (num >= target)
+			return std::min(get_bucket_max(i), get_max());
+	}
+	return get_max();
+}
+
+std::string latency_histogram::to_string() const
+{
+	return (boost::format(
+				"count: %1%, avg: %2$.1fus, p50: %3$.1fus, p90: %4$.1fus, p99: %5$.1fus, p99.9: %6$.1fus, max: %7$.1fus")
+			% get_count() % (get_avg() / 1000.0)
+			% (get_percentile(50) / 1000.0) % (get_percentile(90) / 1000.0)
+			% (get_percentile(99) / 1000.0) % (get_percentile(99.9) / 1000.0)
+			% (get_max() / 1000.0)).str();
+}
+
+namespace
+{
+
+struct latency_registry
+{
+	pthread_mutex_t lock;
+	std::multimap<std::string, latency_histogram::ptr> active;
+	// The values of the unregistered histograms.
+	std::map<std::string, latency_histogram::ptr> retired;
+
+	latency_registry() {
+		pthread_mutex_init(&lock, NULL);
+	}
+};
+
+/*
+ * The registry is never freed, so histograms can be unregistered when
+ * static objects are destroyed at exit.
+ */
+latency_registry &get_registry()
+{
+	static latency_registry *registry = new latency_registry();
+	return *registry;
+}
+
+}
+
+void register_latency_hist(const std::string &name,
+		latency_histogram::ptr hist)
+{
+	latency_registry &registry = get_registry();
+	pthread_mutex_lock(&registry.lock);
+	registry.active.insert(std::pair<std::string, latency_histogram::ptr>(
+				name, hist));
+	pthread_mutex_unlock(&registry.lock);
+}
+
+void unregister_latency_hist(const std::string &name,
+		latency_histogram::ptr hist)
+{
+	latency_registry &registry = get_registry();
+	pthread_mutex_lock(&registry.lock);
+	auto range = registry.active.equal_range(name);
+	for (auto it = range.first; it != range.second; it++) {
+		if (it->second == hist) {
+			registry.active.erase(it);
+			break;
+		}
+	}
+	auto it = registry.retired.find(name);
+	if (it == registry.retired.end())
+		it = registry.retired.insert(std::pair<std::string,
+				latency_histogram::ptr>(name, latency_histogram::ptr(
+						new latency_histogram()))).first;
+	it->second->merge(*hist);
+	pthread_mutex_unlock(&registry.lock);
+}
+
+std::map<std::string, latency_histogram::ptr> get_latency_snapshot()
+{
+	std::map<std::string, latency_histogram::ptr> snapshot;
+	latency_registry &registry = get_registry();
+	pthread_mutex_lock(&registry.lock);
+	for (auto it = registry.retired.begin(); it != registry.retired.end();
+			it++) {
+		latency_histogram::ptr hist(new latency_histogram());
+		hist->merge(*it->second);
+		snapshot.insert(std::pair<std::string, latency_histogram::ptr>(
+					it->first, hist));
+	}
+	for (auto it = registry.active.begin(); it != registry.active.end();
+			it++) {
+		auto sit = snapshot.find(it->first);
+		if (sit == snapshot.end())
+			sit = snapshot.insert(std::pair<std::string,
+					latency_histogram::ptr>(it->first, latency_histogram::ptr(
+							new latency_histogram()))).first;
+		sit->second->merge(*it->second);
+	}
+	pthread_mutex_unlock(&registry.lock);
+	return snapshot;
+}
+
+std::string get_latency_report()
+{
+	std::map<std::string, latency_histogram::ptr> snapshot
+		= get_latency_snapshot();
+	std::string report;
+	for (auto it = snapshot.begin(); it != snapshot.end(); it++)
+		report += it->first + ": " + it->second->to_string() + "\n";
+	return report;
+}
+
+}
@@ -0,0 +1,142 @@
+#ifndef __SAFS_LATENCY_HISTOGRAM_H__
+#define __SAFS_LATENCY_HISTOGRAM_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace safs
+{
+
+static inline uint64_t get_curr_time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/*
+ * This is a latency histogram with log-linear buckets, similar to
+ * HdrHistogram. Each power of two is divided into 16 buckets, so the error
+ * of a percentile is within 1/16 of the value.
+ *
+ * Only one thread adds values to a histogram, but other threads can
+ * read it at any time to take a snapshot.
+ */
+class latency_histogram
+{
+	static const int SUB_BUCKET_BITS = 4;
+	static const int NUM_SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * NUM_SUB_BUCKETS;
+
+	std::atomic<uint64_t> counts[NUM_BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> max;
+
+	static void inc(std::atomic<uint64_t> &v, uint64_t delta) {
+		// There is only one writer, so we don't need an atomic instruction.
+		v.store(v.load(std::memory_order_relaxed) + delta,
+				std::memory_order_relaxed);
+	}
+
+	static int get_bucket(uint64_t v) {
+		if (v < (uint64_t) NUM_SUB_BUCKETS)
+			return v;
+		int exp = 63 - __builtin_clzl(v);
+		int sub = (v >> (exp - SUB_BUCKET_BITS)) & (NUM_SUB_BUCKETS - 1);
+		return (exp - SUB_BUCKET_BITS + 1) * NUM_SUB_BUCKETS + sub;
+	}
+
+	static uint64_t get_bucket_max(int idx);
+public:
+	typedef std::shared_ptr<latency_histogram> ptr;
+
+	latency_histogram() {
+		reset();
+	}
+
+	void reset();
+
+	/*
+	 * Add a latency in nanoseconds.
+	 */
+	void add(uint64_t ns) {
+		inc(counts[get_bucket(ns)], 1);
+		inc(count, 1);
+		inc(sum, ns);
+		if (ns > max.load(std::memory_order_relaxed))
+			max.store(ns, std::memory_order_relaxed);
+	}
+
+	/*
+	 * Add the values in another histogram to this one.
+	 */
+	void merge(const latency_histogram &hist);
+
+	uint64_t get_count() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	uint64_t get_max() const {
+		return max.load(std::memory_order_relaxed);
+	}
+
+	uint64_t get_avg() const {
+		uint64_t num = get_count();
+		return num == 0 ? 0 : sum.load(std::memory_order_relaxed) / num;
+	}
+
+	/*
+	 * Get the latency below which `percent' percent of values fall.
+	 */
+	uint64_t get_percentile(double percent) const;
+
+	/*
+	 * The summary of the histogram in microseconds.
+	 */
+	std::string to_string() const;
+};
+
+/*
+ * The histograms are registered by name, so they can be polled while
+ * the program runs. The histograms registered with the same name are
+ * merged in a snapshot. When a histogram is unregistered, its values are
+ * kept in the snapshots under its name.
+ */
+void register_latency_hist(const std::string &name,
+		latency_histogram::ptr hist);
+void unregister_latency_hist(const std::string &name,
+		latency_histogram::ptr hist);
+std::map<std::string, latency_histogram::ptr> get_latency_snapshot();
+/*
+ * A snapshot of all histograms in text, one histogram per line.
+ */
+std::string get_latency_report();
+
+}
+
+#endif
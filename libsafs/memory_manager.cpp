@@ -17,7 +17,15 @@
  * limitations under the License.
  */
 
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include <boost/format.hpp>
+
+#include "log.h"
 #include "memory_manager.h"
+#include "wpaio.h"
 
 namespace safs
 {
@@ -31,6 +39,36 @@ memory_manager::memory_manager(
 			INCREASE_SIZE <= max_size ? INCREASE_SIZE : max_size,
 			// We don't initialize pages but we pin pages.
 			max_size, node_id, false, true) {
+	long huge_page_size = params.get_cache_huge_page_size();
+	if (huge_page_size > 0) {
+		// The slab allocator allocates memory in chunks, so the arena
+		// should have space for the last chunk.
+		long chunk_size = std::min(INCREASE_SIZE, max_size);
+		arena = huge_page_arena::create(ROUNDUP(max_size, chunk_size),
+				huge_page_size, node_id, params.is_cache_prefault());
+		if (arena == NULL)
+			BOOST_LOG_TRIVIAL(warning) << boost::format(
+					"can't reserve huge pages for the page cache on node %1%")
+				% node_id;
+	}
+}
+
+char *memory_manager::alloc_chunk(long size)
+{
+	char *buf = NULL;
+	if (arena)
+		buf = arena->alloc(size);
+	// We fall back to normal pages if the arena runs out of memory.
+	if (buf == NULL)
+		buf = slab_allocator::alloc_chunk(size);
+	return buf;
+}
+
+void memory_manager::free_chunk(char *buf, long size)
+{
+	// The memory in the arena is freed with the arena.
+	if (arena == NULL || !arena->contains(buf))
+		slab_allocator::free_chunk(buf, size);
 }
 
 /**
@@ -40,6 +78,19 @@ memory_manager::memory_manager(
  */
 bool memory_manager::get_free_pages(int npages,
 		char **pages, page_cache *request_cache) {
+	// The released pages are used first.
+	int num_released = 0;
+	released_lock.lock();
+	while (num_released < npages && !released_pages.empty()) {
+		pages[num_released++] = released_pages.back();
+		released_pages.pop_back();
+	}
+	released_lock.unlock();
+	if (num_released == npages)
+		return true;
+	pages += num_released;
+	npages -= num_released;
+
 	int ret = slab_allocator::alloc(pages, npages);
 	/* 
 	 * slab_allocator allocates either all required number of 
@@ -55,13 +106,12 @@ bool memory_manager::get_free_pages(int npages,
 				cache = caches[i];
 			}
 		}
-		if (cache == NULL)
-			return false;
 		/* 
 		 * if we are going to shrink the cache that requests
 		 * free pages, it just fails.
 		 */
-		if (request_cache == cache) {
+		if (cache == NULL || request_cache == cache) {
+			release_pages(num_released, pages - num_released);
 			return false;
 		}
 		int num_shrink = SHRINK_NPAGES;
@@ -69,6 +119,7 @@ bool memory_manager::get_free_pages(int npages,
 			num_shrink = npages;
 		char *buf[num_shrink];
 		if (!cache->shrink(num_shrink, buf)) {
+			release_pages(num_released, pages - num_released);
 			return false;
 		}
 		slab_allocator::free(buf, num_shrink);
@@ -82,4 +133,54 @@ void memory_manager::free_pages(int npages, char **pages) {
 	slab_allocator::free(pages, npages);
 }
 
+void memory_manager::release_pages(int npages, char **pages)
+{
+	if (npages == 0)
+		return;
+	// The fixed buffers registered in io_uring are pinned by the kernel,
+	// so we can't return their memory.
+	if (params.is_uring_fixed_bufs()) {
+		free_pages(npages, pages);
+		return;
+	}
+
+	// We can't return part of a huge page, so the pages in the arena are
+	// only freed. The pages allocated from normal memory when the arena
+	// ran out are returned to the OS.
+	std::vector<char *> sorted;
+	std::vector<char *> arena_pages;
+	for (int i = 0; i < npages; i++) {
+		if (arena && arena->contains(pages[i]))
+			arena_pages.push_back(pages[i]);
+		else
+			sorted.push_back(pages[i]);
+	}
+	if (!arena_pages.empty())
+		free_pages(arena_pages.size(), arena_pages.data());
+	if (sorted.empty())
+		return;
+
+	// We return contiguous pages to the OS together.
+	std::sort(sorted.begin(), sorted.end());
+	for (size_t i = 0; i < sorted.size(); ) {
+		size_t j = i + 1;
+		while (j < sorted.size() && sorted[j] == sorted[j - 1] + PAGE_SIZE)
+			j++;
+		if (madvise(sorted[i], (j - i) * PAGE_SIZE, MADV_DONTNEED) < 0)
+			perror("madvise");
+		i = j;
+	}
+	released_lock.lock();
+	released_pages.insert(released_pages.end(), sorted.begin(), sorted.end());
+	released_lock.unlock();
+}
+
+void memory_manager::add_buf(char *buf, long size)
+{
+	// Pages in the page cache are used for I/O all the time, so we can
+	// register them in the I/O engine in advance.
+	if (params.is_uring_fixed_bufs())
+		register_io_buf(buf, size);
+}
+
 }
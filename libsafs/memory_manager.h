@@ -24,6 +24,7 @@
 
 #include "cache.h"
 #include "slab_allocator.h"
+#include "huge_page_arena.h"
 
 namespace safs
 {
@@ -35,12 +36,23 @@ namespace safs
 class memory_manager: public slab_allocator
 {
 	std::vector<page_cache *> caches;
+	// The pages whose memory has been returned to the operating system.
+	// They are used first when the caches need pages again.
+	std::vector<char *> released_pages;
+	spin_lock released_lock;
+	// The huge pages where the pages are allocated.
+	// It's NULL if the page cache doesn't use huge pages.
+	huge_page_arena::ptr arena;
 
 	memory_manager(long max_size, int node_id);
 
 	~memory_manager() {
-		// TODO
+		free_chunks();
 	}
+protected:
+	virtual void add_buf(char *buf, long size);
+	virtual char *alloc_chunk(long size);
+	virtual void free_chunk(char *buf, long size);
 public:
 	static memory_manager *create(long max_size, int node_id) {
 		assert(node_id >= 0);
@@ -61,6 +73,17 @@ public:
 
 	bool get_free_pages(int npages, char **pages, page_cache *cache);
 	void free_pages(int npages, char **pages);
+	/*
+	 * Free the pages and return their memory to the operating system.
+	 */
+	void release_pages(int npages, char **pages);
+
+	long get_released_size() {
+		released_lock.lock();
+		long size = released_pages.size() * PAGE_SIZE;
+		released_lock.unlock();
+		return size;
+	}
 
 	long average_cache_size() {
 		return get_max_size() / caches.size();
@@ -524,6 +524,76 @@ public:
 	}
 };
 
+/*
+ * This sends I/O requests to an I/O thread through a single-producer
+ * single-consumer ring. It buffers requests locally and moves them to
+ * the ring when it's flushed. If the ring is full, the remaining requests
+ * stay in the local buffer until the next flush.
+ * The sender can only be used in the thread that owns the ring.
+ */
+class request_ring_sender
+{
+	static const int INIT_BUF_SIZE = 64;
+
+	spsc_queue<io_request> *ring;
+	fifo_queue<io_request> buf;
+
+	request_ring_sender(int node_id,
+			spsc_queue<io_request> *ring): buf(node_id, INIT_BUF_SIZE, true) {
+		this->ring = ring;
+	}
+public:
+	static request_ring_sender *create(int node_id,
+			spsc_queue<io_request> *ring) {
+		return new request_ring_sender(node_id, ring);
+	}
+
+	static void destroy(request_ring_sender *s) {
+		delete s;
+	}
+
+	int send_cached(io_request *reqs, int num = 1) {
+		if (buf.get_num_remaining() < num)
+			buf.expand_queue(buf.get_num_entries() + num);
+		return buf.add(reqs, num);
+	}
+
+	/*
+	 * This returns the number of requests moved to the ring.
+	 */
+	int flush() {
+		int num_flushed = 0;
+		io_request reqs[INIT_BUF_SIZE];
+		while (!buf.is_empty()) {
+			// We can't fetch more requests from the local buffer than
+			// the ring can take.
+			int num = min(INIT_BUF_SIZE,
+					ring->get_size() - ring->get_num_entries());
+			if (num == 0)
+				break;
+			num = buf.fetch(reqs, num);
+			BOOST_VERIFY(ring->add(reqs, num) == num);
+			num_flushed += num;
+		}
+		return num_flushed;
+	}
+
+	/*
+	 * Take the requests that haven't been moved to the ring.
+	 */
+	int fetch_remaining(io_request *reqs, int num) {
+		return buf.fetch(reqs, num);
+	}
+
+	int get_num_remaining() {
+		return buf.get_num_entries();
+	}
+
+	spsc_queue<io_request> *get_ring() const {
+		return ring;
+	}
+};
+
 }
 
 #endif
@@ -37,6 +37,7 @@ str2int RAID_options[] = {
 	{"RAID0", RAID0},
 	{"RAID5", RAID5},
 	{"HASH", HASH},
+	{"WEIGHTED", WEIGHTED},
 };
 
 str2int cache_types[] = {
@@ -48,6 +49,16 @@ str2int cache_types[] = {
 	{ "gclock", GCLOCK_CACHE },
 };
 
+str2int cache_policies[] = {
+	{"gclock", CACHE_POLICY_GCLOCK},
+	{"adaptive", CACHE_POLICY_ADAPTIVE},
+};
+
+str2int io_engines[] = {
+	{"libaio", IO_ENGINE_LIBAIO},
+	{"io_uring", IO_ENGINE_URING},
+};
+
 sys_parameters::sys_parameters()
 {
 	// By default, the block size is 256KB, i.e., 64 pages.
@@ -56,6 +67,7 @@ sys_parameters::sys_parameters()
 	SA_min_cell_size = 12;
 	io_depth_per_file = 32;
 	cache_type = ASSOCIATIVE_CACHE;
+	cache_policy = CACHE_POLICY_GCLOCK;
 	cache_size = 512 * 1024 * 1024;
 	RAID_mapping_option = RAID5;
 	use_virt_aio = false;
@@ -74,14 +86,44 @@ sys_parameters::sys_parameters()
 	// The number of I/O threads will be determined based on the number of SSDs.
 	num_io_threads = 0;
 	bind_io_thread = false;
+#if !defined(USE_LIBAIO) && defined(USE_LIBURING)
+	io_engine = IO_ENGINE_URING;
+#else
+	io_engine = IO_ENGINE_LIBAIO;
+#endif
+	uring_sqpoll = false;
+	uring_fixed_bufs = false;
+	mem_budget = 0;
+	io_coalesce_window = 0;
+	latency_stat = false;
+	stat_interval = 1000;
+	cache_huge_page_size = 0;
+	cache_prefault = false;
+	read_ahead_max = 0;
+	read_ahead_init = 128 * 1024;
+	in_mem_mmap = false;
+	in_mem_populate = false;
+	// A write of a few MB on an SSD takes a few milliseconds.
+	flush_lat_target = 10000;
+	checksum_block_size = 4096;
+	verify_checksum = 0;
+	poll_budget = 0;
+	// interactive: 1ms, normal: 10ms, bulk: 100ms.
+	io_class_deadlines.push_back(1000);
+	io_class_deadlines.push_back(10000);
+	io_class_deadlines.push_back(100000);
 }
 
 void sys_parameters::init(const std::map<std::string, std::string> &configs)
 {
 	str2int_map cache_map(cache_types, 
 			sizeof(cache_types) / sizeof(cache_types[0]));
+	str2int_map cache_policy_map(cache_policies,
+			sizeof(cache_policies) / sizeof(cache_policies[0]));
 	str2int_map RAID_option_map(RAID_options,
 			sizeof(RAID_options) / sizeof(RAID_options[0]));
+	str2int_map io_engine_map(io_engines,
+			sizeof(io_engines) / sizeof(io_engines[0]));
 	std::map<std::string, std::string>::const_iterator it;
 
 	it = configs.find("RAID_block_size");
@@ -107,6 +149,13 @@ void sys_parameters::init(const std::map<std::string, std::string> &configs)
 			throw std::invalid_argument("can't find the right cache type");
 	}
 
+	it = configs.find("cache_policy");
+	if(it != configs.end()) {
+		cache_policy = cache_policy_map.map(it->second);
+		if (cache_policy < 0)
+			throw std::invalid_argument("can't find the right cache policy");
+	}
+
 	it = configs.find("cache_size");
 	if(it != configs.end()) {
 		cache_size = str2size(it->second);
@@ -198,6 +247,150 @@ void sys_parameters::init(const std::map<std::string, std::string> &configs)
 	if (it != configs.end()) {
 		bind_io_thread = true;
 	}
+
+	it = configs.find("io_engine");
+	if (it != configs.end()) {
+		io_engine = io_engine_map.map(it->second);
+		if (io_engine < 0)
+			throw std::invalid_argument("can't find the right I/O engine");
+#ifndef USE_LIBAIO
+		if (io_engine == IO_ENGINE_LIBAIO)
+			throw std::invalid_argument("SAFS isn't compiled with libaio");
+#endif
+#ifndef USE_LIBURING
+		if (io_engine == IO_ENGINE_URING)
+			throw std::invalid_argument("SAFS isn't compiled with liburing");
+#endif
+	}
+
+	it = configs.find("uring_sqpoll");
+	if (it != configs.end()) {
+		uring_sqpoll = true;
+	}
+
+	it = configs.find("uring_fixed_bufs");
+	if (it != configs.end()) {
+		uring_fixed_bufs = true;
+	}
+
+	it = configs.find("mem_budget");
+	if (it != configs.end()) {
+		mem_budget = str2size(it->second);
+	}
+
+	it = configs.find("io_coalesce_window");
+	if (it != configs.end()) {
+		io_coalesce_window = atoi(it->second.c_str());
+		if (io_coalesce_window < 0)
+			throw std::invalid_argument(
+					"io_coalesce_window can't be negative");
+	}
+
+	it = configs.find("latency_stat");
+	if (it != configs.end()) {
+		latency_stat = true;
+	}
+
+	it = configs.find("stat_file");
+	if (it != configs.end()) {
+		stat_file = it->second;
+		// The statistics file shows the latency histograms.
+		latency_stat = true;
+	}
+
+	it = configs.find("stat_interval");
+	if (it != configs.end()) {
+		stat_interval = atoi(it->second.c_str());
+		if (stat_interval <= 0)
+			throw std::invalid_argument("stat_interval must be positive");
+	}
+
+	it = configs.find("cache_huge_page");
+	if (it != configs.end()) {
+		cache_huge_page_size = str2size(it->second);
+		if (cache_huge_page_size != 2 * 1024 * 1024
+				&& cache_huge_page_size != 1024 * 1024 * 1024)
+			throw std::invalid_argument(
+					"the huge page size of the page cache must be 2M or 1G");
+	}
+
+	it = configs.find("cache_prefault");
+	if (it != configs.end()) {
+		cache_prefault = true;
+	}
+
+	it = configs.find("read_ahead_max");
+	if (it != configs.end()) {
+		read_ahead_max = str2size(it->second);
+		if (read_ahead_max < 0)
+			throw std::invalid_argument("read_ahead_max can't be negative");
+	}
+
+	it = configs.find("read_ahead_init");
+	if (it != configs.end()) {
+		read_ahead_init = str2size(it->second);
+		if (read_ahead_init <= 0)
+			throw std::invalid_argument("read_ahead_init must be positive");
+	}
+
+	it = configs.find("cache_warm_file");
+	if (it != configs.end()) {
+		cache_warm_file = it->second;
+	}
+
+	it = configs.find("in_mem_mmap");
+	if (it != configs.end()) {
+		in_mem_mmap = true;
+	}
+
+	it = configs.find("in_mem_populate");
+	if (it != configs.end()) {
+		in_mem_populate = true;
+	}
+
+	it = configs.find("flush_lat_target");
+	if (it != configs.end()) {
+		flush_lat_target = atoi(it->second.c_str());
+		if (flush_lat_target < 0)
+			throw std::invalid_argument("flush_lat_target can't be negative");
+	}
+
+	it = configs.find("checksum_block");
+	if (it != configs.end()) {
+		checksum_block_size = str2size(it->second);
+		if (checksum_block_size < 0 || checksum_block_size % 512 != 0)
+			throw std::invalid_argument(
+					"checksum_block must be a multiple of 512 bytes");
+	}
+
+	it = configs.find("verify_checksum");
+	if (it != configs.end()) {
+		verify_checksum = atoi(it->second.c_str());
+		if (verify_checksum < 0)
+			throw std::invalid_argument("verify_checksum can't be negative");
+	}
+
+	it = configs.find("poll_budget");
+	if (it != configs.end()) {
+		poll_budget = atoi(it->second.c_str());
+		if (poll_budget < 0)
+			throw std::invalid_argument("poll_budget can't be negative");
+	}
+
+	it = configs.find("io_class_deadlines");
+	if (it != configs.end()) {
+		std::vector<std::string> strs;
+		split_string(it->second, ',', strs);
+		if (strs.size() != io_class_deadlines.size())
+			throw std::invalid_argument(
+					"io_class_deadlines needs a deadline for each I/O class");
+		for (size_t i = 0; i < strs.size(); i++) {
+			io_class_deadlines[i] = atoi(strs[i].c_str());
+			if (io_class_deadlines[i] <= 0)
+				throw std::invalid_argument(
+						"io_class_deadlines must be positive");
+		}
+	}
 }
 
 void sys_parameters::print()
@@ -207,6 +400,7 @@ void sys_parameters::print()
 	BOOST_LOG_TRIVIAL(info) << "\tSA_cell_size: " << SA_min_cell_size;
 	BOOST_LOG_TRIVIAL(info) << "\tio_depth:" << io_depth_per_file;
 	BOOST_LOG_TRIVIAL(info) << "\tcache_type: " << cache_type;
+	BOOST_LOG_TRIVIAL(info) << "\tcache_policy: " << cache_policy;
 	BOOST_LOG_TRIVIAL(info) << "\tcache_size: " << cache_size;
 	BOOST_LOG_TRIVIAL(info) << "\tRAID_mapping: " << RAID_mapping_option;
 	BOOST_LOG_TRIVIAL(info) << "\tvirt_aio: " << use_virt_aio;
@@ -224,14 +418,39 @@ void sys_parameters::print()
 	BOOST_LOG_TRIVIAL(info) << "\tbusy_wait: " << busy_wait;
 	BOOST_LOG_TRIVIAL(info) << "\tnum_io_threads: " << num_io_threads;
 	BOOST_LOG_TRIVIAL(info) << "\tbind_io_thread: " << bind_io_thread;
+	BOOST_LOG_TRIVIAL(info) << "\tio_engine: " << io_engine;
+	BOOST_LOG_TRIVIAL(info) << "\turing_sqpoll: " << uring_sqpoll;
+	BOOST_LOG_TRIVIAL(info) << "\turing_fixed_bufs: " << uring_fixed_bufs;
+	BOOST_LOG_TRIVIAL(info) << "\tmem_budget: " << mem_budget;
+	BOOST_LOG_TRIVIAL(info) << "\tio_coalesce_window: " << io_coalesce_window;
+	BOOST_LOG_TRIVIAL(info) << "\tlatency_stat: " << latency_stat;
+	BOOST_LOG_TRIVIAL(info) << "\tstat_file: " << stat_file;
+	BOOST_LOG_TRIVIAL(info) << "\tstat_interval: " << stat_interval;
+	BOOST_LOG_TRIVIAL(info) << "\tcache_huge_page: " << cache_huge_page_size;
+	BOOST_LOG_TRIVIAL(info) << "\tcache_prefault: " << cache_prefault;
+	BOOST_LOG_TRIVIAL(info) << "\tread_ahead_max: " << read_ahead_max;
+	BOOST_LOG_TRIVIAL(info) << "\tread_ahead_init: " << read_ahead_init;
+	BOOST_LOG_TRIVIAL(info) << "\tcache_warm_file: " << cache_warm_file;
+	BOOST_LOG_TRIVIAL(info) << "\tin_mem_mmap: " << in_mem_mmap;
+	BOOST_LOG_TRIVIAL(info) << "\tin_mem_populate: " << in_mem_populate;
+	BOOST_LOG_TRIVIAL(info) << "\tflush_lat_target: " << flush_lat_target;
+	BOOST_LOG_TRIVIAL(info) << "\tchecksum_block: " << checksum_block_size;
+	BOOST_LOG_TRIVIAL(info) << "\tverify_checksum: " << verify_checksum;
+	BOOST_LOG_TRIVIAL(info) << "\tpoll_budget: " << poll_budget;
+	BOOST_LOG_TRIVIAL(info) << boost::format("\tio_class_deadlines: %1%,%2%,%3%")
+		% io_class_deadlines[0] % io_class_deadlines[1] % io_class_deadlines[2];
 }
 
 void sys_parameters::print_help()
 {
 	str2int_map cache_map(cache_types, 
 			sizeof(cache_types) / sizeof(cache_types[0]));
+	str2int_map cache_policy_map(cache_policies,
+			sizeof(cache_policies) / sizeof(cache_policies[0]));
 	str2int_map RAID_option_map(RAID_options,
 			sizeof(RAID_options) / sizeof(RAID_options[0]));
+	str2int_map io_engine_map(io_engines,
+			sizeof(io_engines) / sizeof(io_engines[0]));
 
 	std::cout << "system parameters: " << std::endl;
 	std::cout << "\tRAID_block_size: x(k, K, m, M, g, G)" << std::endl;
@@ -240,6 +459,7 @@ void sys_parameters::print_help()
 		<< std::endl;
 	std::cout << "\thit_percent: the artificial cache hit rate (%)" << std::endl;
 	cache_map.print("\tcache_type: ");
+	cache_policy_map.print("\tcache_policy: ");
 	std::cout << "\tcache_size: x(k, K, m, M, g, G)" << std::endl;
 	RAID_option_map.print("\tRAID_mapping: ");
 	std::cout << "\tvirt_aio: enable virtual AIO for debugging and performance evaluation"
@@ -269,6 +489,45 @@ void sys_parameters::print_help()
 		<< std::endl;
 	std::cout << "\tbind_io_thread: determine whether to bind an I/O thread to a CPU core and use the core exclusivly."
 		<< std::endl;
+	io_engine_map.print("\tio_engine: ");
+	std::cout << "\turing_sqpoll: use a kernel thread to poll the io_uring submission queue"
+		<< std::endl;
+	std::cout << "\turing_fixed_bufs: register the page cache as fixed buffers in io_uring"
+		<< std::endl;
+	std::cout << "\tmem_budget: the memory shared by the page cache and applications x(k, K, m, M, g, G)"
+		<< std::endl;
+	std::cout << "\tio_coalesce_window: the number of requests of user tasks sorted and merged together"
+		<< std::endl;
+	std::cout << "\tlatency_stat: collect latency histograms of I/O requests"
+		<< std::endl;
+	std::cout << "\tstat_file: the file where latency histograms are written periodically"
+		<< std::endl;
+	std::cout << "\tstat_interval: the interval (ms) of writing latency histograms to stat_file"
+		<< std::endl;
+	std::cout << "\tcache_huge_page: the size of huge pages for the page cache (2M or 1G)"
+		<< std::endl;
+	std::cout << "\tcache_prefault: touch all huge pages of the page cache at startup"
+		<< std::endl;
+	std::cout << "\tread_ahead_max: the maximal read-ahead window of a stream (0 disables read-ahead)"
+		<< std::endl;
+	std::cout << "\tread_ahead_init: the initial read-ahead window of a stream"
+		<< std::endl;
+	std::cout << "\tcache_warm_file: the file where the cached pages are saved at exit and reloaded at startup"
+		<< std::endl;
+	std::cout << "\tin_mem_mmap: map in-memory data files instead of reading them to memory"
+		<< std::endl;
+	std::cout << "\tin_mem_populate: read all pages of the mapped in-memory data files at startup"
+		<< std::endl;
+	std::cout << "\tflush_lat_target: the target latency (us) of writing back dirty pages (10000 by default, 0 disables throttling)"
+		<< std::endl;
+	std::cout << "\tchecksum_block: the block size of the checksums computed when data is loaded; data written by I/O instances isn't covered (0 disables checksums)"
+		<< std::endl;
+	std::cout << "\tverify_checksum: verify the checksums of one in N reads from disks (0 disables verification)"
+		<< std::endl;
+	std::cout << "\tpoll_budget: the time (us) of polling for completed I/O before sleeping"
+		<< std::endl;
+	std::cout << "\tio_class_deadlines: the deadlines (us) of the interactive, normal and bulk I/O classes"
+		<< std::endl;
 }
 
 }
@@ -26,6 +26,7 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
 
 #define USE_GCLOCK
 
@@ -34,12 +35,31 @@
 namespace safs
 {
 
+/**
+ * The engines that I/O threads can use to issue asynchronous I/O to SSDs.
+ */
+enum {
+	IO_ENGINE_LIBAIO,
+	IO_ENGINE_URING,
+};
+
+/**
+ * The policies that a page set in the associative cache uses to select
+ * the page to evict.
+ */
+enum {
+	CACHE_POLICY_GCLOCK,
+	CACHE_POLICY_ADAPTIVE,
+};
+
 class sys_parameters
 {
 	int RAID_block_size;
 	int SA_min_cell_size;
 	int io_depth_per_file;
 	int cache_type;
+	// The eviction policy of the page sets in the associative cache.
+	int cache_policy;
 	long cache_size;
 	int RAID_mapping_option;
 	bool use_virt_aio;
@@ -60,6 +80,62 @@ class sys_parameters
 	// Bind a I/O thread to a specific CPU core and ensure no other threads
 	// to use this core.
 	bool bind_io_thread;
+	// The asynchronous I/O engine used by I/O threads.
+	int io_engine;
+	// Use a kernel thread to poll the submission queue of io_uring.
+	bool uring_sqpoll;
+	// Register the page cache memory as fixed buffers in io_uring.
+	bool uring_fixed_bufs;
+	// The memory shared by the page cache and the memory reserved by
+	// applications. 0 means there isn't a budget.
+	long mem_budget;
+	// The number of requests of user tasks that are sorted and merged
+	// together. 0 means requests of user tasks aren't coalesced.
+	int io_coalesce_window;
+	// Collect latency histograms of I/O requests.
+	bool latency_stat;
+	// The file where the latency histograms are written periodically.
+	std::string stat_file;
+	// The interval of writing the latency histograms in milliseconds.
+	int stat_interval;
+	// The size of huge pages for the page cache (2MB or 1GB).
+	// 0 means the page cache doesn't use huge pages.
+	long cache_huge_page_size;
+	// Touch all huge pages of the page cache at startup.
+	bool cache_prefault;
+	// The maximal size of the read-ahead window of a stream in bytes.
+	// 0 means the page cache doesn't read ahead.
+	long read_ahead_max;
+	// The initial size of the read-ahead window of a stream in bytes.
+	long read_ahead_init;
+	// The file where the offsets of the cached pages are saved at exit
+	// and loaded from at startup.
+	std::string cache_warm_file;
+	// Map the files of in-memory data instead of reading them to memory.
+	bool in_mem_mmap;
+	// Read all pages of the mapped files when they are mapped.
+	bool in_mem_populate;
+	// The target latency (us) of writing back dirty pages. The flusher
+	// reduces the number of pending flushes when the writes are slower.
+	// The flushes are issued in the bulk I/O class, so they wait behind
+	// the reads of the application and their latency grows when
+	// the devices are busy.
+	// 0 means the flusher isn't throttled by the write latency.
+	int flush_lat_target;
+	// The size of the blocks whose checksums are computed when data is
+	// loaded to SAFS. 0 means no checksums are computed. Data written
+	// through I/O instances never gets checksums.
+	long checksum_block_size;
+	// Verify the checksums of one in every `verify_checksum' reads from
+	// disks. 0 means the checksums aren't verified.
+	int verify_checksum;
+	// The time (us) a thread polls for completed I/O requests before it
+	// sleeps. 0 means the thread sleeps right away.
+	int poll_budget;
+	// The deadlines (us) of the I/O classes. The requests of a lower class
+	// are issued before the requests of higher classes when they have
+	// waited longer than the deadline of their class.
+	std::vector<int> io_class_deadlines;
 public:
 	sys_parameters();
 
@@ -89,6 +165,10 @@ public:
 		return cache_type;
 	}
 
+	int get_cache_policy() const {
+		return cache_policy;
+	}
+
 	long get_cache_size() const {
 		return cache_size;
 	}
@@ -153,6 +233,86 @@ public:
 	bool is_bind_io_thread() const {
 		return bind_io_thread;
 	}
+
+	int get_io_engine() const {
+		return io_engine;
+	}
+
+	bool is_uring_sqpoll() const {
+		return uring_sqpoll;
+	}
+
+	bool is_uring_fixed_bufs() const {
+		return uring_fixed_bufs;
+	}
+
+	long get_mem_budget() const {
+		return mem_budget;
+	}
+
+	int get_io_coalesce_window() const {
+		return io_coalesce_window;
+	}
+
+	bool is_latency_stat() const {
+		return latency_stat;
+	}
+
+	const std::string &get_stat_file() const {
+		return stat_file;
+	}
+
+	int get_stat_interval() const {
+		return stat_interval;
+	}
+
+	long get_cache_huge_page_size() const {
+		return cache_huge_page_size;
+	}
+
+	bool is_cache_prefault() const {
+		return cache_prefault;
+	}
+
+	long get_read_ahead_max() const {
+		return read_ahead_max;
+	}
+
+	long get_read_ahead_init() const {
+		return read_ahead_init;
+	}
+
+	const std::string &get_cache_warm_file() const {
+		return cache_warm_file;
+	}
+
+	bool is_in_mem_mmap() const {
+		return in_mem_mmap;
+	}
+
+	bool is_in_mem_populate() const {
+		return in_mem_populate;
+	}
+
+	int get_flush_lat_target() const {
+		return flush_lat_target;
+	}
+
+	long get_checksum_block_size() const {
+		return checksum_block_size;
+	}
+
+	int get_verify_checksum() const {
+		return verify_checksum;
+	}
+
+	int get_poll_budget() const {
+		return poll_budget;
+	}
+
+	const std::vector<int> &get_io_class_deadlines() const {
+		return io_class_deadlines;
+	}
 };
 
 extern sys_parameters params;
@@ -169,6 +329,11 @@ extern sys_parameters params;
  * It's in the number of I/O messages.
  */
 const int IO_QUEUE_SIZE = 10;
+/**
+ * The size of a ring between an application thread and an I/O thread.
+ * It's in the number of I/O requests.
+ */
+const int IO_RING_SIZE = 1024;
 const int MAX_FETCH_REQS = 3;
 const int AIO_COMPLETE_BUF_SIZE = 8;
 
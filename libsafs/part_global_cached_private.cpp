@@ -1094,7 +1094,7 @@ int part_global_cached_io::preload(off_t start, long size)
 		if (cache_conf->page2cache(pg_id) != get_node_id())
 			continue;
 		thread_safe_page *p = (thread_safe_page *) local_group->cache->search(
-					pg_id, old_id);
+					pg_id, old_id, get_access_hint());
 		// This is mainly for testing. I don't need to really read data from disks.
 		if (!p->data_ready()) {
 			p->set_io_pending(false);
@@ -1118,7 +1118,7 @@ int part_global_cached_io::wait4complete(int num_to_complete)
 	// But we don't want to be blocked.
 	underlying->wait4complete(0);
 	while (pending - num_pending_ios() < num_to_complete) {
-		get_thread()->wait();
+		wait4activation();
 		process_replies();
 		underlying->wait4complete(0);
 	}
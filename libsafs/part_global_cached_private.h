@@ -151,6 +151,10 @@ public:
 	virtual int get_file_id() const {
 		return underlying->get_file_id();
 	}
+	virtual void set_io_priority(int io_class, int weight) {
+		io_interface::set_io_priority(io_class, weight);
+		underlying->set_io_priority(io_class, weight);
+	}
 	virtual int wait4complete(int num);
 	virtual int num_pending_ios() const {
 		// the number of pending requests on the remote nodes.
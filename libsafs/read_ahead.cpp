@@ -0,0 +1,86 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "read_ahead.h"
+
+namespace safs
+{
+
+void stream_detector::grow_window(size_t req_size)
+{
+	// The window should cover at least one request.
+	size_t max_size = std::max(max_window, req_size);
+	if (window == 0)
+		window = std::max(init_window, req_size);
+	else
+		window *= 2;
+	window = std::min(window, max_size);
+}
+
+void stream_detector::access(off_t off, size_t size,
+		std::vector<range_t> &ranges)
+{
+	off_t curr_stride = off - last_off;
+	bool seq = curr_stride == (off_t) last_size;
+	bool strided = !seq && curr_stride > (off_t) size && curr_stride == stride;
+	// The access pattern is changed, so we start a new stream.
+	if (num_hits > 0 && seq != seq_stream)
+		reset();
+	if (seq || strided) {
+		if (num_hits == 0)
+			seq_stream = seq;
+		num_hits++;
+	}
+	else
+		reset();
+	stride = curr_stride;
+	last_off = off;
+	last_size = size;
+	if (num_hits < trigger)
+		return;
+
+	off_t end = off + size;
+	if (seq) {
+		if (ra_end < end)
+			ra_end = end;
+		// We still have enough data read ahead.
+		if (window > 0 && (size_t) (ra_end - end) >= window / 2)
+			return;
+		grow_window(size);
+		if (end + (off_t) window > ra_end) {
+			ranges.push_back(range_t(ra_end, end + window - ra_end));
+			ra_end = end + window;
+		}
+	}
+	else {
+		if (ra_end < off + stride)
+			ra_end = off + stride;
+		size_t num_ahead = (ra_end - off) / stride - 1;
+		if (window > 0 && num_ahead * size >= window / 2)
+			return;
+		grow_window(size);
+		size_t num_reqs = std::max<size_t>(window / size, 1);
+		for (; ra_end <= off + (off_t) num_reqs * stride; ra_end += stride)
+			ranges.push_back(range_t(ra_end, size));
+	}
+}
+
+}
@@ -0,0 +1,97 @@
+#ifndef __SAFS_READ_AHEAD_H__
+#define __SAFS_READ_AHEAD_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/types.h>
+
+#include <vector>
+#include <utility>
+
+namespace safs
+{
+
+/*
+ * This detects a sequential or strided stream of read requests to a file
+ * and decides the data to read ahead.
+ *
+ * A stream is detected after `trigger' requests follow the same pattern.
+ * The read-ahead window starts with `init_window' bytes (or the request
+ * size if it's larger) and doubles each time the application consumes
+ * half of the data read ahead, until it reaches `max_window' bytes.
+ * A request that breaks the pattern resets the stream, so random access
+ * doesn't read ahead.
+ */
+class stream_detector
+{
+public:
+	typedef std::pair<off_t, size_t> range_t;
+private:
+	const size_t init_window;
+	const size_t max_window;
+	const int trigger;
+
+	off_t last_off;
+	size_t last_size;
+	off_t stride;
+	int num_hits;
+	// Whether the current stream is sequential or strided.
+	bool seq_stream;
+	size_t window;
+	// For a sequential stream, this is where the data read ahead ends.
+	// For a strided stream, this is the location of the next request
+	// that hasn't been read ahead.
+	off_t ra_end;
+
+	void reset() {
+		num_hits = 0;
+		window = 0;
+		ra_end = 0;
+	}
+
+	void grow_window(size_t req_size);
+public:
+	stream_detector(size_t init_window, size_t max_window,
+			int trigger = 2): init_window(init_window),
+			max_window(max_window), trigger(trigger) {
+		last_off = -1;
+		last_size = 0;
+		stride = 0;
+		seq_stream = false;
+		reset();
+	}
+
+	/*
+	 * Record a read request, and add the ranges to read ahead to `ranges'.
+	 */
+	void access(off_t off, size_t size, std::vector<range_t> &ranges);
+
+	bool is_stream() const {
+		return num_hits >= trigger;
+	}
+
+	size_t get_window() const {
+		return window;
+	}
+};
+
+}
+
+#endif
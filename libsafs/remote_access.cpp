@@ -20,6 +20,7 @@
 #include <boost/format.hpp>
 
 #include "remote_access.h"
+#include "messaging.h"
 #include "parameters.h"
 #include "slab_allocator.h"
 #include "disk_read_thread.h"
@@ -43,12 +44,17 @@ public:
 	}
 
 	void init(const io_request &req) {
-		assert(req.get_req_type() == io_request::BASIC_REQ);
-		io_request::init(req);
+		assert(req.get_req_type() != io_request::USER_COMPUTE);
+		// If the original request has multiple buffers, the buffers are
+		// kept in the extension owned by the user.
+		*(io_request *) this = req;
 		completed_size = atomic_number<ssize_t>();
 	}
 
 	bool complete_part(const io_request &part) {
+		// The original request fails if any part of it fails.
+		if (part.is_failed())
+			set_failed(true);
 		ssize_t ret = completed_size.inc(part.get_size());
 		return ret == this->get_size();
 	}
@@ -90,13 +96,20 @@ remote_io::remote_io(const std::vector<disk_io_thread::ptr> &remotes,
 	low_prio_senders.resize(remotes.size());
 	// create a msg sender for each disk read thread.
 	for (unsigned i = 0; i < remotes.size(); i++) {
-		senders[i] = request_sender::create(node_id, &msg_allocator,
-				remotes[i]->get_queue());
+		senders[i] = request_ring_sender::create(node_id,
+				remotes[i]->acquire_ring(t));
 		low_prio_senders[i] = request_sender::create(node_id, &msg_allocator,
 				remotes[i]->get_low_prio_queue());
 	}
 	cb = NULL;
 	this->block_mapper = mapper;
+	orig_allocator = std::unique_ptr<req_obj_allocator<remote_orig_io_request> >(
+			new req_obj_allocator<remote_orig_io_request>(
+				std::string("remote_orig_req_allocator-") + itoa(node_id),
+				node_id, true));
+	ext_allocator = std::unique_ptr<req_ext_allocator>(new req_ext_allocator(
+				std::string("remote_req_ext_allocator-") + itoa(node_id),
+				node_id, true));
 }
 
 remote_io::~remote_io()
@@ -105,11 +118,28 @@ remote_io::~remote_io()
 	assert(senders.size() == low_prio_senders.size());
 	int num_senders = senders.size();
 	for (int i = 0; i < num_senders; i++) {
-		request_sender::destroy(senders[i]);
+		request_ring_sender::destroy(senders[i]);
 		request_sender::destroy(low_prio_senders[i]);
+		io_threads[i]->release_ring(get_thread());
 	}
 }
 
+/*
+ * Only the thread that owns the I/O instance can add requests to the ring.
+ * If the I/O instance is cleaned up in another thread, we have to send
+ * the remaining requests to the I/O thread in a different way.
+ */
+void remote_io::send_remaining(int idx)
+{
+	int num = senders[idx]->get_num_remaining();
+	if (num == 0)
+		return;
+
+	std::vector<io_request> reqs(num);
+	BOOST_VERIFY(senders[idx]->fetch_remaining(reqs.data(), num) == num);
+	io_threads[idx]->send_reqs(reqs);
+}
+
 io_interface *remote_io::clone(thread *t) const
 {
 	// An IO may not be associated to any threads.
@@ -126,8 +156,12 @@ void remote_io::cleanup()
 	process_all_completed_requests();
 
 	num_ios.dec(1);
+	bool is_owner = thread::get_curr_thread() == get_thread();
 	for (unsigned i = 0; i < senders.size(); i++) {
-		senders[i]->flush();
+		if (is_owner)
+			senders[i]->flush();
+		else
+			send_remaining(i);
 		low_prio_senders[i]->flush();
 	}
 	int num;
@@ -135,7 +169,11 @@ void remote_io::cleanup()
 		num = 0;
 		assert(senders.size() == low_prio_senders.size());
 		for (unsigned i = 0; i < senders.size(); i++) {
-			num += senders[i]->get_queue()->get_num_entries();
+			// The ring may not be able to take all requests at once.
+			if (is_owner)
+				senders[i]->flush();
+			num += senders[i]->get_num_remaining();
+			num += senders[i]->get_ring()->get_num_entries();
 			num += low_prio_senders[i]->get_queue()->get_num_entries();
 		}
 		/* 
@@ -158,11 +196,34 @@ void remote_io::cleanup()
 		io_threads[i]->flush_requests();
 }
 
+off_t get_split_end(const block_compress_table *table, int RAID_block_size,
+		off_t begin, off_t end)
+{
+	const off_t RAID_block_bytes = ((off_t) RAID_block_size) * PAGE_SIZE;
+	end = min(end, ROUND(begin + RAID_block_bytes, RAID_block_bytes));
+	if (table == NULL)
+		return end;
+
+	const off_t block_bytes = table->get_block_size() * PAGE_SIZE;
+	off_t block_idx = begin / block_bytes;
+	if (table->get_compressed_size(block_idx) > 0)
+		return min(end, (block_idx + 1) * block_bytes);
+	for (off_t off = (block_idx + 1) * block_bytes; off < end;
+			off += block_bytes)
+		if (table->get_compressed_size(off / block_bytes) > 0)
+			return off;
+	return end;
+}
+
 void remote_io::access(io_request *requests, int num,
 		io_status *status)
 {
 	ASSERT_EQ(get_thread(), thread::get_curr_thread());
 	num_issued_reqs.inc(num);
+	// The I/O threads measure how long the requests wait from now on.
+	uint64_t now = params.is_latency_stat() ? get_curr_time_ns() : 0;
+	const block_compress_table *compress_table
+		= block_mapper->get_compress_table().get();
 
 	bool syncd = false;
 	for (int i = 0; i < num; i++) {
@@ -170,11 +231,26 @@ void remote_io::access(io_request *requests, int num,
 			requests[i].set_io(this);
 			requests[i].set_node_id(this->get_node_id());
 		}
+		if (now > 0)
+			requests[i].set_create_time(now);
 
 		if (requests[i].get_access_method() == WRITE && !params.is_writable())
 			throw io_exception((boost::format(
 							"The I/O object can't write data. offset: %1%, size: %2%")
 						% requests[i].get_offset() % requests[i].get_size()).str());
+		// Compressed blocks are stored in place, so they can't be rewritten.
+		if (requests[i].get_access_method() == WRITE
+				&& block_mapper->get_compress_table())
+			throw io_exception((boost::format(
+							"%1% is compressed and can't be written")
+						% block_mapper->get_name()).str());
+		// The checksums can't be updated by writes. This is checked even if
+		// the checksums aren't verified, so the table never gets stale.
+		if (requests[i].get_access_method() == WRITE
+				&& block_mapper->has_checksums())
+			throw io_exception((boost::format(
+							"%1% has checksums and can't be written")
+						% block_mapper->get_name()).str());
 		if (requests[i].get_offset() % MIN_BLOCK_SIZE > 0)
 			throw io_exception((boost::format(
 						"The IO request offset isn't aligned. offset: %1%, size: %2%")
@@ -185,6 +261,17 @@ void remote_io::access(io_request *requests, int num,
 						% requests[i].get_offset() % requests[i].get_size()).str());
 		if (requests[i].get_req_type() == io_request::USER_COMPUTE)
 			throw io_exception("user compute isn't supported");
+		// The buffers of a scatter-gather request are accessed with direct
+		// I/O, so they have to be aligned.
+		if (requests[i].is_extended_req()) {
+			for (int j = 0; j < requests[i].get_num_bufs(); j++)
+				if ((long) requests[i].get_buf(j) % MIN_BLOCK_SIZE > 0
+						|| requests[i].get_buf_size(j) % MIN_BLOCK_SIZE > 0)
+					throw io_exception((boost::format(
+									"The IO request buffer %1% isn't aligned. offset: %2%, size: %3%")
+								% j % requests[i].get_offset()
+								% requests[i].get_size()).str());
+		}
 
 		if (requests[i].is_flush()) {
 			syncd = true;
@@ -195,8 +282,15 @@ void remote_io::access(io_request *requests, int num,
 			syncd = true;
 		}
 
-		// If the request accesses one RAID block, it's simple.
-		if (requests[i].inside_RAID_block(get_block_size())) {
+		// If the request accesses one block, it's simple.
+		// But we can't tell a scatter-gather request issued by
+		// the application from the requests split by remote_io when it
+		// completes, so it's always handled as a split request.
+		off_t req_end = requests[i].get_offset() + requests[i].get_size();
+		if (get_split_end(compress_table, get_block_size(),
+					requests[i].get_offset(), req_end) == req_end
+				&& !(requests[i].is_extended_req()
+					&& requests[i].get_io() == this)) {
 			off_t pg_off = requests[i].get_offset() / PAGE_SIZE;
 			int idx = block_mapper->map2file(pg_off);
 			// Map to the right disk.
@@ -212,30 +306,30 @@ void remote_io::access(io_request *requests, int num,
 			assert(ret == 1);
 		}
 		else {
-			// If the request accesses multiple RAID blocks, we have to
+			// If the request accesses multiple blocks, we have to
 			// split the request.
-			// I still use the default memory allocator, but since it is used
-			// when the request size is large, it should normally be OK.
-			// TODO I can use slab allocators later.
-			remote_orig_io_request *orig = new remote_orig_io_request();
-			// global_cached_io doesn't issue requests across a block boundary.
-			// It can only be application issued requst, so it shouldn't have
-			// extension.
-			assert(!requests[i].is_extended_req());
+			remote_orig_io_request *orig = orig_allocator->alloc_obj();
+			// global_cached_io doesn't issue requests across a RAID block
+			// boundary. It can only be a request issued by an application or
+			// direct_comp_io, which may read data to multiple buffers,
+			// or a request that accesses a compressed block and
+			// the blocks around it.
 			orig->init(requests[i]);
 			off_t end = orig->get_offset() + orig->get_size();
-			const off_t block_size = get_block_size() * PAGE_SIZE;
+			off_t split_end;
 			for (off_t begin = orig->get_offset(); begin < end;
-					begin = ROUND(begin + block_size, block_size)) {
-				io_req_extension *ext = new io_req_extension();
+					begin = split_end) {
+				split_end = get_split_end(compress_table, get_block_size(),
+						begin, end);
+				io_req_extension *ext = ext_allocator->alloc_obj();
 				ext->set_priv(orig);
 				io_request req(ext, INVALID_DATA_LOC, 0, NULL, 0);
-				int size = ROUND(begin + block_size, block_size) - begin;
-				size = min(size, end - begin);
 				// It only supports to extract a specified request from
 				// a single-buffer request.
-				orig->extract(begin, size, req);
+				orig->extract(begin, split_end - begin, req);
 				req.set_io(this);
+				if (now > 0)
+					req.set_create_time(now);
 				assert(req.inside_RAID_block(get_block_size()));
 
 				// Send a request.
@@ -273,6 +367,16 @@ void remote_io::access(io_request *requests, int num,
 			status[i] = IO_PENDING;
 }
 
+size_t remote_io::get_num_req_allocs() const
+{
+	return orig_allocator->get_num_allocs() + ext_allocator->get_num_allocs();
+}
+
+size_t remote_io::get_num_req_chunks() const
+{
+	return orig_allocator->get_num_chunks() + ext_allocator->get_num_chunks();
+}
+
 void remote_io::flush_requests()
 {
 	flush_requests(0);
@@ -319,7 +423,8 @@ int remote_io::process_completed_requests(io_request reqs[], int num)
 	int num_from_upper = 0;
 	int num_from_app = 0;
 	int num_part_reqs = 0;
-	std::vector<remote_orig_io_request *> completes;
+	remote_orig_io_request *completes[num];
+	int num_completes = 0;
 	for (int i = 0; i < num; i++) {
 		assert(reqs[i].get_io());
 		// The requests issued by the upper layer IO.
@@ -342,11 +447,11 @@ int remote_io::process_completed_requests(io_request reqs[], int num)
 				(io_request *) reqs[i].get_priv());
 		io_request *req = &reqs[i];
 		if (orig->complete_part(*req))
-			completes.push_back(remote_orig_io_request::cast2original(orig));
+			completes[num_completes++] = orig;
 		else {
 			num_part_reqs++;
 		}
-		delete req->get_extension();
+		ext_allocator->free(req->get_extension());
 	}
 	if (num_from_upper > 0) {
 		assert(upper_io);
@@ -355,7 +460,7 @@ int remote_io::process_completed_requests(io_request reqs[], int num)
 	if (num_from_app > 0 && this->have_callback())
 		this->get_callback().invoke(from_app, num_from_app);
 
-	for (unsigned i = 0; i < completes.size(); i++) {
+	for (int i = 0; i < num_completes; i++) {
 		remote_orig_io_request *orig = completes[i];
 		io_request *req = (io_request *) orig;
 		io_interface *io = orig->get_io();
@@ -366,8 +471,8 @@ int remote_io::process_completed_requests(io_request reqs[], int num)
 		}
 		else
 			io->notify_completion(&req, 1);
-		// Now we can delete it.
-		delete orig;
+		// Now we can free it.
+		orig_allocator->free(orig);
 	}
 
 	num_completed_reqs.inc(num - num_part_reqs);
@@ -412,7 +517,9 @@ int remote_io::wait4complete(int num_to_complete)
 	process_all_completed_requests();
 	while (pending - num_pending_ios() < num_to_complete) {
 		if (!params.is_busy_wait())
-			get_thread()->wait();
+			wait4activation();
+		// If a ring was full, some requests are still in the local buffer.
+		flush_requests();
 		process_all_completed_requests();
 	}
 	return pending - num_pending_ios();
@@ -480,8 +587,10 @@ int remote_io_select::wait4complete(int num_to_complete)
 	// If we need to process more I/O requests, we need to wait until
 	// I/O threads wake us up.
 	while (num_complete < num_to_complete) {
+		// All I/O instances run in the same thread, so any of them can
+		// wait for the thread to be activated.
 		if (!params.is_busy_wait())
-			curr->wait();
+			ios[0]->wait4activation();
 		for (size_t i = 0; i < ios.size(); i++) {
 			ios[i]->flush_requests();
 			num_complete += ios[i]->process_all_completed_requests();
@@ -21,6 +21,7 @@
  */
 
 #include "slab_allocator.h"
+#include "req_allocator.h"
 #include "io_interface.h"
 #include "container.h"
 
@@ -28,8 +29,10 @@ namespace safs
 {
 
 class request_sender;
+class request_ring_sender;
 class disk_io_thread;
 class file_mapper;
+class remote_orig_io_request;
 
 /*
  * This class is to help the local thread send IO requests to remote threads
@@ -37,13 +40,25 @@ class file_mapper;
  * However, the helper class isn't thread safe, so each local thread has to
  * reference its own helper object.
  */
+class block_compress_table;
+
+/*
+ * Get the end of the first part of [begin, end) that remote_io issues to
+ * the I/O threads as one request. A request can't cross a RAID block of
+ * `RAID_block_size' pages. A read on a compressed block can only access
+ * that block, while the adjacent uncompressed blocks are read together.
+ */
+off_t get_split_end(const block_compress_table *table, int RAID_block_size,
+		off_t begin, off_t end);
+
 class remote_io: public io_interface
 {
 	static atomic_integer num_ios;
 	const int max_disk_cached_reqs;
 	// They work as buffers for requests and are only used to
-	// send high-priority requests.
-	std::vector<request_sender *> senders;
+	// send high-priority requests. They send requests through the rings
+	// between the current thread and the I/O threads.
+	std::vector<request_ring_sender *> senders;
 	// They are used to send low-priority requests.
 	std::vector<request_sender *> low_prio_senders;
 	std::vector<std::shared_ptr<disk_io_thread> > io_threads;
@@ -51,9 +66,16 @@ class remote_io: public io_interface
 	std::shared_ptr<file_mapper> block_mapper;
 	thread_safe_FIFO_queue<io_request> complete_queue;
 	slab_allocator &msg_allocator;
+	// They allocate the requests split by the I/O instance. The requests
+	// are allocated in the thread that owns the I/O instance, but they
+	// may be freed in another thread when the I/O instance is cleaned up.
+	std::unique_ptr<req_obj_allocator<remote_orig_io_request> > orig_allocator;
+	std::unique_ptr<req_ext_allocator> ext_allocator;
 
 	atomic_integer num_completed_reqs;
 	atomic_integer num_issued_reqs;
+
+	void send_remaining(int idx);
 public:
 	typedef std::shared_ptr<remote_io> ptr;
 
@@ -109,6 +131,9 @@ public:
 		return num_issued_reqs.get();
 	}
 
+	size_t get_num_req_allocs() const;
+	size_t get_num_req_chunks() const;
+
 	virtual io_select::ptr create_io_select() const;
 };
 
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "req_allocator.h"
+
+namespace safs
+{
+
+void req_ext_allocator::ext_initiator::init(io_req_extension *ext)
+{
+	// A new chunk of memory is zeroed, so an extension that has never been
+	// constructed doesn't have a valid vector pointer.
+	if (!ext->is_valid())
+		new (ext) io_req_extension();
+	else
+		ext->init();
+}
+
+void req_ext_allocator::ext_destructor::destroy(io_req_extension *ext)
+{
+#ifdef MEMCHECK
+	// The memory of the object is returned to the heap.
+	ext->~io_req_extension();
+#endif
+}
+
+req_ext_allocator::req_ext_allocator(const std::string &name, int node_id,
+		bool thread_safe, long max_size): req_obj_allocator<io_req_extension>(
+			name, node_id, thread_safe, max_size,
+			obj_initiator<io_req_extension>::ptr(new ext_initiator()),
+			obj_destructor<io_req_extension>::ptr(new ext_destructor()))
+{
+}
+
+void req_ext_allocator::add_buf(char *buf, long size)
+{
+	req_obj_allocator<io_req_extension>::add_buf(buf, size);
+	chunk_lock.lock();
+	chunks.push_back(std::pair<char *, long>(buf, size));
+	chunk_lock.unlock();
+}
+
+req_ext_allocator::~req_ext_allocator()
+{
+	// Free the iovec arrays kept by the extensions.
+	int obj_size = get_obj_size();
+	for (size_t i = 0; i < chunks.size(); i++) {
+		long num_objs = chunks[i].second / obj_size;
+		for (long j = 0; j < num_objs; j++) {
+			io_req_extension *ext = (io_req_extension *) (chunks[i].first
+					+ obj_size * j + sizeof(slab_allocator::linked_obj));
+			if (ext->is_valid())
+				ext->~io_req_extension();
+		}
+	}
+}
+
+}
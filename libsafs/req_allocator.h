@@ -0,0 +1,137 @@
+#ifndef __REQ_ALLOCATOR_H__
+#define __REQ_ALLOCATOR_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include "slab_allocator.h"
+#include "io_request.h"
+#include "parameters.h"
+
+namespace safs
+{
+
+const int OBJ_ALLOC_INC_SIZE = 1024 * 1024;
+
+/*
+ * This allocates the request objects created by I/O instances on the I/O
+ * path, so we don't go to the heap for every request. An I/O instance owns
+ * its allocators, so the objects are allocated in the thread that owns
+ * the I/O instance. If the objects may be freed in other threads,
+ * the allocator needs to be thread-safe.
+ *
+ * The counters are only updated by the thread that allocates objects.
+ */
+template<class T>
+class req_obj_allocator: public obj_allocator<T>
+{
+	class req_initiator: public obj_initiator<T>
+	{
+	public:
+		void init(T *obj) {
+			new (obj) T();
+		}
+	};
+
+	class req_destructor: public obj_destructor<T>
+	{
+	public:
+		void destroy(T *obj) {
+			obj->~T();
+		}
+	};
+
+	size_t num_allocs;
+	// The number of chunks of memory allocated from the operating system.
+	size_t num_chunks;
+protected:
+	req_obj_allocator(const std::string &name, int node_id, bool thread_safe,
+			long max_size, typename obj_initiator<T>::ptr initiator,
+			typename obj_destructor<T>::ptr destructor): obj_allocator<T>(
+				name, node_id, thread_safe, OBJ_ALLOC_INC_SIZE, max_size,
+				std::move(initiator), std::move(destructor)) {
+		num_allocs = 0;
+		num_chunks = 0;
+	}
+
+	virtual void add_buf(char *buf, long size) {
+		num_chunks++;
+	}
+public:
+	req_obj_allocator(const std::string &name, int node_id, bool thread_safe,
+			long max_size = params.get_max_obj_alloc_size(
+				)): obj_allocator<T>(name, node_id, thread_safe,
+				OBJ_ALLOC_INC_SIZE, max_size,
+				typename obj_initiator<T>::ptr(new req_initiator()),
+				typename obj_destructor<T>::ptr(new req_destructor())) {
+		num_allocs = 0;
+		num_chunks = 0;
+	}
+
+	virtual T *alloc_obj() {
+		T *obj = obj_allocator<T>::alloc_obj();
+		assert(obj);
+		num_allocs++;
+		return obj;
+	}
+
+	size_t get_num_allocs() const {
+		return num_allocs;
+	}
+
+	size_t get_num_chunks() const {
+		return num_chunks;
+	}
+};
+
+/*
+ * This allocates request extensions. An extension keeps its iovec array
+ * when it's freed, so a reused extension doesn't need to allocate
+ * the array again when a request has many buffers.
+ */
+class req_ext_allocator: public req_obj_allocator<io_req_extension>
+{
+	class ext_initiator: public obj_initiator<io_req_extension>
+	{
+	public:
+		void init(io_req_extension *ext);
+	};
+
+	class ext_destructor: public obj_destructor<io_req_extension>
+	{
+	public:
+		void destroy(io_req_extension *ext);
+	};
+
+	spin_lock chunk_lock;
+	std::vector<std::pair<char *, long> > chunks;
+protected:
+	virtual void add_buf(char *buf, long size);
+public:
+	req_ext_allocator(const std::string &name, int node_id, bool thread_safe,
+			long max_size = params.get_max_obj_alloc_size());
+	~req_ext_allocator();
+};
+
+}
+
+#endif
@@ -20,6 +20,13 @@
 #include <boost/format.hpp>
 
 #include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <map>
 
 #include "log.h"
 #include "native_file.h"
@@ -48,16 +55,22 @@ safs_file::safs_file(const RAID_config &conf, const std::string &file_name)
 	for (unsigned i = 0; i < native_dirs.size(); i++)
 		native_dirs[i] = part_file_info(
 				native_dirs[i].get_file_name() + "/" + file_name,
-				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id());
+				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id(),
+				native_dirs[i].get_weight());
 	this->name = file_name;
 }
 
+static const std::string COMPRESS_TABLE_NAME = "compress_table";
+static const std::string CHECKSUM_TABLE_NAME = "checksum_table";
+static const std::string DISK_WEIGHTS_NAME = "disk_weights";
+
 std::vector<std::string> safs_file::erase_header_file(
 		const std::vector<std::string> &files)
 {
 	std::vector<std::string> ret;
 	for (auto it = files.begin(); it != files.end(); it++)
-		if (*it != "header")
+		if (*it != "header" && *it != COMPRESS_TABLE_NAME
+				&& *it != CHECKSUM_TABLE_NAME && *it != DISK_WEIGHTS_NAME)
 			ret.push_back(*it);
 	return ret;
 }
@@ -136,7 +149,11 @@ bool safs_file::resize(size_t new_size)
 		std::vector<size_t> sizes_per_disk = get_size_per_disk(new_size);
 		for (size_t i = 0; i < data_files.size(); i++) {
 			native_file f(data_files[i]);
-			bool ret = f.resize(sizes_per_disk[i]);
+			// The sizes are in the order of partition IDs, which are
+			// the names of the data files.
+			int part_id = atoi(f.get_file_name().c_str());
+			assert((size_t) part_id < sizes_per_disk.size());
+			bool ret = f.resize(sizes_per_disk[part_id]);
 			if (!ret)
 				return false;
 		}
@@ -167,10 +184,8 @@ bool safs_file::resize(size_t new_size)
 		return false;
 	}
 
-	safs_header new_header(header.get_block_size(),
-			header.get_mapping_option(), header.is_writable(),
-			new_size);
-	size_t num_writes = fwrite(&new_header, sizeof(new_header), 1, f);
+	header.resize(new_size);
+	size_t num_writes = fwrite(&header, sizeof(header), 1, f);
 	if (num_writes != 1) {
 		perror("fwrite");
 		fclose(f);
@@ -197,17 +212,22 @@ bool safs_file::rename(const std::string &new_name)
 	for (unsigned i = 0; i < native_dirs.size(); i++) {
 		native_file f(native_dirs[i].get_file_name());
 		native_dirs[i] = part_file_info(f.get_dir_name() + "/" + new_name,
-				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id());
+				native_dirs[i].get_disk_id(), native_dirs[i].get_node_id(),
+				native_dirs[i].get_weight());
 	}
 	return true;
 }
 
-std::vector<size_t> safs_file::get_size_per_disk(size_t file_size) const
+/*
+ * Given the SAFS file size, this calculates the sizes of the partitions
+ * in the order of partition IDs.
+ */
+static std::vector<size_t> get_size_per_part(const safs_header &header,
+		const std::vector<int> &weights,
+		const std::vector<part_file_info> &dirs, const std::string &name,
+		size_t file_size)
 {
-	auto header = get_header();
-	if (!header.is_valid())
-		header = safs_header(sys_block_size, sys_mapping_option, false, file_size);
-	file_mapper::ptr map = file_mapper::create(header, native_dirs, name);
+	file_mapper::ptr map = file_mapper::create(header, dirs, name, weights);
 	assert(map);
 	std::vector<size_t> ret = map->get_size_per_disk(div_ceil<size_t>(file_size,
 				PAGE_SIZE));
@@ -216,6 +236,125 @@ std::vector<size_t> safs_file::get_size_per_disk(size_t file_size) const
 	return ret;
 }
 
+std::vector<size_t> safs_file::get_size_per_disk(size_t file_size) const
+{
+	auto header = get_header();
+	if (!header.is_valid())
+		header = safs_header(sys_block_size, sys_mapping_option, false, file_size);
+	return get_size_per_part(header, get_disk_weights(), native_dirs, name,
+			file_size);
+}
+
+/*
+ * This measures the read throughput (MB/s) of the disk where the directory
+ * is. It writes a temporary file to the directory and reads it back with
+ * direct I/O, so the page cache doesn't affect the result.
+ * It returns 0 if it fails.
+ */
+static double measure_read_throughput(const std::string &dir)
+{
+	const size_t BENCH_SIZE = 64 * 1024 * 1024;
+	const size_t BENCH_BUF_SIZE = 1024 * 1024;
+	std::string file_name = dir + "/.weight_bench";
+	int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_DIRECT,
+			0644);
+	// Some filesystems (e.g., tmpfs) don't support direct I/O.
+	if (fd < 0 && errno == EINVAL)
+		fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "open %s: %s\n", file_name.c_str(), strerror(errno));
+		return 0;
+	}
+
+	char *buf = (char *) valloc(BENCH_BUF_SIZE);
+	memset(buf, 1, BENCH_BUF_SIZE);
+	double throughput = 0;
+	bool success = true;
+	for (size_t off = 0; off < BENCH_SIZE && success; off += BENCH_BUF_SIZE)
+		success = pwrite(fd, buf, BENCH_BUF_SIZE, off) == (ssize_t) BENCH_BUF_SIZE;
+	if (success) {
+		fsync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+		for (size_t off = 0; off < BENCH_SIZE && success; off += BENCH_BUF_SIZE)
+			success = pread(fd, buf, BENCH_BUF_SIZE, off)
+				== (ssize_t) BENCH_BUF_SIZE;
+		gettimeofday(&end, NULL);
+		if (success)
+			throughput = BENCH_SIZE / 1024.0 / 1024
+				/ std::max(time_diff(start, end), 0.000001f);
+	}
+	if (!success)
+		fprintf(stderr, "can't benchmark %s: %s\n", dir.c_str(),
+				strerror(errno));
+	free(buf);
+	close(fd);
+	unlink(file_name.c_str());
+	return throughput;
+}
+
+/*
+ * The throughput of the disks measured in the process, indexed by the root
+ * directories of the disks. Each disk is measured once, so creating many
+ * files with the weighted mapping doesn't benchmark the disks every time.
+ */
+static std::map<std::string, double> disk_throughputs;
+static pthread_mutex_t disk_throughput_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double get_disk_throughput(const std::string &root_dir)
+{
+	pthread_mutex_lock(&disk_throughput_lock);
+	auto it = disk_throughputs.find(root_dir);
+	double throughput;
+	if (it != disk_throughputs.end())
+		throughput = it->second;
+	else {
+		throughput = measure_read_throughput(root_dir);
+		BOOST_LOG_TRIVIAL(info) << boost::format("%1%: %2% MB/s")
+			% root_dir % throughput;
+		// We'll try again next time if the measurement fails.
+		if (throughput > 0)
+			disk_throughputs.insert(std::pair<std::string, double>(root_dir,
+						throughput));
+	}
+	pthread_mutex_unlock(&disk_throughput_lock);
+	return throughput;
+}
+
+/*
+ * This gets the weights of the partitions for the weighted mapping.
+ * If the RAID config doesn't give the weights of all disks, we measure
+ * the throughput of the disks. The weights in the config avoid
+ * the measurement.
+ */
+static std::vector<int> get_part_weights(const std::vector<part_file_info> &parts)
+{
+	std::vector<double> throughputs(parts.size());
+	bool has_weights = true;
+	for (size_t i = 0; i < parts.size(); i++) {
+		throughputs[i] = parts[i].get_weight();
+		if (throughputs[i] <= 0)
+			has_weights = false;
+	}
+	if (!has_weights) {
+		for (size_t i = 0; i < parts.size(); i++) {
+			// The directory of a partition is in the root directory of
+			// the disk.
+			throughputs[i] = get_disk_throughput(
+					native_file(parts[i].get_file_name()).get_dir_name());
+			// If we fail to measure one of the disks, we treat all disks
+			// equally.
+			if (throughputs[i] <= 0) {
+				BOOST_LOG_TRIVIAL(warning)
+					<< "can't measure disks, use the same weight for all disks";
+				return std::vector<int>(parts.size(), 1);
+			}
+		}
+	}
+	return throughput2weights(throughputs);
+}
+
 bool safs_file::create_file(size_t file_size, int block_size,
 		int mapping_option, safs_file_group::ptr group)
 {
@@ -231,12 +370,24 @@ bool safs_file::create_file(size_t file_size, int block_size,
 		dir_idxs = group->add_file(*this);
 
 	safs_header header(block_size, mapping_option, true, file_size);
-	std::vector<size_t> sizes_per_disk = get_size_per_disk(file_size);
+	std::vector<part_file_info> parts(native_dirs.size());
 	for (unsigned i = 0; i < native_dirs.size(); i++) {
-		native_dir dir(native_dirs[dir_idxs[i]].get_file_name());
+		parts[i] = native_dirs[dir_idxs[i]];
+		native_dir dir(parts[i].get_file_name());
 		bool ret = dir.create_dir(true);
 		if (!ret)
 			return false;
+	}
+	// The weights are stored with the file, so the mapping of the file
+	// doesn't change even if the disks are measured differently later.
+	std::vector<int> weights;
+	if (mapping_option == WEIGHTED)
+		weights = get_part_weights(parts);
+	std::vector<size_t> sizes_per_disk = get_size_per_part(header, weights,
+			parts, name, file_size);
+	for (unsigned i = 0; i < native_dirs.size(); i++) {
+		native_dir dir(parts[i].get_file_name());
+		bool ret;
 		// We store the metadata of the SAFS in the directory that
 		// stores the first part.
 		if (i == 0) {
@@ -261,6 +412,8 @@ bool safs_file::create_file(size_t file_size, int block_size,
 			return false;
 	}
 	assert(!header_file.empty());
+	if (!weights.empty())
+		return set_disk_weights(weights);
 	return true;
 }
 
@@ -290,6 +443,132 @@ std::string safs_file::get_header_file() const
 	return header_file;
 }
 
+std::string safs_file::get_compress_table_file() const
+{
+	std::string header_file = get_header_file();
+	if (header_file.empty())
+		return header_file;
+	native_file f(header_file);
+	return f.get_dir_name() + "/" + COMPRESS_TABLE_NAME;
+}
+
+block_compress_table::ptr safs_file::get_compress_table() const
+{
+	std::string table_file = get_compress_table_file();
+	if (table_file.empty() || !file_exist(table_file))
+		return block_compress_table::ptr();
+	return block_compress_table::load(table_file);
+}
+
+bool safs_file::set_compress_table(const block_compress_table &table)
+{
+	std::string table_file = get_compress_table_file();
+	if (table_file.empty())
+		return false;
+	return table.dump(table_file);
+}
+
+bool safs_file::remove_compress_table()
+{
+	std::string table_file = get_compress_table_file();
+	if (table_file.empty() || !file_exist(table_file))
+		return true;
+	if (unlink(table_file.c_str()) < 0) {
+		fprintf(stderr, "unlink %s: %s\n", table_file.c_str(), strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+std::string safs_file::get_checksum_table_file() const
+{
+	std::string header_file = get_header_file();
+	if (header_file.empty())
+		return header_file;
+	native_file f(header_file);
+	return f.get_dir_name() + "/" + CHECKSUM_TABLE_NAME;
+}
+
+block_checksum_table::ptr safs_file::get_checksum_table() const
+{
+	std::string table_file = get_checksum_table_file();
+	if (table_file.empty() || !file_exist(table_file))
+		return block_checksum_table::ptr();
+	return block_checksum_table::load(table_file);
+}
+
+bool safs_file::has_checksum_table() const
+{
+	std::string table_file = get_checksum_table_file();
+	return !table_file.empty() && file_exist(table_file);
+}
+
+bool safs_file::set_checksum_table(const block_checksum_table &table)
+{
+	std::string table_file = get_checksum_table_file();
+	if (table_file.empty())
+		return false;
+	return table.dump(table_file);
+}
+
+bool safs_file::remove_checksum_table()
+{
+	std::string table_file = get_checksum_table_file();
+	if (table_file.empty() || !file_exist(table_file))
+		return true;
+	if (unlink(table_file.c_str()) < 0) {
+		fprintf(stderr, "unlink %s: %s\n", table_file.c_str(), strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+std::string safs_file::get_disk_weights_file() const
+{
+	std::string header_file = get_header_file();
+	if (header_file.empty())
+		return header_file;
+	native_file f(header_file);
+	return f.get_dir_name() + "/" + DISK_WEIGHTS_NAME;
+}
+
+std::vector<int> safs_file::get_disk_weights() const
+{
+	std::vector<int> weights;
+	std::string weights_file = get_disk_weights_file();
+	if (weights_file.empty() || !file_exist(weights_file))
+		return weights;
+	FILE *f = fopen(weights_file.c_str(), "r");
+	if (f == NULL) {
+		fprintf(stderr, "fopen %s: %s\n", weights_file.c_str(), strerror(errno));
+		return weights;
+	}
+	int weight;
+	while (fscanf(f, "%d", &weight) == 1)
+		weights.push_back(weight);
+	fclose(f);
+	return weights;
+}
+
+bool safs_file::set_disk_weights(const std::vector<int> &weights)
+{
+	std::string weights_file = get_disk_weights_file();
+	if (weights_file.empty())
+		return false;
+	FILE *f = fopen(weights_file.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "fopen %s: %s\n", weights_file.c_str(), strerror(errno));
+		return false;
+	}
+	for (size_t i = 0; i < weights.size(); i++)
+		fprintf(f, "%d\n", weights[i]);
+	if (fclose(f) != 0) {
+		perror("fclose");
+		return false;
+	}
+	return true;
+}
+
 safs_header safs_file::get_header() const
 {
 	std::string header_file = get_header_file();
@@ -304,6 +583,7 @@ safs_header safs_file::get_header() const
 	size_t num_reads = fread(&header, sizeof(header), 1, f);
 	if (num_reads != 1) {
 		perror("fread");
+		fclose(f);
 		return safs_header();
 	}
 	int ret = fclose(f);
@@ -434,10 +714,14 @@ public:
 };
 
 const int BUF_SIZE = 1024 * 64 * 4096;
+// The number of chunks loaded at the same time. A chunk is read from
+// the external file while the previous one is written to SAFS.
+const int NUM_LOAD_BUFS = 2;
 
 }
 
-bool safs_file::load_data(const std::string &ext_file, size_t block_size)
+bool safs_file::load_data(const std::string &ext_file, size_t block_size,
+		int compression)
 {
 	std::shared_ptr<data_source> source = file_data_source::create(ext_file,
 			get_size());
@@ -447,6 +731,11 @@ bool safs_file::load_data(const std::string &ext_file, size_t block_size)
 	// If the file in SAFS doesn't exist, create a new one.
 	if (!exist())
 		create_file(source->get_size(), block_size);
+	// The data in the file is overwritten, so the compression table of
+	// the file is invalid. The table has to be removed before we open
+	// the file, otherwise, the file can't be written.
+	if (!remove_compress_table() || !remove_checksum_table())
+		return false;
 
 	file_io_factory::shared_ptr factory = create_io_factory(name,
 			REMOTE_ACCESS);
@@ -460,23 +749,101 @@ bool safs_file::load_data(const std::string &ext_file, size_t block_size)
 	assert(curr_thread);
 	io_interface::ptr io = create_io(factory, curr_thread);
 
-	char *buf = (char *) valloc(BUF_SIZE);
+	// If the file exists, its RAID block size may be different from
+	// the one given by the user.
+	const size_t block_bytes = factory->get_header().get_block_size()
+		* PAGE_SIZE;
+	const size_t unit_bytes = get_compress_unit(compression,
+			block_bytes / PAGE_SIZE) * PAGE_SIZE;
+	assert(block_bytes % unit_bytes == 0);
+	block_compress_table table(compression, unit_bytes / PAGE_SIZE);
+	std::unique_ptr<block_checksum_table> sums;
+	if (params.get_checksum_block_size() > 0)
+		sums = std::unique_ptr<block_checksum_table>(new block_checksum_table(
+					params.get_checksum_block_size()));
+	// We read and compress a chunk while the previous chunk is written,
+	// so each chunk has a half of the buffer space.
+	// We compress data in the units of RAID blocks or smaller blocks, so
+	// a buffer has to contain whole RAID blocks.
+	size_t buf_size = BUF_SIZE / NUM_LOAD_BUFS;
+	char *cbufs[NUM_LOAD_BUFS] = {};
+	if (compression != COMPRESS_NONE) {
+		buf_size = std::max(buf_size / block_bytes, 1UL) * block_bytes;
+		for (int i = 0; i < NUM_LOAD_BUFS; i++)
+			cbufs[i] = (char *) valloc(buf_size);
+	}
+	char *bufs[NUM_LOAD_BUFS];
+	for (int i = 0; i < NUM_LOAD_BUFS; i++)
+		bufs[i] = (char *) valloc(buf_size);
 	off_t off = 0;
 
-	while (off < (off_t) source->get_size()) {
-		size_t size = min<size_t>(BUF_SIZE, source->get_size() - off);
+	for (int buf_idx = 0; off < (off_t) source->get_size();
+			buf_idx = (buf_idx + 1) % NUM_LOAD_BUFS) {
+		char *buf = bufs[buf_idx];
+		char *cbuf = cbufs[buf_idx];
+		size_t size = min<size_t>(buf_size, source->get_size() - off);
 		size_t ret = source->get_data(off, size, buf);
 		assert(ret == size);
+		if (sums)
+			sums->append(buf, size);
 		ssize_t write_bytes = ROUNDUP(ret, 512);
 		memset(buf + size, 0, write_bytes - size);
-		data_loc_t loc(io->get_file_id(), off);
-		io_request req(buf, loc, write_bytes, WRITE);
-		io->access(&req, 1);
-		io->wait4complete(1);
+		std::vector<io_request> reqs;
+		if (cbuf == NULL) {
+			data_loc_t loc(io->get_file_id(), off);
+			reqs.push_back(io_request(buf, loc, write_bytes, WRITE));
+		}
+		// Each compressed block is written to the beginning of the space
+		// of the block.
+		for (size_t boff = 0; cbuf && boff < size; boff += unit_bytes) {
+			size_t raw_size = min(unit_bytes, size - boff);
+			size_t raw_write = ROUNDUP(raw_size, 512);
+			char *cblock = cbuf + boff;
+			size_t csize = compress_block(compression, buf + boff, raw_size,
+					cblock, unit_bytes);
+			size_t cwrite = ROUNDUP(csize, 512);
+			off_t block_idx = (off + boff) / unit_bytes;
+			data_loc_t loc(io->get_file_id(), off + boff);
+			// A block is stored compressed only if it reduces disk I/O.
+			if (csize > 0 && cwrite < raw_write) {
+				memset(cblock + csize, 0, cwrite - csize);
+				table.set_compressed_size(block_idx, csize);
+				reqs.push_back(io_request(cblock, loc, cwrite, WRITE));
+			}
+			else {
+				table.set_compressed_size(block_idx, 0);
+				reqs.push_back(io_request(buf + boff, loc, raw_write, WRITE));
+			}
+		}
+		// The writes of the previous chunk were in flight while we read
+		// this chunk.
+		// Its writes have to complete before its buffer is reused.
+		while (io->num_pending_ios() > 0)
+			io->wait4complete(io->num_pending_ios());
+		io->access(reqs.data(), reqs.size());
 		off += write_bytes;
 	}
+	while (io->num_pending_ios() > 0)
+		io->wait4complete(io->num_pending_ios());
 	io->cleanup();
-	free(buf);
+	for (int i = 0; i < NUM_LOAD_BUFS; i++) {
+		free(bufs[i]);
+		free(cbufs[i]);
+	}
+	if (sums) {
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"compute the checksums of %1% blocks of %2% bytes")
+			% sums->get_num_blocks() % sums->get_block_size();
+		if (!set_checksum_table(*sums))
+			return false;
+	}
+	if (compression != COMPRESS_NONE) {
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"%1% of %2% blocks are compressed to %3% bytes")
+			% table.get_num_compressed_blocks() % table.get_num_blocks()
+			% table.get_tot_compressed_bytes();
+		return set_compress_table(table);
+	}
 	return true;
 }
 
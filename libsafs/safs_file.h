@@ -30,6 +30,8 @@
 #include "native_file.h"
 #include "safs_header.h"
 #include "parameters.h"
+#include "compression.h"
+#include "checksum.h"
 
 namespace safs
 {
@@ -46,16 +48,22 @@ class part_file_info
 	int disk_id;
 	// The NUMA node id where the disk is connected to.
 	int node_id;
+	// The relative throughput of the disk, used by the weighted mapping.
+	// 0 means it's unknown.
+	int weight;
 public:
 	part_file_info() {
 		disk_id = 0;
 		node_id = 0;
+		weight = 0;
 	}
 
-	part_file_info(const std::string &name, int disk_id, int node_id) {
+	part_file_info(const std::string &name, int disk_id, int node_id,
+			int weight = 0) {
 		this->name = name;
 		this->disk_id = disk_id;
 		this->node_id = node_id;
+		this->weight = weight;
 	}
 
 	std::string get_file_name() const {
@@ -69,6 +77,14 @@ public:
 	int get_node_id() const {
 		return node_id;
 	}
+
+	int get_weight() const {
+		return weight;
+	}
+
+	void set_weight(int weight) {
+		this->weight = weight;
+	}
 };
 
 class RAID_config;
@@ -88,6 +104,9 @@ class safs_file
 
 	std::vector<std::string> get_data_files() const;
 	std::string get_header_file() const;
+	std::string get_compress_table_file() const;
+	std::string get_checksum_table_file() const;
+	std::string get_disk_weights_file() const;
 	// This gets physical file sizes in each directory of `native_dirs'.
 	std::vector<size_t> get_size_per_disk(size_t file_size) const;
 public:
@@ -105,6 +124,33 @@ public:
 	bool set_user_metadata(const std::vector<char> &data);
 	std::vector<char> get_user_metadata() const;
 
+	/*
+	 * A compressed SAFS file keeps the sizes of its compressed RAID blocks
+	 * in a table next to the header. It returns NULL if the file isn't
+	 * compressed.
+	 */
+	block_compress_table::ptr get_compress_table() const;
+	bool set_compress_table(const block_compress_table &table);
+	bool remove_compress_table();
+
+	/*
+	 * The checksums of the blocks of an SAFS file are kept in a table
+	 * next to the header. It returns NULL if the file has no checksums.
+	 * Only load_data() computes the checksums of a file.
+	 */
+	block_checksum_table::ptr get_checksum_table() const;
+	bool has_checksum_table() const;
+	bool set_checksum_table(const block_checksum_table &table);
+	bool remove_checksum_table();
+
+	/*
+	 * A file with the weighted mapping keeps the weights of its partitions
+	 * in a file next to the header, in the order of partition IDs.
+	 * It returns an empty vector if the file has no weights.
+	 */
+	std::vector<int> get_disk_weights() const;
+	bool set_disk_weights(const std::vector<int> &weights);
+
 	const std::string &get_name() const {
 		return name;
 	}
@@ -120,9 +166,14 @@ public:
 	bool rename(const std::string &new_name);
 	/*
 	 * Load data from a file in the Linux filesystem.
+	 * If a compression codec is given, each RAID block (or each page
+	 * with the delta codec) is compressed and decompressed transparently
+	 * when it's read.
+	 * The checksums of the data are computed if checksum_block is set.
 	 */
 	bool load_data(const std::string &ext_file,
-			size_t block_size = params.get_RAID_block_size());
+			size_t block_size = params.get_RAID_block_size(),
+			int compression = COMPRESS_NONE);
 };
 
 class safs_file_group
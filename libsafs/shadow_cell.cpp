@@ -19,7 +19,8 @@
 
 #include "shadow_cell.h"
 
-#ifdef USE_SHADOW_PAGE
+namespace safs
+{
 
 void clock_shadow_cell::add(shadow_page pg)
 {
@@ -57,11 +58,11 @@ void clock_shadow_cell::add(shadow_page pg)
 	} while (!inserted);
 }
 
-shadow_page clock_shadow_cell::search(off_t off)
+shadow_page clock_shadow_cell::search(const page_id_t &pg_id)
 {
 	for (int i = 0; i < queue.size(); i++) {
 		shadow_page pg = queue.get(i);
-		if (pg.get_offset() == off) {
+		if (pg.match(pg_id)) {
 			queue.get(i).set_referenced(true);
 			return pg;
 		}
@@ -76,11 +77,11 @@ void clock_shadow_cell::scale_down_hits()
 	}
 }
 
-shadow_page LRU_shadow_cell::search(off_t off)
+shadow_page LRU_shadow_cell::search(const page_id_t &pg_id)
 {
 	for (int i = 0; i < queue.size(); i++) {
 		shadow_page pg = queue.get(i);
-		if (pg.get_offset() == off) {
+		if (pg.match(pg_id)) {
 			queue.remove(i);
 			queue.push_back(pg);
 			return pg;
@@ -89,6 +90,30 @@ shadow_page LRU_shadow_cell::search(off_t off)
 	return shadow_page();
 }
 
+shadow_page LRU_shadow_cell::remove(const page_id_t &pg_id)
+{
+	for (int i = 0; i < queue.size(); i++) {
+		shadow_page pg = queue.get(i);
+		if (pg.match(pg_id)) {
+			queue.remove(i);
+			return pg;
+		}
+	}
+	return shadow_page();
+}
+
+void LRU_shadow_cell::count_pages(int &num_active, int &num_inactive)
+{
+	num_active = 0;
+	num_inactive = 0;
+	for (int i = 0; i < queue.size(); i++) {
+		if (queue.get(i).active())
+			num_active++;
+		else
+			num_inactive++;
+	}
+}
+
 void LRU_shadow_cell::scale_down_hits()
 {
 	for (int i = 0; i < queue.size(); i++) {
@@ -168,5 +193,5 @@ void embedded_queue<T, SIZE>::remove(int idx)
 
 template class embedded_queue<shadow_page, NUM_SHADOW_PAGES>;
 
-#endif
+}
 
@@ -31,20 +31,46 @@ namespace safs
 class shadow_page
 {
 	int offset;
+	/*
+	 * Only the low bits of the file ID are kept, so a shadow page fits
+	 * in 8 bytes. A shadow page is just a hint of the access history,
+	 * so a false match only affects how the cache adapts.
+	 */
+	short file_id;
 	unsigned char hits;
 	char flags;
 public:
 	shadow_page() {
 		offset = -1;
+		file_id = -1;
 		hits = 0;
 		flags = 0;
 	}
 	shadow_page(page &pg) {
 		offset = pg.get_offset() >> LOG_PAGE_SIZE;
+		file_id = pg.get_file_id();
 		hits = pg.get_hits();
 		flags = 0;
 	}
 
+	bool match(const page_id_t &pg_id) const {
+		return offset == (pg_id.get_offset() >> LOG_PAGE_SIZE)
+			&& file_id == (short) pg_id.get_file_id();
+	}
+
+	/*
+	 * Whether the page was in the active list when it was evicted.
+	 */
+	void set_active(bool active) {
+		if (active)
+			flags |= 0x1 << ACTIVE_BIT;
+		else
+			flags &= ~(0x1 << ACTIVE_BIT);
+	}
+	bool active() const {
+		return flags & (0x1 << ACTIVE_BIT);
+	}
+
 	void set_referenced(bool referenced) {
 		if (referenced)
 			flags |= 0x1 << REFERENCED_BIT;
@@ -73,13 +99,11 @@ public:
 	}
 };
 
-#ifdef USE_SHADOW_PAGE
-
 class shadow_cell
 {
 public:
 	virtual void add(shadow_page pg) = 0;
-	virtual shadow_page search(off_t off) = 0;
+	virtual shadow_page search(const page_id_t &pg_id) = 0;
 	virtual void scale_down_hits() = 0;
 };
 
@@ -146,13 +170,6 @@ public:
 	void set(T &v, int idx) {
 		buf[(start + idx) % SIZE] = v;
 	}
-
-	void print_state() {
-		printf("start: %d, num: %d\n", start, num);
-		for (int i = 0; i < this->size(); i++)
-			printf("%ld\t", this->get(i));
-		printf("\n");
-	}
 };
 
 class clock_shadow_cell: public shadow_cell
@@ -167,7 +184,7 @@ public:
 
 	void add(shadow_page pg);
 
-	shadow_page search(off_t off);
+	shadow_page search(const page_id_t &pg_id);
 
 	void scale_down_hits();
 };
@@ -190,13 +207,23 @@ public:
 		queue.push_back(pg);
 	}
 
-	shadow_page search(off_t off);
+	shadow_page search(const page_id_t &pg_id);
+
+	/*
+	 * remove the page from the cell and return it.
+	 * If the page doesn't exist, return an invalid page.
+	 */
+	shadow_page remove(const page_id_t &pg_id);
+
+	/*
+	 * count the pages that were in the active list and the pages that
+	 * were in the inactive list when they were evicted.
+	 */
+	void count_pages(int &num_active, int &num_inactive);
 
 	void scale_down_hits();
 };
 
-#endif
-
 }
 
 #endif
@@ -0,0 +1,545 @@
+#ifndef __SHARED_KV_STORE_H__
+#define __SHARED_KV_STORE_H__
+
+/*
+ * Copyright 2015 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of SAFSlib.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "io_interface.h"
+#include "cache.h"
+#include "concurrency.h"
+
+namespace safs
+{
+
+/*
+ * A key identifies a value in a key-value store over multiple files.
+ */
+struct KV_key
+{
+	// The index of the file in the store.
+	int file_idx;
+	// The index of the value in the file.
+	off_t idx;
+
+	KV_key() {
+		file_idx = 0;
+		idx = 0;
+	}
+
+	KV_key(int file_idx, off_t idx) {
+		this->file_idx = file_idx;
+		this->idx = idx;
+	}
+
+	bool operator<(const KV_key &key) const {
+		if (file_idx != key.file_idx)
+			return file_idx < key.file_idx;
+		return idx < key.idx;
+	}
+
+	bool operator==(const KV_key &key) const {
+		return file_idx == key.file_idx && idx == key.idx;
+	}
+};
+
+/*
+ * This is invoked when the value of a requested key is available.
+ * A request may be served by another thread that accesses the store,
+ * so the callback has to be thread-safe.
+ */
+template<class ValueType>
+class KV_get_callback
+{
+public:
+	virtual ~KV_get_callback() {
+	}
+
+	virtual void invoke(const KV_key &key, const ValueType &value) = 0;
+};
+
+/*
+ * This is a small direct-mapped cache of the values read from the store.
+ * A new value evicts the value in the same slot.
+ */
+template<class ValueType>
+class KV_value_cache
+{
+	static const int NUM_LOCKS = 1024;
+
+	struct entry {
+		KV_key key;
+		ValueType value;
+		bool valid;
+
+		entry() {
+			valid = false;
+		}
+	};
+
+	std::vector<entry> entries;
+	std::unique_ptr<spin_lock[]> locks;
+	size_t mask;
+
+	size_t get_slot(const KV_key &key) const {
+		size_t h = key.idx * 0x9E3779B97F4A7C15UL + key.file_idx;
+		return (h ^ (h >> 29)) & mask;
+	}
+
+	spin_lock &get_lock(size_t slot) const {
+		return locks[slot % NUM_LOCKS];
+	}
+public:
+	/*
+	 * The number of entries is rounded up to the power of 2.
+	 */
+	KV_value_cache(size_t num_entries) {
+		size_t size = 1;
+		while (size < num_entries)
+			size *= 2;
+		entries.resize(size);
+		mask = size - 1;
+		locks = std::unique_ptr<spin_lock[]>(new spin_lock[NUM_LOCKS]);
+	}
+
+	bool get(const KV_key &key, ValueType &value) const {
+		size_t slot = get_slot(key);
+		spin_lock &lock = get_lock(slot);
+		lock.lock();
+		const entry &e = entries[slot];
+		bool hit = e.valid && e.key == key;
+		if (hit)
+			value = e.value;
+		lock.unlock();
+		return hit;
+	}
+
+	void put(const KV_key &key, const ValueType &value) {
+		size_t slot = get_slot(key);
+		spin_lock &lock = get_lock(slot);
+		lock.lock();
+		entry &e = entries[slot];
+		e.key = key;
+		e.value = value;
+		e.valid = true;
+		lock.unlock();
+	}
+
+	size_t get_num_entries() const {
+		return entries.size();
+	}
+};
+
+/*
+ * The byte range of a file read by an I/O request that serves
+ * the requests [start, end) of a sorted array of requests.
+ */
+struct KV_req_range
+{
+	int file_idx;
+	off_t off;
+	size_t size;
+	size_t start;
+	size_t end;
+};
+
+/*
+ * Split the requests, which are sorted by their keys, into page-aligned
+ * ranges. Requests that touch the same or adjacent pages are served by
+ * the same range unless the range is larger than `max_range_size'.
+ */
+template<class ReqType>
+void group_KV_reqs(const std::vector<ReqType> &reqs, size_t value_size,
+		size_t max_range_size, std::vector<KV_req_range> &ranges)
+{
+	for (size_t i = 0; i < reqs.size(); i++) {
+		const KV_key &key = reqs[i].key;
+		off_t page_off = ROUND_PAGE(key.idx * value_size);
+		off_t end_page_off = ROUNDUP_PAGE((key.idx + 1) * value_size);
+		if (!ranges.empty()) {
+			KV_req_range &range = ranges.back();
+			off_t range_end = range.off + range.size;
+			if (range.file_idx == key.file_idx && page_off <= range_end
+					&& (size_t) (std::max(range_end, end_page_off)
+						- range.off) <= max_range_size) {
+				range.size = std::max(range_end, end_page_off) - range.off;
+				range.end = i + 1;
+				continue;
+			}
+		}
+		KV_req_range range;
+		range.file_idx = key.file_idx;
+		range.off = page_off;
+		range.size = end_page_off - page_off;
+		range.start = i;
+		range.end = i + 1;
+		ranges.push_back(range);
+	}
+}
+
+template<class ValueType>
+class shared_KV_store;
+
+template<class ValueType>
+struct KV_get_req
+{
+	KV_key key;
+	KV_get_callback<ValueType> *cb;
+
+	bool operator<(const KV_get_req<ValueType> &req) const {
+		return key < req.key;
+	}
+};
+
+template<class ValueType>
+class KV_get_compute: public user_compute
+{
+	shared_KV_store<ValueType> *store;
+	std::vector<KV_get_req<ValueType> > reqs;
+	bool has_run;
+public:
+	KV_get_compute(shared_KV_store<ValueType> *store,
+			compute_allocator *alloc): user_compute(alloc) {
+		this->store = store;
+		has_run = false;
+	}
+
+	void add_req(const KV_get_req<ValueType> &req) {
+		reqs.push_back(req);
+	}
+
+	virtual int serialize(char *buf, int size) const {
+		return 0;
+	}
+
+	virtual int get_serialized_size() const {
+		return 0;
+	}
+
+	virtual void run(page_byte_array &arr) {
+		for (size_t i = 0; i < reqs.size(); i++) {
+			off_t off = reqs[i].key.idx * sizeof(ValueType);
+			BOOST_VERIFY(off >= arr.get_offset() && off + sizeof(ValueType)
+					<= arr.get_offset() + arr.get_size());
+			ValueType value;
+			arr.memcpy(off - arr.get_offset(), (char *) &value,
+					sizeof(value));
+			store->complete_req(reqs[i], value);
+		}
+		has_run = true;
+	}
+
+	virtual bool has_completed() {
+		return has_run;
+	}
+
+	virtual int has_requests() {
+		return false;
+	}
+
+	virtual request_range get_next_request() {
+		throw unsupported_exception("get_next_request");
+	}
+};
+
+template<class ValueType>
+class KV_get_compute_allocator: public compute_allocator
+{
+	shared_KV_store<ValueType> *store;
+public:
+	KV_get_compute_allocator(shared_KV_store<ValueType> *store) {
+		this->store = store;
+	}
+
+	virtual user_compute *alloc() {
+		return new KV_get_compute<ValueType>(store, this);
+	}
+
+	virtual void free(user_compute *compute) {
+		delete compute;
+	}
+};
+
+/*
+ * This is a key-value store over multiple files that can be shared by
+ * many threads. A value is located by the index of its file and its
+ * index in the file.
+ *
+ * A thread requests a batch of keys with get(). The keys are buffered
+ * in the thread. When the buffer is full or the thread flushes requests,
+ * the keys are sorted and the pages touched by them are read with as few
+ * I/O requests as possible. The I/O requests are asynchronous. An I/O
+ * instance can only be used by its own thread, so each thread issues
+ * and serves its own keys, and a thread never waits for another thread.
+ * The files are accessed through the page cache, so a page needed by
+ * multiple threads is still read from the disks once.
+ * A thread has to call wait4complete() to make sure its keys are served.
+ * The I/O instances of a thread are destroyed when the thread exits or
+ * when it calls release_thread().
+ *
+ * The values read from the files are also kept in a small cache, so
+ * the keys of hot values don't cause I/O requests.
+ * The files must be opened with the page cache (GLOBAL_CACHE_ACCESS).
+ */
+template<class ValueType>
+class shared_KV_store
+{
+public:
+	// The maximal number of buffered requests of a thread before they
+	// are issued.
+	static const size_t MAX_BUF_REQS = 4096;
+private:
+	// The maximal size of an I/O request.
+	static const size_t MAX_IO_SIZE = 128 * PAGE_SIZE;
+
+	struct thread_state {
+		shared_KV_store<ValueType> *store;
+		// An I/O instance for each file.
+		std::vector<io_interface::ptr> ios;
+		std::vector<KV_get_req<ValueType> > req_buf;
+	};
+
+	std::vector<file_io_factory::shared_ptr> factories;
+	std::unique_ptr<KV_value_cache<ValueType> > cache;
+	KV_get_compute_allocator<ValueType> alloc;
+
+	pthread_mutex_t state_lock;
+	pthread_key_t state_key;
+	std::vector<thread_state *> states;
+
+	atomic_long num_cache_hits;
+	atomic_long num_ios;
+	// The priority class of the I/O requests issued by the store.
+	int io_class;
+
+	shared_KV_store(const std::vector<file_io_factory::shared_ptr> &factories,
+			size_t cache_size, int io_class): alloc(this) {
+		this->factories = factories;
+		this->io_class = io_class;
+		if (cache_size > 0)
+			cache = std::unique_ptr<KV_value_cache<ValueType> >(
+					new KV_value_cache<ValueType>(cache_size));
+		assert(PAGE_SIZE % sizeof(ValueType) == 0);
+		pthread_mutex_init(&state_lock, NULL);
+		pthread_key_create(&state_key, destroy_thread_state);
+	}
+
+	/*
+	 * This runs in the thread that owns the state, either when the thread
+	 * exits or when it releases the store.
+	 */
+	static void destroy_thread_state(void *arg) {
+		thread_state *state = (thread_state *) arg;
+		shared_KV_store<ValueType> *store = state->store;
+		// The pending I/O requests have to complete before the I/O
+		// instances are destroyed.
+		store->wait4complete(state);
+		pthread_mutex_lock(&store->state_lock);
+		typename std::vector<thread_state *>::iterator it = std::find(
+				store->states.begin(), store->states.end(), state);
+		assert(it != store->states.end());
+		store->states.erase(it);
+		pthread_mutex_unlock(&store->state_lock);
+		delete state;
+	}
+
+	thread_state *get_thread_state() {
+		thread_state *state = (thread_state *) pthread_getspecific(state_key);
+		if (state == NULL) {
+			thread *curr = thread::get_curr_thread();
+			assert(curr);
+			state = new thread_state();
+			state->store = this;
+			for (size_t i = 0; i < factories.size(); i++) {
+				io_interface::ptr io = create_io(factories[i], curr);
+				io->set_io_priority(io_class);
+				state->ios.push_back(io);
+			}
+			pthread_setspecific(state_key, state);
+			pthread_mutex_lock(&state_lock);
+			states.push_back(state);
+			pthread_mutex_unlock(&state_lock);
+		}
+		return state;
+	}
+
+	void issue_reqs(thread_state *state,
+			std::vector<KV_get_req<ValueType> > &reqs) {
+		std::sort(reqs.begin(), reqs.end());
+		std::vector<KV_req_range> ranges;
+		group_KV_reqs(reqs, sizeof(ValueType), MAX_IO_SIZE, ranges);
+		std::vector<std::vector<io_request> > io_reqs(factories.size());
+		for (size_t i = 0; i < ranges.size(); i++) {
+			KV_get_compute<ValueType> *compute
+				= (KV_get_compute<ValueType> *) alloc.alloc();
+			for (size_t j = ranges[i].start; j < ranges[i].end; j++)
+				compute->add_req(reqs[j]);
+			io_interface::ptr io = state->ios[ranges[i].file_idx];
+			data_loc_t loc(io->get_file_id(), ranges[i].off);
+			io_reqs[ranges[i].file_idx].push_back(io_request(compute, loc,
+						ranges[i].size, READ));
+		}
+		num_ios.inc(ranges.size());
+		for (size_t i = 0; i < io_reqs.size(); i++) {
+			if (io_reqs[i].empty())
+				continue;
+			state->ios[i]->access(io_reqs[i].data(), io_reqs[i].size());
+			state->ios[i]->flush_requests();
+		}
+	}
+
+	/*
+	 * Serve the keys whose I/O requests have completed without waiting
+	 * for the others.
+	 */
+	void process_completed(thread_state *state) {
+		for (size_t i = 0; i < state->ios.size(); i++)
+			if (state->ios[i]->num_pending_ios() > 0)
+				state->ios[i]->wait4complete(0);
+	}
+
+	void flush_requests(thread_state *state) {
+		std::vector<KV_get_req<ValueType> > reqs;
+		reqs.swap(state->req_buf);
+		if (!reqs.empty())
+			issue_reqs(state, reqs);
+		process_completed(state);
+	}
+
+	void wait4complete(thread_state *state) {
+		flush_requests(state);
+		for (size_t i = 0; i < state->ios.size(); i++) {
+			io_interface::ptr io = state->ios[i];
+			while (io->num_pending_ios() > 0)
+				io->wait4complete(io->num_pending_ios());
+		}
+	}
+public:
+	typedef std::shared_ptr<shared_KV_store<ValueType> > ptr;
+
+	/*
+	 * `cache_size' is the number of values kept in the cache.
+	 * 0 means the store doesn't cache values.
+	 * `io_class' is the priority class of the I/O requests. A store that
+	 * serves lookups of a query can use IO_CLASS_INTERACTIVE.
+	 */
+	static ptr create(const std::vector<file_io_factory::shared_ptr> &factories,
+			size_t cache_size, int io_class = IO_CLASS_NORMAL) {
+		return ptr(new shared_KV_store<ValueType>(factories, cache_size,
+					io_class));
+	}
+
+	/*
+	 * All threads should have finished accessing the store. The I/O
+	 * instances of the current thread are destroyed here, while the other
+	 * threads that are still alive have to release the store themselves.
+	 */
+	~shared_KV_store() {
+		release_thread();
+		assert(states.empty());
+		pthread_key_delete(state_key);
+		pthread_mutex_destroy(&state_lock);
+	}
+
+	/*
+	 * Request the values of the keys. The callback is invoked for each key,
+	 * either immediately if the value is cached or when the value is read
+	 * from the file. If the buffer of the current thread is full, the thread
+	 * issues the buffered requests without waiting for them.
+	 */
+	void get(const KV_key keys[], int num, KV_get_callback<ValueType> &cb) {
+		thread_state *state = get_thread_state();
+		size_t num_misses = 0;
+		for (int i = 0; i < num; i++) {
+			assert(keys[i].file_idx >= 0
+					&& (size_t) keys[i].file_idx < factories.size());
+			ValueType value;
+			if (cache && cache->get(keys[i], value)) {
+				num_cache_hits.inc(1);
+				cb.invoke(keys[i], value);
+				continue;
+			}
+			KV_get_req<ValueType> req;
+			req.key = keys[i];
+			req.cb = &cb;
+			state->req_buf.push_back(req);
+			num_misses++;
+		}
+		if (state->req_buf.size() >= MAX_BUF_REQS)
+			flush_requests(state);
+		else if (num_misses > 0)
+			process_completed(state);
+	}
+
+	/*
+	 * Issue the buffered requests of the current thread. It doesn't wait
+	 * for them to complete.
+	 */
+	void flush_requests() {
+		flush_requests(get_thread_state());
+	}
+
+	/*
+	 * Wait until all keys requested by the current thread are served.
+	 */
+	void wait4complete() {
+		wait4complete(get_thread_state());
+	}
+
+	/*
+	 * Destroy the I/O instances of the current thread. A thread that has
+	 * accessed the store has to call it if it's still alive when the store
+	 * is destroyed, because the I/O instances can only be destroyed by
+	 * the thread that owns them.
+	 */
+	void release_thread() {
+		thread_state *state = (thread_state *) pthread_getspecific(state_key);
+		if (state) {
+			pthread_setspecific(state_key, NULL);
+			destroy_thread_state(state);
+		}
+	}
+
+	void complete_req(const KV_get_req<ValueType> &req,
+			const ValueType &value) {
+		if (cache)
+			cache->put(req.key, value);
+		req.cb->invoke(req.key, value);
+	}
+
+	size_t get_num_files() const {
+		return factories.size();
+	}
+
+	size_t get_num_cache_hits() const {
+		return num_cache_hits.get();
+	}
+
+	size_t get_num_ios() const {
+		return num_ios.get();
+	}
+};
+
+}
+
+#endif
@@ -129,15 +129,7 @@ int slab_allocator::alloc(char **objs, int nobjs) {
 			tot_slab_size.inc(increase_size);
 			if (thread_safe)
 				lock.unlock();
-			char *objs;
-#ifdef USE_NUMA
-			if (node_id == -1)
-				objs = (char *) numa_alloc_local(increase_size);
-			else
-				objs = (char *) numa_alloc_onnode(increase_size, node_id);
-#else
-			objs = (char *) malloc_aligned(increase_size, PAGE_SIZE);
-#endif
+			char *objs = alloc_chunk(increase_size);
 			assert(objs);
 #ifdef USE_IOAT
 			if (pinned) {
@@ -163,6 +155,7 @@ int slab_allocator::alloc(char **objs, int nobjs) {
 			list.add_list(&tmp_list);
 			if (thread_safe)
 				lock.unlock();
+			add_buf(objs, increase_size);
 		}
 		else {
 			if (thread_safe)
@@ -179,8 +172,34 @@ int slab_allocator::alloc(char **objs, int nobjs) {
 #endif
 }
 
-slab_allocator::~slab_allocator()
+char *slab_allocator::alloc_chunk(long size)
+{
+#ifdef USE_NUMA
+	if (node_id == -1)
+		return (char *) numa_alloc_local(size);
+	else
+		return (char *) numa_alloc_onnode(size, node_id);
+#else
+	return (char *) malloc_aligned(size, PAGE_SIZE);
+#endif
+}
+
+void slab_allocator::free_chunk(char *buf, long size)
 {
+#ifdef USE_NUMA
+	numa_free(buf, size);
+#else
+	free(buf);
+#endif
+}
+
+void slab_allocator::free_chunks()
+{
+#ifdef ENABLE_MEM_TRACE
+	if (!alloc_bufs.empty())
+		printf("%s allocate %ld bytes\n", name.c_str(),
+				alloc_bufs.size() * increase_size);
+#endif
 	for (unsigned i = 0; i < alloc_bufs.size(); i++) {
 #ifdef USE_IOAT
 		if (pinned) {
@@ -190,15 +209,14 @@ slab_allocator::~slab_allocator()
 			munlock(alloc_bufs[i], increase_size);
 		}
 #endif
-#ifdef USE_NUMA
-		numa_free(alloc_bufs[i], increase_size);
-#else
-		free(alloc_bufs[i]);
-#endif
+		free_chunk(alloc_bufs[i], increase_size);
 	}
-#ifdef ENABLE_MEM_TRACE
-	printf("%s allocate %ld bytes\n", name.c_str(), alloc_bufs.size() * increase_size);
-#endif
+	alloc_bufs.clear();
+}
+
+slab_allocator::~slab_allocator()
+{
+	free_chunks();
 	if (local_buf_size > 0) {
 		pthread_key_delete(local_buf_key);
 	}
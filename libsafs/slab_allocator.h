@@ -166,6 +166,25 @@ private:
 #ifdef MEMCHECK
 	aligned_allocator allocator;
 #endif
+protected:
+	/*
+	 * This is invoked when the allocator gets a new chunk of memory
+	 * from the operating system.
+	 */
+	virtual void add_buf(char *buf, long size) {
+	}
+
+	/*
+	 * These allocate and free a chunk of memory for objects.
+	 * By default, the memory is allocated from the operating system.
+	 */
+	virtual char *alloc_chunk(long size);
+	virtual void free_chunk(char *buf, long size);
+	/*
+	 * Free all chunks of memory. A subclass that overrides free_chunk()
+	 * should invoke it in its destructor.
+	 */
+	void free_chunks();
 public:
 	slab_allocator(const std::string &name, int _obj_size, long _increase_size,
 			// We allow pages to be pinned when allocated.
@@ -230,7 +249,7 @@ class default_obj_initiator: public obj_initiator<T>
 {
 public:
 	void init(T *obj) {
-		T tmp;
+		T tmp = T();
 		*obj = tmp;
 	}
 };
@@ -269,7 +288,7 @@ public:
 		char *addrs[num];
 		int ret = slab_allocator::alloc(addrs, num);
 		for (int i = 0; i < ret; i++) {
-			objs[i] = (T *) (addrs + sizeof(slab_allocator::linked_obj));
+			objs[i] = (T *) (addrs[i] + sizeof(slab_allocator::linked_obj));
 			initiator->init(objs[i]);
 		}
 		return ret;
@@ -177,6 +177,7 @@ void thread::construct_init()
 	this->id = 0;
 
 	_is_activated = false;
+	activate_time = 0;
 	_has_exit = false;
 	_is_running = true;
 	_is_sleeping = true;
@@ -215,6 +216,41 @@ thread::thread(std::string name, const std::vector<int> &cpu_affinity,
 	this->blocking = blocking;
 }
 
+uint64_t thread::wait(uint64_t poll_ns, bool &polled)
+{
+	polled = false;
+	if (poll_ns > 0) {
+		uint64_t start = safs::get_curr_time_ns();
+		// The activation is checked without the lock, so the thread that
+		// activates us doesn't need to signal us while we are polling.
+		while (!_is_activated && _is_running
+				&& safs::get_curr_time_ns() - start < poll_ns) {
+#if defined(__x86_64__)
+			__builtin_ia32_pause();
+#endif
+		}
+		polled = _is_activated;
+	}
+
+	pthread_mutex_lock(&mutex);
+	while (!_is_activated && _is_running) {
+		_is_sleeping = true;
+		int ret = pthread_cond_wait(&cond, &mutex);
+		_is_sleeping = false;
+		if (ret)
+			perror("pthread_cond_wait");
+	}
+	uint64_t lat = 0;
+	if (_is_activated && activate_time > 0) {
+		uint64_t now = safs::get_curr_time_ns();
+		if (now > activate_time)
+			lat = now - activate_time;
+	}
+	_is_activated = false;
+	pthread_mutex_unlock(&mutex);
+	return lat;
+}
+
 void thread::start()
 {
 	assert(id == 0);
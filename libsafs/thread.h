@@ -32,6 +32,8 @@
 #include "concurrency.h"
 #include "common.h"
 #include "container.h"
+#include "latency_histogram.h"
+#include "parameters.h"
 
 class thread
 {
@@ -53,6 +55,9 @@ class thread
 	volatile bool _is_running;
 	volatile bool _has_exit;
 	volatile bool _is_activated;
+	// The time (ns) when the thread was activated. It's only recorded
+	// when latency statistics are collected.
+	uint64_t activate_time;
 
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;
@@ -83,7 +88,12 @@ public:
 
 	void activate() {
 		bool sleeping;
+		// Reading the clock is only needed for the wake-up latency.
+		uint64_t now = safs::params.is_latency_stat()
+			? safs::get_curr_time_ns() : 0;
 		pthread_mutex_lock(&mutex);
+		if (!_is_activated)
+			activate_time = now;
 		_is_activated = true;
 		sleeping = _is_sleeping;
 		pthread_mutex_unlock(&mutex);
@@ -106,6 +116,16 @@ public:
 		pthread_mutex_unlock(&mutex);
 	}
 
+	/*
+	 * Wait until the thread is activated. The thread polls the activation
+	 * for `poll_ns' nanoseconds before it sleeps.
+	 * It returns the time (ns) between the activation and the moment
+	 * the thread notices it (0 if latency statistics aren't collected),
+	 * and `polled' tells whether the thread was activated while it was
+	 * polling.
+	 */
+	uint64_t wait(uint64_t poll_ns, bool &polled);
+
 	bool is_running() const {
 		return _is_running;
 	}
@@ -97,4 +97,41 @@ int main()
 	printf("hash mapper\n");
 	hash_mapper mapperh("", files, BLOCK_SIZE);
 	test_get_file_sizes(mapperh, BLOCK_SIZE);
+
+	printf("weighted mapper\n");
+	std::vector<double> throughputs(num_files, 500);
+	throughputs[0] = 1000;
+	throughputs[1] = 510;
+	throughputs[2] = 750;
+	std::vector<int> weights = throughput2weights(throughputs);
+	assert(weights[0] == 4 && weights[1] == 2 && weights[2] == 3);
+	for (int i = 3; i < num_files; i++)
+		assert(weights[i] == 2);
+	std::vector<part_file_info> wfiles(num_files);
+	for (int i = 0; i < num_files; i++)
+		wfiles[i].set_weight(weights[i]);
+	weighted_mapper mapperw("", wfiles, BLOCK_SIZE);
+	test_get_file_sizes(mapperw, BLOCK_SIZE);
+	int tot_weight = 0;
+	for (int i = 0; i < num_files; i++)
+		tot_weight += weights[i];
+	std::vector<int> num_blocks(num_files);
+	std::vector<off_t> next_offs(num_files);
+	for (int i = 0; i < tot_weight * 100; i++) {
+		off_t off = i * BLOCK_SIZE;
+		block_identifier bid;
+		mapperw.map(off, bid);
+		assert(bid.idx == mapperw.map2file(off));
+		// The blocks are stored contiguously in each disk.
+		assert(bid.off == next_offs[bid.idx]);
+		next_offs[bid.idx] += BLOCK_SIZE;
+		num_blocks[bid.idx]++;
+	}
+	for (int i = 0; i < num_files; i++)
+		assert(num_blocks[i] == weights[i] * 100);
+	// Consecutive blocks are spread across disks.
+	block_identifier bid1, bid2;
+	mapperw.map(0, bid1);
+	mapperw.map(BLOCK_SIZE, bid2);
+	assert(bid1.idx != bid2.idx);
 }
@@ -1,4 +1,9 @@
+#include <unistd.h>
+
+#include <boost/assert.hpp>
+
 #include "in_mem_io.h"
+#include "native_file.h"
 
 using namespace safs;
 
@@ -97,6 +102,8 @@ void test_load_save(size_t length)
 
 	char *tmp_file = tempnam("/tmp/", "test");
 	buf->dump(tmp_file);
+	// The buffer is padded to pages, but the file has the exact size.
+	BOOST_VERIFY(truncate(tmp_file, length) == 0);
 
 	NUMA_buffer::ptr buf1 = NUMA_buffer::load(tmp_file, mapper);
 	std::unique_ptr<char[]> raw_buf1(new char[length]);
@@ -105,6 +112,32 @@ void test_load_save(size_t length)
 	for (size_t i = 0; i < length; i++)
 		assert(raw_buf[i] == raw_buf1[i]);
 
+	// The data in a mapped file is contiguous.
+	for (int populate = 0; populate < 2; populate++) {
+		NUMA_buffer::ptr buf2 = NUMA_buffer::map(tmp_file, mapper, populate);
+		assert(buf2->is_mapped());
+		assert(buf2->get_length() == length);
+		auto data = buf2->get_data(0, length);
+		assert(data.second == length);
+		assert(memcmp(data.first, raw_buf.get(), length) == 0);
+		// The mapping covers whole pages, but the buffer and its dump
+		// have the size of the file.
+		char *tmp_file2 = tempnam("/tmp/", "test");
+		buf2->dump(tmp_file2);
+		assert(native_file(tmp_file2).get_size() == (ssize_t) length);
+		unlink(tmp_file2);
+		free(tmp_file2);
+
+		// Writes to the buffer don't change the file.
+		long val = -1;
+		buf2->copy_from((const char *) &val, sizeof(val), 0);
+		buf2->copy_to((char *) &val, sizeof(val), 0);
+		assert(val == -1);
+	}
+	NUMA_buffer::ptr buf3 = NUMA_buffer::load(tmp_file, mapper);
+	buf3->copy_to(raw_buf1.get(), length, 0);
+	assert(memcmp(raw_buf.get(), raw_buf1.get(), length) == 0);
+
 	int ret = unlink(tmp_file);
 	assert(ret == 0);
 }
@@ -118,6 +151,8 @@ void test_load_save()
 #endif
 	for (size_t i = 0; i < num_nodes + 5; i++)
 		test_load_save(i * range_size + range_size / 2);
+	// The file size isn't a multiple of pages.
+	test_load_save(range_size + 100);
 }
 
 int main()
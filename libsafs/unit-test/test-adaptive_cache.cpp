@@ -0,0 +1,85 @@
+#include <assert.h>
+
+#include <map>
+#include <string>
+
+#include "associative_cache.h"
+#include "io_interface.h"
+
+using namespace safs;
+
+const int NUM_HOT_PAGES = 6;
+
+/*
+ * Search for a page in the cache, and release it right away.
+ */
+static void access_page(page_cache &cache, const page_id_t &pg_id, int hint)
+{
+	page_id_t old_id;
+	page *pg = cache.search(pg_id, old_id, hint);
+	assert(pg);
+	pg->dec_ref();
+}
+
+static bool is_cached(page_cache &cache, const page_id_t &pg_id)
+{
+	page *pg = cache.search(pg_id);
+	if (pg == NULL)
+		return false;
+	pg->dec_ref();
+	return true;
+}
+
+/*
+ * A sequential scan shouldn't evict the pages accessed repeatedly.
+ */
+void test_scan(page_cache &cache)
+{
+	printf("test a scan on the hot pages\n");
+	for (int k = 0; k < 3; k++)
+		for (int i = 0; i < NUM_HOT_PAGES; i++)
+			access_page(cache, page_id_t(0, i * PAGE_SIZE), ACCESS_HINT_NORMAL);
+
+	for (int i = 0; i < 1000; i++)
+		access_page(cache, page_id_t(1, i * PAGE_SIZE), ACCESS_HINT_SEQUENTIAL);
+
+	for (int i = 0; i < NUM_HOT_PAGES; i++)
+		assert(is_cached(cache, page_id_t(0, i * PAGE_SIZE)));
+}
+
+/*
+ * A page evicted recently and accessed again should go to the active list.
+ */
+void test_shadow(page_cache &cache)
+{
+	printf("test a page evicted recently\n");
+	page_id_t pg_id(2, 0);
+	access_page(cache, pg_id, ACCESS_HINT_NORMAL);
+	int i = 0;
+	while (is_cached(cache, pg_id)) {
+		access_page(cache, page_id_t(3, i * PAGE_SIZE), ACCESS_HINT_NORMAL);
+		i++;
+	}
+
+	page_id_t old_id;
+	thread_safe_page *pg = (thread_safe_page *) cache.search(pg_id, old_id,
+			ACCESS_HINT_NORMAL);
+	assert(pg);
+	assert(pg->active());
+	pg->dec_ref();
+}
+
+int main()
+{
+	std::map<std::string, std::string> configs;
+	configs.insert(std::pair<std::string, std::string>("cache_policy",
+				"adaptive"));
+	params.init(configs);
+
+	// The cache has only one page set.
+	long cache_size = params.get_SA_min_cell_size() * PAGE_SIZE;
+	page_cache::ptr cache = associative_cache::create(cache_size,
+			cache_size, 0, 1, 0);
+	test_scan(*cache);
+	test_shadow(*cache);
+}
@@ -0,0 +1,112 @@
+#include <assert.h>
+
+#include <map>
+#include <string>
+
+#include <boost/assert.hpp>
+
+#include "associative_cache.h"
+#include "io_interface.h"
+
+using namespace safs;
+
+const int NUM_CELLS = 64;
+
+static void access_pages(page_cache &cache, int num)
+{
+	for (int i = 0; i < num; i++) {
+		page_id_t old_id;
+		page *pg = cache.search(page_id_t(0, i * PAGE_SIZE), old_id,
+				ACCESS_HINT_NORMAL);
+		assert(pg);
+		pg->dec_ref();
+	}
+}
+
+/*
+ * It releases at most `avail' bytes.
+ */
+class test_mem_callback: public mem_pressure_callback
+{
+public:
+	size_t avail;
+	int num_calls;
+
+	test_mem_callback(size_t avail) {
+		this->avail = avail;
+		num_calls = 0;
+	}
+
+	virtual size_t release(size_t size) {
+		num_calls++;
+		size_t ret = std::min(size, avail);
+		avail -= ret;
+		return ret;
+	}
+};
+
+static void test_mem_budget()
+{
+	std::map<std::string, std::string> configs;
+	configs["mem_budget"] = "1M";
+	params.init(configs);
+	const size_t MB = 1024 * 1024;
+
+	printf("reserve memory in the budget\n");
+	std::shared_ptr<test_mem_callback> cb(new test_mem_callback(MB / 2));
+	register_mem_pressure_callback(cb);
+	reserve_memory(MB);
+	assert(cb->num_calls == 0);
+	// The callback releases all it can, but it isn't enough.
+	reserve_memory(MB);
+	assert(cb->num_calls == 1);
+	assert(cb->avail == 0);
+	// The callbacks aren't asked again until memory is returned.
+	reserve_memory(MB);
+	reserve_memory(MB);
+	assert(cb->num_calls == 1);
+	release_memory(MB);
+	reserve_memory(MB);
+	assert(cb->num_calls == 2);
+
+	release_memory(4 * MB);
+	unregister_mem_pressure_callback(cb);
+}
+
+int main()
+{
+	test_mem_budget();
+
+	std::map<std::string, std::string> configs;
+	params.init(configs);
+
+	long cache_size = NUM_CELLS * params.get_SA_min_cell_size() * PAGE_SIZE;
+	page_cache::ptr cache = associative_cache::create(cache_size,
+			cache_size, 0, 1, 0);
+	access_pages(*cache, cache_size / PAGE_SIZE * 2);
+	assert(cache->size() == cache_size);
+
+	printf("shrink the cache\n");
+	long new_size = cache->resize(cache_size / 4);
+	// A cell keeps a minimal number of pages.
+	assert(new_size == NUM_CELLS * CELL_MIN_NUM_PAGES * PAGE_SIZE);
+	cache->sanity_check();
+	access_pages(*cache, cache_size / PAGE_SIZE * 2);
+
+	// A page in use can't be released.
+	page_id_t old_id;
+	page *pg = cache->search(page_id_t(1, 0), old_id, ACCESS_HINT_NORMAL);
+	printf("grow the cache\n");
+	new_size = cache->resize(cache_size * 2);
+	assert(new_size == cache_size);
+	new_size = cache->resize(0);
+	assert(new_size == NUM_CELLS * CELL_MIN_NUM_PAGES * PAGE_SIZE);
+	BOOST_VERIFY(cache->search(page_id_t(1, 0)) == pg);
+	pg->dec_ref();
+	pg->dec_ref();
+
+	new_size = cache->resize(cache_size);
+	assert(new_size == cache_size);
+	cache->sanity_check();
+	access_pages(*cache, cache_size / PAGE_SIZE * 2);
+}
@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <boost/assert.hpp>
+
+#include "io_interface.h"
+#include "io_request.h"
+#include "safs_file.h"
+#include "global_cached_private.h"
+#include "cache_warm.h"
+
+using namespace safs;
+
+void test_merge()
+{
+	printf("test merging cached pages\n");
+	std::vector<std::pair<std::string, off_t> > pages;
+	off_t offs[] = {5, 3, 4, 10, 0, 4, 11};
+	for (size_t i = 0; i < sizeof(offs) / sizeof(offs[0]); i++)
+		pages.push_back(std::pair<std::string, off_t>("file1",
+					offs[i] * PAGE_SIZE));
+	pages.push_back(std::pair<std::string, off_t>("file 2", 0));
+	cached_page_map merged = merge_cached_pages(pages);
+	assert(merged.size() == 2);
+
+	const page_range_list &ranges = merged["file1"];
+	assert(ranges.size() == 3);
+	assert(ranges[0].first == 0 && ranges[0].second == PAGE_SIZE);
+	assert(ranges[1].first == 3 * PAGE_SIZE
+			&& ranges[1].second == 3 * PAGE_SIZE);
+	assert(ranges[2].first == 10 * PAGE_SIZE
+			&& ranges[2].second == 2 * PAGE_SIZE);
+	assert(merged["file 2"].size() == 1);
+}
+
+void test_save_load()
+{
+	printf("test saving and loading cached pages\n");
+	std::string file = "/tmp/test-cache_warm.txt";
+	cached_page_map pages;
+	pages["file1"].push_back(std::pair<off_t, size_t>(0, PAGE_SIZE));
+	pages["file1"].push_back(std::pair<off_t, size_t>(PAGE_SIZE * 100,
+				PAGE_SIZE * 3));
+	pages["file 2"].push_back(std::pair<off_t, size_t>(PAGE_SIZE * 7,
+				PAGE_SIZE));
+	BOOST_VERIFY(save_cached_pages(file, pages));
+
+	cached_page_map loaded;
+	BOOST_VERIFY(load_cached_pages(file, loaded));
+	assert(loaded == pages);
+	unlink(file.c_str());
+
+	BOOST_VERIFY(!load_cached_pages(file, loaded));
+	FILE *f = fopen(file.c_str(), "w");
+	fprintf(f, "file1 100\n");
+	fclose(f);
+	cached_page_map corrupted;
+	BOOST_VERIFY(!load_cached_pages(file, corrupted));
+	assert(corrupted.empty());
+
+	// A corrupted line is dropped as a whole, but the other lines
+	// are still loaded.
+	f = fopen(file.c_str(), "w");
+	fprintf(f, "file1 0 4096\n");
+	fprintf(f, "file1 8192 4096x\n");
+	fprintf(f, "file1 100 4096\n");
+	fprintf(f, "file 2 4096 8192\n");
+	fprintf(f, "file1 16384 40");
+	fclose(f);
+	BOOST_VERIFY(!load_cached_pages(file, corrupted));
+	assert(corrupted.size() == 2);
+	assert(corrupted["file1"].size() == 1);
+	assert(corrupted["file1"][0].first == 0
+			&& corrupted["file1"][0].second == PAGE_SIZE);
+	assert(corrupted["file 2"].size() == 1);
+	assert(corrupted["file 2"][0].first == PAGE_SIZE
+			&& corrupted["file 2"][0].second == PAGE_SIZE * 2);
+	unlink(file.c_str());
+}
+
+/*
+ * Read pages through the page cache in a run of SAFS. They are read back
+ * to the page cache when the file is opened in the next run, so reading
+ * them again only hits the cache.
+ */
+void test_reload(const std::string &conf_file)
+{
+	printf("test reading cached pages back to the page cache\n");
+	std::string warm_file = "/tmp/test-cache_warm.pages";
+	std::string file_name = "test-cache_warm";
+	unlink(warm_file.c_str());
+	config_map::ptr configs = config_map::create(conf_file);
+	configs->add_options("writable=1");
+	configs->add_options("cache_warm_file=" + warm_file);
+	init_io_system(configs);
+
+	const int NUM_PAGES = 16;
+	safs_file file(get_sys_RAID_conf(), file_name);
+	BOOST_VERIFY(file.create_file(NUM_PAGES * 4 * PAGE_SIZE));
+	std::vector<off_t> offs;
+	for (int i = 0; i < NUM_PAGES; i++)
+		offs.push_back((i < NUM_PAGES / 2 ? i : i + NUM_PAGES) * PAGE_SIZE);
+	char *buf = NULL;
+	BOOST_VERIFY(posix_memalign((void **) &buf, PAGE_SIZE, PAGE_SIZE) == 0);
+
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			GLOBAL_CACHE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	for (size_t i = 0; i < offs.size(); i++)
+		BOOST_VERIFY(io->access(buf, offs[i], PAGE_SIZE, READ) == IO_OK);
+	io = NULL;
+	factory = NULL;
+	destroy_io_system();
+
+	// The pages of the file are saved in two ranges.
+	cached_page_map saved;
+	BOOST_VERIFY(load_cached_pages(warm_file, saved));
+	const page_range_list &ranges = saved[file_name];
+	assert(ranges.size() == 2);
+	assert(ranges[0].first == offs[0]
+			&& ranges[0].second == PAGE_SIZE * NUM_PAGES / 2);
+	assert(ranges[1].first == offs[NUM_PAGES / 2]
+			&& ranges[1].second == PAGE_SIZE * NUM_PAGES / 2);
+
+	init_io_system(configs);
+	factory = create_io_factory(file_name, GLOBAL_CACHE_ACCESS);
+	io = create_io(factory, thread::get_curr_thread());
+	for (size_t i = 0; i < offs.size(); i++)
+		BOOST_VERIFY(io->access(buf, offs[i], PAGE_SIZE, READ) == IO_OK);
+	assert(((global_cached_io &) *io).get_cache_hits() == offs.size());
+	io = NULL;
+	factory = NULL;
+	free(buf);
+	file.delete_file();
+	destroy_io_system();
+	unlink(warm_file.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+	test_merge();
+	test_save_load();
+	// Reading pages back to the page cache requires a SAFS configuration.
+	if (argc >= 2)
+		test_reload(argv[1]);
+}
@@ -0,0 +1,101 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include "checksum.h"
+#include "common.h"
+
+using namespace safs;
+
+void test_crc32c()
+{
+	printf("test CRC32C (hardware: %d)\n", crc32c_hw_supported());
+	const char *str = "123456789";
+	assert(crc32c(0, str, strlen(str)) == 0xE3069283);
+	assert(crc32c_sw(0, str, strlen(str)) == 0xE3069283);
+	assert(crc32c(0, str, 0) == 0);
+
+	std::vector<char> data(10000);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = random();
+	uint32_t crc = crc32c(0, data.data(), data.size());
+	assert(crc == crc32c_sw(0, data.data(), data.size()));
+	// The CRC can be computed incrementally.
+	for (size_t split = 0; split < 20; split++) {
+		uint32_t part = crc32c(0, data.data(), split);
+		assert(crc32c(part, data.data() + split, data.size() - split) == crc);
+	}
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 1000; i++)
+		crc = crc32c(crc, data.data(), data.size());
+	gettimeofday(&end, NULL);
+	printf("CRC32C: %.1f MB/s\n", data.size() * 1000.0 / 1024 / 1024
+			/ time_diff(start, end));
+}
+
+void test_table()
+{
+	printf("test the checksum table\n");
+	const size_t block_size = 4096;
+	std::vector<char> data(block_size * 10 + 100);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = random();
+	block_checksum_table table(block_size);
+	// Blocks may span multiple appends.
+	table.append(data.data(), 1000);
+	table.append(data.data() + 1000, data.size() - 1000);
+	assert(table.get_num_blocks() == 10);
+	assert(table.get_checksum(3) == crc32c(0, data.data() + block_size * 3,
+				block_size));
+
+	struct iovec vec;
+	vec.iov_base = data.data();
+	vec.iov_len = data.size();
+	assert(table.verify(0, &vec, 1) == -1);
+
+	// The data is split into multiple buffers.
+	std::vector<struct iovec> vecs;
+	for (size_t off = block_size; off < block_size * 5; off += 1024) {
+		struct iovec v;
+		v.iov_base = data.data() + off;
+		v.iov_len = 1024;
+		vecs.push_back(v);
+	}
+	assert(table.verify(block_size, vecs.data(), vecs.size()) == -1);
+
+	// The corrupted data in a partial block isn't checked.
+	data[block_size * 2 + 10]++;
+	vec.iov_base = data.data() + block_size * 2 + 512;
+	vec.iov_len = block_size * 2;
+	assert(table.verify(block_size * 2 + 512, &vec, 1) == -1);
+	vec.iov_base = data.data();
+	vec.iov_len = data.size();
+	assert(table.verify(0, &vec, 1) == (off_t) block_size * 2);
+	assert(table.verify(block_size, vecs.data(), vecs.size())
+			== (off_t) block_size * 2);
+	data[block_size * 2 + 10]--;
+
+	std::string file = "/tmp/test-checksum_table";
+	BOOST_VERIFY(table.dump(file));
+	block_checksum_table::ptr loaded = block_checksum_table::load(file);
+	assert(loaded);
+	assert(loaded->get_block_size() == block_size);
+	assert(loaded->get_num_blocks() == table.get_num_blocks());
+	for (size_t i = 0; i < table.get_num_blocks(); i++)
+		assert(loaded->get_checksum(i) == table.get_checksum(i));
+	unlink(file.c_str());
+}
+
+int main()
+{
+	test_crc32c();
+	test_table();
+}
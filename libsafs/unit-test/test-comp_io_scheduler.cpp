@@ -0,0 +1,207 @@
+#include <assert.h>
+
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include "comp_io_scheduler.h"
+#include "io_interface.h"
+#include "thread.h"
+
+using namespace safs;
+
+/*
+ * The scheduler only needs an I/O instance to create requests.
+ */
+class dummy_io: public io_interface
+{
+public:
+	dummy_io(thread *t): io_interface(t, safs_header()) {
+	}
+
+	virtual int get_file_id() const {
+		return 0;
+	}
+
+	virtual void access(io_request *requests, int num, io_status *status) {
+		assert(0);
+	}
+
+	virtual void flush_requests() {
+	}
+
+	virtual int wait4complete(int num) {
+		return 0;
+	}
+
+	virtual int num_pending_ios() const {
+		return 0;
+	}
+};
+
+/*
+ * This user task issues a request to each page in a list.
+ */
+class list_compute: public user_compute
+{
+	std::vector<off_t> pages;
+	size_t idx;
+public:
+	list_compute(compute_allocator *alloc,
+			const std::vector<off_t> &pages): user_compute(alloc) {
+		this->pages = pages;
+		idx = 0;
+	}
+
+	virtual int serialize(char *buf, int size) const {
+		return 0;
+	}
+
+	virtual int get_serialized_size() const {
+		return 0;
+	}
+
+	virtual void run(page_byte_array &arr) {
+		assert(0);
+	}
+
+	virtual bool has_completed() {
+		return !has_requests();
+	}
+
+	virtual int has_requests() {
+		return idx < pages.size();
+	}
+
+	virtual request_range get_next_request() {
+		data_loc_t loc(0, pages[idx++] * PAGE_SIZE);
+		return request_range(loc, PAGE_SIZE, READ, this);
+	}
+};
+
+class list_compute_allocator: public compute_allocator
+{
+public:
+	int num_frees;
+
+	list_compute_allocator() {
+		num_frees = 0;
+	}
+
+	virtual user_compute *alloc() {
+		assert(0);
+		return NULL;
+	}
+
+	virtual void free(user_compute *compute) {
+		num_frees++;
+		delete compute;
+	}
+};
+
+static void add_compute(comp_io_scheduler &sched,
+		list_compute_allocator &alloc, const std::vector<off_t> &pages)
+{
+	user_compute *compute = new list_compute(&alloc, pages);
+	// The scheduler takes the reference that an I/O request would hold.
+	compute->inc_ref();
+	sched.post_comp_process(compute);
+}
+
+/*
+ * Get all requests from the scheduler in rounds of `max' requests.
+ */
+static std::vector<io_request> get_all_requests(comp_io_scheduler &sched,
+		size_t max)
+{
+	std::vector<io_request> ret;
+	fifo_queue<io_request> reqs(0, max, false);
+	while (true) {
+		size_t num = sched.get_requests(reqs, max);
+		if (num == 0)
+			break;
+		assert(num <= max);
+		for (size_t i = 0; i < num; i++) {
+			ret.push_back(reqs.front());
+			reqs.pop_front();
+		}
+	}
+	return ret;
+}
+
+static void release_requests(comp_io_scheduler &sched,
+		std::vector<io_request> &reqs)
+{
+	for (size_t i = 0; i < reqs.size(); i++)
+		sched.post_comp_process(reqs[i].get_compute());
+	sched.gc_computes();
+	assert(sched.is_empty());
+}
+
+/*
+ * The requests of all user tasks in a window are sorted by their locations.
+ */
+static void test_sorted_window(io_interface *io)
+{
+	printf("test a window with all requests\n");
+	list_compute_allocator alloc;
+	coalesce_comp_io_scheduler sched(0, 16);
+	sched.set_io(io);
+	off_t pages1[] = {5, 1, 9};
+	off_t pages2[] = {4, 0, 8};
+	off_t pages3[] = {6, 2, 7, 3};
+	add_compute(sched, alloc, std::vector<off_t>(pages1, pages1 + 3));
+	add_compute(sched, alloc, std::vector<off_t>(pages2, pages2 + 3));
+	add_compute(sched, alloc, std::vector<off_t>(pages3, pages3 + 4));
+
+	std::vector<io_request> reqs = get_all_requests(sched, 3);
+	assert(reqs.size() == 10);
+	for (size_t i = 0; i < reqs.size(); i++) {
+		assert(reqs[i].get_offset() == (off_t) (i * PAGE_SIZE));
+		assert(reqs[i].get_io() == io);
+	}
+	release_requests(sched, reqs);
+	assert(alloc.num_frees == 3);
+}
+
+/*
+ * When the user tasks have more requests than a window, each window is
+ * sorted, and every user task gets to issue requests.
+ */
+static void test_multi_windows(io_interface *io)
+{
+	printf("test multiple windows\n");
+	list_compute_allocator alloc;
+	coalesce_comp_io_scheduler sched(0, 4);
+	sched.set_io(io);
+	off_t pages1[] = {7, 3, 5, 1};
+	off_t pages2[] = {6, 2, 4, 0};
+	add_compute(sched, alloc, std::vector<off_t>(pages1, pages1 + 4));
+	add_compute(sched, alloc, std::vector<off_t>(pages2, pages2 + 4));
+
+	std::vector<io_request> reqs = get_all_requests(sched, 8);
+	assert(reqs.size() == 8);
+	for (size_t i = 0; i < reqs.size(); i += 4) {
+		for (size_t j = i + 1; j < i + 4; j++)
+			assert(reqs[j - 1].get_offset() < reqs[j].get_offset());
+	}
+	// All pages are requested once.
+	std::vector<bool> requested(8);
+	for (size_t i = 0; i < reqs.size(); i++) {
+		off_t pg = reqs[i].get_offset() / PAGE_SIZE;
+		assert(!requested[pg]);
+		requested[pg] = true;
+	}
+	release_requests(sched, reqs);
+	assert(alloc.num_frees == 2);
+}
+
+int main()
+{
+	std::map<std::string, std::string> configs;
+	params.init(configs);
+	thread::thread_class_init();
+	dummy_io io(thread::get_curr_thread());
+	test_sorted_window(&io);
+	test_multi_windows(&io);
+}
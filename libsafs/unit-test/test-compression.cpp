@@ -0,0 +1,203 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include "compression.h"
+#include "remote_access.h"
+
+using namespace safs;
+
+const size_t BLOCK_SIZE = 16 * 4096;
+
+/*
+ * Compress and decompress the data, and return the compressed size.
+ */
+static size_t test_round_trip(const std::vector<char> &data,
+		int codec = COMPRESS_LZ)
+{
+	std::vector<char> compressed(data.size() * 2);
+	size_t csize = compress_block(codec, data.data(), data.size(),
+			compressed.data(), compressed.size());
+	assert(csize > 0);
+	// The compressed data doesn't fit in the buffer.
+	BOOST_VERIFY(compress_block(codec, data.data(), data.size(),
+				compressed.data(), csize - 1) == 0);
+
+	std::vector<char> decompressed(data.size());
+	ssize_t size = decompress_block(codec, compressed.data(), csize,
+			decompressed.data(), decompressed.size());
+	assert(size == (ssize_t) data.size());
+	assert(memcmp(data.data(), decompressed.data(), data.size()) == 0);
+
+	// The decompressed data doesn't fit in the buffer.
+	size = decompress_block(codec, compressed.data(), csize,
+			decompressed.data(), decompressed.size() - 1);
+	assert(size < 0);
+	return csize;
+}
+
+void test_codec()
+{
+	printf("test the LZ codec\n");
+	// An adjacency list: sorted vertex IDs with small gaps.
+	std::vector<char> data(BLOCK_SIZE);
+	int *ids = (int *) data.data();
+	ids[0] = 1000;
+	for (size_t i = 1; i < BLOCK_SIZE / sizeof(int); i++)
+		ids[i] = ids[i - 1] + random() % 4;
+	BOOST_VERIFY(test_round_trip(data) < data.size());
+
+	// A block full of zero and a block with a short repeated pattern.
+	memset(data.data(), 0, data.size());
+	BOOST_VERIFY(test_round_trip(data) < data.size() / 100);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = "abc"[i % 3];
+	BOOST_VERIFY(test_round_trip(data) < data.size() / 100);
+
+	// Random data can't be compressed.
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = random();
+	BOOST_VERIFY(test_round_trip(data) > data.size());
+
+	// Small blocks.
+	for (size_t size = 0; size < 16; size++) {
+		std::vector<char> small(size, 'a');
+		std::vector<char> compressed(64);
+		size_t csize = compress_block(COMPRESS_LZ, small.data(), size,
+				compressed.data(), compressed.size());
+		assert(csize > 0);
+		std::vector<char> decompressed(size);
+		BOOST_VERIFY(decompress_block(COMPRESS_LZ, compressed.data(), csize,
+					decompressed.data(), size) == (ssize_t) size);
+		assert(small == decompressed);
+	}
+}
+
+void test_delta_codec()
+{
+	printf("test the delta codec\n");
+	// Adjacency lists: a vertex header followed by sorted neighbor IDs.
+	std::vector<char> data(BLOCK_SIZE);
+	uint64_t *words = (uint64_t *) data.data();
+	size_t num_words = BLOCK_SIZE / sizeof(uint64_t);
+	for (size_t i = 0; i < num_words; ) {
+		size_t num_edges = std::min<size_t>(random() % 100, num_words - i - 1);
+		words[i++] = random();
+		uint64_t id = random() % 1000000;
+		for (size_t j = 0; j < num_edges; j++) {
+			words[i++] = id;
+			id += random() % 100;
+		}
+	}
+	// The neighbor IDs take less than 2 bytes on average.
+	BOOST_VERIFY(test_round_trip(data, COMPRESS_DELTA_VARINT) < data.size() / 4);
+
+	// Negative differences and large values.
+	words[0] = -1;
+	words[1] = 0;
+	words[2] = 1UL << 63;
+	test_round_trip(data, COMPRESS_DELTA_VARINT);
+
+	// The size isn't a multiple of words.
+	for (size_t size = 0; size < 32; size++) {
+		std::vector<char> small(data.begin(), data.begin() + size);
+		std::vector<char> compressed(128);
+		size_t csize = compress_block(COMPRESS_DELTA_VARINT, small.data(),
+				size, compressed.data(), compressed.size());
+		assert(csize > 0);
+		std::vector<char> decompressed(size);
+		BOOST_VERIFY(decompress_block(COMPRESS_DELTA_VARINT, compressed.data(),
+					csize, decompressed.data(), size) == (ssize_t) size);
+		assert(small == decompressed);
+		// Truncated data is detected.
+		if (size >= sizeof(uint64_t))
+			BOOST_VERIFY(decompress_block(COMPRESS_DELTA_VARINT, compressed.data(),
+						csize - 1, decompressed.data(), size) < (ssize_t) size);
+	}
+	assert(get_codec("delta") == COMPRESS_DELTA_VARINT);
+	assert(get_codec("lz") == COMPRESS_LZ);
+	assert(get_codec("none") < 0);
+	// The delta codec compresses each page separately, so a random read
+	// of a page doesn't decompress the entire RAID block.
+	assert(get_compress_unit(COMPRESS_DELTA_VARINT, 64) == 1);
+	// The LZ units are bounded to limit the decoding of a random read.
+	assert(get_compress_unit(COMPRESS_LZ, 64) == MAX_LZ_UNIT);
+	assert(get_compress_unit(COMPRESS_LZ, 8) == 8);
+	assert(get_compress_unit(COMPRESS_LZ, 24) == 12);
+}
+
+void test_table()
+{
+	printf("test the compression table\n");
+	block_compress_table table(COMPRESS_LZ, BLOCK_SIZE / 4096);
+	table.set_compressed_size(0, 100);
+	table.set_compressed_size(2, 300);
+	table.set_compressed_size(3, 0);
+	assert(table.get_num_blocks() == 4);
+	assert(table.get_num_compressed_blocks() == 2);
+	assert(table.get_tot_compressed_bytes() == 400);
+
+	std::string file = "/tmp/test-compress_table";
+	BOOST_VERIFY(table.dump(file));
+	block_compress_table::ptr loaded = block_compress_table::load(file);
+	assert(loaded);
+	assert(loaded->get_codec() == COMPRESS_LZ);
+	assert(loaded->get_block_size() == (int) (BLOCK_SIZE / 4096));
+	assert(loaded->get_num_blocks() == 4);
+	assert(loaded->get_compressed_size(0) == 100);
+	assert(loaded->get_compressed_size(1) == 0);
+	assert(loaded->get_compressed_size(2) == 300);
+	// The blocks out of the table are stored uncompressed.
+	assert(loaded->get_compressed_size(10) == 0);
+	unlink(file.c_str());
+}
+
+/*
+ * remote_io only splits requests at the RAID blocks and the boundaries of
+ * the compressed blocks.
+ */
+void test_split()
+{
+	printf("test splitting requests on compressed blocks\n");
+	const off_t P = PAGE_SIZE;
+	// RAID blocks have 8 pages.
+	assert(get_split_end(NULL, 8, 0, 20 * P) == 8 * P);
+	assert(get_split_end(NULL, 8, 3 * P, 5 * P) == 5 * P);
+
+	// Pages 2, 3 and 9 are compressed.
+	block_compress_table table(COMPRESS_DELTA_VARINT, 1);
+	table.set_compressed_size(2, 100);
+	table.set_compressed_size(3, 200);
+	table.set_compressed_size(9, 300);
+	table.set_compressed_size(12, 0);
+	assert(get_split_end(&table, 8, 0, 16 * P) == 2 * P);
+	assert(get_split_end(&table, 8, 2 * P, 16 * P) == 3 * P);
+	assert(get_split_end(&table, 8, 3 * P, 16 * P) == 4 * P);
+	// The uncompressed pages are read together up to the RAID block.
+	assert(get_split_end(&table, 8, 4 * P, 16 * P) == 8 * P);
+	assert(get_split_end(&table, 8, 4 * P, 6 * P) == 6 * P);
+	assert(get_split_end(&table, 8, 8 * P, 16 * P) == 9 * P);
+	assert(get_split_end(&table, 8, 9 * P, 16 * P) == 10 * P);
+	assert(get_split_end(&table, 8, 10 * P, 16 * P) == 16 * P);
+	// A read inside a compressed block isn't split.
+	block_compress_table lz_table(COMPRESS_LZ, 4);
+	lz_table.set_compressed_size(1, 1000);
+	assert(get_split_end(&lz_table, 8, 5 * P, 7 * P) == 7 * P);
+	assert(get_split_end(&lz_table, 8, 5 * P, 16 * P) == 8 * P);
+	assert(get_split_end(&lz_table, 8, 0, 16 * P) == 4 * P);
+}
+
+int main()
+{
+	test_codec();
+	test_delta_codec();
+	test_table();
+	test_split();
+}
@@ -0,0 +1,327 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <string>
+#include <vector>
+
+#include "io_interface.h"
+#include "safs_file.h"
+#include "file_mapper.h"
+#include "RAID_config.h"
+#include "cache.h"
+
+using namespace safs;
+
+static const size_t FILE_SIZE = 32 * 1024 * 1024;
+
+/*
+ * Each page of the file is filled with its page number, so the file
+ * can be compressed.
+ */
+std::string create_ext_file()
+{
+	char name[] = "/tmp/test-corrupt_readXXXXXX";
+	int fd = mkstemp(name);
+	assert(fd >= 0);
+	std::vector<long> page(PAGE_SIZE / sizeof(long));
+	for (size_t i = 0; i < FILE_SIZE / PAGE_SIZE; i++) {
+		std::fill(page.begin(), page.end(), i);
+		BOOST_VERIFY(write(fd, page.data(), PAGE_SIZE) == PAGE_SIZE);
+	}
+	close(fd);
+	return name;
+}
+
+/*
+ * Overwrite the data of an SAFS file on the disk.
+ */
+void corrupt_data(const std::string &file_name, off_t off, size_t size)
+{
+	std::shared_ptr<file_mapper> mapper
+		= get_sys_RAID_conf().create_file_mapper(file_name);
+	struct block_identifier bid;
+	mapper->map(off / PAGE_SIZE, bid);
+	std::string path = mapper->get_file_name(bid.idx);
+	int fd = open(path.c_str(), O_WRONLY);
+	assert(fd >= 0);
+	std::vector<char> garbage(size, 0xff);
+	BOOST_VERIFY(pwrite(fd, garbage.data(), size,
+				bid.off * PAGE_SIZE + off % PAGE_SIZE) == (ssize_t) size);
+	close(fd);
+}
+
+bool check_data(const char *buf, off_t off, size_t size)
+{
+	const long *vs = (const long *) buf;
+	for (size_t i = 0; i < size / sizeof(long); i++)
+		if (vs[i] != (long) ((off + i * sizeof(long)) / PAGE_SIZE))
+			return false;
+	return true;
+}
+
+class test_callback: public callback
+{
+public:
+	std::vector<off_t> failed;
+	std::vector<off_t> succeeded;
+
+	virtual int invoke(io_request *reqs[], int num) {
+		for (int i = 0; i < num; i++) {
+			if (reqs[i]->is_failed())
+				failed.push_back(reqs[i]->get_offset());
+			else {
+				assert(check_data(reqs[i]->get_buf(), reqs[i]->get_offset(),
+							reqs[i]->get_size()));
+				succeeded.push_back(reqs[i]->get_offset());
+			}
+			free(reqs[i]->get_buf());
+		}
+		return 0;
+	}
+};
+
+class count_compute_allocator;
+
+/*
+ * This user task reads a page and counts whether it runs or fails.
+ */
+class count_compute: public user_compute
+{
+	bool completed;
+public:
+	count_compute(compute_allocator *alloc): user_compute(alloc) {
+		completed = false;
+	}
+
+	virtual int serialize(char *buf, int size) const {
+		return 0;
+	}
+
+	virtual int get_serialized_size() const {
+		return 0;
+	}
+
+	virtual void run(page_byte_array &arr);
+	virtual void fail(const request_range &range);
+
+	virtual bool has_completed() {
+		return completed;
+	}
+
+	virtual int has_requests() {
+		return 0;
+	}
+
+	virtual request_range get_next_request() {
+		assert(0);
+		return request_range();
+	}
+};
+
+class count_compute_allocator: public compute_allocator
+{
+public:
+	std::vector<off_t> failed;
+	std::vector<off_t> succeeded;
+
+	virtual user_compute *alloc() {
+		return new count_compute(this);
+	}
+
+	virtual void free(user_compute *compute) {
+		delete compute;
+	}
+};
+
+void count_compute::run(page_byte_array &arr)
+{
+	std::vector<char> buf(arr.get_size());
+	arr.memcpy(0, buf.data(), buf.size());
+	assert(check_data(buf.data(), arr.get_offset(), buf.size()));
+	((count_compute_allocator *) get_allocator())->succeeded.push_back(
+			arr.get_offset());
+	completed = true;
+}
+
+void count_compute::fail(const request_range &range)
+{
+	((count_compute_allocator *) get_allocator())->failed.push_back(
+			range.get_loc().get_offset());
+	completed = true;
+}
+
+/*
+ * Run a user task on the page in the corrupted block and on the page in
+ * a good block. Only the task on the good page runs.
+ */
+void compute_corrupted(const std::string &file_name, int access_option,
+		off_t bad_off, off_t good_off)
+{
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			access_option);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	count_compute_allocator alloc;
+	off_t offs[] = {bad_off, good_off};
+	for (int i = 0; i < 2; i++) {
+		user_compute *compute = alloc.alloc();
+		data_loc_t loc(io->get_file_id(), offs[i]);
+		io_request req(compute, loc, PAGE_SIZE, READ);
+		io->access(&req, 1);
+	}
+	while (io->num_pending_ios() > 0)
+		io->wait4complete(io->num_pending_ios());
+	assert(alloc.failed.size() == 1 && alloc.failed[0] == bad_off);
+	assert(alloc.succeeded.size() == 1 && alloc.succeeded[0] == good_off);
+}
+
+/*
+ * Read a page in the corrupted block and a page in a good block.
+ * The caller should see the failed read and the I/O system should keep
+ * working.
+ */
+void read_corrupted(const std::string &file_name, off_t bad_off,
+		off_t good_off)
+{
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	test_callback *cb = new test_callback();
+	io->set_callback(callback::ptr(cb));
+	for (int i = 0; i < 2; i++) {
+		off_t offs[] = {bad_off, good_off};
+		for (int j = 0; j < 2; j++) {
+			char *buf = NULL;
+			BOOST_VERIFY(posix_memalign((void **) &buf, PAGE_SIZE,
+						PAGE_SIZE) == 0);
+			data_loc_t loc(io->get_file_id(), offs[j]);
+			io_request req(buf, loc, PAGE_SIZE, READ);
+			io->access(&req, 1);
+		}
+		io->wait4complete(2);
+	}
+	assert(cb->failed.size() == 2);
+	assert(cb->failed[0] == bad_off && cb->failed[1] == bad_off);
+	assert(cb->succeeded.size() == 2);
+	assert(cb->succeeded[0] == good_off && cb->succeeded[1] == good_off);
+	io = NULL;
+
+	// A synchronous read in the page cache fails as well.
+	factory = create_io_factory(file_name, GLOBAL_CACHE_ACCESS);
+	io = create_io(factory, thread::get_curr_thread());
+	char *buf = NULL;
+	BOOST_VERIFY(posix_memalign((void **) &buf, PAGE_SIZE, PAGE_SIZE) == 0);
+	io_status status = io->access(buf, bad_off, PAGE_SIZE, READ);
+	assert(status == IO_FAIL);
+	status = io->access(buf, good_off, PAGE_SIZE, READ);
+	assert(status == IO_OK);
+	assert(check_data(buf, good_off, PAGE_SIZE));
+	// The page of the failed read isn't cached, so it fails again instead
+	// of returning its data.
+	status = io->access(buf, bad_off, PAGE_SIZE, READ);
+	assert(status == IO_FAIL);
+	free(buf);
+	io = NULL;
+
+	compute_corrupted(file_name, GLOBAL_CACHE_ACCESS, bad_off, good_off);
+	compute_corrupted(file_name, DIRECT_COMP_ACCESS, bad_off, good_off);
+}
+
+void test_compressed(const std::string &ext_file)
+{
+	printf("test reading a corrupted compressed block\n");
+	std::string file_name = "test-corrupt_read-compressed";
+	safs_file file(get_sys_RAID_conf(), file_name);
+	BOOST_VERIFY(file.load_data(ext_file, params.get_RAID_block_size(),
+				COMPRESS_LZ));
+	block_compress_table::ptr table = file.get_compress_table();
+	assert(table && table->get_num_blocks() > 1);
+	// The first compressed block can't be decompressed.
+	size_t compressed_size = table->get_compressed_size(0);
+	assert(compressed_size > 0);
+	corrupt_data(file_name, 0, compressed_size);
+	// Sync I/O doesn't decompress data.
+	bool rejected = false;
+	try {
+		create_io_factory(file_name, READ_ACCESS);
+	} catch (io_exception &e) {
+		rejected = true;
+	}
+	assert(rejected);
+
+	read_corrupted(file_name, PAGE_SIZE,
+			params.get_RAID_block_size() * PAGE_SIZE + PAGE_SIZE);
+	file.delete_file();
+}
+
+void test_checksum(const std::string &ext_file)
+{
+	printf("test reading a block with a wrong checksum\n");
+	std::string file_name = "test-corrupt_read-checksum";
+	safs_file file(get_sys_RAID_conf(), file_name);
+	BOOST_VERIFY(file.load_data(ext_file, params.get_RAID_block_size()));
+	assert(file.get_checksum_table());
+	corrupt_data(file_name, PAGE_SIZE, PAGE_SIZE);
+
+	read_corrupted(file_name, PAGE_SIZE,
+			params.get_RAID_block_size() * PAGE_SIZE + PAGE_SIZE);
+	file.delete_file();
+}
+
+/*
+ * A file with checksums can't be written whether or not the checksums
+ * are verified, because the checksums aren't updated by writes.
+ */
+void test_write_checksummed(const std::string &ext_file)
+{
+	printf("test writing a file with checksums\n");
+	std::string file_name = "test-corrupt_read-write";
+	safs_file file(get_sys_RAID_conf(), file_name);
+	BOOST_VERIFY(file.load_data(ext_file, params.get_RAID_block_size()));
+	assert(get_sys_RAID_conf().create_file_mapper(file_name)->has_checksums());
+
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	char *buf = NULL;
+	BOOST_VERIFY(posix_memalign((void **) &buf, PAGE_SIZE, PAGE_SIZE) == 0);
+	memset(buf, 0, PAGE_SIZE);
+	data_loc_t loc(io->get_file_id(), 0);
+	io_request req(buf, loc, PAGE_SIZE, WRITE);
+	bool rejected = false;
+	try {
+		io->access(&req, 1);
+	} catch (io_exception &e) {
+		rejected = true;
+	}
+	assert(rejected);
+	free(buf);
+	io = NULL;
+	file.delete_file();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "test-corrupt_read conf_file [options]\n");
+		exit(1);
+	}
+
+	config_map::ptr configs = config_map::create(argv[1]);
+	configs->add_options("writable=1");
+	for (int i = 2; i < argc; i++)
+		configs->add_options(argv[i]);
+	init_io_system(configs);
+
+	std::string ext_file = create_ext_file();
+	test_compressed(ext_file);
+	test_write_checksummed(ext_file);
+	if (params.get_verify_checksum() > 0)
+		test_checksum(ext_file);
+	unlink(ext_file.c_str());
+
+	destroy_io_system();
+}
@@ -0,0 +1,129 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include <boost/assert.hpp>
+
+#include "disk_req_scheduler.h"
+
+using namespace safs;
+
+class test_io: public io_interface
+{
+public:
+	test_io(): io_interface(NULL, safs_header()) {
+	}
+
+	virtual int get_file_id() const {
+		return 0;
+	}
+};
+
+const size_t REQ_SIZE = 4096;
+const uint64_t MS = 1000 * 1000;
+
+std::vector<int> get_deadlines()
+{
+	std::vector<int> deadlines;
+	deadlines.push_back(1000);
+	deadlines.push_back(10000);
+	deadlines.push_back(100000);
+	return deadlines;
+}
+
+void add_reqs(disk_req_scheduler &sched, test_io &io, size_t num,
+		uint64_t now, off_t off = 0)
+{
+	std::vector<io_request> reqs;
+	for (size_t i = 0; i < num; i++) {
+		data_loc_t loc(0, off + i * REQ_SIZE);
+		reqs.push_back(io_request((char *) 1, loc, REQ_SIZE, READ, &io));
+	}
+	sched.add(reqs.data(), reqs.size(), now);
+}
+
+void test_priority()
+{
+	printf("test priority classes\n");
+	disk_req_scheduler sched(get_deadlines());
+	test_io bulk, query;
+	bulk.set_io_priority(IO_CLASS_BULK);
+	query.set_io_priority(IO_CLASS_INTERACTIVE);
+	add_reqs(sched, bulk, 1000, 0);
+	add_reqs(sched, query, 2, 0);
+	std::vector<io_request> reqs;
+	// The interactive requests are issued first.
+	BOOST_VERIFY(sched.fetch(4, 0, 0, reqs) == 4);
+	assert(reqs[0].get_io() == &query && reqs[1].get_io() == &query);
+	assert(reqs[2].get_io() == &bulk && reqs[3].get_io() == &bulk);
+	// The bulk requests can't use the reserved slots.
+	reqs.clear();
+	BOOST_VERIFY(sched.fetch(4, 4, 0, reqs) == 0);
+	add_reqs(sched, query, 1, 0);
+	BOOST_VERIFY(sched.fetch(4, 4, 0, reqs) == 1);
+	assert(reqs[0].get_io() == &query);
+	assert(sched.get_num_reqs() == 998);
+}
+
+void test_deadline()
+{
+	printf("test deadlines\n");
+	disk_req_scheduler sched(get_deadlines());
+	test_io bulk, normal;
+	bulk.set_io_priority(IO_CLASS_BULK);
+	add_reqs(sched, bulk, 10, 0);
+	add_reqs(sched, normal, 100, 0);
+	std::vector<io_request> reqs;
+	// The bulk requests haven't expired.
+	sched.fetch(10, 0, 50 * MS, reqs);
+	for (size_t i = 0; i < reqs.size(); i++)
+		assert(reqs[i].get_io() == &normal);
+	// The expired bulk requests alternate with the normal requests.
+	reqs.clear();
+	sched.fetch(10, 0, 200 * MS, reqs);
+	for (size_t i = 0; i < reqs.size(); i++)
+		assert(reqs[i].get_io() == (i % 2 == 0 ? &bulk : &normal));
+	assert(sched.get_num_expired(IO_CLASS_BULK) == 5);
+	assert(sched.get_num_issued(IO_CLASS_NORMAL) == 15);
+}
+
+void test_fair_share()
+{
+	printf("test fair sharing\n");
+	disk_req_scheduler sched(get_deadlines());
+	test_io io1, io2, io3;
+	io2.set_io_priority(IO_CLASS_NORMAL, 3);
+	add_reqs(sched, io1, 1000, 0);
+	add_reqs(sched, io2, 1000, 0);
+	add_reqs(sched, io3, 10, 0);
+	std::vector<io_request> reqs;
+	sched.fetch(1000, 0, 0, reqs);
+	size_t num1 = 0, num2 = 0, num3 = 0;
+	for (size_t i = 0; i < reqs.size(); i++) {
+		if (reqs[i].get_io() == &io1)
+			num1++;
+		else if (reqs[i].get_io() == &io2)
+			num2++;
+		else
+			num3++;
+	}
+	printf("io1: %ld, io2: %ld, io3: %ld\n", num1, num2, num3);
+	// The I/O instance with few requests gets all of them.
+	assert(num3 == 10);
+	// The shares follow the weights.
+	assert(num2 > num1 * 2.5 && num2 < num1 * 3.5);
+	// The requests of an I/O instance are issued in order.
+	off_t prev = -1;
+	for (size_t i = 0; i < reqs.size(); i++) {
+		if (reqs[i].get_io() != &io1)
+			continue;
+		assert(reqs[i].get_offset() > prev);
+		prev = reqs[i].get_offset();
+	}
+}
+
+int main()
+{
+	test_priority();
+	test_deadline();
+	test_fair_share();
+}
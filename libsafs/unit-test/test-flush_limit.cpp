@@ -0,0 +1,67 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "associative_cache.h"
+
+using namespace safs;
+
+const long LAT_TARGET = 2000;
+const int MAX_LIMIT = 256;
+
+/*
+ * The limit shrinks multiplicatively when writes are slow and grows
+ * additively when they meet the target.
+ */
+void test_adjust()
+{
+	printf("test adjusting the flush limit\n");
+	int limit = MAX_LIMIT;
+	limit = adjust_flush_limit(limit, LAT_TARGET * 2, LAT_TARGET, MAX_LIMIT);
+	assert(limit == MAX_LIMIT - MAX_LIMIT / 4);
+	int prev = limit;
+	limit = adjust_flush_limit(limit, LAT_TARGET, LAT_TARGET, MAX_LIMIT);
+	assert(limit == prev + 1);
+
+	// The limit can't grow beyond the maximum.
+	for (int i = 0; i < MAX_LIMIT; i++)
+		limit = adjust_flush_limit(limit, LAT_TARGET / 2, LAT_TARGET,
+				MAX_LIMIT);
+	assert(limit == MAX_LIMIT);
+
+	// The limit can't shrink below the minimum.
+	for (int i = 0; i < 100; i++)
+		limit = adjust_flush_limit(limit, LAT_TARGET * 2, LAT_TARGET,
+				MAX_LIMIT);
+	assert(limit == 8);
+	// It recovers when the writes get fast again.
+	limit = adjust_flush_limit(limit, LAT_TARGET / 2, LAT_TARGET, MAX_LIMIT);
+	assert(limit == 9);
+}
+
+/*
+ * When the cache allows fewer pending flushes than the minimum,
+ * the limit never exceeds the maximum.
+ */
+void test_small_max()
+{
+	printf("test a maximal flush limit smaller than the minimum\n");
+	const int small_max = 4;
+	int limit = small_max;
+	for (int i = 0; i < 10; i++) {
+		limit = adjust_flush_limit(limit, LAT_TARGET * 2, LAT_TARGET,
+				small_max);
+		assert(limit > 0 && limit <= small_max);
+	}
+	for (int i = 0; i < 10; i++) {
+		limit = adjust_flush_limit(limit, LAT_TARGET / 2, LAT_TARGET,
+				small_max);
+		assert(limit > 0 && limit <= small_max);
+	}
+	assert(limit == small_max);
+}
+
+int main()
+{
+	test_adjust();
+	test_small_max();
+}
@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include "huge_page_arena.h"
+#include "memory_manager.h"
+#include "parameters.h"
+
+using namespace safs;
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+const size_t CHUNK_SIZE = 64 * 1024;
+const int NUM_THREADS = 8;
+
+struct alloc_task
+{
+	huge_page_arena *arena;
+	std::vector<char *> chunks;
+};
+
+void *alloc_chunks(void *arg)
+{
+	alloc_task *task = (alloc_task *) arg;
+	while (true) {
+		char *chunk = task->arena->alloc(CHUNK_SIZE);
+		if (chunk == NULL)
+			break;
+		task->chunks.push_back(chunk);
+	}
+	return NULL;
+}
+
+/*
+ * Threads allocate chunks from the arena concurrently until it runs out.
+ * The chunks cover the arena without overlapping.
+ */
+void test_alloc(huge_page_arena::ptr arena)
+{
+	printf("allocate chunks in %d threads\n", NUM_THREADS);
+	std::vector<alloc_task> tasks(NUM_THREADS);
+	std::vector<pthread_t> ids(NUM_THREADS);
+	for (int i = 0; i < NUM_THREADS; i++) {
+		tasks[i].arena = arena.get();
+		BOOST_VERIFY(pthread_create(&ids[i], NULL, alloc_chunks,
+					&tasks[i]) == 0);
+	}
+	std::vector<char *> chunks;
+	for (int i = 0; i < NUM_THREADS; i++) {
+		pthread_join(ids[i], NULL);
+		chunks.insert(chunks.end(), tasks[i].chunks.begin(),
+				tasks[i].chunks.end());
+	}
+	assert(chunks.size() == arena->get_size() / CHUNK_SIZE);
+	std::sort(chunks.begin(), chunks.end());
+	for (size_t i = 0; i < chunks.size(); i++) {
+		assert(arena->contains(chunks[i]));
+		assert(arena->contains(chunks[i] + CHUNK_SIZE - 1));
+		if (i > 0)
+			assert(chunks[i] == chunks[i - 1] + CHUNK_SIZE);
+		// The memory can be written.
+		chunks[i][0] = 1;
+	}
+	assert(arena->alloc(1) == NULL);
+	assert(!arena->contains(chunks.back() + CHUNK_SIZE));
+}
+
+/*
+ * The pages in the arena are only freed when they're released, while
+ * the pages from normal memory are returned to the OS.
+ */
+void test_release_pages()
+{
+	printf("release pages in and out of the arena\n");
+	std::map<std::string, std::string> configs;
+	configs["cache_huge_page"] = "2M";
+	params.init(configs);
+	memory_manager *manager = memory_manager::create(HUGE_PAGE_SIZE, 0);
+
+	const int NUM_PAGES = 16;
+	char *pages[NUM_PAGES];
+	BOOST_VERIFY(manager->get_free_pages(NUM_PAGES, pages, NULL));
+	manager->release_pages(NUM_PAGES, pages);
+	assert(manager->get_released_size() == 0);
+
+	// A page from normal memory, like the pages allocated when the arena
+	// runs out.
+	char *normal_page = (char *) valloc(PAGE_SIZE);
+	normal_page[0] = 1;
+	manager->release_pages(1, &normal_page);
+	assert(manager->get_released_size() == PAGE_SIZE);
+	// The released page is used first.
+	char *page;
+	BOOST_VERIFY(manager->get_free_pages(1, &page, NULL));
+	assert(page == normal_page);
+	assert(manager->get_released_size() == 0);
+	free(normal_page);
+
+	BOOST_VERIFY(manager->get_free_pages(NUM_PAGES, pages, NULL));
+	manager->free_pages(NUM_PAGES, pages);
+	memory_manager::destroy(manager);
+}
+
+int main()
+{
+	huge_page_arena::ptr arena = huge_page_arena::create(HUGE_PAGE_SIZE * 2,
+			HUGE_PAGE_SIZE, -1, true);
+	// The test needs huge pages reserved in the system,
+	// e.g., in /proc/sys/vm/nr_hugepages.
+	if (arena == NULL) {
+		printf("there aren't huge pages in the system. skip the test\n");
+		return 0;
+	}
+	test_alloc(arena);
+	arena.reset();
+	test_release_pages();
+}
@@ -174,6 +174,64 @@ void test_direct_comp(const std::string &data_file)
 	printf("direct compute I/O passed the test.\n");
 }
 
+//////////////////////////// Test direct scatter reads ////////////////////////
+
+static const size_t SCATTER_BUF_SIZE = 4096;
+
+class scatter_callback: public callback
+{
+public:
+	virtual int invoke(io_request *reqs[], int num);
+};
+
+int scatter_callback::invoke(io_request *reqs[], int num)
+{
+	for (int i = 0; i < num; i++) {
+		io_req_extension *ext = reqs[i]->get_extension();
+		long expected = reqs[i]->get_offset() / sizeof(long);
+		for (int j = 0; j < reqs[i]->get_num_bufs(); j++) {
+			long *vs = (long *) reqs[i]->get_buf(j);
+			int num_longs = reqs[i]->get_buf_size(j) / sizeof(long);
+			for (int k = 0; k < num_longs; k++) {
+				assert(vs[k] == expected);
+				expected++;
+			}
+			free(vs);
+		}
+		delete ext;
+	}
+	return 0;
+}
+
+void test_direct_scatter(const std::string &data_file)
+{
+	file_io_factory::shared_ptr factory = create_io_factory(data_file,
+			DIRECT_COMP_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	io->set_callback(callback::ptr(new scatter_callback()));
+	for (int i = 0; i < 1000; i++) {
+		std::pair<off_t, size_t> p = get_rand_align_req();
+		data_loc_t loc(io->get_file_id(), p.first);
+		// The data is read to many small buffers, and the request may
+		// cross RAID blocks.
+		io_req_extension *ext = new io_req_extension();
+		io_request req(ext, loc, READ);
+		for (size_t off = 0; off < p.second; off += SCATTER_BUF_SIZE) {
+			size_t size = std::min(SCATTER_BUF_SIZE, p.second - off);
+			char *buf = NULL;
+			int ret = posix_memalign((void **) &buf, 512, size);
+			assert(ret == 0);
+			req.add_buf(buf, size);
+		}
+		io->access(&req, 1);
+		while (io->num_pending_ios() > 32)
+			io->wait4complete(1);
+	}
+	while (io->num_pending_ios() > 0)
+		io->wait4complete(io->num_pending_ios());
+	printf("direct scatter reads passed the test.\n");
+}
+
 //////////////////////////////// Test remote IO ///////////////////////////////
 
 class test_callback: public callback
@@ -249,17 +307,20 @@ std::string prepare_file()
 int main(int argc, char *argv[])
 {
 	if (argc < 2) {
-		fprintf(stderr, "test conf_file\n");
+		fprintf(stderr, "test conf_file [options]\n");
 		exit(1);
 	}
 
 	std::string conf_file = argv[1];
 	config_map::ptr configs = config_map::create(conf_file);
+	for (int i = 2; i < argc; i++)
+		configs->add_options(argv[i]);
 	init_io_system(configs);
 
 	std::string data_file = prepare_file();
 	test_remote_io(data_file);
 	test_direct_comp(data_file);
+	test_direct_scatter(data_file);
 
 	safs_file f(get_sys_RAID_conf(), data_file);
 	f.delete_file();
@@ -0,0 +1,70 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "latency_histogram.h"
+
+using namespace safs;
+
+/*
+ * The percentile is in the bucket of the expected value, and a bucket
+ * is within 1/16 of its values.
+ */
+static void check_close(uint64_t v, uint64_t expected)
+{
+	assert(v >= expected);
+	assert(v - expected <= expected / 16);
+}
+
+void test_percentile()
+{
+	printf("test percentiles\n");
+	latency_histogram hist;
+	assert(hist.get_percentile(50) == 0);
+	for (uint64_t i = 1; i <= 100000; i++)
+		hist.add(i * 1000);
+	assert(hist.get_count() == 100000);
+	assert(hist.get_max() == 100000 * 1000);
+	assert(hist.get_avg() == 50000500);
+	check_close(hist.get_percentile(50), 50000 * 1000);
+	check_close(hist.get_percentile(99), 99000 * 1000);
+	assert(hist.get_percentile(100) == hist.get_max());
+
+	// Small values are kept exactly.
+	latency_histogram small;
+	for (int i = 0; i < 10; i++)
+		small.add(i);
+	assert(small.get_percentile(50) == 4);
+	assert(small.get_percentile(100) == 9);
+}
+
+void test_registry()
+{
+	printf("test the histogram registry\n");
+	latency_histogram::ptr hist1(new latency_histogram());
+	latency_histogram::ptr hist2(new latency_histogram());
+	register_latency_hist("disk", hist1);
+	register_latency_hist("disk", hist2);
+	hist1->add(100);
+	hist2->add(200);
+	std::map<std::string, latency_histogram::ptr> snapshot
+		= get_latency_snapshot();
+	assert(snapshot.size() == 1);
+	assert(snapshot["disk"]->get_count() == 2);
+	assert(snapshot["disk"]->get_max() == 200);
+
+	// The values of an unregistered histogram are kept.
+	unregister_latency_hist("disk", hist1);
+	hist1->add(300);
+	hist2->add(400);
+	snapshot = get_latency_snapshot();
+	assert(snapshot["disk"]->get_count() == 3);
+	assert(snapshot["disk"]->get_max() == 400);
+	unregister_latency_hist("disk", hist2);
+	printf("%s", get_latency_report().c_str());
+}
+
+int main()
+{
+	test_percentile();
+	test_registry();
+}
@@ -0,0 +1,95 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "read_ahead.h"
+
+using namespace safs;
+
+const size_t INIT_WINDOW = 16 * 4096;
+const size_t MAX_WINDOW = 64 * 4096;
+
+void test_sequential()
+{
+	printf("test sequential streams\n");
+	stream_detector detector(INIT_WINDOW, MAX_WINDOW);
+	std::vector<stream_detector::range_t> ranges;
+	detector.access(0, 4096, ranges);
+	detector.access(4096, 4096, ranges);
+	assert(ranges.empty());
+	// The third sequential read triggers read-ahead.
+	detector.access(8192, 4096, ranges);
+	assert(detector.is_stream());
+	assert(ranges.size() == 1);
+	assert(ranges[0].first == 12288);
+	assert(ranges[0].second == INIT_WINDOW);
+
+	// We don't read ahead until half of the window is consumed.
+	ranges.clear();
+	off_t off = 12288;
+	while (ranges.empty()) {
+		detector.access(off, 4096, ranges);
+		off += 4096;
+	}
+	assert(off - 12288 > (off_t) INIT_WINDOW / 2);
+	assert(detector.get_window() == INIT_WINDOW * 2);
+	// The read-ahead continues from where the previous one ends.
+	assert(ranges[0].first == (off_t) (12288 + INIT_WINDOW));
+	assert(ranges[0].first + ranges[0].second == off + INIT_WINDOW * 2);
+
+	// The window can't grow beyond the maximal size.
+	for (int i = 0; i < 1000; i++) {
+		detector.access(off, 4096, ranges);
+		off += 4096;
+	}
+	assert(detector.get_window() == MAX_WINDOW);
+	for (size_t i = 1; i < ranges.size(); i++)
+		assert(ranges[i].first == ranges[i - 1].first
+				+ (off_t) ranges[i - 1].second);
+}
+
+void test_strided()
+{
+	printf("test strided streams\n");
+	stream_detector detector(INIT_WINDOW, MAX_WINDOW);
+	std::vector<stream_detector::range_t> ranges;
+	const off_t stride = 1024 * 1024;
+	for (int i = 0; i < 3; i++)
+		detector.access(i * stride, 4096, ranges);
+	assert(ranges.empty());
+	detector.access(3 * stride, 4096, ranges);
+	assert(detector.is_stream());
+	assert(ranges.size() == INIT_WINDOW / 4096);
+	for (size_t i = 0; i < ranges.size(); i++) {
+		assert(ranges[i].first == (off_t) (4 + i) * stride);
+		assert(ranges[i].second == 4096);
+	}
+}
+
+void test_random()
+{
+	printf("test random access\n");
+	stream_detector detector(INIT_WINDOW, MAX_WINDOW);
+	std::vector<stream_detector::range_t> ranges;
+	for (int i = 0; i < 10; i++)
+		detector.access(i * 4096, 4096, ranges);
+	assert(detector.is_stream());
+	assert(!ranges.empty());
+
+	// A random read stops the stream.
+	ranges.clear();
+	detector.access(1024 * 1024 * 1024, 4096, ranges);
+	assert(!detector.is_stream());
+	assert(detector.get_window() == 0);
+	off_t offs[] = {12345 * 4096, 5 * 4096, 777 * 4096, 3 * 4096, 9999 * 4096};
+	for (size_t i = 0; i < sizeof(offs) / sizeof(offs[0]); i++)
+		detector.access(offs[i], 4096, ranges);
+	assert(ranges.empty());
+	assert(!detector.is_stream());
+}
+
+int main()
+{
+	test_sequential();
+	test_strided();
+	test_random();
+}
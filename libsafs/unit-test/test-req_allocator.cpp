@@ -0,0 +1,67 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include <boost/assert.hpp>
+
+#include "req_allocator.h"
+
+using namespace safs;
+
+void test_obj_allocator()
+{
+	printf("test request object allocator\n");
+	req_obj_allocator<io_request> alloc("test-req_allocator", -1, false,
+			INT_MAX);
+	const int num = 100;
+	io_request *reqs[num];
+	for (int i = 0; i < num; i++) {
+		reqs[i] = alloc.alloc_obj();
+		assert(reqs[i]->get_offset() == 0);
+	}
+	alloc.free(reqs, num);
+	assert(alloc.get_num_allocs() == num);
+	size_t num_chunks = alloc.get_num_chunks();
+	assert(num_chunks == 1);
+
+	// The freed objects are reused.
+	for (int i = 0; i < 100; i++) {
+		io_request *req = alloc.alloc_obj();
+		alloc.free(req);
+	}
+	assert(alloc.get_num_chunks() == num_chunks);
+
+	BOOST_VERIFY(alloc.alloc_objs(reqs, num) == num);
+	for (int i = 0; i < num; i++)
+		assert(alloc.contains((char *) reqs[i]));
+	alloc.free(reqs, num);
+}
+
+void test_ext_allocator()
+{
+	printf("test request extension allocator\n");
+	req_ext_allocator alloc("test-req_ext_allocator", -1, false);
+	io_req_extension *ext = alloc.alloc_obj();
+	for (int i = 0; i < 100; i++)
+		ext->add_buf((char *) 4096, 4096, false);
+	assert(ext->get_num_bufs() == 100);
+	alloc.free(ext);
+
+	// The iovec array is kept when the extension is reused.
+	size_t num_vec_allocs = io_req_extension::get_num_vec_allocs();
+	for (int j = 0; j < 100; j++) {
+		ext = alloc.alloc_obj();
+		assert(ext->get_num_bufs() == 0);
+		assert(ext->get_priv() == NULL);
+		for (int i = 0; i < 100; i++)
+			ext->add_buf((char *) 4096, 4096, false);
+		alloc.free(ext);
+	}
+	assert(io_req_extension::get_num_vec_allocs() == num_vec_allocs);
+	assert(alloc.get_num_allocs() == 101);
+}
+
+int main()
+{
+	test_obj_allocator();
+	test_ext_allocator();
+}
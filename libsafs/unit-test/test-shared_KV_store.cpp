@@ -0,0 +1,427 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <boost/assert.hpp>
+
+#include "shared_KV_store.h"
+
+using namespace safs;
+
+struct test_req
+{
+	KV_key key;
+
+	test_req(int file_idx, off_t idx): key(file_idx, idx) {
+	}
+
+	bool operator<(const test_req &req) const {
+		return key < req.key;
+	}
+};
+
+void test_value_cache()
+{
+	printf("test the value cache\n");
+	KV_value_cache<long> cache(1000);
+	assert(cache.get_num_entries() == 1024);
+	long v;
+	assert(!cache.get(KV_key(0, 10), v));
+	cache.put(KV_key(0, 10), 100);
+	assert(cache.get(KV_key(0, 10), v));
+	assert(v == 100);
+	assert(!cache.get(KV_key(1, 10), v));
+	cache.put(KV_key(0, 10), 101);
+	assert(cache.get(KV_key(0, 10), v));
+	assert(v == 101);
+
+	// A cached value is either the latest value of the key or evicted.
+	for (long i = 0; i < 10000; i++)
+		cache.put(KV_key(i % 3, i), i * 2);
+	int num_hits = 0;
+	for (long i = 0; i < 10000; i++) {
+		if (cache.get(KV_key(i % 3, i), v)) {
+			assert(v == i * 2);
+			num_hits++;
+		}
+	}
+	assert(num_hits > 0 && num_hits <= 1024);
+}
+
+void test_group()
+{
+	printf("test grouping requests\n");
+	const size_t num_per_page = PAGE_SIZE / sizeof(long);
+	std::vector<test_req> reqs;
+	// Two requests in page 0.
+	reqs.push_back(test_req(0, 1));
+	reqs.push_back(test_req(0, 5));
+	// A request in the adjacent page is merged.
+	reqs.push_back(test_req(0, num_per_page + 1));
+	// A request far away.
+	reqs.push_back(test_req(0, num_per_page * 10));
+	// The same offset in another file.
+	reqs.push_back(test_req(1, num_per_page * 10));
+	std::sort(reqs.begin(), reqs.end());
+
+	std::vector<KV_req_range> ranges;
+	group_KV_reqs(reqs, sizeof(long), 128 * PAGE_SIZE, ranges);
+	assert(ranges.size() == 3);
+	assert(ranges[0].file_idx == 0 && ranges[0].off == 0);
+	assert(ranges[0].size == 2 * PAGE_SIZE);
+	assert(ranges[0].start == 0 && ranges[0].end == 3);
+	assert(ranges[1].file_idx == 0 && ranges[1].off == 10 * PAGE_SIZE);
+	assert(ranges[1].size == PAGE_SIZE);
+	assert(ranges[1].start == 3 && ranges[1].end == 4);
+	assert(ranges[2].file_idx == 1 && ranges[2].off == 10 * PAGE_SIZE);
+	assert(ranges[2].start == 4 && ranges[2].end == 5);
+
+	// A range doesn't grow beyond the maximal size.
+	reqs.clear();
+	for (size_t i = 0; i < 10; i++)
+		reqs.push_back(test_req(0, i * num_per_page));
+	ranges.clear();
+	group_KV_reqs(reqs, sizeof(long), 4 * PAGE_SIZE, ranges);
+	assert(ranges.size() == 3);
+	assert(ranges[0].size == 4 * PAGE_SIZE && ranges[0].end == 4);
+	assert(ranges[1].off == 4 * PAGE_SIZE && ranges[1].end == 8);
+	assert(ranges[2].size == 2 * PAGE_SIZE && ranges[2].end == 10);
+}
+
+/*
+ * The value of a key in the in-memory files.
+ */
+static long get_key_value(int file_idx, off_t idx)
+{
+	return file_idx * 1000000000L + idx;
+}
+
+/*
+ * The pages of an in-memory file covered by a request.
+ */
+class mem_byte_array: public page_byte_array
+{
+	off_t off;
+	size_t size;
+	std::vector<char> pages;
+public:
+	mem_byte_array(int file_idx, off_t off, size_t size) {
+		this->off = off;
+		this->size = size;
+		off_t first_pg = ROUND_PAGE(off);
+		pages.resize(ROUNDUP_PAGE(off + size) - first_pg);
+		long *vs = (long *) pages.data();
+		for (size_t i = 0; i < pages.size() / sizeof(long); i++)
+			vs[i] = get_key_value(file_idx, first_pg / sizeof(long) + i);
+	}
+
+	virtual void lock() {
+	}
+
+	virtual void unlock() {
+	}
+
+	virtual size_t get_size() const {
+		return size;
+	}
+
+	virtual page_byte_array *clone() {
+		assert(0);
+		return NULL;
+	}
+
+	virtual off_t get_offset() const {
+		return off;
+	}
+
+	virtual off_t get_offset_in_first_page() const {
+		return off % PAGE_SIZE;
+	}
+
+	virtual const char *get_page(int idx) const {
+		return pages.data() + idx * PAGE_SIZE;
+	}
+};
+
+/*
+ * This I/O instance serves user computes from an in-memory file.
+ * Like the real I/O instances, it can only be used in its own thread.
+ */
+class mem_io: public io_interface
+{
+	int file_idx;
+	atomic_long &num_reads;
+	std::vector<io_request> pending;
+public:
+	mem_io(int file_idx, atomic_long &_num_reads,
+			thread *t): io_interface(t, safs_header()), num_reads(_num_reads) {
+		this->file_idx = file_idx;
+	}
+
+	virtual int get_file_id() const {
+		return file_idx;
+	}
+
+	virtual void access(io_request *requests, int num, io_status *status) {
+		assert(get_thread() == thread::get_curr_thread());
+		pending.insert(pending.end(), requests, requests + num);
+	}
+
+	virtual void flush_requests() {
+	}
+
+	/*
+	 * The requests only complete when the thread waits for them, so
+	 * the test can see which requests are still in flight.
+	 */
+	virtual int wait4complete(int num) {
+		assert(get_thread() == thread::get_curr_thread());
+		if (num == 0)
+			return 0;
+		std::vector<io_request> reqs;
+		reqs.swap(pending);
+		for (size_t i = 0; i < reqs.size(); i++) {
+			assert(reqs[i].get_req_type() == io_request::USER_COMPUTE);
+			mem_byte_array arr(file_idx, reqs[i].get_offset(),
+					reqs[i].get_size());
+			user_compute *compute = reqs[i].get_compute();
+			compute->run(arr);
+			assert(compute->has_completed());
+			compute->get_allocator()->free(compute);
+		}
+		num_reads.inc(reqs.size());
+		return reqs.size();
+	}
+
+	virtual int num_pending_ios() const {
+		return pending.size();
+	}
+};
+
+class mem_io_factory: public file_io_factory
+{
+	int file_idx;
+	atomic_long num_reads;
+	atomic_integer num_ios;
+
+	virtual io_interface::ptr create_io(thread *t) {
+		num_ios.inc(1);
+		return io_interface::ptr(new mem_io(file_idx, num_reads, t));
+	}
+
+	virtual void destroy_io(io_interface &io) {
+		num_ios.dec(1);
+	}
+public:
+	mem_io_factory(int file_idx): file_io_factory(
+			std::string("mem-") + itoa(file_idx)) {
+		this->file_idx = file_idx;
+	}
+
+	virtual int get_file_id() const {
+		return file_idx;
+	}
+
+	size_t get_num_reads() const {
+		return num_reads.get();
+	}
+
+	int get_num_ios() const {
+		return num_ios.get();
+	}
+};
+
+class check_callback: public KV_get_callback<long>
+{
+public:
+	atomic_long num_values;
+
+	virtual void invoke(const KV_key &key, const long &value) {
+		assert(value == get_key_value(key.file_idx, key.idx));
+		num_values.inc(1);
+	}
+};
+
+typedef shared_KV_store<long> long_store;
+
+std::vector<file_io_factory::shared_ptr> create_mem_files(int num)
+{
+	std::vector<file_io_factory::shared_ptr> factories;
+	for (int i = 0; i < num; i++)
+		factories.push_back(file_io_factory::shared_ptr(new mem_io_factory(i)));
+	return factories;
+}
+
+size_t get_num_reads(const std::vector<file_io_factory::shared_ptr> &factories)
+{
+	size_t num = 0;
+	for (size_t i = 0; i < factories.size(); i++)
+		num += ((mem_io_factory *) factories[i].get())->get_num_reads();
+	return num;
+}
+
+int get_num_ios(const std::vector<file_io_factory::shared_ptr> &factories)
+{
+	int num = 0;
+	for (size_t i = 0; i < factories.size(); i++)
+		num += ((mem_io_factory *) factories[i].get())->get_num_ios();
+	return num;
+}
+
+/*
+ * Batched gets are asynchronous. The keys are served when the thread
+ * waits for them.
+ */
+void test_async_get()
+{
+	printf("test asynchronous gets\n");
+	std::vector<file_io_factory::shared_ptr> factories = create_mem_files(2);
+	long_store::ptr store = long_store::create(factories, 0);
+	std::vector<KV_key> keys;
+	for (size_t i = 0; i < long_store::MAX_BUF_REQS; i++)
+		keys.push_back(KV_key(i % 2, i * 100));
+	check_callback cb;
+	// The buffer gets full, so the requests are issued in get().
+	store->get(keys.data(), keys.size() - 1, cb);
+	assert(store->get_num_ios() == 0);
+	store->get(&keys.back(), 1, cb);
+	assert(store->get_num_ios() > 0);
+	assert(cb.num_values.get() == 0);
+
+	// Flushing requests doesn't wait for them either.
+	size_t num_ios = store->get_num_ios();
+	std::vector<KV_key> keys2(1, KV_key(0, 1));
+	store->get(keys2.data(), keys2.size(), cb);
+	store->flush_requests();
+	assert(store->get_num_ios() == num_ios + 1);
+	assert(cb.num_values.get() == 0);
+
+	store->wait4complete();
+	assert((size_t) cb.num_values.get() == keys.size() + keys2.size());
+	assert(get_num_reads(factories) == store->get_num_ios());
+	assert(get_num_ios(factories) == 2);
+	// The I/O instances of the current thread are destroyed with the store.
+	store.reset();
+	assert(get_num_ios(factories) == 0);
+}
+
+/*
+ * A thread that requests some keys and waits for them while the main
+ * thread has requested the same keys.
+ */
+struct waiter_data
+{
+	long_store *store;
+	std::vector<KV_key> keys;
+	check_callback cb;
+	volatile bool requested;
+	volatile bool released;
+
+	waiter_data() {
+		store = NULL;
+		requested = false;
+		released = false;
+	}
+};
+
+void *run_waiter(void *arg)
+{
+	waiter_data *data = (waiter_data *) arg;
+	data->store->get(data->keys.data(), data->keys.size(), data->cb);
+	data->requested = true;
+	data->store->wait4complete();
+	assert((size_t) data->cb.num_values.get() == data->keys.size());
+	// The thread keeps running after it releases the store.
+	data->store->release_thread();
+	data->released = true;
+	return NULL;
+}
+
+/*
+ * The thread that has issued the same keys as a waiting thread never
+ * waits for its keys. The waiting thread doesn't depend on it.
+ */
+void test_idle_thread()
+{
+	printf("test waiting for keys while another thread is idle\n");
+	std::vector<file_io_factory::shared_ptr> factories = create_mem_files(2);
+	long_store::ptr store = long_store::create(factories, 0);
+	std::vector<KV_key> keys;
+	for (size_t i = 0; i < long_store::MAX_BUF_REQS; i++)
+		keys.push_back(KV_key(i % 2, i));
+	check_callback cb;
+	store->get(keys.data(), keys.size(), cb);
+	assert(cb.num_values.get() == 0);
+
+	waiter_data data;
+	data.store = store.get();
+	data.keys = keys;
+	pthread_t waiter;
+	pthread_create(&waiter, NULL, run_waiter, &data);
+	// The main thread doesn't wait for anything before the waiter returns.
+	while (!data.released)
+		sched_yield();
+	assert(get_num_ios(factories) == 2);
+	assert(cb.num_values.get() == 0);
+	store->wait4complete();
+	assert((size_t) cb.num_values.get() == keys.size());
+	pthread_join(waiter, NULL);
+}
+
+struct stress_data
+{
+	long_store *store;
+	int num_files;
+	unsigned int seed;
+};
+
+void *run_stress(void *arg)
+{
+	stress_data *data = (stress_data *) arg;
+	for (int i = 0; i < 100; i++) {
+		std::vector<KV_key> keys;
+		for (int j = 0; j < 100; j++)
+			keys.push_back(KV_key(rand_r(&data->seed) % data->num_files,
+						rand_r(&data->seed) % 100000));
+		check_callback cb;
+		data->store->get(keys.data(), keys.size(), cb);
+		data->store->wait4complete();
+		BOOST_VERIFY((size_t) cb.num_values.get() == keys.size());
+	}
+	return NULL;
+}
+
+void test_concurrent_gets()
+{
+	printf("test concurrent gets\n");
+	const int NUM_THREADS = 8;
+	std::vector<file_io_factory::shared_ptr> factories = create_mem_files(3);
+	long_store::ptr store = long_store::create(factories, 4096,
+			IO_CLASS_INTERACTIVE);
+	pthread_t threads[NUM_THREADS];
+	stress_data data[NUM_THREADS];
+	for (int i = 0; i < NUM_THREADS; i++) {
+		data[i].store = store.get();
+		data[i].num_files = factories.size();
+		data[i].seed = i;
+		pthread_create(&threads[i], NULL, run_stress, &data[i]);
+	}
+	for (int i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	assert(get_num_ios(factories) == 0);
+	assert(store->get_num_ios() == get_num_reads(factories));
+}
+
+int main()
+{
+	test_value_cache();
+	test_group();
+	// The store runs in SAFS threads. A thread that isn't created by SAFS
+	// is represented by a thread object when it accesses the store.
+	thread::thread_class_init();
+	test_async_get();
+	test_idle_thread();
+	test_concurrent_gets();
+}
@@ -0,0 +1,81 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include <boost/assert.hpp>
+
+#include "container.h"
+
+const long NUM_ENTRIES = 1000 * 1000;
+
+spsc_queue<long> q(1000);
+
+void *produce(void *arg)
+{
+	long buf[37];
+	long next = 0;
+	while (next < NUM_ENTRIES) {
+		int num = 0;
+		for (; num < 37 && next + num < NUM_ENTRIES; num++)
+			buf[num] = next + num;
+		int ret = 0;
+		while (ret < num) {
+			int num_added = q.add(buf + ret, num - ret);
+			if (num_added == 0)
+				sched_yield();
+			ret += num_added;
+		}
+		next += num;
+	}
+	return NULL;
+}
+
+void test_single_thread()
+{
+	printf("test spsc_queue in a single thread\n");
+	spsc_queue<long> q1(10);
+	assert(q1.get_size() == 16);
+	long buf[32];
+	for (int i = 0; i < 32; i++)
+		buf[i] = i;
+	BOOST_VERIFY(q1.add(buf, 32) == 16);
+	BOOST_VERIFY(q1.add(buf, 1) == 0);
+	assert(q1.get_num_entries() == 16);
+
+	long out[32];
+	BOOST_VERIFY(q1.fetch(out, 10) == 10);
+	for (int i = 0; i < 10; i++)
+		assert(out[i] == i);
+	// Add entries across the end of the circular buffer.
+	BOOST_VERIFY(q1.add(buf + 16, 16) == 10);
+	BOOST_VERIFY(q1.fetch(out, 32) == 16);
+	for (int i = 0; i < 16; i++)
+		assert(out[i] == i + 10);
+	assert(q1.is_empty());
+	BOOST_VERIFY(q1.fetch(out, 32) == 0);
+}
+
+void test_two_threads()
+{
+	printf("test spsc_queue with a producer and a consumer\n");
+	pthread_t producer;
+	pthread_create(&producer, NULL, produce, NULL);
+	long expected = 0;
+	long buf[53];
+	while (expected < NUM_ENTRIES) {
+		int num = q.fetch(buf, 53);
+		if (num == 0)
+			sched_yield();
+		for (int i = 0; i < num; i++) {
+			assert(buf[i] == expected);
+			expected++;
+		}
+	}
+	pthread_join(producer, NULL);
+	assert(q.is_empty());
+}
+
+int main()
+{
+	test_single_thread();
+	test_two_threads();
+}
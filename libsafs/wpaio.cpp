@@ -28,8 +28,15 @@
 #include <assert.h>
 #include <sys/select.h>
 
+#include <algorithm>
+#include <atomic>
+
+#include <boost/format.hpp>
+
 #include "wpaio.h"
 #include "parameters.h"
+#include "concurrency.h"
+#include "log.h"
 
 #define INIT_CAPACITY 8
 
@@ -66,7 +73,19 @@ struct iocb *aio_ctx::make_iovec_request(int fd, const struct iovec iov[],
 	}
 	return a_req;
 #else
-	return NULL;
+	if (io_type != A_READ && io_type != A_WRITE) {
+		fprintf(stderr, "unknown operation");
+		return NULL;
+	}
+
+	struct iocb* a_req = iocb_allocator.alloc_obj();
+	a_req->data = cb;
+	a_req->aio_lio_opcode = io_type == A_READ ? IO_CMD_PREADV : IO_CMD_PWRITEV;
+	a_req->aio_fildes = fd;
+	a_req->u.v.vec = iov;
+	a_req->u.v.nr = count;
+	a_req->u.v.offset = offset;
+	return a_req;
 #endif
 }
 
@@ -92,7 +111,19 @@ struct iocb* aio_ctx::make_io_request(int fd, size_t iosize, long long offset,
   }
   return a_req;
 #else
-  return NULL;
+	if (io_type != A_READ && io_type != A_WRITE) {
+		fprintf(stderr, "unknown operation");
+		return NULL;
+	}
+
+	struct iocb* a_req = iocb_allocator.alloc_obj();
+	a_req->data = cb;
+	a_req->aio_lio_opcode = io_type == A_READ ? IO_CMD_PREAD : IO_CMD_PWRITE;
+	a_req->aio_fildes = fd;
+	a_req->u.c.buf = buffer;
+	a_req->u.c.nbytes = iosize;
+	a_req->u.c.offset = offset;
+	return a_req;
 #endif
 }
 
@@ -124,7 +155,9 @@ int aio_ctx_impl::io_wait(struct timespec* to, int num)
 	res2[i] = ep->res2;
   }
 
-  cb_func(ctx, iocbs, (void **) cbs, res, res2, n);
+  // There may be no completed requests if we don't block.
+  if (n > 0)
+	  cb_func(ctx, iocbs, (void **) cbs, res, res2, n);
 
   busy_aio -= n;
   destroy_io_requests(iocbs, n);
@@ -154,4 +187,348 @@ int aio_ctx_impl::max_io_slot()
 #endif
 }
 
+/*
+ * The memory registered for I/O. The I/O engines check the version to
+ * find out whether new memory has been registered.
+ */
+static struct
+{
+	spin_lock lock;
+	std::vector<struct iovec> bufs;
+	std::atomic<long> version;
+} io_buf_registry;
+
+void register_io_buf(void *buf, size_t size)
+{
+	struct iovec vec;
+	vec.iov_base = buf;
+	vec.iov_len = size;
+	io_buf_registry.lock.lock();
+	io_buf_registry.bufs.push_back(vec);
+	io_buf_registry.lock.unlock();
+	io_buf_registry.version++;
+}
+
+aio_ctx *create_aio_ctx(int node_id, int max_aio)
+{
+#ifdef USE_LIBURING
+	if (params.get_io_engine() == IO_ENGINE_URING)
+		return new uring_ctx_impl(node_id, max_aio);
+#endif
+	return new aio_ctx_impl(node_id, max_aio);
+}
+
+#ifdef USE_LIBURING
+
+/*
+ * The max number of files that can be registered in a ring.
+ */
+static const int MAX_REG_FILES = 1024;
+/*
+ * io_uring doesn't allow a fixed buffer to be larger than 1GB.
+ */
+static const size_t MAX_FIXED_BUF_SIZE = 1024L * 1024 * 1024;
+static const int MAX_FIXED_BUFS = 16384;
+
+static bool buf_less(const struct iovec &v1, const struct iovec &v2)
+{
+	return v1.iov_base < v2.iov_base;
+}
+
+uring_ctx_impl::uring_ctx_impl(int node_id, int max_aio): aio_ctx(node_id,
+		max_aio)
+{
+	this->max_aio = max_aio;
+	busy_aio = 0;
+	num_submit_calls = 0;
+	num_sqes = 0;
+	num_fixed_reqs = 0;
+	num_wait_calls = 0;
+	num_cqes = 0;
+
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	if (params.is_uring_sqpoll()) {
+		p.flags |= IORING_SETUP_SQPOLL;
+		// The kernel thread goes to sleep after it is idle for 1ms.
+		p.sq_thread_idle = 1;
+	}
+	int ret = io_uring_queue_init_params(max_aio, &ring, &p);
+	if (ret < 0)
+		throw std::system_error(std::make_error_code((std::errc) -ret),
+				"io_uring_queue_init");
+
+	// The table of registered files is sparse in the beginning, and
+	// files are added when the I/O instance opens them.
+	std::vector<int> fds(MAX_REG_FILES, -1);
+	ret = io_uring_register_files(&ring, fds.data(), fds.size());
+	use_reg_files = ret == 0;
+	if (use_reg_files) {
+		for (int i = MAX_REG_FILES - 1; i >= 0; i--)
+			free_file_slots.push_back(i);
+	}
+	else
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"can't register files in io_uring: %1%") % strerror(-ret);
+
+	use_fixed_bufs = params.is_uring_fixed_bufs();
+	fixed_buf_version = 0;
+}
+
+uring_ctx_impl::~uring_ctx_impl()
+{
+	if (!fixed_bufs.empty())
+		io_uring_unregister_buffers(&ring);
+	if (use_reg_files)
+		io_uring_unregister_files(&ring);
+	io_uring_queue_exit(&ring);
+}
+
+void uring_ctx_impl::register_files(const std::vector<int> &fds)
+{
+	if (!use_reg_files)
+		return;
+
+	for (size_t i = 0; i < fds.size(); i++) {
+		if (reg_files.find(fds[i]) != reg_files.end())
+			continue;
+		// We can still access the file without registering it.
+		if (free_file_slots.empty())
+			return;
+
+		int slot = free_file_slots.back();
+		int ret = io_uring_register_files_update(&ring, slot, &fds[i], 1);
+		if (ret < 0) {
+			BOOST_LOG_TRIVIAL(warning) << boost::format(
+					"can't register file %1% in io_uring: %2%")
+				% fds[i] % strerror(-ret);
+			continue;
+		}
+		free_file_slots.pop_back();
+		reg_files.insert(std::pair<int, int>(fds[i], slot));
+	}
+}
+
+void uring_ctx_impl::unregister_files(const std::vector<int> &fds)
+{
+	for (size_t i = 0; i < fds.size(); i++) {
+		auto it = reg_files.find(fds[i]);
+		if (it == reg_files.end())
+			continue;
+
+		// The file descriptor may be reused by another file after it's
+		// closed, so we have to remove it from the ring.
+		int empty = -1;
+		BOOST_VERIFY(io_uring_register_files_update(&ring, it->second,
+					&empty, 1) == 1);
+		free_file_slots.push_back(it->second);
+		reg_files.erase(it);
+	}
+}
+
+/*
+ * Register all memory in the registry as fixed buffers.
+ * io_uring waits for all pending requests before it unregisters the fixed
+ * buffers in old kernels, so we only do it when the ring is idle.
+ */
+void uring_ctx_impl::sync_fixed_bufs()
+{
+	long version = io_buf_registry.version.load();
+	if (version == fixed_buf_version || busy_aio > 0)
+		return;
+
+	std::vector<struct iovec> bufs;
+	io_buf_registry.lock.lock();
+	bufs = io_buf_registry.bufs;
+	io_buf_registry.lock.unlock();
+	fixed_buf_version = version;
+
+	// Split the memory that is too large for a fixed buffer.
+	std::vector<struct iovec> split_bufs;
+	for (size_t i = 0; i < bufs.size(); i++) {
+		char *base = (char *) bufs[i].iov_base;
+		size_t remain = bufs[i].iov_len;
+		while (remain > 0) {
+			struct iovec vec;
+			vec.iov_base = base;
+			vec.iov_len = std::min(remain, MAX_FIXED_BUF_SIZE);
+			split_bufs.push_back(vec);
+			base += vec.iov_len;
+			remain -= vec.iov_len;
+		}
+	}
+	if (split_bufs.size() > (size_t) MAX_FIXED_BUFS)
+		split_bufs.resize(MAX_FIXED_BUFS);
+	std::sort(split_bufs.begin(), split_bufs.end(), buf_less);
+
+	if (!fixed_bufs.empty()) {
+		io_uring_unregister_buffers(&ring);
+		fixed_bufs.clear();
+	}
+	int ret = io_uring_register_buffers(&ring, split_bufs.data(),
+			split_bufs.size());
+	if (ret < 0) {
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"can't register fixed buffers in io_uring: %1%")
+			% strerror(-ret);
+		use_fixed_bufs = false;
+	}
+	else
+		fixed_bufs = split_bufs;
+}
+
+int uring_ctx_impl::get_fixed_buf_idx(const void *buf, size_t size) const
+{
+	if (fixed_bufs.empty())
+		return -1;
+
+	struct iovec key;
+	key.iov_base = (void *) buf;
+	key.iov_len = size;
+	auto it = std::upper_bound(fixed_bufs.begin(), fixed_bufs.end(), key,
+			buf_less);
+	if (it == fixed_bufs.begin())
+		return -1;
+	it--;
+	const char *start = (const char *) it->iov_base;
+	if ((const char *) buf + size <= start + it->iov_len)
+		return it - fixed_bufs.begin();
+	else
+		return -1;
+}
+
+void uring_ctx_impl::submit_io_request(struct iocb* ioq[], int num)
+{
+	if (use_fixed_bufs)
+		sync_fixed_bufs();
+
+	for (int i = 0; i < num; i++) {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+		// The number of pending requests never exceeds the size of the ring.
+		assert(sqe);
+
+		struct iocb *req = ioq[i];
+		int fd = req->aio_fildes;
+		int slot = get_file_slot(fd);
+		if (slot >= 0)
+			fd = slot;
+		switch (req->aio_lio_opcode) {
+			case IO_CMD_PREAD:
+			case IO_CMD_PWRITE:
+			{
+				bool is_read = req->aio_lio_opcode == IO_CMD_PREAD;
+				int buf_idx = get_fixed_buf_idx(req->u.c.buf, req->u.c.nbytes);
+				if (buf_idx >= 0) {
+					num_fixed_reqs++;
+					if (is_read)
+						io_uring_prep_read_fixed(sqe, fd, req->u.c.buf,
+								req->u.c.nbytes, req->u.c.offset, buf_idx);
+					else
+						io_uring_prep_write_fixed(sqe, fd, req->u.c.buf,
+								req->u.c.nbytes, req->u.c.offset, buf_idx);
+				}
+				else if (is_read)
+					io_uring_prep_read(sqe, fd, req->u.c.buf, req->u.c.nbytes,
+							req->u.c.offset);
+				else
+					io_uring_prep_write(sqe, fd, req->u.c.buf, req->u.c.nbytes,
+							req->u.c.offset);
+				break;
+			}
+			case IO_CMD_PREADV:
+				io_uring_prep_readv(sqe, fd, req->u.v.vec, req->u.v.nr,
+						req->u.v.offset);
+				break;
+			case IO_CMD_PWRITEV:
+				io_uring_prep_writev(sqe, fd, req->u.v.vec, req->u.v.nr,
+						req->u.v.offset);
+				break;
+			default:
+				throw std::invalid_argument("unknown I/O operation");
+		}
+		if (slot >= 0)
+			io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+		io_uring_sqe_set_data(sqe, req);
+	}
+
+	// With SQ polling, the submission doesn't need a system call unless
+	// the kernel thread has gone to sleep. liburing handles it for us.
+	int rc = io_uring_submit(&ring);
+	if (rc < 0)
+		throw std::system_error(std::make_error_code((std::errc) -rc),
+				"io_uring_submit");
+	num_submit_calls++;
+	num_sqes += num;
+	busy_aio += num;
+}
+
+int uring_ctx_impl::io_wait(struct timespec* to, int num)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+	num_wait_calls++;
+	// When we poll the completion queue, we don't wait for anything,
+	// so we only need to peek at the completed requests.
+	bool poll = num == 0 || (to && to->tv_sec == 0 && to->tv_nsec == 0);
+	if (!poll) {
+		do {
+			if (to) {
+				struct __kernel_timespec ts;
+				ts.tv_sec = to->tv_sec;
+				ts.tv_nsec = to->tv_nsec;
+				ret = io_uring_wait_cqes(&ring, &cqe, num, &ts, NULL);
+			}
+			else
+				ret = io_uring_wait_cqe_nr(&ring, &cqe, num);
+		} while (ret == -EINTR);
+		// liburing returns -EAGAIN instead of -ETIME if there is nothing
+		// in the completion queue and it doesn't need to wait.
+		if (ret == -ETIME || ret == -EAGAIN)
+			return 0;
+		if (ret < 0)
+			throw std::system_error(std::make_error_code((std::errc) -ret),
+					"io_wait");
+	}
+
+	struct io_uring_cqe *cqes[max_aio];
+	int n = io_uring_peek_batch_cqe(&ring, cqes, max_aio);
+	struct iocb *iocbs[n];
+	long res[n];
+	long res2[n];
+	io_callback_s *cbs[n];
+	callback_t cb_func = NULL;
+	for (int i = 0; i < n; i++) {
+		iocbs[i] = (struct iocb *) io_uring_cqe_get_data(cqes[i]);
+		cbs[i] = (io_callback_s *) iocbs[i]->data;
+		if (cb_func == NULL)
+			cb_func = cbs[i]->func;
+		assert(cb_func == cbs[i]->func);
+		res[i] = cqes[i]->res;
+		res2[i] = 0;
+	}
+	io_uring_cq_advance(&ring, n);
+	num_cqes += n;
+
+	if (n > 0)
+		cb_func(0, iocbs, (void **) cbs, res, res2, n);
+
+	busy_aio -= n;
+	destroy_io_requests(iocbs, n);
+	return n;
+}
+
+int uring_ctx_impl::max_io_slot()
+{
+	return max_aio - busy_aio;
+}
+
+void uring_ctx_impl::print_stat()
+{
+	printf("\tio_uring: %ld submit calls with %ld sqes (%ld with fixed buffers), %ld wait calls with %ld cqes\n",
+			num_submit_calls, num_sqes, num_fixed_reqs, num_wait_calls,
+			num_cqes);
+}
+
+#endif
+
 }
@@ -30,10 +30,16 @@
 #include <sys/param.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <sys/uio.h>
 #ifdef USE_LIBAIO
 #include <libaio.h>
 #endif
+#ifdef USE_LIBURING
+#include <liburing.h>
+#endif
 #include <system_error>
+#include <vector>
+#include <unordered_map>
 
 #include "slab_allocator.h"
 
@@ -42,7 +48,33 @@
 
 #ifndef USE_LIBAIO
 typedef long io_context_t;
+enum io_iocb_cmd {
+	IO_CMD_PREAD = 0,
+	IO_CMD_PWRITE = 1,
+	IO_CMD_PREADV = 7,
+	IO_CMD_PWRITEV = 8,
+};
+
+/*
+ * Without libaio, we still describe an I/O request with the fields of
+ * the libaio iocb, so the other I/O engines can use the same request.
+ */
 struct iocb {
+	void *data;
+	short aio_lio_opcode;
+	int aio_fildes;
+	union {
+		struct {
+			void *buf;
+			unsigned long nbytes;
+			long long offset;
+		} c;
+		struct {
+			const struct iovec *vec;
+			int nr;
+			long long offset;
+		} v;
+	} u;
 };
 #endif
 
@@ -68,6 +100,14 @@ public:
 	virtual void submit_io_request(struct iocb* ioq[], int num) = 0;
 	virtual int io_wait(struct timespec* to, int num) = 0;
 	virtual int max_io_slot() = 0;
+	/*
+	 * These are invoked when the I/O instance opens or closes physical
+	 * files, so an I/O engine can register the files in the kernel.
+	 */
+	virtual void register_files(const std::vector<int> &fds) {
+	}
+	virtual void unregister_files(const std::vector<int> &fds) {
+	}
 	virtual void print_stat() {
 	}
 };
@@ -99,6 +139,72 @@ public:
 	virtual int max_io_slot();
 };
 
+#ifdef USE_LIBURING
+
+/*
+ * This I/O engine issues requests with io_uring. Requests are still
+ * constructed as iocb, and are translated into submission queue entries
+ * when they are submitted, so a batch of requests is submitted with
+ * a single system call. The physical files are registered in the ring,
+ * and the memory of the page cache can be registered as fixed buffers.
+ */
+class uring_ctx_impl: public aio_ctx
+{
+	int max_aio;
+	int busy_aio;
+	struct io_uring ring;
+
+	// The physical files registered in the ring. file descriptor <-> slot.
+	std::unordered_map<int, int> reg_files;
+	std::vector<int> free_file_slots;
+	bool use_reg_files;
+
+	// The fixed buffers registered in the ring, sorted by the address.
+	std::vector<struct iovec> fixed_bufs;
+	long fixed_buf_version;
+	bool use_fixed_bufs;
+
+	long num_submit_calls;
+	long num_sqes;
+	long num_fixed_reqs;
+	long num_wait_calls;
+	long num_cqes;
+
+	int get_file_slot(int fd) const {
+		auto it = reg_files.find(fd);
+		if (it == reg_files.end())
+			return -1;
+		else
+			return it->second;
+	}
+	int get_fixed_buf_idx(const void *buf, size_t size) const;
+	void sync_fixed_bufs();
+public:
+	uring_ctx_impl(int node_id, int max_aio);
+	~uring_ctx_impl();
+
+	virtual void submit_io_request(struct iocb* ioq[], int num);
+	virtual int io_wait(struct timespec* to, int num);
+	virtual int max_io_slot();
+	virtual void register_files(const std::vector<int> &fds);
+	virtual void unregister_files(const std::vector<int> &fds);
+	virtual void print_stat();
+};
+
+#endif
+
+/*
+ * Create the context of the I/O engine specified in the SAFS parameters.
+ */
+aio_ctx *create_aio_ctx(int node_id, int max_aio);
+
+/*
+ * Memory that is used for I/O for a long time (e.g., the page cache) can
+ * be registered here, so I/O engines can pin the memory in the kernel
+ * in advance.
+ */
+void register_io_buf(void *buf, size_t size);
+
 typedef void (*callback_t) (io_context_t, struct iocb*[],
 		void *[], long *, long *, int);
 
@@ -74,10 +74,13 @@ EM_matrix_store::ptr EM_matrix_store::create(size_t nrow, size_t ncol,
 		return EM_matrix_store::ptr();
 
 	safs::file_io_factory::shared_ptr factory = safs::create_io_factory(
-			holder->get_name(), safs::REMOTE_ACCESS);
+			holder->get_name(), get_access_option());
 	if (factory == NULL)
 		return EM_matrix_store::ptr();
-	io_set::ptr ios = io_set::ptr(new io_set(factory));
+	// A dense matrix is usually streamed once in a computation, so its data
+	// shouldn't evict other data in the page cache.
+	io_set::ptr ios = io_set::ptr(new io_set(factory,
+				safs::ACCESS_HINT_SEQUENTIAL));
 
 	// Store the header as the metadata.
 	std::vector<char> header_buf(matrix_header::get_header_size());
@@ -141,8 +144,8 @@ EM_matrix_store::ptr EM_matrix_store::create(const std::string &mat_file)
 	}
 
 	safs::file_io_factory::shared_ptr factory = safs::create_io_factory(
-			holder->get_name(), safs::REMOTE_ACCESS);
-	io_set::ptr ios(new io_set(factory));
+			holder->get_name(), get_access_option());
+	io_set::ptr ios(new io_set(factory, safs::ACCESS_HINT_SEQUENTIAL));
 
 	// Read the matrix header.
 	safs::safs_file f(safs::get_sys_RAID_conf(), holder->get_name());
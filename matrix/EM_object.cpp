@@ -108,6 +108,11 @@ safs::io_interface::ptr EM_object::io_set::create_io()
 
 		safs::io_interface::ptr io = safs::create_io(factory, t);
 		io->set_callback(portion_callback::ptr(new portion_callback()));
+		io->set_access_hint(access_hint);
+		// Sequential scans of a matrix read a lot of data and don't need
+		// low latency, so they yield to the other I/O.
+		if (access_hint == safs::ACCESS_HINT_SEQUENTIAL)
+			io->set_io_priority(safs::IO_CLASS_BULK);
 		pthread_setspecific(io_key, io.get());
 
 		pthread_spin_lock(&io_lock);
@@ -122,9 +127,11 @@ safs::io_interface::ptr EM_object::io_set::create_io()
 	}
 }
 
-EM_object::io_set::io_set(safs::file_io_factory::shared_ptr factory)
+EM_object::io_set::io_set(safs::file_io_factory::shared_ptr factory,
+		int access_hint)
 {
 	this->factory = factory;
+	this->access_hint = access_hint;
 	int ret = pthread_key_create(&io_key, NULL);
 	assert(ret == 0);
 	pthread_spin_init(&io_lock, PTHREAD_PROCESS_PRIVATE);
@@ -65,9 +65,12 @@ public:
 		std::unordered_map<thread *, safs::io_interface::ptr> thread_ios;
 		pthread_key_t io_key;
 		pthread_spinlock_t io_lock;
+		// The access hint of the I/O instances.
+		int access_hint;
 	public:
 		typedef std::shared_ptr<io_set> ptr;
-		io_set(safs::file_io_factory::shared_ptr factory);
+		io_set(safs::file_io_factory::shared_ptr factory,
+				int access_hint = safs::ACCESS_HINT_NORMAL);
 		~io_set();
 
 		safs::io_interface::ptr create_io();
@@ -79,6 +82,17 @@ public:
 
 	typedef std::shared_ptr<EM_object> ptr;
 	typedef std::shared_ptr<const EM_object> const_ptr;
+
+	/*
+	 * SAFS only reads ahead in the page cache. When read-ahead is enabled,
+	 * EM objects are accessed through the page cache, so streaming them
+	 * is read ahead. Otherwise, they bypass the page cache.
+	 */
+	static int get_access_option() {
+		return safs::params.get_read_ahead_max() > 0
+			? safs::GLOBAL_CACHE_ACCESS : safs::REMOTE_ACCESS;
+	}
+
 	/*
 	 * This creates an I/O instance for the current thread.
 	 */
@@ -245,7 +245,7 @@ EM_vec_store::EM_vec_store(size_t length, const scalar_type &type): vec_store(
 	// TODO I should provide an SAFS file group.
 	holder = file_holder::create_temp("vec", length * type.get_size(), NULL);
 	safs::file_io_factory::shared_ptr factory = safs::create_io_factory(
-			holder->get_name(), safs::REMOTE_ACCESS);
+			holder->get_name(), get_access_option());
 	ios = io_set::ptr(new io_set(factory));
 	file_size = length * type.get_size();
 }
@@ -1623,7 +1623,7 @@ bool EM_vec_store::set_persistent(const std::string &name)
 	// TODO we have to make sure no other threads are accessing the data
 	// in the vector. How can we do that?
 	safs::file_io_factory::shared_ptr factory = safs::create_io_factory(
-			holder->get_name(), safs::REMOTE_ACCESS);
+			holder->get_name(), get_access_option());
 	ios = io_set::ptr(new io_set(factory));
 	return true;
 }
@@ -25,6 +25,7 @@
 #include <boost/format.hpp>
 
 #include "thread.h"
+#include "io_interface.h"
 
 #include "mem_worker_thread.h"
 #include "raw_data_array.h"
@@ -63,14 +64,21 @@ public:
 #else
 		free(addr);
 #endif
+		safs::release_memory(size);
 	}
 };
 
 class aligned_deleter
 {
+	size_t size;
 public:
+	aligned_deleter(size_t size) {
+		this->size = size;
+	}
+
 	void operator()(char *addr) {
 		free(addr);
+		safs::release_memory(size);
 	}
 };
 
@@ -81,6 +89,8 @@ std::shared_ptr<char> memalloc_node(int node_id, bool is_local, size_t num_bytes
 
 	std::shared_ptr<char> ret;
 	if (node_id >= 0) {
+		// Let SAFS shrink the page cache if we run out of the memory budget.
+		safs::reserve_memory(num_bytes);
 #ifdef USE_NUMA
 		void *addr = numa_alloc_onnode(num_bytes, node_id);
 #else
@@ -95,11 +105,13 @@ std::shared_ptr<char> memalloc_node(int node_id, bool is_local, size_t num_bytes
 		if (is_local)
 			ret = local_mem_buffer::alloc(num_bytes);
 		if (ret == NULL) {
+			safs::reserve_memory(num_bytes);
 			void *addr = NULL;
 			int ret_val = posix_memalign(&addr, PAGE_SIZE, num_bytes);
 			assert(ret_val == 0);
 			assert(((long) ret.get()) % 512 == 0);
-			ret = std::shared_ptr<char>((char *) addr, aligned_deleter());
+			ret = std::shared_ptr<char>((char *) addr,
+					aligned_deleter(num_bytes));
 		}
 	}
 	assert(ret);
@@ -243,6 +255,7 @@ static std::shared_ptr<char> memchunk_alloc(int node_id, size_t num_bytes)
 	}
 	else if (node_id < 0) {
 		smp_reserved_bytes += num_bytes;
+		safs::reserve_memory(num_bytes);
 		void *addr = NULL;
 		int ret_val = posix_memalign(&addr, PAGE_SIZE, num_bytes);
 		assert(ret_val == 0);
@@ -261,6 +274,7 @@ static std::shared_ptr<char> memchunk_alloc(int node_id, size_t num_bytes)
 	}
 	else {
 		reserved_bytes += num_bytes;
+		safs::reserve_memory(num_bytes);
 #ifdef USE_NUMA
 		void *addr = numa_alloc_onnode(num_bytes, node_id);
 #else
@@ -314,6 +328,7 @@ void destroy_memchunk_reserve()
 #else
 			free(reserved_chunks[i][j]);
 #endif
+	safs::release_memory(reserved_bytes + smp_reserved_bytes);
 	reserved_bytes = 0;
 	smp_reserved_bytes = 0;
 }
@@ -19,9 +19,14 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <errno.h>
 
 #include <string>
+#include <deque>
 #include <boost/format.hpp>
 
 #include "io_interface.h"
@@ -201,6 +206,65 @@ void comm_verify_file(int argc, char *argv[])
 	io->cleanup();
 }
 
+/*
+ * Read the entire file and verify it with the checksums stored with it.
+ * Unlike the verification in I/O threads, it reports all corrupted blocks.
+ */
+void comm_scrub_file(int argc, char *argv[])
+{
+	if (argc < 1) {
+		fprintf(stderr, "scrub file_name\n");
+		fprintf(stderr, "file_name is the file name in the SA-FS file system\n");
+		exit(-1);
+	}
+
+	std::string file_name = argv[0];
+	// We verify the data here.
+	configs->add_options("verify_checksum=0");
+	init_io_system(configs, false);
+	safs_file file(get_sys_RAID_conf(), file_name);
+	block_checksum_table::ptr sums = file.get_checksum_table();
+	if (sums == NULL) {
+		fprintf(stderr, "%s doesn't have checksums\n", file_name.c_str());
+		exit(-1);
+	}
+
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	thread *curr_thread = thread::get_curr_thread();
+	assert(curr_thread);
+	io_interface::ptr io = create_io(factory, curr_thread);
+	const size_t block_size = sums->get_block_size();
+	const size_t buf_size = std::max(BUF_SIZE / block_size, 1UL) * block_size;
+	const off_t file_size = sums->get_num_blocks() * block_size;
+	char *buf = (char *) valloc(buf_size);
+	size_t num_corrupted = 0;
+	for (off_t off = 0; off < file_size; off += buf_size) {
+		size_t size = std::min<size_t>(buf_size, file_size - off);
+		data_loc_t loc(io->get_file_id(), off);
+		io_request req(buf, loc, ROUNDUP(size, 512), READ);
+		io->access(&req, 1);
+		io->wait4complete(1);
+
+		off_t start = off;
+		while (start < off + (off_t) size) {
+			struct iovec vec;
+			vec.iov_base = buf + (start - off);
+			vec.iov_len = off + size - start;
+			off_t bad_off = sums->verify(start, &vec, 1);
+			if (bad_off < 0)
+				break;
+			printf("the block at %ld is corrupted\n", bad_off);
+			num_corrupted++;
+			start = bad_off + block_size;
+		}
+	}
+	printf("verify %ld blocks of %ld bytes, %ld blocks are corrupted\n",
+			sums->get_num_blocks(), block_size, num_corrupted);
+	free(buf);
+	io->cleanup();
+}
+
 void comm_load_file2fs(int argc, char *argv[])
 {
 	if (argc < 2) {
@@ -228,6 +292,42 @@ void comm_load_file2fs(int argc, char *argv[])
 	assert(ret);
 }
 
+void comm_load_compressed_file2fs(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "load_compressed file_name ext_file [block_size] [codec]\n");
+		fprintf(stderr, "file_name is the file name in the SA-FS file system\n");
+		fprintf(stderr, "ext_file is the file in the external file system\n");
+		fprintf(stderr, "codec is lz (default) or delta. lz compresses each RAID block. delta compresses each page and is designed for the adjacency list files of FlashGraph\n");
+		exit(-1);
+	}
+
+	std::string int_file_name = argv[0];
+	std::string ext_file = argv[1];
+	configs->add_options("writable=1");
+	init_io_system(configs, false);
+
+	size_t block_size = params.get_RAID_block_size();
+	if (argc >= 3) {
+		block_size = str2size(argv[2]);
+		// block_size is the number of pages.
+		block_size /= PAGE_SIZE;
+	}
+	printf("RAID block size is %ld pages\n", block_size);
+	int codec = COMPRESS_LZ;
+	if (argc >= 4) {
+		codec = get_codec(argv[3]);
+		if (codec < 0) {
+			fprintf(stderr, "unknown codec %s\n", argv[3]);
+			exit(-1);
+		}
+	}
+
+	safs_file file(get_sys_RAID_conf(), int_file_name);
+	bool ret = file.load_data(ext_file, block_size, codec);
+	assert(ret);
+}
+
 void comm_load_part_file2fs(int argc, char *argv[])
 {
 	if (argc < 3) {
@@ -446,6 +546,414 @@ void comm_export(int argc, char *argv[])
 	fclose(f);
 }
 
+/*
+ * The parallel load and export move data in chunks. Multiple threads read
+ * or write the file in the Linux filesystem with direct I/O, and the main
+ * thread keeps many chunks in flight in SAFS, whose I/O threads access
+ * all disks in the RAID in parallel.
+ */
+const size_t PARALLEL_CHUNK_SIZE = 64 * 1024 * 1024;
+
+struct data_chunk
+{
+	off_t off;
+	size_t size;
+	char *buf;
+
+	data_chunk() {
+		off = 0;
+		size = 0;
+		buf = NULL;
+	}
+};
+
+/*
+ * A blocking queue of chunks shared by the threads of the parallel
+ * load and export.
+ */
+class chunk_queue
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	std::deque<data_chunk> chunks;
+public:
+	chunk_queue() {
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&cond, NULL);
+	}
+
+	~chunk_queue() {
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&lock);
+	}
+
+	void push(const data_chunk &chunk) {
+		pthread_mutex_lock(&lock);
+		chunks.push_back(chunk);
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+
+	data_chunk pop() {
+		pthread_mutex_lock(&lock);
+		while (chunks.empty())
+			pthread_cond_wait(&cond, &lock);
+		data_chunk chunk = chunks.front();
+		chunks.pop_front();
+		pthread_mutex_unlock(&lock);
+		return chunk;
+	}
+
+	bool try_pop(data_chunk &chunk) {
+		pthread_mutex_lock(&lock);
+		bool ret = !chunks.empty();
+		if (ret) {
+			chunk = chunks.front();
+			chunks.pop_front();
+		}
+		pthread_mutex_unlock(&lock);
+		return ret;
+	}
+};
+
+/*
+ * Open a file with direct I/O. Some filesystems (e.g., tmpfs) don't
+ * support direct I/O, so we fall back to buffered I/O.
+ */
+int open_direct(const std::string &file, int flags)
+{
+	int fd = open(file.c_str(), flags | O_DIRECT, 0644);
+	if (fd < 0 && errno == EINVAL)
+		fd = open(file.c_str(), flags, 0644);
+	if (fd < 0)
+		fprintf(stderr, "can't open %s: %s\n", file.c_str(), strerror(errno));
+	return fd;
+}
+
+/*
+ * Direct I/O requires the sizes of reads and writes to be aligned to
+ * the logical block size of the device. For a file in a filesystem,
+ * the block size of the filesystem is a multiple of it.
+ */
+size_t get_direct_io_align(int fd)
+{
+	size_t align = 512;
+	struct stat st;
+	int size;
+	if (fstat(fd, &st) == 0) {
+		if (S_ISBLK(st.st_mode) && ioctl(fd, BLKSSZGET, &size) == 0)
+			align = size;
+		else if (!S_ISBLK(st.st_mode))
+			align = std::max<size_t>(st.st_blksize, align);
+	}
+	// The chunks start at multiples of the chunk size.
+	assert(PARALLEL_CHUNK_SIZE % align == 0);
+	return align;
+}
+
+/*
+ * Get a free buffer. We have to process the completed requests in SAFS
+ * while waiting, because they return buffers.
+ */
+data_chunk get_free_chunk(chunk_queue &free_bufs, io_interface &io)
+{
+	data_chunk chunk;
+	while (!free_bufs.try_pop(chunk)) {
+		if (io.num_pending_ios() > 0)
+			io.wait4complete(1);
+		else
+			return free_bufs.pop();
+	}
+	return chunk;
+}
+
+struct parallel_load_state
+{
+	int fd;
+	// The alignment of reads from the file.
+	size_t align;
+	size_t file_size;
+	size_t num_chunks;
+	atomic_number<size_t> next_chunk;
+	chunk_queue free_bufs;
+	chunk_queue read_chunks;
+};
+
+void *read_chunks(void *arg)
+{
+	parallel_load_state *state = (parallel_load_state *) arg;
+	while (true) {
+		size_t idx = state->next_chunk.inc(1) - 1;
+		if (idx >= state->num_chunks)
+			break;
+		data_chunk chunk = state->free_bufs.pop();
+		chunk.off = idx * PARALLEL_CHUNK_SIZE;
+		chunk.size = min(PARALLEL_CHUNK_SIZE, state->file_size - chunk.off);
+		// Direct I/O requires the read size to be aligned.
+		size_t read_size = ROUNDUP(chunk.size, state->align);
+		size_t bytes = 0;
+		while (bytes < chunk.size) {
+			ssize_t ret = pread(state->fd, chunk.buf + bytes, read_size - bytes,
+					chunk.off + bytes);
+			if (ret <= 0) {
+				fprintf(stderr, "can't read %ld bytes at %ld: %s\n",
+						chunk.size, chunk.off, ret < 0 ? strerror(errno) : "EOF");
+				exit(-1);
+			}
+			bytes += ret;
+		}
+		state->read_chunks.push(chunk);
+	}
+	return NULL;
+}
+
+/*
+ * Return the buffer of a chunk when the chunk is written to or read from
+ * SAFS. The parallel export passes the data to writer threads.
+ */
+class chunk_callback: public callback
+{
+	chunk_queue &queue;
+	size_t file_size;
+public:
+	chunk_callback(chunk_queue &_queue, size_t file_size): queue(_queue) {
+		this->file_size = file_size;
+	}
+
+	int invoke(io_request *reqs[], int num) {
+		for (int i = 0; i < num; i++) {
+			if (reqs[i]->is_failed()) {
+				fprintf(stderr, "can't %s %ld bytes at %ld in SAFS\n",
+						reqs[i]->get_access_method() == READ ? "read" : "write",
+						reqs[i]->get_size(), reqs[i]->get_offset());
+				exit(-1);
+			}
+			data_chunk chunk;
+			chunk.off = reqs[i]->get_offset();
+			chunk.size = min<size_t>(reqs[i]->get_size(),
+					file_size - chunk.off);
+			chunk.buf = reqs[i]->get_buf();
+			queue.push(chunk);
+		}
+		return 0;
+	}
+};
+
+int get_num_parallel_threads(int argc, char *argv[], int idx)
+{
+	int num_threads = get_sys_RAID_conf().get_num_disks();
+	if (argc > idx)
+		num_threads = atoi(argv[idx]);
+	return std::max(num_threads, 1);
+}
+
+void comm_load_parallel(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "load_parallel file_name ext_file [num_threads]\n");
+		fprintf(stderr, "file_name is the file name in the SA-FS file system\n");
+		fprintf(stderr, "ext_file is the file in the external file system\n");
+		fprintf(stderr, "num_threads is the number of threads reading ext_file\n");
+		exit(-1);
+	}
+
+	std::string int_file_name = argv[0];
+	std::string ext_file = argv[1];
+	configs->add_options("writable=1");
+	init_io_system(configs, false);
+	int num_threads = get_num_parallel_threads(argc, argv, 2);
+
+	parallel_load_state state;
+	state.fd = open_direct(ext_file, O_RDONLY);
+	if (state.fd < 0)
+		exit(-1);
+	state.align = get_direct_io_align(state.fd);
+	state.file_size = native_file(ext_file).get_size();
+	state.num_chunks = ROUNDUP(state.file_size, PARALLEL_CHUNK_SIZE)
+		/ PARALLEL_CHUNK_SIZE;
+
+	safs_file file(get_sys_RAID_conf(), int_file_name);
+	if (!file.exist())
+		file.create_file(state.file_size);
+	// The tables of the old data are invalid.
+	if (!file.remove_compress_table() || !file.remove_checksum_table())
+		exit(-1);
+	std::unique_ptr<block_checksum_table> sums;
+	size_t checksum_block = params.get_checksum_block_size();
+	if (checksum_block > 0 && PARALLEL_CHUNK_SIZE % checksum_block == 0)
+		sums = std::unique_ptr<block_checksum_table>(
+				new block_checksum_table(checksum_block));
+	else if (checksum_block > 0)
+		fprintf(stderr, "checksums of %ld-byte blocks aren't computed\n",
+				checksum_block);
+
+	file_io_factory::shared_ptr factory = create_io_factory(int_file_name,
+			REMOTE_ACCESS);
+	assert((size_t) factory->get_file_size() >= state.file_size);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	io->set_callback(callback::ptr(new chunk_callback(state.free_bufs,
+					state.file_size)));
+
+	// Each thread can read a chunk while the other chunks are written.
+	std::vector<char *> bufs(num_threads * 2);
+	for (size_t i = 0; i < bufs.size(); i++) {
+		data_chunk chunk;
+		chunk.buf = (char *) valloc(PARALLEL_CHUNK_SIZE);
+		bufs[i] = chunk.buf;
+		state.free_bufs.push(chunk);
+	}
+	std::vector<pthread_t> threads(num_threads);
+	for (int i = 0; i < num_threads; i++)
+		BOOST_VERIFY(pthread_create(&threads[i], NULL, read_chunks,
+					&state) == 0);
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	for (size_t i = 0; i < state.num_chunks; i++) {
+		data_chunk chunk;
+		while (!state.read_chunks.try_pop(chunk)) {
+			if (io->num_pending_ios() > 0)
+				io->wait4complete(1);
+			else {
+				chunk = state.read_chunks.pop();
+				break;
+			}
+		}
+		if (sums) {
+			for (size_t off = 0; off + checksum_block <= chunk.size;
+					off += checksum_block)
+				sums->set_checksum((chunk.off + off) / checksum_block,
+						crc32c(0, chunk.buf + off, checksum_block));
+		}
+		// The physical storage size of SAFS is always rounded to
+		// the page size, which is a multiple of the logical block size
+		// of the disks.
+		size_t write_size = ROUNDUP(chunk.size, PAGE_SIZE);
+		memset(chunk.buf + chunk.size, 0, write_size - chunk.size);
+		data_loc_t loc(io->get_file_id(), chunk.off);
+		io_request req(chunk.buf, loc, write_size, WRITE);
+		io->access(&req, 1);
+	}
+	while (io->num_pending_ios() > 0)
+		io->wait4complete(io->num_pending_ios());
+	gettimeofday(&end, NULL);
+	for (int i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+	io->cleanup();
+	close(state.fd);
+	for (size_t i = 0; i < bufs.size(); i++)
+		free(bufs[i]);
+	printf("load %ld bytes with %d threads in %.3f seconds\n",
+			state.file_size, num_threads, time_diff(start, end));
+	if (sums && !file.set_checksum_table(*sums))
+		exit(-1);
+}
+
+struct parallel_export_state
+{
+	int fd;
+	// The alignment of writes to the file.
+	size_t align;
+	chunk_queue free_bufs;
+	chunk_queue read_chunks;
+};
+
+void *write_chunks(void *arg)
+{
+	parallel_export_state *state = (parallel_export_state *) arg;
+	while (true) {
+		data_chunk chunk = state->read_chunks.pop();
+		// A chunk without a buffer tells the thread to exit.
+		if (chunk.buf == NULL)
+			break;
+		// Direct I/O requires the write size to be aligned. The file is
+		// truncated to its real size in the end.
+		size_t write_size = ROUNDUP(chunk.size, state->align);
+		size_t bytes = 0;
+		while (bytes < write_size) {
+			ssize_t ret = pwrite(state->fd, chunk.buf + bytes,
+					write_size - bytes, chunk.off + bytes);
+			if (ret < 0) {
+				fprintf(stderr, "can't write %ld bytes at %ld: %s\n",
+						write_size, chunk.off, strerror(errno));
+				exit(-1);
+			}
+			bytes += ret;
+		}
+		state->free_bufs.push(chunk);
+	}
+	return NULL;
+}
+
+void comm_export_parallel(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "export_parallel file_name ext_file [num_threads]\n");
+		fprintf(stderr, "num_threads is the number of threads writing ext_file\n");
+		exit(-1);
+	}
+
+	std::string file_name = argv[0];
+	std::string ext_file = argv[1];
+	init_io_system(configs, false);
+	int num_threads = get_num_parallel_threads(argc, argv, 2);
+
+	parallel_export_state state;
+	state.fd = open_direct(ext_file, O_WRONLY | O_CREAT | O_TRUNC);
+	if (state.fd < 0)
+		exit(-1);
+	state.align = get_direct_io_align(state.fd);
+
+	file_io_factory::shared_ptr io_factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(io_factory, thread::get_curr_thread());
+	size_t file_size = io_factory->get_header().get_size();
+	if (file_size == 0)
+		file_size = io_factory->get_file_size();
+	io->set_callback(callback::ptr(new chunk_callback(state.read_chunks,
+					file_size)));
+
+	std::vector<char *> bufs(num_threads * 2);
+	for (size_t i = 0; i < bufs.size(); i++) {
+		data_chunk chunk;
+		chunk.buf = (char *) valloc(PARALLEL_CHUNK_SIZE);
+		bufs[i] = chunk.buf;
+		state.free_bufs.push(chunk);
+	}
+	std::vector<pthread_t> threads(num_threads);
+	for (int i = 0; i < num_threads; i++)
+		BOOST_VERIFY(pthread_create(&threads[i], NULL, write_chunks,
+					&state) == 0);
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	for (size_t off = 0; off < file_size; off += PARALLEL_CHUNK_SIZE) {
+		data_chunk chunk = get_free_chunk(state.free_bufs, *io);
+		// The physical storage size of SAFS is always rounded to
+		// the page size, so we can read whole pages.
+		size_t read_size = ROUNDUP(min(PARALLEL_CHUNK_SIZE, file_size - off),
+				PAGE_SIZE);
+		data_loc_t loc(io->get_file_id(), off);
+		io_request req(chunk.buf, loc, read_size, READ);
+		io->access(&req, 1);
+	}
+	while (io->num_pending_ios() > 0)
+		io->wait4complete(io->num_pending_ios());
+	for (int i = 0; i < num_threads; i++)
+		state.read_chunks.push(data_chunk());
+	for (int i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+	gettimeofday(&end, NULL);
+	io->cleanup();
+	if (ftruncate(state.fd, file_size) < 0)
+		perror("ftruncate");
+	close(state.fd);
+	for (size_t i = 0; i < bufs.size(); i++)
+		free(bufs[i]);
+	printf("export %ld bytes with %d threads in %.3f seconds\n",
+			file_size, num_threads, time_diff(start, end));
+}
+
 void comm_show_info(int argc, char *argv[])
 {
 	if (argc < 1) {
@@ -463,6 +971,24 @@ void comm_show_info(int argc, char *argv[])
 	printf("RAID block size: %d\n", header.get_block_size() * PAGE_SIZE);
 	printf("RAID mapping option: %d\n", header.get_mapping_option());
 	printf("file size: %ld\n", header.get_size());
+	safs_file file(get_sys_RAID_conf(), file_name);
+	std::vector<int> weights = file.get_disk_weights();
+	if (!weights.empty()) {
+		printf("disk weights:");
+		for (size_t i = 0; i < weights.size(); i++)
+			printf(" %d", weights[i]);
+		printf("\n");
+	}
+
+	block_compress_table::ptr table = file.get_compress_table();
+	if (table)
+		printf("%ld of %ld blocks are compressed to %ld bytes\n",
+				table->get_num_compressed_blocks(), table->get_num_blocks(),
+				table->get_tot_compressed_bytes());
+	block_checksum_table::ptr sums = file.get_checksum_table();
+	if (sums)
+		printf("%ld blocks of %ld bytes have checksums\n",
+				sums->get_num_blocks(), sums->get_block_size());
 }
 
 void comm_rename(int argc, char *argv[])
@@ -506,12 +1032,20 @@ struct command commands[] = {
 	{"list", comm_list, "list: list existing files in SAFS"},
 	{"load", comm_load_file2fs,
 		"load file_name [ext_file]: load data to the file"},
+	{"load_compressed", comm_load_compressed_file2fs,
+		"load_compressed file_name ext_file [block_size] [codec]: load data to the file and compress it"},
+	{"load_parallel", comm_load_parallel,
+		"load_parallel file_name ext_file [num_threads]: load data to the file with multiple threads"},
 	{"load_part", comm_load_part_file2fs,
 		"load_part file_name ext_file part_id: load part of the file to SAFS"},
 	{"verify", comm_verify_file,
 		"verify file_name [ext_file]: verify data in the file"},
+	{"scrub", comm_scrub_file,
+		"scrub file_name: verify the file with its checksums"},
 	{"export", comm_export,
 		"export file_name ext_file: export an SAFS file to Linux filesystem"},
+	{"export_parallel", comm_export_parallel,
+		"export_parallel file_name ext_file [num_threads]: export an SAFS file with multiple threads"},
 	{"info", comm_show_info,
 		"info file_name: show the information of an SAFS file"},
 	{"rename", comm_rename,